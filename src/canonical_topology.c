@@ -0,0 +1,297 @@
+/* 
+
+Copyright (c) 2009 Thomas Junier and Evgeny Zdobnov, University of Geneva
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+* Neither the name of the University of Geneva nor the names of its
+    contributors may be used to endorse or promote products derived from this
+    software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "tree.h"
+#include "rnode.h"
+#include "list.h"
+#include "hash.h"
+#include "common.h"
+#include "canonical_topology.h"
+
+/* Pattern IDs start at 1. In the target, 0 means that there is no pattern leaf
+ * below the node. */
+
+static const int NO_PATTERN_LEAF = 0;
+
+struct canonical_topology {
+	struct hash *leaf_ids;	/* leaf label -> int* */
+	struct hash *node_ids;	/* key (see node_key()) -> int* */
+	/* Storage for the IDs the hashes point to: one block per pattern */
+	struct llist *id_blocks;
+	int next_id;
+	int *root_ids;		/* one per pattern */
+	int pattern_count;
+	/* Work space, reused from one target tree to the next. The stack holds
+	 * the IDs of the nodes visited so far whose parent has not been
+	 * visited yet. */
+	int *stack;
+	int stack_size;
+	char *key;
+	int key_size;
+};
+
+static int int_comparator(const void *a, const void *b)
+{
+	return *((int *) a) - *((int *) b);
+}
+
+/* Makes sure that the stack can hold 'size' elements */
+
+static int reserve_stack(struct canonical_topology *ct, int size)
+{
+	if (size <= ct->stack_size) return SUCCESS;
+	int *stack = realloc(ct->stack, size * sizeof(int));
+	if (NULL == stack) return FAILURE;
+	ct->stack = stack;
+	ct->stack_size = size;
+	return SUCCESS;
+}
+
+/* Sorts the 'n' children IDs in 'kids' and writes them to ct->key, in the form
+ * "2,5,7,". The order of the children thus does not matter. */
+/* Returns FAILURE iff there is a malloc() problem. */
+
+static int node_key(struct canonical_topology *ct, int *kids, int n)
+{
+	/* 11 characters for an int, plus the comma, plus the final '\0' */
+	int size = 12 * n + 1;
+	if (size > ct->key_size) {
+		char *key = realloc(ct->key, size);
+		if (NULL == key) return FAILURE;
+		ct->key = key;
+		ct->key_size = size;
+	}
+
+	qsort(kids, n, sizeof(int), int_comparator);
+	char *p = ct->key;
+	int i;
+	for (i = 0; i < n; i++)
+		p += sprintf(p, "%d,", kids[i]);
+
+	return SUCCESS;
+}
+
+/* Computes the pattern's IDs, adding those it doesn't share with previous
+ * patterns. Returns the ID of the pattern's root, or -1 in case of malloc()
+ * problem. */
+
+static int compile_pattern(struct canonical_topology *ct,
+		struct rooted_tree *pattern)
+{
+	int count = pattern->nodes_in_order->count;
+	if (! reserve_stack(ct, count)) return -1;
+	int *ids = malloc(count * sizeof(int));
+	if (NULL == ids) return -1;
+	if (! append_element(ct->id_blocks, ids)) return -1;
+
+	struct list_elem *el;
+	int n_ids = 0;
+	int sp = 0;	/* stack pointer */
+	for (el = pattern->nodes_in_order->head; NULL != el; el = el->next) {
+		struct rnode *current = el->data;
+		int *id;
+		if (is_leaf(current)) {
+			/* Empty labels get an ID, but can't be looked up: a
+			 * pattern with unlabeled leaves matches nothing. */
+			id = NULL;
+			if ('\0' != current->label[0])
+				id = hash_get(ct->leaf_ids, current->label);
+			if (NULL == id) {
+				id = &(ids[n_ids++]);
+				*id = ++ct->next_id;
+				if ('\0' != current->label[0])
+					if (! hash_set(ct->leaf_ids,
+							current->label, id))
+						return -1;
+			}
+			ct->stack[sp++] = *id;
+			continue;
+		}
+
+		int n = current->child_count;
+		sp -= n;
+		/* A node with a single child has its child's ID. */
+		if (1 == n) {
+			sp++;
+			continue;
+		}
+		if (! node_key(ct, ct->stack + sp, n)) return -1;
+		id = hash_get(ct->node_ids, ct->key);
+		if (NULL == id) {
+			id = &(ids[n_ids++]);
+			*id = ++ct->next_id;
+			if (! hash_set(ct->node_ids, ct->key, id))
+				return -1;
+		}
+		ct->stack[sp++] = *id;
+	}
+
+	return ct->stack[0];
+}
+
+struct canonical_topology *create_canonical_topology(
+		struct rooted_tree *pattern)
+{
+	int count = pattern->nodes_in_order->count;
+
+	struct canonical_topology *ct = malloc(sizeof(struct canonical_topology));
+	if (NULL == ct) return NULL;
+	ct->leaf_ids = create_hash(count);
+	if (NULL == ct->leaf_ids) return NULL;
+	ct->node_ids = create_hash(count);
+	if (NULL == ct->node_ids) return NULL;
+	ct->id_blocks = create_llist();
+	if (NULL == ct->id_blocks) return NULL;
+	ct->next_id = 0;
+	ct->root_ids = NULL;
+	ct->pattern_count = 0;
+	ct->stack = NULL;
+	ct->stack_size = 0;
+	ct->key = NULL;
+	ct->key_size = 0;
+
+	if (add_canonical_pattern(ct, pattern) < 0) return NULL;
+
+	return ct;
+}
+
+int add_canonical_pattern(struct canonical_topology *ct,
+		struct rooted_tree *pattern)
+{
+	int *root_ids = realloc(ct->root_ids,
+			(ct->pattern_count + 1) * sizeof(int));
+	if (NULL == root_ids) return -1;
+	ct->root_ids = root_ids;
+
+	int root_id = compile_pattern(ct, pattern);
+	if (root_id < 0) return -1;
+	ct->root_ids[ct->pattern_count] = root_id;
+
+	return ct->pattern_count++;
+}
+
+int canonical_pattern_count(struct canonical_topology *ct)
+{
+	return ct->pattern_count;
+}
+
+/* Returns the ID of the target's topology restricted to the patterns' leaves,
+ * UNKNOWN_TOPOLOGY if it has a clade that isn't among the patterns', or
+ * ERROR_TOPOLOGY in case of malloc() problem. */
+
+static const int UNKNOWN_TOPOLOGY = -1;
+static const int ERROR_TOPOLOGY = -2;
+
+static int restricted_topology_id(struct canonical_topology *ct,
+		struct rooted_tree *target)
+{
+	if (! reserve_stack(ct, target->nodes_in_order->count))
+		return ERROR_TOPOLOGY;
+
+	struct list_elem *el;
+	int sp = 0;
+	for (el = target->nodes_in_order->head; NULL != el; el = el->next) {
+		struct rnode *current = el->data;
+		if (is_leaf(current)) {
+			int *id = NULL;
+			if ('\0' != current->label[0])
+				id = hash_get(ct->leaf_ids, current->label);
+			ct->stack[sp++] = (NULL == id) ? NO_PATTERN_LEAF : *id;
+			continue;
+		}
+
+		/* Only children with pattern leaves below them count. */
+		int n = current->child_count;
+		int *kids = ct->stack + (sp - n);
+		int i, relevant = 0;
+		for (i = 0; i < n; i++)
+			if (NO_PATTERN_LEAF != kids[i])
+				kids[relevant++] = kids[i];
+		sp -= n;
+
+		if (relevant <= 1) {
+			/* either no pattern leaf at all, or a single child
+			 * that stands for this node (which would be spliced
+			 * out when pruning) */
+			ct->stack[sp++] = (0 == relevant) ?
+				NO_PATTERN_LEAF : kids[0];
+			continue;
+		}
+		if (! node_key(ct, kids, relevant)) return ERROR_TOPOLOGY;
+		int *id = hash_get(ct->node_ids, ct->key);
+		/* This clade isn't in any pattern: no need to look further. */
+		if (NULL == id) return UNKNOWN_TOPOLOGY;
+		ct->stack[sp++] = *id;
+	}
+
+	return ct->stack[0];
+}
+
+enum canonical_match match_canonical_topology(struct canonical_topology *ct,
+		struct rooted_tree *target)
+{
+	int id = restricted_topology_id(ct, target);
+	if (ERROR_TOPOLOGY == id) return CANON_ERROR;
+	return (ct->root_ids[0] == id) ? CANON_MATCH : CANON_NO_MATCH;
+}
+
+enum canonical_match match_canonical_patterns(struct canonical_topology *ct,
+		struct rooted_tree *target, bool *matches)
+{
+	int id = restricted_topology_id(ct, target);
+	if (ERROR_TOPOLOGY == id) return CANON_ERROR;
+
+	enum canonical_match result = CANON_NO_MATCH;
+	int i;
+	for (i = 0; i < ct->pattern_count; i++) {
+		matches[i] = (ct->root_ids[i] == id);
+		if (matches[i]) result = CANON_MATCH;
+	}
+
+	return result;
+}
+
+void destroy_canonical_topology(struct canonical_topology *ct)
+{
+	struct list_elem *el;
+	for (el = ct->id_blocks->head; NULL != el; el = el->next)
+		free(el->data);
+	destroy_llist(ct->id_blocks);
+	destroy_hash(ct->leaf_ids);
+	destroy_hash(ct->node_ids);
+	free(ct->root_ids);
+	free(ct->stack);
+	free(ct->key);
+	free(ct);
+}
@@ -0,0 +1,83 @@
+/* 
+
+Copyright (c) 2009 Thomas Junier and Evgeny Zdobnov, University of Geneva
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+* Neither the name of the University of Geneva nor the names of its
+    contributors may be used to endorse or promote products derived from this
+    software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+/* canonical_topology.h: deciding whether a tree, restricted to the leaves of
+ * a pattern tree, has the same (rooted) topology as the pattern - without
+ * pruning, ordering or cloning the tree. */
+
+/* The pattern is compiled once: each leaf label gets an ID, and so does each
+ * inner node, keyed by the sorted IDs of its children (as in the
+ * Aho-Hopcroft-Ullman tree isomorphism algorithm). The target is then visited
+ * in postorder, computing the same IDs over the pattern's leaves only: leaves
+ * whose labels are not in the pattern are ignored, and so are nodes left with
+ * a single relevant child. As soon as a node's key is not found among the
+ * pattern's, the target is known not to match. Inner node labels and branch
+ * lengths are ignored in both trees. */
+
+#include <stdbool.h>
+
+struct rooted_tree;
+
+enum canonical_match { CANON_MATCH, CANON_NO_MATCH, CANON_ERROR };
+
+struct canonical_topology;
+
+/* Compiles a pattern tree. Leaves are assumed to have unique labels. */
+/* Returns NULL in case of malloc() problem. */
+
+struct canonical_topology *create_canonical_topology(
+		struct rooted_tree *pattern);
+
+/* Adds another pattern, which must have the same leaf labels as the first
+ * one. Patterns share their IDs, so that a target is visited only once for all
+ * of them (see match_canonical_patterns()). Returns the pattern's number (the
+ * first pattern is number 0), or -1 in case of malloc() problem. */
+
+int add_canonical_pattern(struct canonical_topology *,
+		struct rooted_tree *pattern);
+
+/* Returns the number of patterns */
+
+int canonical_pattern_count(struct canonical_topology *);
+
+/* Returns CANON_MATCH iff 'target', restricted to the pattern's leaf labels,
+ * has the same topology as the (first) pattern; CANON_NO_MATCH otherwise, and
+ * CANON_ERROR in case of malloc() problem. 'target' is not modified. */
+
+enum canonical_match match_canonical_topology(struct canonical_topology *,
+		struct rooted_tree *target);
+
+/* Like match_canonical_topology(), but for all patterns at once: sets
+ * matches[i] to true iff 'target' matches pattern number i. Returns
+ * CANON_MATCH iff at least one pattern matches. */
+
+enum canonical_match match_canonical_patterns(struct canonical_topology *,
+		struct rooted_tree *target, bool *matches);
+
+void destroy_canonical_topology(struct canonical_topology *);
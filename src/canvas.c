@@ -506,6 +506,18 @@ void canvas_dump(struct canvas *canvasp)
 }
 
 
+void canvas_clear(struct canvas *canvasp)
+{
+	int line;
+
+	/* Lines can only have grown (see vt100_canvas_write()), so there is
+	 * always room for 'width' characters. */
+	for (line = 0; line < canvasp->height; line++) {
+		memset(canvasp->lines[line], ' ', canvasp->width);
+		canvasp->lines[line][canvasp->width] = '\0';
+	}
+}
+
 void canvas_inspect(struct canvas* canvasp)
 {
 	int line;
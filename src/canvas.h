@@ -153,6 +153,11 @@ void canvas_decorate_leaf(struct canvas *canvas, int col, int line);
 
 void canvas_dump(struct canvas* canvas);
 
+/** Fills the canvas with spaces, as it was when created. This allows a canvas
+ * to be reused, e.g. for drawing a tree one line at a time. */
+
+void canvas_clear(struct canvas* canvas);
+
 /** (Debugging function) like canvas_dump(), but prints line numbers. */
 
 void canvas_inspect(struct canvas* canvasp);
@@ -47,8 +47,16 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "common.h"
 #include "link.h"
 #include "subtree.h"
+#include "label_filter.h"
+#include "readline.h"
+#include "label_matcher.h"
 
-enum modes {EXACT, REGEXP};
+enum modes {EXACT, REGEXP, BATCH};
+
+/* Regexp matches are cached across trees (see label_matcher.h). This is only
+ * the number of hash bins; more labels still work. */
+
+static const int EXPECTED_LABEL_COUNT = 10000;
 
 struct parameters {
 	struct llist *labels;
@@ -57,9 +65,22 @@ struct parameters {
 	enum modes mode;
 	char * regexp_string;
 	regex_t *regexp;
+	struct label_matcher *matcher;	/* uses 'regexp' */
 	int context;	/* how many levels above LCA */
+	struct llist *queries;	/* BATCH mode: llist of label llists */
+	bool require_all;
+	struct label_filter *filter;	/* only with 'require_all' */
+	bool statistics;
 };
 
+/* Trees (queries in BATCH mode) read, and those skipped because they lacked
+ * some label (-a) */
+
+static int tree_count = 0;
+static int rejected_count = 0;
+static int query_count = 0;
+static int rejected_query_count = 0;
+
 void help(char *argv[])
 {
 	printf(
@@ -68,7 +89,8 @@ void help(char *argv[])
 "Synopsis\n"
 "--------\n"
 "\n"
-"%s [-chmrs] <target tree filename|-> <label> [label]+\n"
+"%s [-achmrSs] <target tree filename|-> <label> [label]+\n"
+"%s [-achmSs] -f <queries filename> <target tree filename|->\n"
 "\n"
 "Input\n"
 "-----\n"
@@ -78,26 +100,38 @@ void help(char *argv[])
 "\n"
 "The next arguments are labels found in the tree (both leaf and internal\n"
 "labels work). Any label not found in the tree will be ignored. There\n"
-"must be at least one label. (See also option -r)\n"
+"must be at least one label. (See also options -f and -r)\n"
 "\n"
 "Output\n"
 "------\n"
 "\n"
 "Outputs the clade rooted at the last common ancestor of all labels passed\n"
-"as arguments, as Newick.\n"
+"as arguments, as Newick. With option -f, the output for each query is\n"
+"preceded by the query's number (starting at 1) and a TAB.\n"
 "\n"
 "Options\n"
 "-------\n"
 "\n"
+"    -a: only consider trees that contain ALL the labels passed as\n"
+"        arguments; other trees are skipped (this is checked before any\n"
+"        other work is done on the tree). With -f, skips the queries\n"
+"        whose labels are not all in the tree. Incompatible with -r.\n"
 "    -c <levels (int)>: give context, i.e. start the subtree not at the last\n"
 "        common ancestor of the labels, but 'level' nodes higher (limited\n"
 "        by the tree's root, of course).\n"
+"    -f <filename>: read the label sets from this file, one per line\n"
+"        (labels separated by whitespace; empty lines and lines that\n"
+"        start with '#' are ignored). Each tree is indexed only once,\n"
+"        after which each query takes time proportional to its number\n"
+"        of labels (plus the size of the output).\n"
 "    -h: prints this message and exits\n"
 "    -m: only prints the clade if it is monophyletic, in the sense that ONLY\n"
 "        the labels passed as arguments are found in the clade.\n"
 "        See also -s.\n"
 "    -r <regexp>: clade is defined by labels that match the regexp (instead.\n"
 "        of labels passed as arguments)\n"
+"    -S: with -a, print on stderr how many trees (queries, with -f) were\n"
+"        skipped.\n"
 "    -s: prints the siblings of the clade defined by the labels passed as\n"
 "        arguments, in the order in which they appear in the Newick.\n"
 "        If -m is also passed, only prints siblings if the labels passed\n"
@@ -122,7 +156,16 @@ void help(char *argv[])
 "$ %s -r data/HRV.nw '^POLIO.*'\n"
 "\n"
 "# clade defined by Homo and Pan, plus 1 level of context\n"
-"$ %s -c 1 data/catarrhini Homo Pan\n",
+"$ %s -c 1 data/catarrhini Homo Pan\n"
+"\n"
+"# clade defined by Homo and Pan, in the trees that contain both\n"
+"$ %s -a data/forest Homo Pan\n"
+"\n"
+"# one clade per line of file clades.txt\n"
+"$ %s -f clades.txt data/catarrhini\n",
+	argv[0],
+	argv[0],
+	argv[0],
 	argv[0],
 	argv[0],
 	argv[0],
@@ -152,6 +195,47 @@ static regex_t * compile_regexp(char *regexp_string)
 	return preg;
 }
 
+/* Reads the label sets, one per line. */
+
+static struct llist *read_queries(FILE *queries_file)
+{
+	struct llist *queries = create_llist();
+	if (NULL == queries) { perror(NULL); exit(EXIT_FAILURE); }
+	char *line;
+
+	while (NULL != (line = read_line(queries_file))) {
+		/* Skip comments and lines that are empty or all whitespace */
+		if ('#' == line[0] || is_all_whitespace(line)) {
+			free(line);
+			continue;
+		}
+		struct llist *labels = create_llist();
+		if (NULL == labels) { perror(NULL); exit(EXIT_FAILURE); }
+		struct word_tokenizer *wtok = create_word_tokenizer(line);
+		if (NULL == wtok) { perror(NULL); exit(EXIT_FAILURE); }
+		char *label;
+		while (NULL != (label = wt_next(wtok))) {
+			if (! append_element(labels, label)) {
+				perror(NULL);
+				exit(EXIT_FAILURE);
+			}
+		}
+		destroy_word_tokenizer(wtok);
+		free(line);
+		if (! append_element(queries, labels)) {
+			perror(NULL);
+			exit(EXIT_FAILURE);
+		}
+	}
+	fclose(queries_file);
+
+	if (0 == queries->count) {
+		fprintf (stderr, "No query found.\n");
+		exit(EXIT_FAILURE);
+	}
+	return queries;
+}
+
 struct parameters get_params(int argc, char *argv[])
 {
 
@@ -161,13 +245,28 @@ struct parameters get_params(int argc, char *argv[])
 	params.siblings = false;
 	params.mode = EXACT;
 	params.context = 0;
+	params.queries = NULL;
+	params.require_all = false;
+	params.filter = NULL;
+	params.statistics = false;
 
+	FILE *queries_file = NULL;
 	int opt_char;
-	while ((opt_char = getopt(argc, argv, "c:hmrs")) != -1) {
+	while ((opt_char = getopt(argc, argv, "ac:f:hmrSs")) != -1) {
 		switch (opt_char) {
+		case 'a':
+			params.require_all = true;
+			break;
 		case 'c':
 			params.context = atoi(optarg);
 			break;
+		case 'f':
+			queries_file = fopen(optarg, "r");
+			if (NULL == queries_file) {
+				perror(NULL);
+				exit(EXIT_FAILURE);
+			}
+			break;
 		case 'h':
 			help(argv);
 			exit(EXIT_SUCCESS);
@@ -177,6 +276,9 @@ struct parameters get_params(int argc, char *argv[])
 		case 'r':
 			params.mode = REGEXP;
 			break;
+		case 'S':
+			params.statistics = true;
+			break;
 		case 's':
 			params.siblings = true;
 			break;
@@ -187,8 +289,22 @@ struct parameters get_params(int argc, char *argv[])
 		}
 	}
 
+	if (params.require_all && REGEXP == params.mode) {
+		fprintf (stderr, "Options -a and -r are incompatible\n");
+		exit(EXIT_FAILURE);
+	}
+	if (NULL != queries_file) {
+		if (REGEXP == params.mode) {
+			fprintf (stderr, "Options -f and -r are incompatible\n");
+			exit(EXIT_FAILURE);
+		}
+		params.mode = BATCH;
+		params.queries = read_queries(queries_file);
+	}
+
 	/* check arguments */
-	if ((argc - optind) >= 2)	{
+	int min_args = (BATCH == params.mode) ? 1 : 2;
+	if ((argc - optind) >= min_args)	{
 		if (0 != strcmp("-", argv[optind])) {
 			if (! set_parser_input_filename(argv[optind])) {
 				perror(NULL);
@@ -210,29 +326,153 @@ struct parameters get_params(int argc, char *argv[])
 				}
 			}
 			params.labels = lbl_list;
+			if (params.require_all) {
+				params.filter = create_label_filter(lbl_list,
+						false);
+				if (NULL == params.filter) {
+					perror(NULL);
+					exit(EXIT_FAILURE);
+				}
+			}
 			break;
 		case REGEXP:
 			optind++;	/* optind is now index of regexp */
 			params.regexp_string = argv[optind];
 			params.regexp = compile_regexp(params.regexp_string);
+			params.matcher = create_label_matcher(
+					params.regexp_string, params.regexp,
+					EXPECTED_LABEL_COUNT);
+			if (NULL == params.matcher) {
+				perror(NULL);
+				exit(EXIT_FAILURE);
+			}
+			break;
+		case BATCH:
 			break;
 		default:
 			fprintf (stderr, "Unknown mode %d\n", params.mode);
 			exit(EXIT_FAILURE);
 		}
 	} else {
-		fprintf(stderr, "Usage: %s [-hm] <filename|-> <label> [label+]\n",
-				argv[0]);
+		fprintf(stderr, "Usage: %s [-hm] <filename|-> <label> [label+]\n"
+				"       %s [-hm] -f <queries filename> "
+				"<filename|->\n", argv[0], argv[0]);
 		exit(EXIT_FAILURE);
 	}
 
 	return params;
 }
 
+/* Prints the clade defined by 'descendants', whose LCA is 'subtree_root' (or
+ * its siblings, etc. - see options), preceded by the query number if it is
+ * positive. The tree must have been numbered. */
+
+static void print_clade(struct llist *descendants, struct rnode *subtree_root,
+		struct parameters params, int query_number)
+{
+
+	/* Jump up tree to get context, if any was required ('context' > 0) */
+	int context;
+	for (context = params.context; context > 0; context--)
+		if (! is_root(subtree_root))
+			subtree_root = subtree_root->parent;
+
+	if (params.check_monophyly &&
+	    MONOPH_TRUE != is_monophyletic(descendants, subtree_root))
+		return;
+
+	/* monophyly of input labels is verified or not requested */
+	if (params.siblings) {
+		struct llist *sibs = siblings(subtree_root);
+		if (NULL == sibs) {
+			perror(NULL);
+			exit(EXIT_FAILURE);
+		}
+		struct list_elem *el;
+		for (el=sibs->head;NULL!=el;el=el->next) {
+			if (query_number > 0) printf ("%d\t", query_number);
+			dump_newick(el->data);
+		}
+		destroy_llist(sibs);
+	} else {
+		/* normal operation: print clade defined by labels. */
+		if (query_number > 0) printf ("%d\t", query_number);
+		dump_newick(subtree_root);
+	}
+}
+
+/* The tree is indexed, numbered and given an LCA table once; then each query
+ * only costs a hash lookup per label, plus the LCA and monophyly checks (see
+ * lca.h and subtree.h), which are linear in the number of labels and do not
+ * depend on the tree's size or shape. */
+
+static void process_queries(struct rooted_tree *tree,
+		struct parameters params)
+{
+	struct hash *label2node_map = create_label2node_map(
+			tree->nodes_in_order);
+	if (NULL == label2node_map) { perror(NULL); exit(EXIT_FAILURE); }
+	/* This also numbers the tree, for the monophyly check */
+	struct lca_table *lca_table = create_lca_table(tree->root);
+	if (NULL == lca_table) { perror(NULL); exit(EXIT_FAILURE); }
+
+	struct list_elem *q_el;
+	int query_number = 0;
+	for (q_el = params.queries->head; NULL != q_el; q_el = q_el->next) {
+		struct llist *labels = q_el->data;
+		struct llist *descendants = create_llist();
+		if (NULL == descendants) { perror(NULL); exit(EXIT_FAILURE); }
+		bool all_found = true;
+		struct list_elem *el;
+
+		query_number++;
+		query_count++;
+		for (el = labels->head; NULL != el; el = el->next) {
+			struct rnode *node = hash_get(label2node_map, el->data);
+			if (NULL == node) {
+				all_found = false;
+				if (params.require_all) break;
+				fprintf (stderr, "WARNING: query %d: label '%s'"
+					" not found.\n", query_number,
+					(char *) el->data);
+			} else if (! append_element(descendants, node)) {
+				perror(NULL);
+				exit(EXIT_FAILURE);
+			}
+		}
+
+		if (params.require_all && ! all_found)
+			rejected_query_count++;
+		else if (0 == descendants->count)
+			fprintf (stderr, "WARNING: query %d: no label matches.\n",
+					query_number);
+		else
+			print_clade(descendants,
+				lca_from_table(lca_table, descendants),
+				params, query_number);
+
+		destroy_llist(descendants);
+	}
+
+	destroy_lca_table(lca_table);
+	destroy_hash(label2node_map);
+}
+
 void process_tree(struct rooted_tree *tree, struct parameters params)
 {
 	struct llist *descendants;
 
+	tree_count++;
+	if (BATCH == params.mode) {
+		process_queries(tree, params);
+		return;
+	}
+	if (NULL != params.filter &&
+	    ! label_filter_accepts(params.filter, tree)) {
+		rejected_count++;
+		return;
+	}
+
 	switch (params.mode) {
 	case EXACT:
 		descendants = nodes_from_labels(tree, params.labels);
@@ -246,7 +486,7 @@ void process_tree(struct rooted_tree *tree, struct parameters params)
 		}
 		break;
 	case REGEXP:
-		descendants = nodes_from_regexp(tree, params.regexp);
+		descendants = nodes_from_label_matcher(tree, params.matcher);
 		if (NULL == descendants) { perror(NULL); exit(EXIT_FAILURE); }
 		if (0 == descendants->count) {
 			fprintf (stderr, "WARNING: no match for regexp /%s/\n",
@@ -259,43 +499,14 @@ void process_tree(struct rooted_tree *tree, struct parameters params)
 		exit(EXIT_FAILURE);
 	}
 
-	struct rnode *subtree_root = lca_from_nodes(tree, descendants);
+	/* Both the LCA and the monophyly check use the numbering. For a
+	 * single query, an LCA table would cost more than it saves. */
+	number_nodes(tree->root);
+	struct rnode *subtree_root = lca_from_numbered_nodes(descendants);
 	if (NULL == subtree_root) { perror(NULL); exit(EXIT_FAILURE); }
-
-	/* Jump up tree to get context, if any was required ('context' > 0) */
-	int context;
-	for (context = params.context; context > 0; context--)
-		if (! is_root(subtree_root))
-			subtree_root = subtree_root->parent;
-
-	if (NULL != subtree_root) {
-		if ((! params.check_monophyly) ||
-		    (MONOPH_TRUE == is_monophyletic(descendants, subtree_root))) {
-			/* monophyly of input labels is verified or not
-			 * requested */
-			if (params.siblings) {
-				struct llist *sibs = siblings(subtree_root);
-				if (NULL == sibs) {
-					perror(NULL);
-					exit(EXIT_FAILURE);
-				}
-				struct list_elem *el;
-				for (el=sibs->head;NULL!=el;el=el->next) {
-					dump_newick(el->data);
-				}
-				destroy_llist(sibs);
-			} else {
-				/* normal operation: print clade defined by
-				 * labels. */
-				dump_newick(subtree_root);
-			}
-		}
-	} else {
-		fprintf (stderr, "WARNING: LCA not found\n");
-	}
+	print_clade(descendants, subtree_root, params, 0);
 
 	destroy_llist(descendants);
-
 }
 
 int main(int argc, char *argv[])
@@ -311,15 +522,41 @@ int main(int argc, char *argv[])
 		destroy_tree(tree);
 	}
 
-	if (EXACT == params.mode)
+	if (params.statistics) {
+		if (BATCH == params.mode)
+			fprintf (stderr, "%d queries, %d skipped for lack of "
+				"labels\n", query_count, rejected_query_count);
+		else
+			fprintf (stderr, "%d trees read, %d skipped for lack "
+				"of labels\n", tree_count, rejected_count);
+	}
+
+	struct list_elem *el, *lbl_el;
+	switch (params.mode) {
+	case EXACT:
 		destroy_llist(params.labels);
-	else {
+		if (NULL != params.filter)
+			destroy_label_filter(params.filter);
+		break;
+	case REGEXP:
 		/* This does not free 'params.regexp' itself, only memory
 		 * pointed to by 'params.regexp' members and allocated by
 		 * regcomp().*/
+		destroy_label_matcher(params.matcher);
 		regfree(params.regexp);
 		/* Therefore: */
 		free(params.regexp);
+		break;
+	case BATCH:
+		for (el = params.queries->head; NULL != el; el = el->next) {
+			struct llist *labels = el->data;
+			for (lbl_el = labels->head; NULL != lbl_el;
+					lbl_el = lbl_el->next)
+				free(lbl_el->data);
+			destroy_llist(labels);
+		}
+		destroy_llist(params.queries);
+		break;
 	}
 
 	return 0;
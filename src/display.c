@@ -73,6 +73,8 @@ struct parameters {
 	bool	scale_zero_at_root;	/* if false, at max depth */
 	int	label_space_correction;	/* between a node and its label */
 	enum text_graph_style txt_graph_style;		/* ... text graph style (surprise!)*/
+	bool	compact;		/* SVG: merged paths, etc. */
+	double	lod_threshold;		/* SVG: collapse smaller clades (px) */
 };
 
 void help(char* argv[])
@@ -140,6 +142,11 @@ void help(char* argv[])
 "       fill:green;font-style:italic	L	A D\n"
 "       If no colormap is specified, the default is (but see option -d):\n"
 "       stroke:black;fill:none;stroke-width:1;stroke-linecap:round\n"
+"    -C: compact output [only SVG]. All edges of the same style are drawn\n"
+"       as a single path, and all labels of the same style are grouped, with\n"
+"       coordinates rounded to 0.01 px. The output is several times smaller\n"
+"       and is faster to render, which matters for large trees; but edges\n"
+"       can no longer be edited individually (e.g. in Inkscape).\n"
 "    -d <string>: CSS for 'plain' tree nodes (i.e., unless overridden by -c)\n"
 "       [only SVG]\n"
 "       Default: stroke:black;fill:none;stroke-width:1;stroke-linecap:round\n"
@@ -167,6 +174,14 @@ void help(char* argv[])
 "       setting 'visibility:hidden' disables printing of leaf node labels.\n"
 "       Note: if you change this, you will probably need to adjust the\n"
 "       space allocated to leaf labels - see option -W.\n"
+"    -L <number>: level of detail [only SVG]. Clades that would span less\n"
+"       than <number> pixels (across the leaves, i.e. vertically for\n"
+"       orthogonal trees) are drawn as a single filled triangle (or wedge,\n"
+"       for radial trees) labeled with the number of leaves they contain,\n"
+"       instead of one edge per node. This keeps huge trees readable (and\n"
+"       the output small) at a given size (see options -v and -w). The\n"
+"       triangles have CSS class 'collapsed' (default fill: lightgrey).\n"
+"       Default: 0 (show all clades).\n"
 "    -n <number> add this number of pixels to the horizontal position of\n"
 "       node labels. [SVG only]\n"
 "    -o <filename>: use specified file as ornament map. Works like the CSS\n"
@@ -319,6 +334,8 @@ struct parameters get_params(int argc, char *argv[])
 	params.inner_label_pos = INNER_LBL_LEAVES;
 	params.scale_zero_at_root = true;
 	params.label_space_correction = 0;	/* px */
+	params.compact = false;
+	params.lod_threshold = 0;	/* px */
 	// params.text_st = false;
 
 	char *nw_display_text_style = getenv("NW_DISPLAY_TEXT_STYLE");
@@ -333,7 +350,7 @@ struct parameters get_params(int argc, char *argv[])
 	int pos;
 	
 	/* parse options and switches */
-	while ((opt_char = getopt(argc, argv, "a:A:b:c:d:e:hi:I:l:n:o:rR:sStu:U:v:Vw:W:")) != -1) {
+	while ((opt_char = getopt(argc, argv, "a:A:b:c:Cd:e:hi:I:l:L:n:o:rR:sStu:U:v:Vw:W:")) != -1) {
 		switch (opt_char) {
 		case 'a':
 			params.label_angle_correction = atof(optarg);
@@ -350,6 +367,9 @@ struct parameters get_params(int argc, char *argv[])
 				perror(NULL); exit(EXIT_FAILURE);
 			}
 			break;
+		case 'C':
+			params.compact = true;
+			break;
 		case 'd':
 			params.plain_node_style = optarg;
 			break;
@@ -373,6 +393,9 @@ struct parameters get_params(int argc, char *argv[])
 		case 'l':
 			params.leaf_label_style = optarg;
 			break;
+		case 'L':
+			params.lod_threshold = atof(optarg);
+			break;
 		case 'o':
 			params.ornament_map = fopen(optarg, "r");
 			if (NULL == params.ornament_map) {
@@ -484,6 +507,8 @@ void set_svg_parameters(struct parameters params)
 	set_label_char_width(params.label_char_width);
 	set_scalebar_zero_at_root(params.scale_zero_at_root);
 	add_to_label_space(params.label_space_correction);
+	set_compact_svg(params.compact);
+	set_lod_threshold(params.lod_threshold);
 }
 
 /* Prints an XML comment containing the command line parameters, so that the
@@ -515,6 +540,8 @@ int main(int argc, char *argv[])
 	params = get_params(argc, argv);
 
 	if (params.svg) {
+		/* SVG is printed in many small pieces, and can be large */
+		setvbuf(stdout, NULL, _IOFBF, 1 << 20);
 		set_svg_parameters(params);
 		if(! svg_init()) {
 			fprintf (stderr, "%s\n", get_last_error_message());
@@ -532,12 +559,8 @@ int main(int argc, char *argv[])
 		/* User can also suppress scale bar */
 		if (params.no_scale_bar) with_scale_bar = false;
 
-		if (strcmp("", tree->root->edge_length_as_string) &&
-			0 == params.root_length) {
-			free(tree->root->edge_length_as_string);
-			tree->root->edge_length_as_string =
-				strdup("");
-		}
+		if (has_edge_length(tree->root) && 0 == params.root_length)
+			unset_edge_length(tree->root);
 
 		if (params.svg) {
 
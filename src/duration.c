@@ -132,25 +132,18 @@ void process_tree(struct rooted_tree *tree)
 		struct rnode *current = (struct rnode *) el->data;
 		if (is_root(current)) {
 			/* set to none */
-			free(current->edge_length_as_string);
-			current->edge_length_as_string = strdup("");
+			unset_edge_length(current);
 		}
 		else {
-			double age = -1.0;
-			if (strcmp("", current->edge_length_as_string) == 0)
-				age = 0.0;
-			else 
-				age = atof(current->edge_length_as_string);	
-
-			/* Note: we are assuming that only leaves can have an
-			 * empty length_as_string. Thus we do not check
-			 * for emptiness before calling atof(). */
-			double parent_age = atof(current->parent->
-				edge_length_as_string);
-			double edge_length = parent_age - age;
-			free(current->edge_length_as_string);
-			current->edge_length_as_string = masprintf("%g",
-					edge_length);
+			/* An undefined length (normally only on leaves) has a
+			 * value of 0, which is the age we want. */
+			double age = current->edge_length;
+			/* Nodes are in postorder, so the parent's length
+			 * hasn't been changed yet: it is still its age. */
+			double parent_age = current->parent->edge_length;
+			if (! set_edge_length(current, parent_age - age)) {
+				perror(NULL); exit(EXIT_FAILURE);
+			}
 		}
 	}
 }
@@ -29,12 +29,14 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <assert.h>
 
 #include "enode.h"
 #include "rnode.h"
 #include "list.h"
 #include "tree_editor_rnode_data.h"
+#include "common.h"
 
 /* Functions that operate on a tree node (e.g., to return whether or not it is
  * a leaf, or its depth in the tree, etc) operate on this external variable. It
@@ -143,3 +145,287 @@ float eval_enode(struct enode *node)
 		assert(0);	/* programmer error */
 	}
 }
+
+/* Compiled expressions. The program is a flat array of instructions for a
+ * stack machine, each slot of which is a vector of ENODE_BATCH_SIZE floats
+ * (one per row), so that each instruction processes a whole batch of rows at
+ * once. Binary operators combine slots 'slot' and 'slot' + 1 into 'slot'.
+ * Conjunctions and disjunctions skip their right operand when the left one
+ * decides the whole batch - since expressions have no side effects, this
+ * gives the same results as eval_enode()'s per-node short-circuiting. */
+
+#define ENODE_BATCH_SIZE 256
+
+enum opcode {
+	OP_CONST,	/* slot = value */
+	OP_LOAD,	/* slot = column */
+	OP_GT, OP_GTE, OP_LT, OP_LTE, OP_EQ, OP_NEQ,
+	OP_AND, OP_OR,
+	OP_NOT,
+	OP_BOOL,	/* slot = slot != 0 */
+	OP_JUMP_IF_NONE,	/* to 'target' if slot is 0 for all rows */
+	OP_JUMP_IF_ALL		/* to 'target' if slot is 1 for all rows */
+};
+
+struct instruction {
+	enum opcode op;
+	int slot;
+	float value;	/* OP_CONST */
+	int column;	/* OP_LOAD */
+	int target;	/* jumps */
+};
+
+struct enode_program {
+	struct instruction *code;
+	int length;
+	int capacity;
+	int slot_count;
+	bool reads[ENODE_COLUMN_COUNT];
+	float *stack;	/* slot_count * ENODE_BATCH_SIZE */
+};
+
+static int column_of(enum enode_type type)
+{
+	switch (type) {
+	case ENODE_DEPTH: return ENODE_COL_DEPTH;
+	case ENODE_NB_ANCESTORS: return ENODE_COL_NB_ANCESTORS;
+	case ENODE_NB_DESCENDANTS: return ENODE_COL_NB_DESCENDANTS;
+	case ENODE_NB_CHILDREN: return ENODE_COL_NB_CHILDREN;
+	case ENODE_SUPPORT: return ENODE_COL_SUPPORT;
+	case ENODE_IS_LEAF: return ENODE_COL_IS_LEAF;
+	case ENODE_IS_INNER: return ENODE_COL_IS_INNER;
+	case ENODE_IS_ROOT: return ENODE_COL_IS_ROOT;
+	default: return -1;
+	}
+}
+
+/* Sets 'value' and returns true iff the expression is constant. Besides
+ * operators on constants, conjunctions and disjunctions are constant when
+ * either operand decides them. Values are computed exactly as eval_enode()
+ * does. */
+
+static bool constant_value(struct enode *node, float *value)
+{
+	float left, right;
+	bool left_const, right_const;
+
+	switch (node->type) {
+	case ENODE_CONSTANT:
+		*value = node->value;
+		return true;
+	case ENODE_NOT:
+		if (! constant_value(node->left, &left)) return false;
+		*value = ! left;
+		return true;
+	case ENODE_AND:
+		left_const = constant_value(node->left, &left);
+		right_const = constant_value(node->right, &right);
+		if ((left_const && ! left) || (right_const && ! right)) {
+			*value = 0;
+			return true;
+		}
+		if (! left_const || ! right_const) return false;
+		*value = left && right;
+		return true;
+	case ENODE_OR:
+		left_const = constant_value(node->left, &left);
+		right_const = constant_value(node->right, &right);
+		if ((left_const && left) || (right_const && right)) {
+			*value = 1;
+			return true;
+		}
+		if (! left_const || ! right_const) return false;
+		*value = left || right;
+		return true;
+	case ENODE_GT: case ENODE_GTE: case ENODE_LT: case ENODE_LTE:
+	case ENODE_EQ: case ENODE_NEQ:
+		if (! constant_value(node->left, &left)) return false;
+		if (! constant_value(node->right, &right)) return false;
+		switch (node->type) {
+		case ENODE_GT: *value = left > right; break;
+		case ENODE_GTE: *value = left >= right; break;
+		case ENODE_LT: *value = left < right; break;
+		case ENODE_LTE: *value = left <= right; break;
+		case ENODE_EQ: *value = left == right; break;
+		default: *value = left != right; break;
+		}
+		return true;
+	default:
+		return false;	/* node functions */
+	}
+}
+
+/* Appends an instruction; returns its address, or -1 if malloc() fails. */
+
+static int emit(struct enode_program *prog, enum opcode op, int slot)
+{
+	if (prog->length == prog->capacity) {
+		int capacity = 2 * prog->capacity + 8;
+		struct instruction *code = realloc(prog->code,
+				capacity * sizeof(struct instruction));
+		if (NULL == code) return -1;
+		prog->code = code;
+		prog->capacity = capacity;
+	}
+	struct instruction *insn = prog->code + prog->length;
+	insn->op = op;
+	insn->slot = slot;
+	insn->value = 0;
+	insn->column = -1;
+	insn->target = -1;
+	if (slot >= prog->slot_count) prog->slot_count = slot + 1;
+	return prog->length++;
+}
+
+/* Compiles 'node' so that its value ends up in slot 'slot'. */
+
+static int compile_node(struct enode_program *prog, struct enode *node,
+		int slot)
+{
+	float value, left, right;
+	int addr, jump;
+
+	if (constant_value(node, &value)) {
+		if ((addr = emit(prog, OP_CONST, slot)) < 0) return FAILURE;
+		prog->code[addr].value = value;
+		return SUCCESS;
+	}
+
+	switch (node->type) {
+	case ENODE_AND:
+	case ENODE_OR:
+		/* A constant operand that does not decide the result (see
+		 * constant_value()) just leaves the other one's truth value */
+		if (constant_value(node->left, &left)) {
+			if (! compile_node(prog, node->right, slot))
+				return FAILURE;
+			return emit(prog, OP_BOOL, slot) >= 0;
+		}
+		if (constant_value(node->right, &right)) {
+			if (! compile_node(prog, node->left, slot))
+				return FAILURE;
+			return emit(prog, OP_BOOL, slot) >= 0;
+		}
+		if (! compile_node(prog, node->left, slot)) return FAILURE;
+		if (emit(prog, OP_BOOL, slot) < 0) return FAILURE;
+		jump = emit(prog, ENODE_AND == node->type ?
+				OP_JUMP_IF_NONE : OP_JUMP_IF_ALL, slot);
+		if (jump < 0) return FAILURE;
+		if (! compile_node(prog, node->right, slot + 1))
+			return FAILURE;
+		if (emit(prog, ENODE_AND == node->type ? OP_AND : OP_OR,
+					slot) < 0)
+			return FAILURE;
+		prog->code[jump].target = prog->length;
+		return SUCCESS;
+	case ENODE_NOT:
+		if (! compile_node(prog, node->left, slot)) return FAILURE;
+		return emit(prog, OP_NOT, slot) >= 0;
+	case ENODE_GT: case ENODE_GTE: case ENODE_LT: case ENODE_LTE:
+	case ENODE_EQ: case ENODE_NEQ:
+		if (! compile_node(prog, node->left, slot)) return FAILURE;
+		if (! compile_node(prog, node->right, slot + 1))
+			return FAILURE;
+		return emit(prog, OP_GT + (node->type - ENODE_GT), slot) >= 0;
+	default:
+		if ((addr = emit(prog, OP_LOAD, slot)) < 0) return FAILURE;
+		prog->code[addr].column = column_of(node->type);
+		assert(prog->code[addr].column >= 0);
+		prog->reads[prog->code[addr].column] = true;
+		return SUCCESS;
+	}
+}
+
+struct enode_program *compile_enode(struct enode *expr)
+{
+	struct enode_program *prog = malloc(sizeof(struct enode_program));
+	if (NULL == prog) return NULL;
+	prog->code = NULL;
+	prog->length = prog->capacity = prog->slot_count = 0;
+	prog->stack = NULL;
+	memset(prog->reads, 0, sizeof(prog->reads));
+
+	if (! compile_node(prog, expr, 0)) {
+		destroy_enode_program(prog);
+		return NULL;
+	}
+	prog->stack = malloc(prog->slot_count * ENODE_BATCH_SIZE
+			* sizeof(float));
+	if (NULL == prog->stack) {
+		destroy_enode_program(prog);
+		return NULL;
+	}
+
+	return prog;
+}
+
+bool enode_program_reads(struct enode_program *prog,
+		enum enode_column column)
+{
+	return prog->reads[column];
+}
+
+/* Runs the program on 'n' (at most ENODE_BATCH_SIZE) rows from 'first'. */
+
+static void eval_batch(struct enode_program *prog, float *columns[],
+		int first, int n, bool *result)
+{
+	int pc, i;
+
+	for (pc = 0; pc < prog->length; pc++) {
+		struct instruction *insn = prog->code + pc;
+		float *a = prog->stack + insn->slot * ENODE_BATCH_SIZE;
+		float *b = a + ENODE_BATCH_SIZE;
+		switch (insn->op) {
+		case OP_CONST:
+			for (i = 0; i < n; i++) a[i] = insn->value;
+			break;
+		case OP_LOAD:
+			memcpy(a, columns[insn->column] + first,
+					n * sizeof(float));
+			break;
+		case OP_GT: for (i = 0; i < n; i++) a[i] = a[i] > b[i]; break;
+		case OP_GTE: for (i = 0; i < n; i++) a[i] = a[i] >= b[i]; break;
+		case OP_LT: for (i = 0; i < n; i++) a[i] = a[i] < b[i]; break;
+		case OP_LTE: for (i = 0; i < n; i++) a[i] = a[i] <= b[i]; break;
+		case OP_EQ: for (i = 0; i < n; i++) a[i] = a[i] == b[i]; break;
+		case OP_NEQ: for (i = 0; i < n; i++) a[i] = a[i] != b[i]; break;
+		case OP_AND: for (i = 0; i < n; i++) a[i] = a[i] && b[i]; break;
+		case OP_OR: for (i = 0; i < n; i++) a[i] = a[i] || b[i]; break;
+		case OP_NOT: for (i = 0; i < n; i++) a[i] = ! a[i]; break;
+		case OP_BOOL: for (i = 0; i < n; i++) a[i] = a[i] != 0; break;
+		case OP_JUMP_IF_NONE:
+			for (i = 0; i < n && 0 == a[i]; i++) ;
+			if (i == n) pc = insn->target - 1;
+			break;
+		case OP_JUMP_IF_ALL:
+			for (i = 0; i < n && 0 != a[i]; i++) ;
+			if (i == n) pc = insn->target - 1;
+			break;
+		default:
+			assert(0);	/* programmer error */
+		}
+	}
+
+	float *top = prog->stack;
+	for (i = 0; i < n; i++)
+		result[i] = 0 != top[i];
+}
+
+void eval_enode_program(struct enode_program *prog, float *columns[],
+		int first, int count, bool *result)
+{
+	int done;
+	for (done = 0; done < count; done += ENODE_BATCH_SIZE) {
+		int n = count - done;
+		if (n > ENODE_BATCH_SIZE) n = ENODE_BATCH_SIZE;
+		eval_batch(prog, columns, first + done, n, result + first + done);
+	}
+}
+
+void destroy_enode_program(struct enode_program *prog)
+{
+	free(prog->code);
+	free(prog->stack);
+	free(prog);
+}
@@ -33,6 +33,8 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  *  \deprecated \c nw_ed has been replaced by \c nw_sched. */
 
 /** \cond */
+#include <stdbool.h>
+
 struct rnode;
 
 /** The type of node. */
@@ -104,4 +106,47 @@ void enode_eval_set_current_rnode(struct rnode *);
 
 float eval_enode(struct enode *expr);
 
+/** The node attributes that an expression can read, as columns (see
+ * eval_enode_program()). \deprecated */
+
+enum enode_column {
+	ENODE_COL_DEPTH,
+	ENODE_COL_NB_ANCESTORS,
+	ENODE_COL_NB_DESCENDANTS,
+	ENODE_COL_NB_CHILDREN,
+	ENODE_COL_SUPPORT,
+	ENODE_COL_IS_LEAF,
+	ENODE_COL_IS_INNER,
+	ENODE_COL_IS_ROOT,
+	ENODE_COLUMN_COUNT
+};
+
+/** An expression compiled into a flat sequence of instructions. */
+
+struct enode_program;
+
+/** Compiles an expression, folding constants. The expression is not needed
+ * afterwards. Returns NULL iff malloc() fails. \deprecated */
+
+struct enode_program *compile_enode(struct enode *expr);
+
+/** Returns true iff the program reads column 'column' (after constant
+ * folding). Only those columns need to be filled. \deprecated */
+
+bool enode_program_reads(struct enode_program *, enum enode_column column);
+
+/** Evaluates the program for rows 'first' to 'first' + 'count' - 1 of
+ * 'columns', setting the corresponding elements of 'result' to true iff the
+ * expression is true for that row. 'columns' is indexed by enum enode_column;
+ * for each row, columns must hold the same values (booleans as 0 or 1) as
+ * eval_enode() would return for the corresponding functions. The results are
+ * then the same as eval_enode()'s. Rows are processed in batches, an
+ * instruction at a time, so that the instruction dispatch is paid once per
+ * batch rather than once per node. \deprecated */
+
+void eval_enode_program(struct enode_program *, float *columns[],
+		int first, int count, bool *result);
+
+void destroy_enode_program(struct enode_program *);
+
 /** \endcond */
@@ -34,11 +34,15 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <string.h>
 #include <time.h>
 #include <stdlib.h>
+#include <stdbool.h>
 #include <assert.h>
+#include <pthread.h>
 
 #include "tree_models.h"
+#include "prng.h"
+#include "common.h"
 
-enum tree_models { GEOMETRIC_TREE, TIME_LIMITED_TREE };
+enum tree_models { GEOMETRIC_TREE, TIME_LIMITED_TREE, EXACT_SIZE_TREE };
 
 const double	DEFAULT_MEAN_BRANCH_LENGTH = 1.0;
 const double	DEFAULT_DURATION = 3;
@@ -49,6 +53,27 @@ struct parameters {
 	double duration;
 	double mean_branch_length;
 	double prob_node_has_children;
+	struct exact_size_params exact;
+	int nb_trees;
+	int nb_threads;
+};
+
+/* State shared by the threads that generate exact-size trees: each thread
+ * generates every nb_threads-th tree into memory, and waits for its turn to
+ * write it, so the trees come out in order. */
+
+struct run {
+	const struct parameters *params;
+	pthread_mutex_t lock;
+	pthread_cond_t turn;
+	int next_tree;		/* the next tree to write */
+	bool failed;
+};
+
+struct worker {
+	struct run *run;
+	int first_tree;
+	pthread_t thread;
 };
 
 void help(char *argv[])
@@ -59,7 +84,7 @@ void help(char *argv[])
 "Synopsis\n"
 "--------\n"
 "\n"
-"%s [-dghlps]\n"
+"%s [-cdghklmnpst]\n"
 "\n"
 "Input\n"
 "-----\n"
@@ -69,21 +94,42 @@ void help(char *argv[])
 "Output\n"
 "------\n"
 "\n"
-"The generated tree. By default, this is a \"time-limited\" tree: branches\n"
+"The generated tree(s). By default, this is a \"time-limited\" tree: branches\n"
 "are \"grown\" using exponentially distributed lengths. If the length\n"
 "exceeds the time limit, growth stops; otherwise the lineage splits in two,\n"
 "and the process is repeated on the children.\n"
 "\n"
+"With option -m, the tree has an exact number of leaves (see -n), labeled\n"
+"n1, n2, etc. Such trees are written as they are generated, and can have\n"
+"millions of leaves. The models are:\n"
+"\n"
+"    balanced: binary, as balanced as possible\n"
+"    caterpillar: binary, every inner node has a leaf child\n"
+"    yule: random binary (Yule or coalescent topology), with branch\n"
+"          lengths from a Yule process of rate 1/L started D time units\n"
+"          ago (see -l and -d)\n"
+"    polytomy: random, every inner node has K children (see -k)\n"
+"    skewed: random, most inner nodes have few children but some have\n"
+"          very many, as in taxonomies\n"
+"\n"
 "Options\n"
 "-------\n"
 "\n"
+"    -c <int>: generate this many trees (default: 1). Each exact-size tree\n"
+"       only depends on the seed and on its position, so that part of a\n"
+"       run can be reproduced, whatever the number of threads (-t).\n"
 "    -d <float>: sets the maximum depth (time limit). Default: 3.0\n"
-"       Only for time-limited trees.\n"
+"       Only for time-limited and yule trees.\n"
 "    -g: generate a geometric tree instead of a time-limited one.\n"
 "        Each node has a fixed probability of having 2 children.\n"
 "    -h: print this message and exit\n"
+"    -k <int>: number of children of inner nodes (default: 3). Only for\n"
+"       polytomy trees.\n"
 "    -l <float>: sets the average branch length (default: 1.0)\n"
-"       Only for time-limited trees.\n"
+"       Only for time-limited and yule trees.\n"
+"    -m <model>: generate a tree with an exact number of leaves,\n"
+"       according to <model> (see above).\n"
+"    -n <int>: number of leaves. Required with -m.\n"
 "    -p <float>: sets the probability of a node having (2) children.\n"
 "       Only for geometric trees. WARNING: if > 0.5, the tree will\n"
 "       probably grow 'forever'. On the other hand, low values will\n"
@@ -91,13 +137,21 @@ void help(char *argv[])
 "       that the root has no children is 1-p, like for every other node.\n"
 "    -s <int>: sets the pseudorandom number generator's seed\n"
 "       (default: 0.1)\n"
+"    -t <int>: generate exact-size trees in this many threads\n"
+"       (default: 1). The output is the same as with one thread.\n"
+"       Only for exact-size trees (-m).\n"
 "\n"
 "Examples\n"
 "--------\n"
 "\n"
 "# Generate a random time-limited tree\n"
 "\n"
-"$ %s\n",
+"$ %s\n"
+"\n"
+"# Generate 100 random binary trees of 1,000,000 leaves each, in 4 threads\n"
+"\n"
+"$ %s -m yule -n 1000000 -c 100 -t 4\n",
+	argv[0],
 	argv[0],
 	argv[0]
 	);
@@ -112,10 +166,17 @@ struct parameters get_params(int argc, char *argv[])
 	params.duration = DEFAULT_DURATION;
 	params.mean_branch_length = DEFAULT_MEAN_BRANCH_LENGTH;
 	params.prob_node_has_children = 0.1;
+	params.exact.nb_leaves = 0;
+	params.exact.degree = 3;
+	params.nb_trees = 1;
+	params.nb_threads = 1;
 
 	int opt_char;
-	while ((opt_char = getopt(argc, argv, "d:ghl:p:s:")) != -1) {
+	while ((opt_char = getopt(argc, argv, "c:d:ghk:l:m:n:p:s:t:")) != -1) {
 		switch (opt_char) {
+		case 'c':
+			params.nb_trees = atoi(optarg);
+			break;
 		case 'd':
 			params.duration = atof(optarg);	
 			break;
@@ -125,41 +186,185 @@ struct parameters get_params(int argc, char *argv[])
 		case 'h':
 			help(argv);
 			exit(EXIT_SUCCESS);
+		case 'k':
+			params.exact.degree = atoi(optarg);
+			break;
 		case 'l':
 			params.mean_branch_length = atof(optarg);	
 			break;
+		case 'm':
+			params.tree_model = EXACT_SIZE_TREE;
+			if (0 == strcmp("balanced", optarg))
+				params.exact.model = BALANCED_TREE;
+			else if (0 == strcmp("caterpillar", optarg))
+				params.exact.model = CATERPILLAR_TREE;
+			else if (0 == strcmp("yule", optarg))
+				params.exact.model = YULE_TREE;
+			else if (0 == strcmp("polytomy", optarg))
+				params.exact.model = POLYTOMY_TREE;
+			else if (0 == strcmp("skewed", optarg))
+				params.exact.model = SKEWED_TREE;
+			else {
+				fprintf(stderr, "Unknown model '%s'.\n",
+						optarg);
+				exit(EXIT_FAILURE);
+			}
+			break;
+		case 'n':
+			params.exact.nb_leaves = atol(optarg);
+			break;
 		case 'p':
 			params.prob_node_has_children = atof(optarg);
 			break;
 		case 's':
 			params.seed = atoi(optarg);
 			break;
+		case 't':
+			params.nb_threads = atoi(optarg);
+			break;
 		}
 	}
+	params.exact.birth_rate = 1.0 / params.mean_branch_length;
+	params.exact.duration = params.duration;
 
 	/* check arguments */
 	if ((argc - optind) != 0)	{
-		fprintf(stderr, "Usage: %s [-hs]\n",
+		fprintf(stderr, "Usage: %s [-cdghklmnpst]\n",
 				argv[0]);
 		exit(EXIT_FAILURE);
 	}
+	if (EXACT_SIZE_TREE == params.tree_model) {
+		if (params.exact.nb_leaves < 1) {
+			fprintf(stderr, "Option -m requires -n "
+					"(number of leaves, > 0).\n");
+			exit(EXIT_FAILURE);
+		}
+		if (params.exact.degree < 2) {
+			fprintf(stderr, "Argument to -k must be > 1.\n");
+			exit(EXIT_FAILURE);
+		}
+	} else if (params.nb_threads > 1) {
+		fprintf(stderr, "Option -t requires -m (only exact-size trees "
+				"are generated in threads).\n");
+		exit(EXIT_FAILURE);
+	}
+	if (params.nb_trees < 1 || params.nb_threads < 1) {
+		fprintf(stderr, "Arguments to -c and -t must be > 0.\n");
+		exit(EXIT_FAILURE);
+	}
+	if (params.nb_threads > params.nb_trees)
+		params.nb_threads = params.nb_trees;
 
 	return params;
 }
 
+static int exact_size_trees(const struct parameters *params)
+{
+	struct prng prng;
+	int i;
+
+	for (i = 0; i < params->nb_trees; i++) {
+		prng_seed(&prng, params->seed, i);
+		if (! exact_size_tree(stdout, &params->exact, &prng))
+			return FAILURE;
+	}
+
+	return SUCCESS;
+}
+
+static void *work(void *arg)
+{
+	struct worker *worker = arg;
+	struct run *run = worker->run;
+	const struct parameters *params = run->params;
+	struct prng prng;
+	int i;
+
+	for (i = worker->first_tree; i < params->nb_trees;
+			i += params->nb_threads) {
+		char *text = NULL;
+		size_t length = 0;
+		FILE *out = open_memstream(&text, &length);
+		bool ok = (NULL != out);
+		if (ok) {
+			prng_seed(&prng, params->seed, i);
+			ok = exact_size_tree(out, &params->exact, &prng);
+			if (EOF == fclose(out))
+				ok = false;
+		}
+
+		pthread_mutex_lock(&run->lock);
+		while (run->next_tree != i)
+			pthread_cond_wait(&run->turn, &run->lock);
+		if (! ok || (! run->failed &&
+				fwrite(text, 1, length, stdout) != length))
+			run->failed = true;
+		run->next_tree++;
+		pthread_cond_broadcast(&run->turn);
+		pthread_mutex_unlock(&run->lock);
+
+		free(text);
+	}
+
+	return NULL;
+}
+
+static int exact_size_trees_in_parallel(const struct parameters *params)
+{
+	struct run run;
+	run.params = params;
+	pthread_mutex_init(&run.lock, NULL);
+	pthread_cond_init(&run.turn, NULL);
+	run.next_tree = 0;
+	run.failed = false;
+
+	struct worker *workers = malloc(params->nb_threads *
+			sizeof(struct worker));
+	if (NULL == workers) return FAILURE;
+
+	int i;
+	for (i = 0; i < params->nb_threads; i++) {
+		workers[i].run = &run;
+		workers[i].first_tree = i;
+		if (0 != pthread_create(&workers[i].thread, NULL, work,
+					&workers[i])) {
+			perror(NULL);
+			exit(EXIT_FAILURE);
+		}
+	}
+	for (i = 0; i < params->nb_threads; i++)
+		pthread_join(workers[i].thread, NULL);
+
+	free(workers);
+	pthread_cond_destroy(&run.turn);
+	pthread_mutex_destroy(&run.lock);
+
+	return run.failed ? FAILURE : SUCCESS;
+}
+
 int main(int argc, char *argv[])
 {
 	struct parameters params = get_params(argc, argv);
 	srand(params.seed);
 
-	int result;
+	int result = SUCCESS;
+	int i;
 	switch (params.tree_model) {
 	case GEOMETRIC_TREE:
-		result = geometric_tree(params.prob_node_has_children);
+		for (i = 0; i < params.nb_trees && result; i++)
+			result = geometric_tree(params.prob_node_has_children);
 		break;
 	case TIME_LIMITED_TREE:
-		result = time_limited_tree(1.0 / params.mean_branch_length,
-			params.duration);
+		for (i = 0; i < params.nb_trees && result; i++)
+			result = time_limited_tree(
+				1.0 / params.mean_branch_length,
+				params.duration);
+		break;
+	case EXACT_SIZE_TREE:
+		if (params.nb_threads > 1)
+			result = exact_size_trees_in_parallel(&params);
+		else
+			result = exact_size_trees(&params);
 		break;
 	default:
 		assert(0);	/* programmer error */
@@ -0,0 +1,176 @@
+/* 
+
+Copyright (c) 2009 Thomas Junier and Evgeny Zdobnov, University of Geneva
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+* Neither the name of the University of Geneva nor the names of its
+    contributors may be used to endorse or promote products derived from this
+    software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "tree.h"
+#include "rnode.h"
+#include "list.h"
+#include "hash.h"
+#include "label_filter.h"
+
+/* Bits per label in the Bloom filter: with two probes, this makes false
+ * positives rare (about (1 - e^(-2/16))^2, or 1.4%, less when the size is
+ * rounded up) while keeping the filter small. */
+
+static const int BLOOM_BITS_PER_LABEL = 16;
+static const int MIN_BLOOM_BITS = 64;
+
+#define WORD_BITS (8 * sizeof(unsigned long))
+
+struct label_filter {
+	struct hash *ids;	/* label -> int* */
+	int *id_storage;	/* what 'ids' points to */
+	int count;		/* number of distinct labels */
+	unsigned long *bloom;
+	unsigned int bloom_mask;	/* number of bits - 1 */
+	/* For each ID, the number of the last tree in which it was seen, so
+	 * that nothing needs resetting between trees. */
+	int *seen_in;
+	int tree_number;
+	bool leaves_only;
+};
+
+/* FNV-1a. Independent of hash_func() in hash.c, so that a label that collides
+ * in one does not systematically collide in the other. */
+
+static unsigned int label_hash(const char *label)
+{
+	unsigned int h = 2166136261u;
+	while (*label) {
+		h ^= (unsigned char) *label++;
+		h *= 16777619u;
+	}
+	return h;
+}
+
+/* The two probes are derived from the same hash value */
+
+static unsigned int second_probe(unsigned int h)
+{
+	return (h >> 16) | (h << 16);
+}
+
+static void bloom_add(struct label_filter *filter, unsigned int h)
+{
+	unsigned int b1 = h & filter->bloom_mask;
+	unsigned int b2 = second_probe(h) & filter->bloom_mask;
+	filter->bloom[b1 / WORD_BITS] |= 1UL << (b1 % WORD_BITS);
+	filter->bloom[b2 / WORD_BITS] |= 1UL << (b2 % WORD_BITS);
+}
+
+static bool bloom_may_contain(struct label_filter *filter, unsigned int h)
+{
+	unsigned int b1 = h & filter->bloom_mask;
+	unsigned int b2 = second_probe(h) & filter->bloom_mask;
+	return (filter->bloom[b1 / WORD_BITS] & (1UL << (b1 % WORD_BITS))) &&
+		(filter->bloom[b2 / WORD_BITS] & (1UL << (b2 % WORD_BITS)));
+}
+
+struct label_filter *create_label_filter(struct llist *labels,
+		bool leaves_only)
+{
+	struct label_filter *filter = malloc(sizeof(struct label_filter));
+	if (NULL == filter) return NULL;
+
+	/* One bin per label */
+	filter->ids = create_hash(labels->count + 1);
+	filter->id_storage = malloc((labels->count + 1) * sizeof(int));
+	filter->seen_in = malloc((labels->count + 1) * sizeof(int));
+	if (NULL == filter->ids || NULL == filter->id_storage ||
+	    NULL == filter->seen_in)
+		return NULL;
+
+	unsigned int nbits = MIN_BLOOM_BITS;
+	while (nbits < (unsigned int) labels->count * BLOOM_BITS_PER_LABEL)
+		nbits *= 2;
+	filter->bloom_mask = nbits - 1;
+	filter->bloom = calloc((nbits + WORD_BITS - 1) / WORD_BITS,
+			sizeof(unsigned long));
+	if (NULL == filter->bloom) return NULL;
+
+	filter->count = 0;
+	struct list_elem *el;
+	for (el = labels->head; NULL != el; el = el->next) {
+		char *label = el->data;
+		if ('\0' == label[0]) continue;
+		if (NULL != hash_get(filter->ids, label)) continue;
+		int *id = filter->id_storage + filter->count;
+		*id = filter->count;
+		filter->seen_in[*id] = 0;
+		if (! hash_set(filter->ids, label, id)) return NULL;
+		bloom_add(filter, label_hash(label));
+		filter->count++;
+	}
+
+	filter->tree_number = 0;
+	filter->leaves_only = leaves_only;
+
+	return filter;
+}
+
+int label_filter_count(struct label_filter *filter)
+{
+	return filter->count;
+}
+
+bool label_filter_accepts(struct label_filter *filter,
+		struct rooted_tree *tree)
+{
+	int tree_number = ++filter->tree_number;
+	int found = 0;
+	struct list_elem *el;
+
+	if (found == filter->count) return true;
+
+	for (el = tree->nodes_in_order->head; NULL != el; el = el->next) {
+		struct rnode *node = el->data;
+		if (filter->leaves_only && ! is_leaf(node)) continue;
+		if (! bloom_may_contain(filter, label_hash(node->label)))
+			continue;
+		int *id = hash_get(filter->ids, node->label);
+		if (NULL == id) continue;	/* false positive */
+		if (tree_number == filter->seen_in[*id]) continue;
+		filter->seen_in[*id] = tree_number;
+		if (++found == filter->count) return true;
+	}
+
+	return false;
+}
+
+void destroy_label_filter(struct label_filter *filter)
+{
+	destroy_hash(filter->ids);
+	free(filter->id_storage);
+	free(filter->seen_in);
+	free(filter->bloom);
+	free(filter);
+}
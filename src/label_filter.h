@@ -0,0 +1,63 @@
+/* 
+
+Copyright (c) 2009 Thomas Junier and Evgeny Zdobnov, University of Geneva
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+* Neither the name of the University of Geneva nor the names of its
+    contributors may be used to endorse or promote products derived from this
+    software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+/* label_filter.h: cheaply rejecting trees that lack some of a set of labels,
+ * before any real work (LCA, pruning, matching...) is done on them. */
+
+/* The labels are interned (each gets an ID) and also entered in a small Bloom
+ * filter. A tree is then checked by looking at its labels once: most labels
+ * that are not in the set are dismissed by the Bloom filter alone, the others
+ * are looked up to get their ID, and the distinct IDs seen are counted. The
+ * check stops as soon as all labels have been seen. */
+
+#include <stdbool.h>
+
+struct llist;
+struct rooted_tree;
+
+struct label_filter;
+
+/* Creates a filter for the labels in 'labels' (a list of char*, which are
+ * copied). Duplicates and empty labels are ignored. If 'leaves_only' is true,
+ * only leaf labels are considered in the trees; otherwise all labels are.
+ * Returns NULL in case of malloc() problem. */
+
+struct label_filter *create_label_filter(struct llist *labels,
+		bool leaves_only);
+
+/* Returns the number of distinct labels in the filter */
+
+int label_filter_count(struct label_filter *);
+
+/* Returns true iff every label of the filter is found in 'tree'. The tree is
+ * not modified. */
+
+bool label_filter_accepts(struct label_filter *, struct rooted_tree *tree);
+
+void destroy_label_filter(struct label_filter *);
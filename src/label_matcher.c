@@ -0,0 +1,202 @@
+/* 
+
+Copyright (c) 2009 Thomas Junier and Evgeny Zdobnov, University of Geneva
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+* Neither the name of the University of Geneva nor the names of its
+    contributors may be used to endorse or promote products derived from this
+    software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "tree.h"
+#include "rnode.h"
+#include "list.h"
+#include "hash.h"
+#include "label_matcher.h"
+
+enum match_kind { REGEXP, SUBSTRING, PREFIX, SUFFIX, WHOLE };
+
+/* Past this many distinct labels, new labels are still matched, but no longer
+ * remembered: the hash does not grow its number of bins, and long bins would
+ * eventually cost more than regexec(). */
+
+static const int MAX_CACHED_PER_BIN = 10;
+
+/* What the cache points to: only the address matters. */
+
+static char MATCH = 'y';
+static char NO_MATCH = 'n';
+
+struct label_matcher {
+	enum match_kind kind;
+	char *literal;		/* for the string kinds */
+	size_t literal_length;
+	regex_t *preg;		/* for REGEXP */
+	struct hash *cache;	/* label -> &MATCH or &NO_MATCH */
+	int max_cached;
+};
+
+/* Characters that are special somewhere in a POSIX basic regexp (in GNU
+ * implementations, '\' also introduces '\+', '\|', etc.). Any other character
+ * stands for itself. */
+
+static const char *SPECIAL = ".[]\\*^$";
+
+/* Works out whether 'regexp' is a literal string, possibly anchored at one or
+ * both ends, and if so sets the matcher's kind and literal. Returns false
+ * otherwise. */
+
+static bool parse_literal(struct label_matcher *matcher, const char *regexp)
+{
+	bool anchored_start = false, anchored_end = false;
+	size_t length = strlen(regexp);
+
+	if ('^' == regexp[0]) {
+		anchored_start = true;
+		regexp++; length--;
+	} else if (0 == strncmp(regexp, ".*", 2)) {
+		/* same as no anchor */
+		regexp += 2; length -= 2;
+	}
+	if (length >= 2 && 0 == strcmp(regexp + length - 2, ".*")) {
+		length -= 2;
+	} else if (length >= 1 && '$' == regexp[length-1]) {
+		anchored_end = true;
+		length--;
+	}
+
+	size_t i;
+	for (i = 0; i < length; i++)
+		if (NULL != strchr(SPECIAL, regexp[i]))
+			return false;
+
+	matcher->literal = malloc(length + 1);
+	if (NULL == matcher->literal) return false;
+	memcpy(matcher->literal, regexp, length);
+	matcher->literal[length] = '\0';
+	matcher->literal_length = length;
+	if (anchored_start && anchored_end)
+		matcher->kind = WHOLE;
+	else if (anchored_start)
+		matcher->kind = PREFIX;
+	else if (anchored_end)
+		matcher->kind = SUFFIX;
+	else
+		matcher->kind = SUBSTRING;
+
+	return true;
+}
+
+struct label_matcher *create_label_matcher(const char *regexp_string,
+		regex_t *preg, int cache_size)
+{
+	struct label_matcher *matcher = malloc(sizeof(struct label_matcher));
+	if (NULL == matcher) return NULL;
+
+	matcher->preg = preg;
+	matcher->literal = NULL;
+	matcher->cache = NULL;
+	if (parse_literal(matcher, regexp_string))
+		return matcher;
+
+	matcher->kind = REGEXP;
+	if (cache_size < 1) cache_size = 1;
+	matcher->cache = create_hash(cache_size);
+	if (NULL == matcher->cache) return NULL;
+	matcher->max_cached = cache_size * MAX_CACHED_PER_BIN;
+
+	return matcher;
+}
+
+static bool regexp_matches(struct label_matcher *matcher, const char *label)
+{
+	char *cached = hash_get(matcher->cache, label);
+	if (NULL != cached) return &MATCH == cached;
+
+	size_t nmatch = 1;	/* either matches or doesn't */
+	regmatch_t pmatch[nmatch];
+	bool match = (0 == regexec(matcher->preg, label, nmatch, pmatch, 0));
+
+	/* A failed hash_set() only means the label won't be remembered */
+	if (matcher->cache->count < matcher->max_cached)
+		hash_set(matcher->cache, label, match ? &MATCH : &NO_MATCH);
+
+	return match;
+}
+
+bool label_matches(struct label_matcher *matcher, const char *label)
+{
+	size_t label_length;
+
+	switch (matcher->kind) {
+	case SUBSTRING:
+		return NULL != strstr(label, matcher->literal);
+	case PREFIX:
+		return 0 == strncmp(label, matcher->literal,
+				matcher->literal_length);
+	case SUFFIX:
+		label_length = strlen(label);
+		return label_length >= matcher->literal_length &&
+			0 == strcmp(label + label_length -
+					matcher->literal_length,
+					matcher->literal);
+	case WHOLE:
+		return 0 == strcmp(label, matcher->literal);
+	case REGEXP:
+		return regexp_matches(matcher, label);
+	}
+
+	return false;
+}
+
+bool label_matcher_is_literal(struct label_matcher *matcher)
+{
+	return REGEXP != matcher->kind;
+}
+
+struct llist *nodes_from_label_matcher(struct rooted_tree *tree,
+		struct label_matcher *matcher)
+{
+	struct llist *result = create_llist();
+	if (NULL == result) return NULL;
+	struct list_elem *el;
+
+	for (el = tree->nodes_in_order->head; NULL != el; el = el->next) {
+		struct rnode *node = el->data;
+		if (label_matches(matcher, node->label))
+			if (! append_element(result, node))
+				return NULL;
+	}
+
+	return result;
+}
+
+void destroy_label_matcher(struct label_matcher *matcher)
+{
+	free(matcher->literal);
+	if (NULL != matcher->cache) destroy_hash(matcher->cache);
+	free(matcher);
+}
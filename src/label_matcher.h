@@ -0,0 +1,72 @@
+/* 
+
+Copyright (c) 2009 Thomas Junier and Evgeny Zdobnov, University of Geneva
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+* Neither the name of the University of Geneva nor the names of its
+    contributors may be used to endorse or promote products derived from this
+    software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+/* label_matcher.h: selecting node labels with a regular expression, over a
+ * stream of trees. */
+
+/* Trees in a stream typically share most of their labels, so the result of
+ * matching each distinct label is remembered, and the regexp is run only once
+ * per label rather than once per label per tree. Besides, many expressions
+ * are really plain strings, possibly anchored (e.g. '^HRV', 'Homo$', or
+ * '^POLIO.*'): these are recognized, and matched with string comparisons
+ * instead of regexec() (and without a cache, which they don't need). */
+
+#include <stdbool.h>
+#include <regex.h>
+
+struct rooted_tree;
+struct llist;
+
+struct label_matcher;
+
+/* Creates a matcher for 'regexp_string', which 'preg' must have been compiled
+ * from (with regcomp() and no flags, i.e. as a basic regexp); 'preg' is still
+ * owned by the caller, and must outlive the matcher. 'cache_size' is the
+ * expected number of distinct labels. Returns NULL in case of malloc()
+ * problem. */
+
+struct label_matcher *create_label_matcher(const char *regexp_string,
+		regex_t *preg, int cache_size);
+
+/* Returns true iff the expression matches 'label' */
+
+bool label_matches(struct label_matcher *, const char *label);
+
+/* Returns true iff the matcher uses string comparisons rather than regexec()
+ * (this is mostly for testing). */
+
+bool label_matcher_is_literal(struct label_matcher *);
+
+/* Like nodes_from_regexp() (see tree.h), but with a matcher. Returns NULL in
+ * case of malloc() problem. */
+
+struct llist *nodes_from_label_matcher(struct rooted_tree *tree,
+		struct label_matcher *);
+
+void destroy_label_matcher(struct label_matcher *);
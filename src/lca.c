@@ -30,15 +30,17 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <limits.h>
+#include <stdbool.h>
 
 #include "tree.h"
 #include "rnode.h"
 #include "list.h"
 #include "hash.h"
 #include "nodemap.h"
+#include "rnode_iterator.h"
 #include "error.h"
-
-struct rooted_tree *lca2w_tree;
+#include "common.h"
 
 /* NOTE: these two functions are obsolete, but I keep them in case the new
  * implementation turns out to be faulty. */
@@ -98,43 +100,178 @@ struct rnode *lca2(struct rooted_tree *tree, struct rnode *desc_A,
 	return desc_B;
 }
 
-/* A wrapper around lca2() so it can be passed to reduce() */
+/* The descendants' subtrees all lie within the LCA's, and a subtree's nodes
+ * have consecutive ranks. So the LCA is the first node, on the way up from the
+ * descendant ranked last, whose range also includes the lowest rank. */
 
-void * lca2w(void *a, void *b)
+struct rnode *lca_from_numbered_nodes(struct llist *descendants)
 {
-	return lca2(lca2w_tree, (struct rnode*) a,
-			(struct rnode *) b);
+	if (0 == descendants->count) return NULL;
+
+	struct list_elem *el = descendants->head;
+	struct rnode *highest = el->data;
+	int lowest_rank = highest->rank;
+	for (el = el->next; NULL != el; el = el->next) {
+		struct rnode *node = el->data;
+		if (node->rank > highest->rank) highest = node;
+		if (node->first_rank < lowest_rank)
+			lowest_rank = node->first_rank;
+	}
+
+	struct rnode *ancestor = highest;
+	while (ancestor->first_rank > lowest_rank)
+		ancestor = ancestor->parent;
+
+	return ancestor;
 }
 
-/* Returns the LCA of any number of nodes, by applying lca2 to a list of
- * descendants. THIS USES UP THE LIST! Use lca_from_nodes() to keep the
- * argument list intact. */
+/* The Euler tour of the tree, with a sparse table for range minimum queries
+ * on the nodes' depths: min_pos[j][i] is the position of the shallowest node
+ * among the 2^j that start at position i of the tour. */
+
+struct lca_table {
+	int length;		/* of the tour */
+	struct rnode **tour;
+	int *depth;		/* of the nodes in the tour */
+	int *first_visit;	/* position in the tour, indexed by rank */
+	int *log2;		/* floor of the log2 of 1..length */
+	int levels;		/* number of arrays in min_pos */
+	int **min_pos;
+};
+
+void destroy_lca_table(struct lca_table *table)
+{
+	int j;
+	if (NULL != table->min_pos)
+		for (j = 0; j < table->levels; j++)
+			free(table->min_pos[j]);
+	free(table->min_pos);
+	free(table->log2);
+	free(table->first_visit);
+	free(table->depth);
+	free(table->tour);
+	free(table);
+}
 
-static struct rnode *lca (struct rooted_tree *tree,
-		struct llist *descendants)
+/* Fills the tour and the first visits. Returns FAILURE iff the traversal
+ * fails (malloc()). */
+
+static int euler_tour(struct lca_table *table, struct rnode *root)
 {
-	void * result;
+	struct rnode_traversal *trav = create_rnode_traversal(root,
+			TRAVERSAL_EULER);
+	if (NULL == trav) return FAILURE;
+	struct rnode *node;
+	int pos = 0;
+	while (NULL != (node = rnode_traversal_next(trav))) {
+		if (0 == rnode_traversal_visit_index(trav))
+			table->first_visit[node->rank] = pos;
+		table->tour[pos] = node;
+		table->depth[pos] = rnode_traversal_depth(trav);
+		pos++;
+	}
+	bool failed = rnode_traversal_failed(trav);
+	destroy_rnode_traversal(trav);
+	return failed ? FAILURE : SUCCESS;
+}
 
-	/* lca2w() has only 2 args (by definition of reduce() in
-	 * list.h), but lca() needs *tree */
-	lca2w_tree = tree; 
-	result = reduce(descendants, lca2w);
+struct lca_table *create_lca_table(struct rnode *root)
+{
+	struct lca_table *table = calloc(1, sizeof(struct lca_table));
+	if (NULL == table) return NULL;
+
+	number_nodes(root);
+	int node_count = root->rank + 1;	/* postorder: root is last */
+	int length = 2 * node_count - 1;
+	int i, j;
+
+	table->length = length;
+	table->tour = malloc(length * sizeof(struct rnode *));
+	table->depth = malloc(length * sizeof(int));
+	table->first_visit = malloc(node_count * sizeof(int));
+	table->log2 = malloc((length + 1) * sizeof(int));
+	if (NULL == table->tour || NULL == table->depth ||
+	    NULL == table->first_visit || NULL == table->log2 ||
+	    ! euler_tour(table, root)) {
+		destroy_lca_table(table);
+		return NULL;
+	}
 
-	return result;
+	table->log2[1] = 0;
+	for (i = 2; i <= length; i++)
+		table->log2[i] = table->log2[i / 2] + 1;
+	table->levels = table->log2[length] + 1;
+	table->min_pos = calloc(table->levels, sizeof(int *));
+	if (NULL == table->min_pos) {
+		destroy_lca_table(table);
+		return NULL;
+	}
+
+	/* Each level is made from the previous one, whose intervals are half
+	 * as long. */
+	for (j = 0; j < table->levels; j++) {
+		int count = length - (1 << j) + 1;
+		int *level = malloc(count * sizeof(int));
+		if (NULL == level) {
+			destroy_lca_table(table);
+			return NULL;
+		}
+		table->min_pos[j] = level;
+		if (0 == j) {
+			for (i = 0; i < count; i++) level[i] = i;
+			continue;
+		}
+		int *prev = table->min_pos[j-1];
+		int half = 1 << (j-1);
+		for (i = 0; i < count; i++) {
+			int a = prev[i], b = prev[i + half];
+			level[i] = table->depth[a] <= table->depth[b] ? a : b;
+		}
+	}
+
+	return table;
 }
 
-struct rnode *lca_from_nodes (struct rooted_tree *tree,
+/* The LCA of a set of nodes is the shallowest node in the tour between the
+ * first and last of their first visits. */
+
+struct rnode *lca_from_table(struct lca_table *table,
 		struct llist *descendants)
 {
-	struct rnode *result;
-	struct llist *copy = shallow_copy(descendants);
-	if (NULL == copy) return NULL;
+	if (0 == descendants->count) return NULL;
 
-	result = lca(tree, copy);
-	if (NULL == result) return NULL;
+	int lo = INT_MAX, hi = -1;
+	struct list_elem *el;
+	for (el = descendants->head; NULL != el; el = el->next) {
+		struct rnode *node = el->data;
+		int pos = table->first_visit[node->rank];
+		if (pos < lo) lo = pos;
+		if (pos > hi) hi = pos;
+	}
 
-	destroy_llist(copy);
-	return result;
+	/* Two (overlapping) intervals of length 2^j cover [lo, hi]. */
+	int j = table->log2[hi - lo + 1];
+	int a = table->min_pos[j][lo];
+	int b = table->min_pos[j][hi - (1 << j) + 1];
+	return table->tour[table->depth[a] <= table->depth[b] ? a : b];
+}
+
+/* Returns the LCA of any number of nodes (NULL if there are none). This
+ * numbers the tree, which takes linear time - much less than the pairwise
+ * lca2(), which needs a hash of the whole tree for each pair. */
+
+static struct rnode *lca (struct rooted_tree *tree,
+		struct llist *descendants)
+{
+	if (0 == descendants->count) return NULL;
+	number_nodes(tree->root);
+	return lca_from_numbered_nodes(descendants);
+}
+
+struct rnode *lca_from_nodes (struct rooted_tree *tree,
+		struct llist *descendants)
+{
+	return lca(tree, descendants);
 }
 
 struct rnode *lca_from_labels(struct rooted_tree *tree, struct llist *labels)
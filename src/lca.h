@@ -40,10 +40,38 @@ struct llist;
 struct rnode *lca2(struct rooted_tree *, struct rnode *,
 		struct rnode *);
 
-/* Given a tree and a list of nodes, returns the LCA */
+/* Given a tree and a list of nodes, returns the LCA. The list is left
+ * intact, and the tree is numbered as a side effect (see number_nodes() in
+ * rnode.h). */
 
 struct rnode *lca_from_nodes(struct rooted_tree *tree, struct llist *labels);
 
+/* Like lca_from_nodes(), but the tree must already be numbered: this takes
+ * time proportional to the number of nodes in the list plus the distance from
+ * one of them up to the LCA (at most the tree's depth). Returns NULL iff the
+ * list is empty. */
+
+struct rnode *lca_from_numbered_nodes(struct llist *nodes);
+
+/* For many LCA queries on the same tree: the table is built once, in time
+ * O(n log n) for n nodes, after which each query takes time proportional to
+ * the number of nodes in it, whatever the shape of the tree. */
+
+struct lca_table;
+
+/* Builds the table for the tree rooted at 'root', which is numbered as a side
+ * effect (see number_nodes() in rnode.h). The table is only valid until the
+ * tree is next modified. Returns NULL in case of malloc() error. */
+
+struct lca_table *create_lca_table(struct rnode *root);
+
+/* Returns the LCA of the nodes in the list (which must all be in the table's
+ * tree), or NULL iff the list is empty. */
+
+struct rnode *lca_from_table(struct lca_table *table, struct llist *nodes);
+
+void destroy_lca_table(struct lca_table *table);
+
 /* Given a tree and a list of labels, returns the LCA (assumes labels are
 unique in tree - use lca_from_labels_multi() if labels are not known to be
 unique) - NOTE: there is probably no reason to use this function rather than
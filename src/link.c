@@ -52,105 +52,93 @@ void add_child(struct rnode *parent, struct rnode *child)
 {
 	child->parent = parent;
 
-	if (0 == parent->child_count)
+	if (0 == parent->child_count) {
 		parent->first_child = child;
-	else
+		child->prev_sibling = NULL;
+	} else {
 		parent->last_child->next_sibling = child;
+		child->prev_sibling = parent->last_child;
+	}
 
 	parent->child_count++;
 	parent->last_child = child;
 	child->linked = true;
 }
 
-/* Returns half the length passed as a parameter (as char *), or "". */
-
-char * compute_new_edge_length(char * length_as_string)
-{
-	char *result;
-
-	if (0 != strcmp("", length_as_string)) {
-		double length = atof(length_as_string);
-		result = masprintf("%g", length / 2);
-		if (NULL == result) return NULL;
-	} else  {
-                /* Note: we cannot just say result = ""; because result will be
-                 * free()d later, so it has to have been dynamically allocated.
-                 * */
-                result = strdup("");
-        }
-
-	return result;
-}
-
 int insert_node_above(struct rnode *this, char *label)
 {
 	struct rnode *new;
-	char * new_edge_length;	/* both new edges have 1/2 the length of the
-				   old one */
 
-	new_edge_length = compute_new_edge_length(this->edge_length_as_string);
-	if (NULL == new_edge_length) return FAILURE;
 	/* create new node */
-	new = create_rnode(label, new_edge_length);
+	new = create_rnode(label, NULL);
 	if (NULL == new) return FAILURE;
-	free(this->edge_length_as_string);
-	this->edge_length_as_string = strdup(new_edge_length);
+	/* both new edges have 1/2 the length of the old one */
+	if (has_edge_length(this)) {
+		double new_edge_length = this->edge_length / 2;
+		if (! set_edge_length(new, new_edge_length)) return FAILURE;
+		if (! set_edge_length(this, new_edge_length)) return FAILURE;
+	}
 	replace_child(this, new);
 	this->next_sibling = NULL;
 	/* link new node to this node */
 	add_child(new, this);
 
-	free(new_edge_length);
-
 	return SUCCESS;
 }
 	
 void replace_child (struct rnode *old, struct rnode *new)
 {
-	/* To replace the old rnode by the new one, we need a pointer to the
-	 * node _before_ the old node (so as to be able to change its
-	 * next_sibling member). We therefore start "ahead" of the list, using
-	 * a dummy first child. */
-
-	struct rnode dummy_first;	/* NOT a pointer! */
-	struct rnode *current;
 	struct rnode *dad = old->parent;
 
-	dummy_first.next_sibling = dad->first_child;
-
-	for (current = &dummy_first; NULL != current->next_sibling;
-			current = current->next_sibling) 
-		if (current->next_sibling == old) 
-			break;
-
-	current->next_sibling = new;
+	/* Thanks to the prev_sibling links, there is no need to look for the
+	 * node before 'old' in the children list. */
+	new->prev_sibling = old->prev_sibling;
 	new->next_sibling = old->next_sibling; 
 	if (dad->first_child == old) 
 		dad->first_child = new;
+	else
+		old->prev_sibling->next_sibling = new;
 	if (dad->last_child == old)
 		dad->last_child = new;
+	else
+		old->next_sibling->prev_sibling = new;
 	new->parent = dad;
 	new->linked = true;
 }
 
-char *add_len_strings(char *ls1, char *ls2)
+/* Removes 'child' from its parent's children list, in constant time. The
+ * child's 'parent' member is left alone. */
+
+static void detach_child(struct rnode *child)
 {
-	char * result;
-
-	/* if ls1 and ls2 are not both "" */
-	if (	strcmp("", ls1) != 0 ||
-		strcmp("", ls2) != 0)	{
-		double l1 = atof(ls1);
-		double l2 = atof(ls2);
-		result = masprintf("%g", l1 + l2);
-		if (NULL == result) return NULL;
-	} else {
-		result = strdup("");
-		/* I'd be REALLY suprised if this fails... */
-		if (NULL == result) return NULL;
-	}
+	struct rnode *parent = child->parent;
+	struct rnode *prev = child->prev_sibling;
+	/* The last child's next_sibling isn't necessarily NULL (see
+	 * add_child()) */
+	struct rnode *next = (parent->last_child == child) ?
+		NULL : child->next_sibling;
+
+	if (NULL == prev)
+		parent->first_child = next;
+	else
+		prev->next_sibling = next;
+	if (NULL == next)
+		parent->last_child = prev;
+	else
+		next->prev_sibling = prev;
 
-	return result;
+	child->prev_sibling = NULL;
+	child->linked = false;
+	parent->child_count--;
+}
+
+int add_edge_length(struct rnode *node, struct rnode *other)
+{
+	/* if both lengths are undefined, so is the sum */
+	if (! has_edge_length(node) && ! has_edge_length(other))
+		return SUCCESS;
+
+	return set_edge_length(node, node->edge_length + other->edge_length);
 }
 
 /* 'this' node is the one that is to be spliced out. All nodes and edges are
@@ -158,43 +146,40 @@ char *add_len_strings(char *ls1, char *ls2)
 
 int splice_out_rnode(struct rnode *this)
 {
-	struct rnode dummy_head;	/* see [where?] */
 	struct rnode *parent = this->parent;
-	struct rnode *current_child, *current_sibling;
+	struct rnode *current_child;
+
+	/* An unlinked (or already spliced-out) node is not among its parent's
+	 * children anymore: there is nothing to do. */
+	if (! this->linked) return SUCCESS;
 
 	/* change the children's parent edges: they must now point to their
 	 * 'grandparent', and the length from their parent to their grandparent
 	 * must be added. */
 	for (current_child = this->first_child; NULL != current_child;
-			current_child = current_child->next_sibling) {
-		char *new_edge_len_s = add_len_strings(
-			this->edge_length_as_string,
-			current_child->edge_length_as_string);
-		if (NULL == new_edge_len_s) return FAILURE;
-		free(current_child->edge_length_as_string);
-		current_child->edge_length_as_string = new_edge_len_s;
+			current_child = (this->last_child == current_child) ?
+				NULL : current_child->next_sibling) {
+		if (! add_edge_length(current_child, this)) return FAILURE;
 		current_child->parent = parent;  /* instead of this node */
 	}
 
 	/* Insert this node's children in place of itself among its parent's
-	 * children */
-	dummy_head.next_sibling = parent->first_child;
-	for (current_sibling = &dummy_head;
-			NULL != current_sibling->next_sibling;
-			current_sibling = current_sibling->next_sibling) {
-
-		if (current_sibling->next_sibling == this) {
-			current_sibling->next_sibling = this->first_child;
-			this->last_child->next_sibling = this->next_sibling;
-			break;
-		}
-	}
-
-	/* Update prent's first_child and last_child pointers, if needed */
-	if (parent->first_child == this)
+	 * children. The prev_sibling link gives us the node before this one
+	 * directly. */
+	struct rnode *prev = this->prev_sibling;
+	struct rnode *next = (parent->last_child == this) ?
+		NULL : this->next_sibling;
+
+	this->first_child->prev_sibling = prev;
+	this->last_child->next_sibling = next;
+	if (NULL == prev)
 		parent->first_child = this->first_child;
-	if (parent->last_child == this)
+	else
+		prev->next_sibling = this->first_child;
+	if (NULL == next)
 		parent->last_child = this->last_child;
+	else
+		next->prev_sibling = this->last_child;
 
 	/* Update parent's children count */
 	parent->child_count += this->child_count - 1;
@@ -209,78 +194,60 @@ int remove_child(struct rnode *child)
 {
 	if (is_root(child)) return RM_CHILD_HAS_NO_PARENT;
 
-	struct rnode *parent = child->parent;
-	struct rnode dummy_head;
-	struct rnode *previous;
-	int n;
+	/* Only the index costs time proportional to the number of siblings:
+	 * callers that don't need it should use detach_child(). */
+	int n = 0;
+	struct rnode *sib;
+	for (sib = child->prev_sibling; NULL != sib; sib = sib->prev_sibling)
+		n++;
 
-	child->linked = false;
+	detach_child(child);
+	return n;	
+}
 
-	/* Easy special case: parent has exactly one child. */
-	if (1 == parent->child_count) {
-		parent->first_child = NULL;
-		parent->last_child = NULL;
-		parent->child_count = 0;
-		return 0;
-	}
+/* Returns the 'index'th child of 'parent' (0-based), walking from whichever end
+ * of the children list is closer. */
 
-	/* Find node previous to child. We need a dummy head node, in case the
-	 * child to remove is the list's head (and there is therefore no real
-	 * previous node) */
-	dummy_head.label = "DUMMY";
-	dummy_head.edge_length_as_string = "-1";
-	dummy_head.edge_length = -1;
-	dummy_head.data = NULL;
-	dummy_head.parent = parent;
-	dummy_head.first_child = dummy_head.last_child = NULL;
-	dummy_head.child_count = 0;
-	dummy_head.next_sibling = parent->first_child;
-
-	for (n = 0, previous = &dummy_head;
-		NULL != previous->next_sibling;
-		n++, previous = previous->next_sibling) 
-		if (previous->next_sibling == child) 
-			break;
-	
-	/* Update parent's first_child and last_child, if needed. */
-	if (parent->first_child == child)
-		parent->first_child = child->next_sibling;
-	if (parent->last_child == previous->next_sibling)
-			parent->last_child = previous;
+static struct rnode *nth_child(struct rnode *parent, int index)
+{
+	struct rnode *kid;
+	int n;
 
-	// TODO: SEGV around here. GDB: set bp here iff label is 22
-	/* Skip 'child', effectively removing it from children list */
-	previous->next_sibling = previous->next_sibling->next_sibling;
+	if (index < parent->child_count / 2)
+		for (kid = parent->first_child, n = 0; n < index; n++)
+			kid = kid->next_sibling;
+	else
+		for (kid = parent->last_child, n = parent->child_count - 1;
+				n > index; n--)
+			kid = kid->prev_sibling;
 
-	parent->child_count --;
-	return n;	
+	return kid;
 }
 
 int insert_child(struct rnode *parent, struct rnode *insert, int index)
 {
-	struct rnode dummy_head, *current;
-	int n;
-
 	if (index < 0 || index > parent->child_count)
 		return FAILURE;	/* invalid index */
 
-	/* Find node just before insertion point */
-	dummy_head.next_sibling = parent->first_child;
-	for (	current = &dummy_head, n = index; 
-		n > 0;
-		current = current->next_sibling, n--);
+	if (parent->child_count == index) {
+		add_child(parent, insert);
+		return SUCCESS;
+	}
 
-	/* current is now the node before the insertion point */
-	insert->next_sibling = current->next_sibling;
-	current->next_sibling = insert;
-	insert->parent = parent;
-	insert->linked = true;
+	/* 'next' is the node currently at the insertion point */
+	struct rnode *next = nth_child(parent, index);
+	struct rnode *prev = next->prev_sibling;
 
-	/* Update parent's child pointers */
-	if (0 == index)
+	insert->prev_sibling = prev;
+	insert->next_sibling = next;
+	next->prev_sibling = insert;
+	if (NULL == prev)
 		parent->first_child = insert;
-	if (parent->child_count == index)
-		parent->last_child = insert;
+	else
+		prev->next_sibling = insert;
+	insert->parent = parent;
+	insert->linked = true;
+	parent->child_count++;
 
 	return SUCCESS;
 }
@@ -297,8 +264,7 @@ static int _swap_nodes(struct rnode *node, bool i_node_lbl_as_support)
 	assert(is_root(node->parent));  /* must swap below root */
 
 	struct rnode *parent = node->parent;
-	char *length = strdup(node->edge_length_as_string);
-	if(remove_child(node) < 0) return FAILURE;
+	detach_child(node);
 	node->parent = NULL;
 	add_child(node, parent);
 
@@ -307,10 +273,8 @@ static int _swap_nodes(struct rnode *node, bool i_node_lbl_as_support)
 		parent->label = strdup(node->label);
 	}
 
-	free(node->edge_length_as_string);
-	node->edge_length_as_string = strdup("");
-	free(parent->edge_length_as_string);
-	parent->edge_length_as_string = length;
+	if (! copy_edge_length(parent, node)) return FAILURE;
+	unset_edge_length(node);
 
 	return SUCCESS;
 }
@@ -336,9 +300,14 @@ int unlink_rnode(struct rnode *node)
 	if (! node->linked) return UNLINK_RNODE_DONE;
 
 	struct rnode *parent = node->parent;
-	/* Remove this node from its parent's list of children.  */
-	remove_child(node);
-	node->linked = false;
+	/* Likewise, if the parent has been unlinked, this node has left the
+	 * tree with it. The parent is no longer among its own parent's
+	 * children, so splicing it out (below) would corrupt the tree. */
+	if (! is_root(parent) && ! parent->linked) return UNLINK_RNODE_DONE;
+
+	/* Remove this node from its parent's list of children (we don't need
+	 * its index, so this takes constant time).  */
+	detach_child(node);
 
 	/* If deleting this node results in the parent having only one child,
 	 * we splice the parent out (unless it's the root, in which case we
@@ -60,7 +60,7 @@ void add_child(struct rnode *parent, struct rnode *child);
 
 int insert_node_above(struct rnode *node, char *label);
 
-/* Replaces child node 'old' by 'new'. Does nothing if 'old' is not found. */
+/* Replaces child node 'old' by 'new', in constant time. */
 
 void replace_child(struct rnode *old, struct rnode *new);
 
@@ -69,7 +69,8 @@ void replace_child(struct rnode *old, struct rnode *new);
  * depth is unchanged. */
 
 /* Should NOT be used for deleting ("pruning") nodes (will segfault)! Use
- * unlink_rnode() instead. */
+ * unlink_rnode() instead. Does nothing if 'node' has already been unlinked or
+ * spliced out. */
 /* Returns FAILURE iff there is a malloc() problem. */
 
 int splice_out_rnode(struct rnode *node);
@@ -78,7 +79,8 @@ int splice_out_rnode(struct rnode *node);
  * the list prior to removal. Child's parent is set to NULL. In case of error,
  * returns a negative number (see RM_CHILD_*) above. This function makes no
  * attempt to leave the tree in a coherent state, see unlink_rnode() for this.
- * */
+ * The removal itself takes constant time, but finding the index takes time
+ * proportional to the number of preceding siblings. */
 
 enum remove_child_status remove_child(struct rnode *child);
 
@@ -86,6 +88,8 @@ enum remove_child_status remove_child(struct rnode *child);
  * the child's parent. An index of 0 means insertion before the first child, an
  * index of 1 means after the first child, etc. If there are n children, an
  * index of n means inserttion after the last child. */
+/* Runs in time proportional to the distance from 'index' to the nearest end
+ * of the children list, so appending and prepending take constant time. */
 /* Returns FAILURE iff index is off limits (<0 or > number of children). */
 
 int insert_child(struct rnode *parent, struct rnode *insert, int index);
@@ -114,7 +118,8 @@ int swap_nodes_wsupport(struct rnode *node, bool i_node_lbl_as_support);
  * out.
  * RETURN VALUE:
 	UNLINK_RNODE_ERROR - there was an error (malloc(), most probably)
-	UNLINK_RNODE_DONE - cases 1 and 3 (nothing else to do)
+	UNLINK_RNODE_DONE - cases 1 and 3 (nothing else to do), or the node
+		or its parent had already been unlinked (nothing is done)
 	UNLINK_RNODE_ROOT_CHILD - case 2; use get_unlink_rnode_root_child()
 		to get the root's only child.
 */
@@ -134,6 +139,8 @@ struct llist *siblings(struct rnode *);
 
 void remove_children(struct rnode *);
 
-/* takes 2 lengths (as strings), and return their sum (as a string) */
+/* Adds the length of 'other''s parent edge to that of 'node' (an undefined
+ * length counts as zero). If both lengths are undefined, so is the result. */
+/* Returns FAILURE iff there is a malloc() problem. */
 
-char *add_len_strings(char *ls1, char *ls2);
+int add_edge_length(struct rnode *node, struct rnode *other);
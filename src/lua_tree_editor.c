@@ -46,6 +46,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <string.h>
 #include <assert.h>
 #include <stdbool.h>
+#include <pthread.h>
 #include <lua.h>
 #include <lauxlib.h>
 #include <lualib.h>
@@ -56,7 +57,6 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "tree.h"
 #include "parser.h"
 #include "to_newick.h"
-#include "tree_editor_rnode_data.h"
 #include "common.h"
 #include "masprintf.h"
 
@@ -84,10 +84,35 @@ struct parameters {
 	int order;
 	bool stop_clade_at_first_match;
 	bool single;
+	int nb_threads;
 };
 
-struct lua_rnode {
-	struct rnode *orig;	/* Just keep a ptr to the original rnode */
+/* Nodes are passed to Lua as light userdata (i.e., just the struct rnode
+ * pointer), which all share the LRnode metatable: this way, getting a node
+ * handle (N, N.par, etc.) costs no allocation, and handles to the same node
+ * compare equal.
+ *
+ * The predefined variables (lbl, a, d, etc.) are not stored in the globals
+ * table: they are computed on demand (see lua_predefined_variable()) from the
+ * current node and from the following per-tree arrays, indexed by node rank.
+ * The arrays are reused from tree to tree, and only grow. A script may assign
+ * a predefined variable: the value then lives in a table of overrides, which
+ * is cleared when the next node is processed (so that the variable again
+ * reflects the current node). All output (the tree, s(), and print()) goes
+ * to 'out'. There is one state per Lua state. */
+
+struct editor_state {
+	FILE *out;
+	struct rnode *current;	/* NULL outside of process_tree() */
+	int capacity;
+	struct rnode **nodes;	/* in parse order */
+	double *depth;
+	bool *is_depth_defined;
+	int *nb_ancestors;
+	int *nb_descendants;
+	bool *stop_mark;	/* to stop processing of a clade, see option -o */
+	int overrides;		/* registry reference to the overrides table */
+	bool has_overrides;	/* true iff that table may be non-empty */
 };
 
 static void help(char *argv[])
@@ -99,11 +124,11 @@ static void help(char *argv[])
 "Synopsis\n"
 "--------\n"
 "\n"
-"%s [-f:hnoL:r] <newick trees filename|-> <Lua expression>\n"
+"%s [-f:hnoL:rt:] <newick trees filename|-> <Lua expression>\n"
 "\n"
 "or\n"
 "\n"
-"%s [-hnor] -f <filename> <newick trees filename|->\n"
+"%s [-hnor] [-t <threads>] -f <filename> <newick trees filename|->\n"
 "\n"
 "This program is analogous to pattern-oriented, stream processing UNIX\n"
 "utilities like sed(1) and awk(1), but instead of working on lines (like\n"
@@ -152,7 +177,8 @@ static void help(char *argv[])
 "\n"
 "You do not need to define all hooks. Any hook left undefined will be\n"
 "replaced by a no-op function, and nothing will happen on the corresponding\n"
-"event.\n"
+"event. The node hook is passed the current node (see N below) as\n"
+"argument.\n"
 "\n"
 "The program provides specalized Lua functions and variables for working\n"
 "with nodes (see 'Selector' and 'Action' below; they are available in hooks\n"
@@ -277,6 +303,15 @@ static void help(char *argv[])
 "        matches, its descendants are not processed.\n"
 "        Note: this option will automatically set -r, as it makes no\n"
 "        sense in post-order.\n"
+"    -t <number>: process this many trees at a time, in parallel threads.\n"
+"        Each thread has its own Lua interpreter, in which the -L code, the\n"
+"        file passed to -f, and the expressions are loaded: so variables\n"
+"        set while processing a tree are NOT seen when processing the\n"
+"        others, and should not be relied on. The output (trees, s() and\n"
+"        print()) is in input order, but other output (e.g., io.write())\n"
+"        may not be. If start_run or stop_run are defined, this option is\n"
+"        ignored (with a warning), since these hooks normally work on\n"
+"        variables set while processing all trees.\n"
 "\n"
 "Bugs\n"
 "----\n"
@@ -324,8 +359,8 @@ static void help(char *argv[])
 
 static void print_usage(const char *progname) 
 {
-	fprintf(stderr, "Usage: %s [-hnor] <filename|-> <condition> <action>\n"
-			" or:   %s -f scriptname [-hnor] <filename|->\n",
+	fprintf(stderr, "Usage: %s [-hnor] [-t threads] <filename|-> <condition> <action>\n"
+			" or:   %s -f scriptname [-hnor] [-t threads] <filename|->\n",
 			progname, progname);
 }
 
@@ -341,9 +376,10 @@ static struct parameters get_params(int argc, char *argv[])
 	params.order = POST_ORDER;
 	params.stop_clade_at_first_match = false;
 	params.single = true;
+	params.nb_threads = 1;
 
 	int opt_char;
-	while ((opt_char = getopt(argc, argv, "f:hL:nor")) != -1) {
+	while ((opt_char = getopt(argc, argv, "f:hL:nort:")) != -1) {
 		switch (opt_char) {
 		case 'f':
 			params.user_hooks_filename = optarg;
@@ -365,6 +401,14 @@ static struct parameters get_params(int argc, char *argv[])
 		case 'r':
 			params.order = PRE_ORDER;
 			break;
+		case 't':
+			params.nb_threads = atoi(optarg);
+			if (params.nb_threads < 1) {
+				fprintf (stderr, "Number of threads must be "
+					"at least 1 (got '%s')\n", optarg);
+				exit (EXIT_FAILURE);
+			}
+			break;
 		default:
 			fprintf (stderr, "Unknown option '-%c'\n", opt_char);
 			exit (EXIT_FAILURE);
@@ -407,210 +451,219 @@ static struct parameters get_params(int argc, char *argv[])
 	return params;
 }
 
-/* A helper for parse_order_traversal() - gets the number of descendants of a
- * node. This function is NOT recursive, the node data of all descendants must
- * have been set already - which is why we're calling it from
- * parse_order_traversal().
- * */
+/* Makes room for 'count' nodes in the per-tree arrays. */
 
-static int get_nb_descendants(struct rnode *node)
+static void reserve_state(struct editor_state *state, int count)
 {
-	struct rnode *kid;
-	struct rnode_data *rndata;
-	int descendants = 0;
-
-	for (kid = node->first_child; NULL != kid; kid = kid->next_sibling) {
-		rndata = kid->data;
-		descendants += rndata->nb_descendants;
-		descendants += 1;	/* kid itself (no pun intended :-) ) */
+	if (count <= state->capacity)
+		return;
+
+	state->nodes = realloc(state->nodes, count * sizeof(struct rnode *));
+	state->depth = realloc(state->depth, count * sizeof(double));
+	state->is_depth_defined = realloc(state->is_depth_defined,
+			count * sizeof(bool));
+	state->nb_ancestors = realloc(state->nb_ancestors, count * sizeof(int));
+	state->nb_descendants = realloc(state->nb_descendants,
+			count * sizeof(int));
+	state->stop_mark = realloc(state->stop_mark, count * sizeof(bool));
+	if (NULL == state->nodes || NULL == state->depth
+		|| NULL == state->is_depth_defined
+		|| NULL == state->nb_ancestors
+		|| NULL == state->nb_descendants
+		|| NULL == state->stop_mark) {
+		perror(NULL);
+		exit(EXIT_FAILURE);
 	}
-
-	return descendants;
+	state->capacity = count;
 }
 
-/* This allocates the rnode_data structure for each node, and fills it with
- * "top-down" data,  i.e. data for which the parent's value needs to be known
- * (such as depth and number of ancestors). Some values do not depend on the
- * parent nor on the children, I also set them here (this is arbitrary, I
- * could set them in parse_order_traversal() below as well). */
+/* Ranks the nodes in parse order, and fills the per-tree arrays: "top-down"
+ * data (depth, number of ancestors), for which the parent's value must be
+ * known, in reverse parse order; and "bottom-up" data (number of
+ * descendants) in parse order. This must be done before the tree is
+ * modified, since the actions may unlink nodes. */
 
-static void reverse_parse_order_traversal(struct rooted_tree *tree)
+static void fill_state(struct editor_state *state, struct rooted_tree *tree)
 {
 	struct list_elem *el;
-	struct llist *rev_nodes = llist_reverse(tree->nodes_in_order);
-	if (NULL == rev_nodes) { perror(NULL), exit(EXIT_FAILURE); }
-	struct rnode *node;
-	struct rnode_data *rndata;
-
-	el = rev_nodes->head;	/* root */
-	node = (struct rnode *) el->data;
-	rndata = malloc(sizeof(struct rnode_data));
-	if (NULL == rndata) { perror(NULL); exit (EXIT_FAILURE); }
-	rndata->nb_ancestors = 0;
-	rndata->is_depth_defined = true;
-	rndata->depth = 0;
-	rndata->stop_mark = false;
-	node->data = rndata;
-
-	/* WARNING: don't forget to set values for the root's data, above. The
-	 * following loop starts at the first non-root node! */
-
-	for (el = rev_nodes->head->next; NULL != el; el = el -> next) {
-		node = (struct rnode *) el->data;
-		struct rnode_data *parent_data = node->parent->data;
-		rndata = malloc(sizeof(struct rnode_data));
-		if (NULL == rndata) { perror(NULL); exit (EXIT_FAILURE); }
-		rndata->nb_ancestors = parent_data->nb_ancestors + 1;
-
-		if (parent_data->is_depth_defined) {
-			double edge_length;
-			char *endptr;
-			edge_length = strtod(node->edge_length_as_string,
-					&endptr);
-			if (endptr == node->edge_length_as_string) {
-				/* no conversion: depth is undefined */
-				rndata->is_depth_defined = false;
-			} else {
-				rndata->is_depth_defined = true; 
-				rndata->depth = parent_data->depth
-					+ edge_length;
-			}
-		} else {
-			/* We don't even set the value: it must not be used. */
-			rndata->is_depth_defined = false;
-		}
+	int count = tree->nodes_in_order->count;
+	int i;
+
+	reserve_state(state, count);
+
+	for (i = 0, el = tree->nodes_in_order->head; NULL != el;
+			i++, el = el->next) {
+		struct rnode *node = el->data;
+		node->rank = i;
+		state->nodes[i] = node;
+		state->nb_descendants[i] = 0;
+		state->stop_mark[i] = false;
+	}
 
-		rndata->stop_mark = false;
-		node->data = rndata;
+	/* root is last in parse order */
+	state->nb_ancestors[count-1] = 0;
+	state->is_depth_defined[count-1] = true;
+	state->depth[count-1] = 0;
+	for (i = count - 2; i >= 0; i--) {
+		struct rnode *node = state->nodes[i];
+		int parent = node->parent->rank;
+		state->nb_ancestors[i] = state->nb_ancestors[parent] + 1;
+		/* depth is undefined if any edge on the way to the root has
+		 * no length */
+		state->is_depth_defined[i] = state->is_depth_defined[parent]
+			&& has_edge_length(node);
+		if (state->is_depth_defined[i])
+			state->depth[i] = state->depth[parent]
+				+ node->edge_length;
 	}
 
-	destroy_llist(rev_nodes);
+	for (i = 0; i < count - 1; i++) {
+		int parent = state->nodes[i]->parent->rank;
+		state->nb_descendants[parent] += state->nb_descendants[i] + 1;
+	}
 }
 
-/* This fills bottom-up data. Note that it relies on rnode_data being already
- * allocated, which is done in reverse_parse_order_traversal(). Data that does
- * not depend on order is also filled in here. */
+/* Pushes a node handle, or nil if there is no node (e.g. the root's parent). */
 
-static void parse_order_traversal(struct rooted_tree *tree)
+static void push_lnode(lua_State *L, struct rnode *node)
 {
-	struct list_elem *el;
-	struct rnode *node;
-	struct rnode_data *rndata;
-
-	for (el = tree->nodes_in_order->head; NULL != el; el = el -> next) {
-		node = (struct rnode *) el->data;
-		rndata = (struct rnode_data *) node->data;
-		rndata->support = atof(node->label);	
-		rndata->nb_descendants = get_nb_descendants(node);
-	}
+	if (NULL == node)
+		lua_pushnil(L);
+	else
+		lua_pushlightuserdata(L, node);
 }
 
-static int lua_set_current_node(lua_State *L, struct rnode *current)
-{
-	struct lua_rnode *lua_current = lua_newuserdata(L,
-			sizeof (struct lua_rnode));
-
-	luaL_getmetatable(L, "LRnode");
-	lua_setmetatable(L, -2);
+/* Pushes the node's label as a bootstrap support value, or nil if this can't
+ * be done (leaves have no support value). */
 
-	// TODO: shouldn't we check for NULL?
-	lua_current->orig = current;
-	return 1;
+static void push_support(lua_State *L, struct rnode *node)
+{
+	if (is_leaf(node)) {
+		lua_pushnil(L);
+		return;
+	}
+	lua_pushstring(L, node->label);
+	if (lua_isnumber(L, -1)) {
+		lua_Number b = lua_tonumber(L, -1);
+		lua_pop(L, 1);
+		lua_pushnumber(L, b);
+	} else {
+		lua_pop(L, 1);
+		lua_pushnil(L);
+	}
 }
 
+/* True iff 'name' is that of a predefined variable */
 
-/* Sets the value of the predefined variables (i, l, a, etc), according to the
- * node passed as argument. This is normally the current node, while visiting
- * the tree. Using variables rather than functions makes for shorter Scheme
- * expression can be shorter, because function calls can be replaced by
- * variables, e.g. (< 2 a) instead of (< 2 (a)) to check that the current node
- * has fewer than two ancestors. On the command line, this is handy. */
-
-static void set_predefined_variables(struct rnode *node, lua_State *L)
+static bool is_predefined_variable(const char *name, size_t length)
 {
-	int initial_lua_stack_size = lua_gettop(L);
+	if (3 == length)
+		return 0 == strcmp("lbl", name);
+	return 1 == length && '\0' != name[0] &&
+		NULL != strchr("NabcdDiLlr", name[0]);
+}
 
-	/* N: current node */
-	lua_set_current_node(L, node);
-	lua_setglobal(L, "N");
+/* The __index metamethod of the globals table: pushes the value of the
+ * predefined variable (i, l, a, etc) whose name is passed as argument,
+ * according to the current node (unless the script assigned it, see
+ * lua_set_predefined_variable()). Using variables rather than functions makes
+ * for shorter Lua expressions on the command line, e.g. 'a < 2' instead of
+ * 'a() < 2' to check that the current node has fewer than two ancestors.
+ * Since the globals table is only consulted when the name is not an ordinary
+ * global, a variable costs nothing unless it is actually used. Any other name
+ * is nil, as usual for undefined globals. */
+
+static int lua_predefined_variable(lua_State *L)
+{
+	struct editor_state *state = lua_touserdata(L, lua_upvalueindex(1));
+	struct rnode *node = state->current;
+	size_t length;
+	const char *name;
+
+	if (state->has_overrides) {
+		lua_rawgeti(L, LUA_REGISTRYINDEX, state->overrides);
+		lua_pushvalue(L, 2);
+		lua_rawget(L, -2);
+		if (! lua_isnil(L, -1))
+			return 1;
+		lua_pop(L, 2);
+	}
 
-	lua_pushstring(L, node->label);
-	lua_setglobal(L, "lbl");
+	if (NULL == node || LUA_TSTRING != lua_type(L, 2))
+		return 0;
+	name = lua_tolstring(L, 2, &length);
 
-	/* b: returns node label, as a bootstrap support value (or nil if
-	this can't be done) */
-	if (is_leaf(node)) {
-		lua_pushnil(L);
-	} else {
+	if (3 == length && 0 == strcmp("lbl", name)) {
 		lua_pushstring(L, node->label);
-		if (lua_isnumber(L, -1)) {
-			lua_Number b = lua_tonumber(L, -1);
-			lua_pop(L, 1);
-			lua_pushnumber(L, b);
-		} else {
-			lua_pop(L, 1);
-			lua_pushnil(L);
-		}
+		return 1;
 	}
-	lua_setglobal(L, "b");
-
-	/* i: true IFF node is inner (not leaf, not root) */
-	if (is_inner_node(node))
-		lua_pushboolean(L, true);
-	else
-		lua_pushboolean(L, false);
-	lua_setglobal(L, "i");
+	if (1 != length)
+		return 0;
 
-	/* L: parent edge's length */
-	if (strcmp ("", node->edge_length_as_string) == 0) {
-		lua_pushnil(L);
-	} else {
-		/* edge_length_as_string represents a number */
-		lua_pushstring(L, node->edge_length_as_string);
-		lua_Number len = lua_tonumber(L, -1);
-		lua_pop(L, 1);
-		lua_pushnumber(L, len);
+	switch (name[0]) {
+	case 'N':	/* the current node */
+		lua_pushlightuserdata(L, node);
+		break;
+	case 'a':	/* number of ancestors */
+		lua_pushinteger(L, state->nb_ancestors[node->rank]);
+		break;
+	case 'b':	/* support */
+		push_support(L, node);
+		break;
+	case 'c':	/* number of children */
+		lua_pushinteger(L, node->child_count);
+		break;
+	case 'd':	/* depth */
+		if (state->is_depth_defined[node->rank])
+			lua_pushnumber(L, state->depth[node->rank]);
+		else
+			lua_pushnil(L);
+		break;
+	case 'D':	/* number of descendants */
+		lua_pushinteger(L, state->nb_descendants[node->rank]);
+		break;
+	case 'i':	/* inner node (not leaf, not root) */
+		lua_pushboolean(L, is_inner_node(node));
+		break;
+	case 'L':	/* parent edge's length */
+		if (has_edge_length(node))
+			lua_pushnumber(L, node->edge_length);
+		else
+			lua_pushnil(L);
+		break;
+	case 'l':	/* leaf */
+		lua_pushboolean(L, is_leaf(node));
+		break;
+	case 'r':	/* root */
+		lua_pushboolean(L, is_root(node));
+		break;
+	default:
+		return 0;
 	}
-	lua_setglobal(L, "L");
-
-	/* l: true IFF node is a leaf */
-	if (is_leaf(node))
-		lua_pushboolean(L, true);
-	else
-		lua_pushboolean(L, false);
-	lua_setglobal(L, "l");
-
-	/* c: number of children */
-	lua_pushinteger(L, (lua_Integer) node->child_count);
-	lua_setglobal(L, "c");
-	
-	struct rnode_data *data = node->data;
-
-	/* d: depth */
-	if (data->is_depth_defined) 
-		lua_pushnumber(L, data->depth);
-	else
-		lua_pushnil(L);
-	lua_setglobal(L, "d");
-
-	/* a: number of ancestors */
-	lua_pushinteger(L, (lua_Integer) data->nb_ancestors);
-	lua_setglobal(L, "a");
 
-	/* D: number of descendants */
-	//scm_c_define("D", scm_from_int(data->nb_descendants));
-	lua_pushinteger(L, (lua_Integer) data->nb_descendants);
-	lua_setglobal(L, "D");
+	return 1;
+}
 
-	/* r: true iff node is root */
-	if (is_root(node))
-		lua_pushboolean(L, true);
-	else
-		lua_pushboolean(L, false);
-	lua_setglobal(L, "r");
+/* The __newindex metamethod of the globals table: assigning a predefined
+ * variable stores the value among the overrides, where it stays until the
+ * next node; any other name becomes an ordinary global. */
 
-	/* sanity check */
-	assert(lua_gettop(L) == initial_lua_stack_size);
+static int lua_set_predefined_variable(lua_State *L)
+{
+	struct editor_state *state = lua_touserdata(L, lua_upvalueindex(1));
+	size_t length;
+	const char *name;
+
+	if (LUA_TSTRING == lua_type(L, 2)) {
+		name = lua_tolstring(L, 2, &length);
+		if (is_predefined_variable(name, length)) {
+			lua_rawgeti(L, LUA_REGISTRYINDEX, state->overrides);
+			lua_replace(L, 1);
+			state->has_overrides = true;
+		}
+	}
+	lua_rawset(L, 1);
+	return 0;
 }
 
 /* Pushes onto the stack the function at index '*phase' in the globals table. */
@@ -641,74 +694,74 @@ static void set_user_hook(lua_State *L, const char *phase)
 
 
 static void process_tree(struct rooted_tree *tree, lua_State *L,
-		struct parameters params)
+		struct editor_state *state, struct parameters params)
 {
-	struct llist *nodes;
-	struct list_elem *el;
-
-	/* these two traversals fill the node data. */
-	reverse_parse_order_traversal(tree);
-	parse_order_traversal(tree);
-
-	if (POST_ORDER == params.order)
-		nodes = tree->nodes_in_order;
-	else if (PRE_ORDER == params.order) {
-		nodes = llist_reverse(tree->nodes_in_order);
-		if (NULL == nodes) { perror(NULL); exit(EXIT_FAILURE); }
-	}
-	else 
-		assert(0);	 /* programmer error... */
-
-
-	/* Main loop: Iterate over all nodes */
-	for (el = nodes->head; NULL != el; el = el -> next) {
-		struct rnode *current_node = (struct rnode *) el->data;
+	int count = tree->nodes_in_order->count;
+	int i;
+
+	fill_state(state, tree);
+
+	/* The node hook is looked up once per tree, and called with the
+	 * current node as argument. */
+	lua_getglobal(L, NODE);
+
+	/* Main loop: Iterate over all nodes (parse order is post-order; the
+	 * reverse is pre-order) */
+	for (i = 0; i < count; i++) {
+		struct rnode *current_node;
+		if (POST_ORDER == params.order)
+			current_node = state->nodes[i];
+		else if (PRE_ORDER == params.order)
+			current_node = state->nodes[count - 1 - i];
+		else 
+			assert(0);	 /* programmer error... */
 
 		/* Check for stop mark in parent (see option -o) */
 		if (! is_root(current_node)) { 	/* root has no parent... */
-			if (((struct rnode_data *)
-				current_node->parent->data)->stop_mark) {
+			if (state->stop_mark[current_node->parent->rank]) {
 				/* Stop-mark the current node and continue */ 
-				((struct rnode_data *)
-					current_node->data)->stop_mark = true;
+				state->stop_mark[current_node->rank] = true;
 				continue;
 			}
 		} 
 
-		set_predefined_variables(current_node, L);
-		lua_getglobal(L, NODE);
-		lua_call(L, 0, 0);
+		state->current = current_node;
+		if (state->has_overrides) {
+			lua_newtable(L);
+			lua_rawseti(L, LUA_REGISTRYINDEX, state->overrides);
+			state->has_overrides = false;
+		}
+		lua_pushvalue(L, -1);
+		lua_pushlightuserdata(L, current_node);
+		lua_call(L, 1, 0);
 	} /* loop over all nodes */
 
-	/* If order is PRE_ORDER, the list of nodes is an inverted copy, so we
-	 * need to free it. */
-	if (PRE_ORDER == params.order)
-		destroy_llist(nodes);
+	lua_pop(L, 1);
+	state->current = NULL;
 }
 
 
 /* Checks that 1st arg passed to a Lua function is an lnode. */
 
-static struct lua_rnode *check_lnode(lua_State *L)
+static struct rnode *check_lnode(lua_State *L)
 {
-	void *ud = luaL_checkudata(L, 1, "LRnode");
-	luaL_argcheck(L, NULL != ud, 1, "expected node");
-	return (struct lua_rnode *) ud;
+	luaL_argcheck(L, lua_islightuserdata(L, 1), 1, "expected node");
+	return (struct rnode *) lua_touserdata(L, 1);
 }
 
 /* Returns the node on which to work. This is for functions that use the
  * current node (N) as an implicit argument IFF no argument is passed. */
 
-static struct lua_rnode *get_lua_rnode_arg(lua_State *L)
+static struct rnode *get_lua_rnode_arg(lua_State *L)
 {
-	struct lua_rnode *lnode = NULL;
+	struct rnode *lnode = NULL;
 	int num_args = lua_gettop(L);
 	switch (num_args) {
 	case 0:
 		lua_getglobal(L, "N");
-		lnode = lua_touserdata(L, -1);
-		if (NULL == lnode)
+		if (! lua_islightuserdata(L, -1))
 			luaL_error(L, "N is not a node");
+		lnode = lua_touserdata(L, -1);
 		break;
 	case 1:
 		lnode = check_lnode(L);
@@ -720,17 +773,57 @@ static struct lua_rnode *get_lua_rnode_arg(lua_State *L)
 	return lnode;
 }
 
+/* Prints the subtree rooted at 'node' on 'out'. */
+
+static void print_newick(FILE *out, struct rnode *node)
+{
+	char *newick = to_newick(node);
+	if (NULL == newick) { perror(NULL); exit(EXIT_FAILURE); }
+	fprintf(out, "%s\n", newick);
+	free(newick);
+}
+
 static int lua_print_subclade(lua_State * L)
 {
-	struct lua_rnode *lnode = get_lua_rnode_arg(L);
-	dump_newick(lnode->orig);
+	struct editor_state *state = lua_touserdata(L, lua_upvalueindex(1));
+	struct rnode *lnode = get_lua_rnode_arg(L);
+	print_newick(state->out, lnode);
+	return 0;
+}
+
+/* Replaces Lua's print(), so that the output goes to the state's output
+ * (see option -t). Otherwise works like the original. */
+
+static int lua_print(lua_State *L)
+{
+	struct editor_state *state = lua_touserdata(L, lua_upvalueindex(1));
+	int num_args = lua_gettop(L);
+	int i;
+
+	lua_getglobal(L, "tostring");
+	for (i = 1; i <= num_args; i++) {
+		size_t length;
+		const char *string;
+		lua_pushvalue(L, -1);
+		lua_pushvalue(L, i);
+		lua_call(L, 1, 1);
+		string = lua_tolstring(L, -1, &length);
+		if (NULL == string)
+			return luaL_error(L, "'tostring' must return a string "
+					"to 'print'");
+		if (i > 1)
+			fputc('\t', state->out);
+		fwrite(string, sizeof(char), length, state->out);
+		lua_pop(L, 1);
+	}
+	fputc('\n', state->out);
+
 	return 0;
 }
 
 static int lua_open_node(lua_State *L)
 {
-	struct lua_rnode *lnode = get_lua_rnode_arg(L);
-	struct rnode *node = lnode->orig;
+	struct rnode *node = get_lua_rnode_arg(L);
 	// TODO: unify error handling (see below)
 	if (is_inner_node(node)) {
 		if (! splice_out_rnode(node)) {
@@ -746,8 +839,7 @@ static int lua_open_node(lua_State *L)
 static int lua_unlink_node (lua_State * L)
 {
 	// int num_args = lua_gettop(L);
-	struct lua_rnode *lnode = get_lua_rnode_arg(L);
-	struct rnode *node = lnode->orig;
+	struct rnode *node = get_lua_rnode_arg(L);
 
 	if (is_root(node)) {
 		// TODO: unify error handling (Lua? C?)
@@ -769,9 +861,12 @@ static int lua_unlink_node (lua_State * L)
 	return 0;
 }
 
+/* The condition and action are compiled once, into chunks that receive the
+ * current node as argument (N). Each function pushes its chunk. */
+
 static void load_lua_condition(lua_State * L, char *lua_condition)
 {
-	char *lua_condition_chunk = masprintf("return (%s)",
+	char *lua_condition_chunk = masprintf("local N = ...; return (%s)",
 					      lua_condition);
 	int error = luaL_loadbuffer(L, lua_condition_chunk,
 				    strlen(lua_condition_chunk),
@@ -783,19 +878,20 @@ static void load_lua_condition(lua_State * L, char *lua_condition)
 		printf("%s\n", msg);
 		exit(EXIT_FAILURE);
 	}
-	lua_setglobal(L, CONDITION);
 }
 
 static void load_lua_action(lua_State *L, char *lua_action)
 {
-	int error = luaL_loadbuffer(L, lua_action, strlen(lua_action), ACTION);
+	char *lua_action_chunk = masprintf("local N = ...; %s", lua_action);
+	int error = luaL_loadbuffer(L, lua_action_chunk,
+				    strlen(lua_action_chunk), ACTION);
+	free(lua_action_chunk);
 	if (error) {
 		const char *msg = lua_tostring(L, -1);
 		lua_pop(L, 1);
 		printf("%s\n", msg);
 		exit(EXIT_FAILURE);
 	}
-	lua_setglobal(L, ACTION);
 }
 
 static void run_user_hooks_file(lua_State * L, char *user_hooks_filename)
@@ -829,7 +925,7 @@ static enum node_field field_string2code (const char *fld_str)
 
 static int lua_node_set(lua_State *L)
 {
-	struct lua_rnode *lnode = check_lnode(L);
+	struct rnode *lnode = check_lnode(L);
 	const char *field = luaL_checkstring(L, 2);
 	luaL_argcheck(L, NULL != field, 2, "expected string");
 	enum node_field field_code = field_string2code(field);
@@ -838,14 +934,14 @@ static int lua_node_set(lua_State *L)
 	case NODE_LABEL:
 		luaL_argcheck(L, lua_isstring(L, 3), 3, "expected a string");
 		const char *label = lua_tostring(L, 3);
-		free(lnode->orig->label);
-		lnode->orig->label = strdup(label);
+		free(lnode->label);
+		lnode->label = strdup(label);
 		return 0;
 	case NODE_LENGTH:
 		if (lua_isnumber(L, 3)) {
 			const char *len_s = lua_tostring(L, 3);
-			free(lnode->orig->edge_length_as_string);
-			lnode->orig->edge_length_as_string = strdup(len_s);
+			if (! set_edge_length_as_string(lnode, len_s))
+				luaL_error(L, "memory problem");
 			return 0;
 		} else if (lua_isstring(L, 3)) {
 			/* already checked for numbers, so this is a
@@ -854,8 +950,7 @@ static int lua_node_set(lua_State *L)
 			luaL_argcheck(L, '\0' == *len_s, 3,
 				"expected a number, a number-convertible "
 				"string, or the empty string.");
-			free(lnode->orig->edge_length_as_string);
-			lnode->orig->edge_length_as_string = strdup("");
+			unset_edge_length(lnode);
 			return 0;
 		} else {
 			luaL_error(L, false, 3,
@@ -872,16 +967,6 @@ static int lua_node_set(lua_State *L)
 	return 0;
 }
 
-static void push_new_lnode(lua_State *L, struct rnode *orig)
-{
-	struct lua_rnode *lua_result = lua_newuserdata(
-			L, sizeof (struct lua_rnode));
-	luaL_getmetatable(L, "LRnode");
-	lua_setmetatable(L, -2);
-	// TODO: shouldn't we check for NULL?
-	lua_result->orig = orig;
-}
-
 static void push_kids(lua_State *L, struct rnode *orig)
 {
 	struct rnode *current_kid = orig->first_child;
@@ -889,22 +974,18 @@ static void push_kids(lua_State *L, struct rnode *orig)
 	int index = 0;
 	for(; NULL != current_kid; current_kid = current_kid->next_sibling) {
 		index++;
-		lua_pushinteger(L, index);
-		push_new_lnode(L, current_kid); 
-		/* now we have the table at -3, the key (index) at -2  and the
-		 * value on top (-1) */
-		lua_settable(L, -3);
+		lua_pushlightuserdata(L, current_kid); 
+		/* now we have the table at -2, and the value on top (-1) */
+		lua_rawseti(L, -2, index);
 	}
 }
 
 static int lua_node_get(lua_State *L)
 {
-	struct lua_rnode *lnode = check_lnode(L);
+	struct rnode *orig = check_lnode(L);
 	const char *field = luaL_checkstring(L, 2);
 	luaL_argcheck(L, NULL != field, 2, "expected string");
 	enum node_field field_code = field_string2code(field);
-	//struct lua_rnode *lua_result = NULL;
-	struct rnode *orig = lnode->orig;
 
 	switch (field_code) {
 	case NODE_ADDRESS:
@@ -914,16 +995,16 @@ static int lua_node_get(lua_State *L)
 		lua_pushstring(L, orig->label);
 		return 1;
 	case NODE_LENGTH:
-		lua_pushnumber(L, atof(orig->edge_length_as_string));
+		lua_pushnumber(L, orig->edge_length);
 		return 1;
 	case NODE_PARENT:
-		push_new_lnode(L, orig->parent);
+		push_lnode(L, orig->parent);
 		return 1;
 	case NODE_FIRST_CHILD:
-		push_new_lnode(L, orig->first_child);
+		push_lnode(L, orig->first_child);
 		return 1;
 	case NODE_LAST_CHILD:
-		push_new_lnode(L, orig->last_child);
+		push_lnode(L, orig->last_child);
 		return 1;
 	case NODE_CHILD_COUNT:
 		lua_pushinteger(L, orig->child_count);
@@ -944,18 +1025,18 @@ static int lua_node_get(lua_State *L)
 
 static int lua_no_op(lua_State *L) { return 0; }
 
-/* Processes the current node according to the condtion and action given on the
- * command line. */
+/* Processes the current node (passed as argument) according to the condtion
+ * and action given on the command line. These are passed as upvalues, along
+ * with the editor state. */
 
 static int lua_cli_process_node(lua_State *L)
 {
-	lua_getglobal(L, "N");
-	struct lua_rnode *lnode = lua_touserdata(L, -1);
-	if (NULL == lnode)
-		luaL_error(L, "N is not a node");
+	struct editor_state *state = lua_touserdata(L, lua_upvalueindex(1));
+	struct rnode *lnode = check_lnode(L);
 
-	lua_getglobal(L, CONDITION);
-	lua_call(L, 0, 1);
+	lua_pushvalue(L, lua_upvalueindex(2));	/* condition */
+	lua_pushvalue(L, 1);
+	lua_call(L, 1, 1);
 	if (lua_isboolean(L, -1) != 1) {
 		fprintf(stderr, "WARNING: condition does not evaluate "
 				"to a boolean.\n");
@@ -965,14 +1046,15 @@ static int lua_cli_process_node(lua_State *L)
 	int match = lua_toboolean(L, -1);
 	lua_pop(L, 1);
 	if (match) {
-		lua_getglobal(L, ACTION);
-		lua_call(L, 0, 0);
+		lua_pushvalue(L, lua_upvalueindex(3));	/* action */
+		lua_pushvalue(L, 1);
+		lua_call(L, 1, 0);
 		/* see -o switch */
 		lua_getglobal(L, STOP_AT_1ST_MATCH);
 		int stop_clade_at_first_match = lua_toboolean(L, -1);
 		lua_pop(L, 1);
 		if (stop_clade_at_first_match)
-			((struct rnode_data *) lnode->orig->data)->stop_mark = true;
+			state->stop_mark[lnode->rank] = true;
 	}
 	return 0;
 }
@@ -1003,9 +1085,37 @@ static int luaopen_lnode (lua_State *L)
 	lua_gettable(L, 2);	/* get lnode.set */
 	lua_settable(L, 1);	/* mt.__index = lnode.set */
 
+	/* All light userdata share a metatable: make it LRnode's (we use no
+	 * other light userdata). */
+	lua_pushlightuserdata(L, NULL);
+	lua_pushvalue(L, 1);
+	lua_setmetatable(L, -2);
+	lua_pop(L, 1);
+
 	return 0;
 }
 
+/* Makes the predefined variables visible as globals (see
+ * lua_predefined_variable()). */
+
+static void open_predefined_variables(lua_State *L, struct editor_state *state)
+{
+	lua_newtable(L);
+	state->overrides = luaL_ref(L, LUA_REGISTRYINDEX);
+	state->has_overrides = false;
+
+	lua_rawgeti(L, LUA_REGISTRYINDEX, LUA_RIDX_GLOBALS);
+	lua_createtable(L, 0, 2);
+	lua_pushlightuserdata(L, state);
+	lua_pushcclosure(L, lua_predefined_variable, 1);
+	lua_setfield(L, -2, "__index");
+	lua_pushlightuserdata(L, state);
+	lua_pushcclosure(L, lua_set_predefined_variable, 1);
+	lua_setfield(L, -2, "__newindex");
+	lua_setmetatable(L, -2);
+	lua_pop(L, 1);
+}
+
 
 static void run_user_hook(lua_State *L, const char *phase)
 {
@@ -1019,26 +1129,45 @@ static void run_user_hook(lua_State *L, const char *phase)
 		lua_pop(L, 1);
 }
 
-int main(int argc, char* argv[])
+/* Creates a Lua interpreter for the editor state 'state' (which is
+ * initialized here): defines the functions and variables that work on nodes,
+ * runs the -L code, and loads the user's hooks file or the condition and
+ * action. */
+
+static lua_State *create_lua_state(struct parameters params,
+		struct editor_state *state)
 {
-	struct parameters params = get_params(argc, argv);
-	struct rooted_tree *tree;
+	state->out = stdout;
+	state->current = NULL;
+	state->capacity = 0;
+	state->nodes = NULL;
+	state->depth = NULL;
+	state->is_depth_defined = NULL;
+	state->nb_ancestors = NULL;
+	state->nb_descendants = NULL;
+	state->stop_mark = NULL;
 
 	/* Initializes Lua */
 	lua_State *L = luaL_newstate();   
+	if (NULL == L) { perror(NULL); exit(EXIT_FAILURE); }
 	luaL_openlibs(L);
 
-	lua_pushcfunction(L, lua_print_subclade);
+	lua_pushlightuserdata(L, state);
+	lua_pushcclosure(L, lua_print_subclade, 1);
 	lua_setglobal(L, "s");
 	lua_pushcfunction(L, lua_unlink_node);
 	lua_setglobal(L, "u");
 	lua_pushcfunction(L, lua_open_node);
 	lua_setglobal(L, "o");
+	lua_pushlightuserdata(L, state);
+	lua_pushcclosure(L, lua_print, 1);
+	lua_setglobal(L, "print");
 	lua_pushboolean(L, params.stop_clade_at_first_match);
 	lua_setglobal(L, STOP_AT_1ST_MATCH);
 
 
 	luaopen_lnode(L);
+	open_predefined_variables(L, state);
 
 	if (NULL != params.lua_options) {
 		luaL_dostring(L, params.lua_options);
@@ -1064,25 +1193,235 @@ int main(int argc, char* argv[])
 			lua_setglobal(L, NODE);
 		}
 	} else {
-		lua_pushcfunction(L, lua_cli_process_node);
-		lua_setglobal(L, NODE);
+		lua_pushlightuserdata(L, state);
 		load_lua_condition(L, params.lua_condition);
 		load_lua_action(L, params.lua_action);
+		lua_pushcclosure(L, lua_cli_process_node, 3);
+		lua_setglobal(L, NODE);
+	}
+
+	return L;
+}
+
+/* True IFF the user defined start_run() or stop_run(). */
+
+static bool has_run_hooks(lua_State *L)
+{
+	bool result;
+
+	lua_getglobal(L, START);
+	lua_getglobal(L, STOP);
+	result = lua_isfunction(L, -1) || lua_isfunction(L, -2);
+	lua_pop(L, 2);
+
+	return result;
+}
+
+/* Runs the per-tree hooks, and processes the tree. */
+
+static void edit_tree(struct rooted_tree *tree, lua_State *L,
+		struct editor_state *state, struct parameters params)
+{
+	run_user_hook(L, START_TREE);
+	process_tree(tree, L, state, params);
+	if (params.show_tree) {
+		print_newick(state->out, tree->root);
 	}
+	run_user_hook(L, STOP_TREE);
+}
 
+static void edit_trees(lua_State *L, struct editor_state *state,
+		struct parameters params)
+{
+	struct rooted_tree *tree;
 
 	run_user_hook(L, START);
 	while (NULL != (tree = parse_tree())) {
-		run_user_hook(L, START_TREE);
-		process_tree(tree, L, params);
-		if (params.show_tree) {
-			dump_newick(tree->root);
-		}
-		run_user_hook(L, STOP_TREE);
+		edit_tree(tree, L, state, params);
 		destroy_all_rnodes(NULL);
 		destroy_tree(tree);
 	}
 	run_user_hook(L, STOP);
+}
+
+/* Parallel processing (option -t). The main thread parses the trees and puts
+ * them into a ring of slots, from which the workers take them in turn. Each
+ * worker has its own Lua interpreter, and writes a tree's output to the
+ * tree's slot; the main thread prints the slots' output in input order. Since
+ * several trees are alive at the same time, the main thread disowns their
+ * nodes (see disown_all_rnodes()), and frees each tree after printing it. */
+
+struct slot {
+	struct rooted_tree *tree;
+	char *output;
+	size_t output_size;
+	bool done;
+};
+
+struct run {
+	pthread_mutex_t lock;
+	pthread_cond_t changed;	/* a tree was parsed, or processed */
+	struct parameters params;
+	struct slot *slots;
+	int slot_count;
+	long nb_parsed;		/* number of trees parsed so far */
+	long nb_taken;		/* ... taken by the workers */
+	long nb_written;	/* ... whose output was printed */
+	bool end_of_input;
+};
+
+struct worker {
+	pthread_t thread;
+	lua_State *L;
+	struct editor_state state;
+	struct run *run;
+};
+
+static void destroy_tree_and_rnodes(struct rooted_tree *tree)
+{
+	struct list_elem *el;
+
+	for (el = tree->nodes_in_order->head; NULL != el; el = el->next)
+		destroy_rnode(el->data, NULL);
+	destroy_tree(tree);
+}
+
+static void *work(void *arg)
+{
+	struct worker *worker = arg;
+	struct run *run = worker->run;
+
+	pthread_mutex_lock(&run->lock);
+	for (;;) {
+		while (run->nb_taken == run->nb_parsed && ! run->end_of_input)
+			pthread_cond_wait(&run->changed, &run->lock);
+		if (run->nb_taken == run->nb_parsed)
+			break;	/* no more trees */
+		struct slot *slot =
+			&run->slots[run->nb_taken++ % run->slot_count];
+		pthread_mutex_unlock(&run->lock);
+
+		worker->state.out = open_memstream(&slot->output,
+				&slot->output_size);
+		if (NULL == worker->state.out) {
+			perror(NULL);
+			exit(EXIT_FAILURE);
+		}
+		edit_tree(slot->tree, worker->L, &worker->state, run->params);
+		fclose(worker->state.out);
+
+		pthread_mutex_lock(&run->lock);
+		slot->done = true;
+		pthread_cond_broadcast(&run->changed);
+	}
+	pthread_mutex_unlock(&run->lock);
+
+	return NULL;
+}
+
+/* Prints the output of the next tree in input order, if it has been
+ * processed, and frees the tree and its slot. Returns false if there is no
+ * such tree. Must be called with the lock held, but does not hold it while
+ * printing. The tree is freed by the thread that parsed it, as malloc() is
+ * typically slower to free memory allocated by another thread. */
+
+static bool write_next_tree(struct run *run)
+{
+	struct slot *slot = &run->slots[run->nb_written % run->slot_count];
+
+	if (run->nb_written == run->nb_parsed || ! slot->done)
+		return false;
+
+	pthread_mutex_unlock(&run->lock);
+	fwrite(slot->output, sizeof(char), slot->output_size, stdout);
+	free(slot->output);
+	destroy_tree_and_rnodes(slot->tree);
+	pthread_mutex_lock(&run->lock);
+
+	slot->done = false;
+	run->nb_written++;
+	return true;
+}
+
+static void edit_trees_in_parallel(struct worker *workers, int nb_workers,
+		struct parameters params)
+{
+	struct run run;
+	struct rooted_tree *tree;
+	int i;
+
+	pthread_mutex_init(&run.lock, NULL);
+	pthread_cond_init(&run.changed, NULL);
+	run.params = params;
+	run.slot_count = 2 * nb_workers;
+	run.slots = calloc(run.slot_count, sizeof(struct slot));
+	if (NULL == run.slots) { perror(NULL); exit(EXIT_FAILURE); }
+	run.nb_parsed = run.nb_taken = run.nb_written = 0;
+	run.end_of_input = false;
+
+	for (i = 0; i < nb_workers; i++) {
+		workers[i].run = &run;
+		if (0 != pthread_create(&workers[i].thread, NULL, work,
+					&workers[i])) {
+			perror(NULL);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	while (NULL != (tree = parse_tree())) {
+		disown_all_rnodes();
+		pthread_mutex_lock(&run.lock);
+		/* Wait for a free slot, printing processed trees meanwhile. */
+		while (run.nb_parsed - run.nb_written == run.slot_count)
+			if (! write_next_tree(&run))
+				pthread_cond_wait(&run.changed, &run.lock);
+		run.slots[run.nb_parsed++ % run.slot_count].tree = tree;
+		pthread_cond_broadcast(&run.changed);
+		while (write_next_tree(&run))
+			;
+		pthread_mutex_unlock(&run.lock);
+	}
+
+	pthread_mutex_lock(&run.lock);
+	run.end_of_input = true;
+	pthread_cond_broadcast(&run.changed);
+	while (run.nb_written < run.nb_parsed)
+		if (! write_next_tree(&run))
+			pthread_cond_wait(&run.changed, &run.lock);
+	pthread_mutex_unlock(&run.lock);
+
+	for (i = 0; i < nb_workers; i++)
+		pthread_join(workers[i].thread, NULL);
+
+	free(run.slots);
+	pthread_cond_destroy(&run.changed);
+	pthread_mutex_destroy(&run.lock);
+}
+
+int main(int argc, char* argv[])
+{
+	struct parameters params = get_params(argc, argv);
+	struct worker *workers;
+	int i;
+
+	workers = malloc(params.nb_threads * sizeof(struct worker));
+	if (NULL == workers) { perror(NULL); exit(EXIT_FAILURE); }
+
+	workers[0].L = create_lua_state(params, &workers[0].state);
+	if (params.nb_threads > 1 && has_run_hooks(workers[0].L)) {
+		fprintf(stderr, "WARNING: start_run or stop_run is defined "
+				"- ignoring -t.\n");
+		params.nb_threads = 1;
+	}
+
+	if (1 == params.nb_threads) {
+		edit_trees(workers[0].L, &workers[0].state, params);
+	} else {
+		for (i = 1; i < params.nb_threads; i++)
+			workers[i].L = create_lua_state(params,
+					&workers[i].state);
+		edit_trees_in_parallel(workers, params.nb_threads, params);
+	}
 
 	exit(EXIT_SUCCESS);
 }
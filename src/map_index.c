@@ -0,0 +1,489 @@
+/* 
+
+Copyright (c) 2009 Thomas Junier and Evgeny Zdobnov, University of Geneva
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+* Neither the name of the University of Geneva nor the names of its
+    contributors may be used to endorse or promote products derived from this
+    software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "readline.h"
+#include "map_index.h"
+
+const char *INDEX_SUFFIX = ".idx";
+
+/* Changing the layout requires a new version, so that old indexes are
+ * rebuilt rather than misread. */
+
+static const char MAGIC[8] = "NWMAPIX";
+static const uint32_t VERSION = 1;
+
+struct index_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t slot_size;	/* sizeof(struct slot), as a sanity check */
+	uint64_t map_size;	/* of the map file */
+	int64_t map_mtime;
+	uint64_t slot_count;	/* a power of 2 */
+	uint64_t key_count;
+	uint64_t blob_size;
+};
+
+/* The blob holds the keys and values, as consecutive '\0'-terminated
+ * strings. Empty slots have an offset of EMPTY. */
+
+struct slot {
+	uint32_t hash;
+	uint32_t unused;
+	uint64_t key_offset;
+	uint64_t value_offset;
+};
+
+static const uint64_t EMPTY = UINT64_MAX;
+
+struct map_index {
+	char *image;		/* header, then slots, then blob */
+	size_t image_size;
+	bool mapped;		/* mmap()ed, as opposed to malloc()ed */
+	struct index_header *header;
+	struct slot *slots;
+	char *blob;
+	char *map_filename;
+	/* A mapped image that turned out to be corrupt: it is kept until the
+	 * index is closed, since values returned so far point into it. */
+	char *corrupt_image;
+	size_t corrupt_image_size;
+	bool failed;		/* see map_index_failed() */
+};
+
+static uint32_t key_hash(const char *key)
+{
+	uint32_t h = 2166136261u;
+	while (*key) {
+		h ^= (unsigned char) *key++;
+		h *= 16777619u;
+	}
+	return h;
+}
+
+static void set_pointers(struct map_index *index)
+{
+	index->header = (struct index_header *) index->image;
+	index->slots = (struct slot *) (index->image +
+			sizeof(struct index_header));
+	index->blob = (char *) (index->slots + index->header->slot_count);
+}
+
+/* Returns the slot where 'key' is, or the empty slot where it would go. A
+ * mapped index was only checked as a whole when it was opened (see
+ * map_existing_index()), so the slots are checked as they are probed: if one
+ * has an offset outside the blob, or if there is no empty slot, the index is
+ * corrupt and this returns NULL. The blob ends with a '\0', so a string that
+ * starts within it also ends within it. */
+
+static struct slot *find_slot(struct map_index *index, const char *key,
+		uint32_t hash)
+{
+	uint64_t slot_count = index->header->slot_count;
+	uint64_t blob_size = index->header->blob_size;
+	uint64_t mask = slot_count - 1;
+	uint64_t i = hash & mask;
+	uint64_t probes;
+	for (probes = 0; probes < slot_count; probes++) {
+		struct slot *slot = index->slots + i;
+		if (EMPTY == slot->key_offset) return slot;
+		if (slot->key_offset >= blob_size ||
+		    slot->value_offset >= blob_size)
+			return NULL;
+		if (hash == slot->hash &&
+		    0 == strcmp(key, index->blob + slot->key_offset))
+			return slot;
+		i = (i + 1) & mask;
+	}
+	return NULL;
+}
+
+long map_index_count(struct map_index *index)
+{
+	return (long) index->header->key_count;
+}
+
+/* A growable buffer for the blob */
+
+struct blob {
+	char *data;
+	uint64_t size;
+	uint64_t capacity;
+};
+
+static bool blob_append(struct blob *blob, const char *string,
+		uint64_t *offset)
+{
+	size_t length = strlen(string) + 1;
+	if (blob->size + length > blob->capacity) {
+		uint64_t capacity = 2 * blob->capacity + length;
+		char *data = realloc(blob->data, capacity);
+		if (NULL == data) return false;
+		blob->data = data;
+		blob->capacity = capacity;
+	}
+	memcpy(blob->data + blob->size, string, length);
+	*offset = blob->size;
+	blob->size += length;
+	return true;
+}
+
+/* Reads the map's (key, value) pairs into 'blob', in file order. Returns the
+ * number of pairs, or -1 in case of error. */
+
+static long read_pairs(FILE *map_file, struct blob *blob)
+{
+	long count = 0;
+	char *line;
+	uint64_t offset;
+
+	while (NULL != (line = read_line(map_file))) {
+		/* Skip comments and lines that are empty or all whitespace */
+		if ('#' == line[0] || is_all_whitespace(line)) {
+			free(line);
+			continue;
+		}
+		struct word_tokenizer *wtok = create_word_tokenizer(line);
+		if (NULL == wtok) return -1;
+		char *key = wt_next(wtok);
+		if (NULL == key) return -1;
+		char *value = wt_next(wtok);
+		if (! blob_append(blob, key, &offset) ||
+		    ! blob_append(blob, NULL == value ? "" : value, &offset))
+			return -1;
+		count++;
+		free(key);
+		free(value);
+		destroy_word_tokenizer(wtok);
+		free(line);
+	}
+	if (READLINE_ERROR == read_line_status) return -1;
+
+	return count;
+}
+
+/* Builds the index image in memory, from the map file. */
+
+static struct map_index *build_index(const char *map_filename,
+		struct stat *map_stat)
+{
+	FILE *map_file = fopen(map_filename, "r");
+	if (NULL == map_file) return NULL;
+	struct blob pairs = { NULL, 0, 0 };
+	long pair_count = read_pairs(map_file, &pairs);
+	fclose(map_file);
+	if (pair_count < 0) return NULL;
+
+	/* Load factor at most 1/2, so that probe sequences stay short */
+	uint64_t slot_count = 2;
+	while (slot_count < 2 * (uint64_t) pair_count)
+		slot_count *= 2;
+
+	struct map_index *index = calloc(1, sizeof(struct map_index));
+	if (NULL == index) return NULL;
+	index->image_size = sizeof(struct index_header) +
+		slot_count * sizeof(struct slot) + pairs.size;
+	index->image = malloc(index->image_size);
+	if (NULL == index->image) return NULL;
+	index->mapped = false;
+
+	struct index_header *header = (struct index_header *) index->image;
+	memcpy(header->magic, MAGIC, sizeof(MAGIC));
+	header->version = VERSION;
+	header->slot_size = sizeof(struct slot);
+	header->map_size = map_stat->st_size;
+	header->map_mtime = map_stat->st_mtime;
+	header->slot_count = slot_count;
+	header->key_count = 0;
+	header->blob_size = pairs.size;
+	set_pointers(index);
+	uint64_t i;
+	for (i = 0; i < slot_count; i++)
+		index->slots[i].key_offset = EMPTY;
+	if (pairs.size > 0)
+		memcpy(index->blob, pairs.data, pairs.size);
+	free(pairs.data);
+
+	/* Keys and values alternate in the blob. A later key replaces an
+	 * earlier one, like in a struct hash. */
+	uint64_t offset = 0;
+	while (offset < header->blob_size) {
+		char *key = index->blob + offset;
+		uint64_t value_offset = offset + strlen(key) + 1;
+		uint32_t hash = key_hash(key);
+		struct slot *slot = find_slot(index, key, hash);
+		if (EMPTY == slot->key_offset) {
+			slot->hash = hash;
+			slot->unused = 0;
+			slot->key_offset = offset;
+			header->key_count++;
+		}
+		slot->value_offset = value_offset;
+		offset = value_offset + strlen(index->blob + value_offset) + 1;
+	}
+
+	return index;
+}
+
+/* Checks, in constant time, that the mapped image's layout is consistent: the
+ * file size must match the header, and the blob must end with a '\0'. The
+ * slots themselves are only checked when find_slot() probes them, since
+ * reading them all would make opening the index take time proportional to its
+ * size. */
+
+static bool image_is_consistent(struct index_header *header, size_t size)
+{
+	size_t slots_size = size - sizeof(struct index_header);
+	uint64_t slot_count = header->slot_count;
+	/* checked before multiplying, which could overflow */
+	if (0 == slot_count || 0 != (slot_count & (slot_count - 1)) ||
+	    slot_count > slots_size / sizeof(struct slot) ||
+	    header->blob_size != slots_size - slot_count * sizeof(struct slot))
+		return false;
+	if (header->key_count >= slot_count)
+		return false;
+
+	char *blob = (char *) header + (size - header->blob_size);
+	uint64_t blob_size = header->blob_size;
+	return 0 == blob_size || '\0' == blob[blob_size - 1];
+}
+
+/* Maps an existing index file, if it is valid for the map. Returns NULL
+ * otherwise (the index should then be rebuilt). */
+
+static struct map_index *map_existing_index(const char *index_filename,
+		struct stat *map_stat)
+{
+	int fd = open(index_filename, O_RDONLY);
+	if (fd < 0) return NULL;
+	struct stat index_stat;
+	if (0 != fstat(fd, &index_stat) ||
+	    (size_t) index_stat.st_size < sizeof(struct index_header)) {
+		close(fd);
+		return NULL;
+	}
+	void *image = mmap(NULL, index_stat.st_size, PROT_READ, MAP_SHARED,
+			fd, 0);
+	close(fd);	/* the mapping stays valid */
+	if (MAP_FAILED == image) return NULL;
+
+	struct index_header *header = image;
+	if (0 != memcmp(header->magic, MAGIC, sizeof(MAGIC)) ||
+	    VERSION != header->version ||
+	    sizeof(struct slot) != header->slot_size ||
+	    (uint64_t) map_stat->st_size != header->map_size ||
+	    (int64_t) map_stat->st_mtime != header->map_mtime ||
+	    ! image_is_consistent(header, index_stat.st_size)) {
+		munmap(image, index_stat.st_size);
+		return NULL;
+	}
+
+	struct map_index *index = calloc(1, sizeof(struct map_index));
+	if (NULL == index) {
+		munmap(image, index_stat.st_size);
+		return NULL;
+	}
+	index->image = image;
+	index->image_size = index_stat.st_size;
+	index->mapped = true;
+	set_pointers(index);
+
+	return index;
+}
+
+/* Writes the image to a temporary file, then renames it, so that a
+ * concurrent run never sees a partial index. Failure is not an error: the
+ * index just won't be reused. */
+
+static void save_index(struct map_index *index, const char *index_filename)
+{
+	/* The PID makes the name unique among concurrent runs */
+	char *tmp_filename = malloc(strlen(index_filename) + 32);
+	if (NULL == tmp_filename) return;
+	sprintf(tmp_filename, "%s.%ld.tmp", index_filename, (long) getpid());
+
+	FILE *out = fopen(tmp_filename, "w");
+	if (NULL != out) {
+		bool ok = (1 == fwrite(index->image, index->image_size, 1,
+					out));
+		if (0 != fclose(out)) ok = false;
+		if (! ok || 0 != rename(tmp_filename, index_filename))
+			remove(tmp_filename);
+	}
+	free(tmp_filename);
+}
+
+static char *index_filename_for(const char *map_filename)
+{
+	char *index_filename = malloc(strlen(map_filename) +
+			strlen(INDEX_SUFFIX) + 1);
+	if (NULL == index_filename) return NULL;
+	sprintf(index_filename, "%s%s", map_filename, INDEX_SUFFIX);
+	return index_filename;
+}
+
+struct map_index *open_map_index(const char *map_filename)
+{
+	struct stat map_stat;
+	if (0 != stat(map_filename, &map_stat)) return NULL;
+
+	char *index_filename = index_filename_for(map_filename);
+	if (NULL == index_filename) return NULL;
+
+	struct map_index *index = map_existing_index(index_filename,
+			&map_stat);
+	if (NULL == index) {
+		index = build_index(map_filename, &map_stat);
+		if (NULL != index)
+			save_index(index, index_filename);
+	}
+	free(index_filename);
+	if (NULL == index) return NULL;
+
+	/* needed to rebuild the index, should it turn out to be corrupt */
+	index->map_filename = strdup(map_filename);
+	if (NULL == index->map_filename) {
+		close_map_index(index);
+		return NULL;
+	}
+
+	return index;
+}
+
+/* Replaces a corrupt (mapped) image by one built from the map, which is also
+ * saved for later runs. Returns false in case of error. */
+
+static bool rebuild_index(struct map_index *index)
+{
+	struct stat map_stat;
+	if (0 != stat(index->map_filename, &map_stat)) return false;
+	struct map_index *rebuilt = build_index(index->map_filename,
+			&map_stat);
+	if (NULL == rebuilt) return false;
+	char *index_filename = index_filename_for(index->map_filename);
+	if (NULL != index_filename) {
+		save_index(rebuilt, index_filename);
+		free(index_filename);
+	}
+
+	index->corrupt_image = index->image;
+	index->corrupt_image_size = index->image_size;
+	index->image = rebuilt->image;
+	index->image_size = rebuilt->image_size;
+	index->mapped = false;
+	set_pointers(index);
+	free(rebuilt);
+
+	return true;
+}
+
+const char *map_index_get(struct map_index *index, const char *key)
+{
+	uint32_t hash = key_hash(key);
+	struct slot *slot = find_slot(index, key, hash);
+	if (NULL == slot) {
+		/* Only a mapped index can be corrupt, and a rebuilt one is
+		 * not mapped: this happens at most once per index. */
+		if (! index->mapped || ! rebuild_index(index)) {
+			index->failed = true;
+			return NULL;
+		}
+		slot = find_slot(index, key, hash);
+	}
+	if (EMPTY == slot->key_offset) return NULL;
+	return index->blob + slot->value_offset;
+}
+
+bool map_index_failed(struct map_index *index)
+{
+	return index->failed;
+}
+
+/* Returns true IFF all the slots' offsets fall in the blob (see
+ * find_slot()). */
+
+static bool slots_are_consistent(struct map_index *index)
+{
+	uint64_t blob_size = index->header->blob_size;
+	uint64_t i;
+	for (i = 0; i < index->header->slot_count; i++) {
+		struct slot *slot = index->slots + i;
+		if (EMPTY == slot->key_offset) continue;
+		if (slot->key_offset >= blob_size ||
+		    slot->value_offset >= blob_size)
+			return false;
+	}
+	return true;
+}
+
+bool map_index_foreach(struct map_index *index,
+		bool (*func)(const char *key, const char *value, void *param),
+		void *param)
+{
+	/* Checked first, so that func() sees each key once even if the index
+	 * has to be rebuilt. */
+	if (! slots_are_consistent(index) &&
+	    (! index->mapped || ! rebuild_index(index))) {
+		index->failed = true;
+		return false;
+	}
+
+	uint64_t i;
+	for (i = 0; i < index->header->slot_count; i++) {
+		struct slot *slot = index->slots + i;
+		if (EMPTY == slot->key_offset) continue;
+		if (! func(index->blob + slot->key_offset,
+				index->blob + slot->value_offset, param))
+			return false;
+	}
+	return true;
+}
+
+void close_map_index(struct map_index *index)
+{
+	if (index->mapped)
+		munmap(index->image, index->image_size);
+	else
+		free(index->image);
+	if (NULL != index->corrupt_image)
+		munmap(index->corrupt_image, index->corrupt_image_size);
+	free(index->map_filename);
+	free(index);
+}
@@ -0,0 +1,81 @@
+/* 
+
+Copyright (c) 2009 Thomas Junier and Evgeny Zdobnov, University of Geneva
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+* Neither the name of the University of Geneva nor the names of its
+    contributors may be used to endorse or promote products derived from this
+    software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+#include <stdbool.h>
+
+/* map_index.h: an on-disk index of a rename map (see nw_rename), so that large
+ * maps need not be read and hashed again on every run. */
+
+/* The index is stored next to the map, in a file whose name is the map's with
+ * INDEX_SUFFIX appended. It is an open-addressing hash table followed by the
+ * keys and values, and is mmap()ed rather than read: opening it takes constant
+ * time, and lookups only touch the pages they need (which is also when the
+ * slots they use are checked). The index records the map's size and
+ * modification time, and is rebuilt when they no longer match. The time only
+ * has a resolution of one second, so rewriting the map without changing its
+ * size within the second of its previous modification goes unnoticed. If the
+ * index can't be written (e.g. the directory is read-only), it is kept in
+ * memory for the current run. */
+
+extern const char *INDEX_SUFFIX;
+
+struct map_index;
+
+/* Opens the index of the map in 'map_filename', (re)building it if needed.
+ * Lines of the map are parsed like in read_map() (see rename.c): one key and
+ * an optional value per line, comment and blank lines being ignored; later
+ * keys override earlier ones. Returns NULL in case of error (errno is set). */
+
+struct map_index *open_map_index(const char *map_filename);
+
+/* Returns the value for 'key', or NULL if there is none. The value belongs to
+ * the index. If the index file turns out to be corrupt, the index is rebuilt
+ * from the map; if that fails, this returns NULL and map_index_failed() returns
+ * true. */
+
+const char *map_index_get(struct map_index *, const char *key);
+
+/* Returns true IFF a lookup failed (see map_index_get()). */
+
+bool map_index_failed(struct map_index *);
+
+/* Calls 'func(key, value, param)' on each key of the index, in no particular
+ * order, and stops if it returns false. This reads the whole index. Returns
+ * false if func() did, or in case of error (like map_index_get(), this sets
+ * map_index_failed()). */
+
+bool map_index_foreach(struct map_index *,
+		bool (*func)(const char *key, const char *value, void *param),
+		void *param);
+
+/* Returns the number of keys */
+
+long map_index_count(struct map_index *);
+
+void close_map_index(struct map_index *);
@@ -40,7 +40,6 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "parser.h"
 #include "to_newick.h"
 #include "tree.h"
-#include "order_tree.h"
 #include "hash.h"
 #include "list.h"
 #include "rnode.h"
@@ -49,6 +48,8 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "common.h"
 #include "rnode_iterator.h"
 #include "masprintf.h"
+#include "canonical_topology.h"
+#include "label_filter.h"
 
 #ifdef DEBUG_MATCH
 #define DEBUG 1
@@ -62,8 +63,34 @@ void newick_scanner_set_file_input(FILE *);
 
 struct parameters {
 	char *pattern;
+	FILE *pattern_file;
 	FILE *target_trees;
 	bool reverse;
+	bool counts;
+	bool statistics;
+};
+
+/* Patterns that have the same leaf labels are compiled together, so that
+ * each target tree is visited only once for all of them. */
+
+struct pattern_group {
+	struct label_filter *filter;	/* the group's leaf labels */
+	struct canonical_topology *topology;
+	int *numbers;	/* pattern numbers, in order of addition to 'topology' */
+	bool *matches;	/* work space for match_canonical_patterns() */
+};
+
+struct patterns {
+	int count;
+	char **newicks;		/* the patterns, for output */
+	struct llist *groups;	/* of struct pattern_group* */
+	bool *matched;		/* for each pattern, whether the current
+				   target tree matches it */
+	int *match_counts;	/* for each pattern, number of (non-)matching
+				   trees so far */
+	int tree_count;		/* target trees read so far */
+	int rejected_count;	/* target trees that lacked the leaves of every
+				   pattern (hence were not visited further) */
 };
 
 void help(char* argv[])
@@ -73,7 +100,8 @@ void help(char* argv[])
 "\n"
 "Synopsis\n"
 "--------\n"
-"%s [-v] <target tree filename|-> <pattern tree>\n"
+"%s [-cSv] <target tree filename|-> <pattern tree>\n"
+"%s [-cSv] -f <pattern trees filename> <target tree filename|->\n"
 "\n"
 "Input\n"
 "-----\n"
@@ -82,23 +110,35 @@ void help(char* argv[])
 "which support values are to be attributed), or '-' (in which case the tree\n"
 "is read on stdin).\n"
 "\n"
-"The second argument is a pattern tree\n"
+"The second argument is a pattern tree. Alternatively, any number of pattern\n"
+"trees can be read from a file (see option -f). All patterns are then\n"
+"tested in a single pass over the target trees.\n"
 "\n"
 "Output\n"
 "------\n"
 "\n"
-"Outputs the target tree if the pattern tree is a subgraph of it.\n"
+"Outputs the target tree if the pattern tree is a subgraph of it. With\n"
+"option -f, the target tree is output once for each pattern it matches,\n"
+"preceded by the pattern's number (starting at 1) and a TAB.\n"
 "\n"
 "Options\n"
 "-------\n"
 "\n"
-"    -v: prints tree which do NOT match the pattern.\n"
+"    -c: only print, for each pattern, the number of target trees that\n"
+"        match it, followed by a TAB and the pattern.\n"
+"    -f <filename>: read the pattern trees from this file.\n"
+"    -S: print, on stderr, how many target trees were rejected early because\n"
+"        they lack some of the leaves of every pattern.\n"
+"    -v: prints tree which do NOT match the pattern (with -f: which do not\n"
+"        match any pattern; with -c: count trees that do not match).\n"
 "\n"
 "Limits & Assumptions\n"
 "--------------------\n"
 "\n"
 "Assumes that the labels are leaf labels, and that they are unique in\n"
-"all trees (both target and pattern)\n"
+"all trees (both target and pattern). Inner node labels and branch\n"
+"lengths are ignored. A target tree that does not have all the leaf labels\n"
+"of a pattern cannot match it, and is not examined further.\n"
 "\n"
 "Example\n"
 "-------\n"
@@ -109,14 +149,30 @@ void help(char* argv[])
 "\n"
 "# Prints trees in data/vrt_gen.nw where Tamias is NOT closer to Homo than it is\n"
 "# to Vulpes:\n"
-"$ %s -v data/vrt_gen.nw '((Tamias,Homo),Vulpes);'\n",
+"$ %s -v data/vrt_gen.nw '((Tamias,Homo),Vulpes);'\n"
+"\n"
+"# Counts the trees in data/vrt_gen.nw that match each of the patterns in\n"
+"# file patterns.nw:\n"
+"$ %s -c -f patterns.nw data/vrt_gen.nw\n",
 
+	argv[0],
+	argv[0],
 	argv[0],
 	argv[0],
 	argv[0]
 	      );
 }
 
+static FILE *open_or_die(char *filename)
+{
+	FILE *fin = fopen(filename, "r");
+	if (NULL == fin) {
+		perror(NULL);
+		exit(EXIT_FAILURE);
+	}
+	return fin;
+}
+
 struct parameters get_params(int argc, char *argv[])
 {
 	struct parameters params;
@@ -124,276 +180,320 @@ struct parameters get_params(int argc, char *argv[])
 
 
 	params.reverse = false;
+	params.counts = false;
+	params.statistics = false;
+	params.pattern = NULL;
+	params.pattern_file = NULL;
 
 	/* parse options and switches */
-	while ((opt_char = getopt(argc, argv, "hv")) != -1) {
+	while ((opt_char = getopt(argc, argv, "cf:hSv")) != -1) {
 		switch (opt_char) {
+		case 'c':
+			params.counts = true;
+			break;
+		case 'f':
+			params.pattern_file = open_or_die(optarg);
+			break;
 		case 'h':
 			help(argv);
 			exit(EXIT_SUCCESS);
-		/* we keep this for debugging, but not documented */
+		case 'S':
+			params.statistics = true;
+			break;
+		/* reverse the match (see help) */
 		case 'v':
 			params.reverse = true;
 			break;
 		}
 	}
 	/* get arguments */
-	if (2 == (argc - optind))	{
+	int nargs = (NULL == params.pattern_file) ? 2 : 1;
+	if (nargs == (argc - optind))	{
 		if (0 != strcmp("-", argv[optind])) {
-			FILE *fin = fopen(argv[optind], "r");
-			if (NULL == fin) {
-				perror(NULL);
-				exit(EXIT_FAILURE);
-			}
-			params.target_trees = fin;
+			params.target_trees = open_or_die(argv[optind]);
 		} else {
 			params.target_trees = stdin;
 		}
-		params.pattern = argv[optind+1];
+		if (2 == nargs)
+			params.pattern = argv[optind+1];
 	} else {
-		fprintf(stderr, "Usage: %s [-hv] <target trees filename|-> <pattern>\n", argv[0]);
+		fprintf(stderr, "Usage: %s [-chSv] <target trees filename|-> <pattern>\n"
+				"       %s [-chSv] -f <patterns filename> "
+				"<target trees filename|->\n", argv[0], argv[0]);
 		exit(EXIT_FAILURE);
 	}
 
 	return params;
 }
 
-/* A debugging function */
-
-void show_node_children_numbers(struct rooted_tree *tree)
+static int strcmp_p(const void *a, const void *b)
 {
-	struct list_elem *el;
-	for (el = tree->nodes_in_order->head; NULL != el; el = el->next) {
-		struct rnode *current = el->data;
-		printf ("node %p (%s): %d children\n", current,
-			current->label, children_count(current));
-	}
+	return strcmp(*((char **) a), *((char **) b));
 }
 
-/* Get pattern tree and order it */
+/* Returns the tree's sorted leaf labels, separated by newlines. Patterns with
+ * the same key go in the same group. */
 
-struct rooted_tree *get_ordered_pattern_tree(char *pattern)
+static char *leaf_set_key(struct rooted_tree *tree)
 {
-	struct rooted_tree *pattern_tree;
-
-	newick_scanner_set_string_input(pattern);
-	pattern_tree = parse_tree();
-	if (NULL == pattern_tree) {
-		fprintf (stderr, "Could not parse pattern tree '%s'\n", pattern);
-		exit(EXIT_FAILURE);
+	struct llist *labels = get_leaf_labels(tree);
+	if (NULL == labels) return NULL;
+	if (0 == labels->count) {
+		destroy_llist(labels);
+		return strdup("");
 	}
-	newick_scanner_clear_string_input();
+	char **array = (char **) llist_to_array(labels);
+	if (NULL == array) return NULL;
+	qsort(array, labels->count, sizeof(char *), strcmp_p);
+
+	size_t length = 1;
+	int i;
+	for (i = 0; i < labels->count; i++)
+		length += strlen(array[i]) + 1;
+	char *key = malloc(length);
+	if (NULL == key) return NULL;
+	char *p = key;
+	for (i = 0; i < labels->count; i++)
+		p += sprintf(p, "%s\n", array[i]);
+	*p = '\0';
+
+	free(array);
+	destroy_llist(labels);
+	return key;
+}
 
-	if (!order_tree_lbl(pattern_tree)) {
+static void add_pattern(struct patterns *patterns, struct hash *groups_by_key,
+		struct rooted_tree *pattern_tree)
+{
+	int number = patterns->count++;
+	patterns->newicks = realloc(patterns->newicks,
+			patterns->count * sizeof(char *));
+	if (NULL == patterns->newicks) { perror(NULL); exit(EXIT_FAILURE); }
+	patterns->newicks[number] = to_newick(pattern_tree->root);
+	if (NULL == patterns->newicks[number]) {
 		perror(NULL);
 		exit(EXIT_FAILURE);
 	}
 
-	return pattern_tree;
-}
-
-/* Removes inner labels, since match operates on leaf labels only (this might
- * change if operating on internal labels proves useful). */
-
-void remove_inner_node_labels(struct rooted_tree *target_tree)
-{
-	struct list_elem *el;
+	char *key = leaf_set_key(pattern_tree);
+	if (NULL == key) { perror(NULL); exit(EXIT_FAILURE); }
+	struct pattern_group *group = hash_get(groups_by_key, key);
+	int index;
+	if (NULL == group) {
+		group = malloc(sizeof(struct pattern_group));
+		if (NULL == group) { perror(NULL); exit(EXIT_FAILURE); }
+		struct llist *labels = get_leaf_labels(pattern_tree);
+		if (NULL == labels) { perror(NULL); exit(EXIT_FAILURE); }
+		group->filter = create_label_filter(labels, true);
+		if (NULL == group->filter) { perror(NULL); exit(EXIT_FAILURE); }
+		destroy_llist(labels);
+		group->topology = create_canonical_topology(pattern_tree);
+		if (NULL == group->topology) {
+			perror(NULL);
+			exit(EXIT_FAILURE);
+		}
+		group->numbers = NULL;
+		group->matches = NULL;
+		index = 0;
+		if (! hash_set(groups_by_key, key, group) ||
+		    ! append_element(patterns->groups, group)) {
+			perror(NULL);
+			exit(EXIT_FAILURE);
+		}
+	} else {
+		index = add_canonical_pattern(group->topology, pattern_tree);
+		if (index < 0) { perror(NULL); exit(EXIT_FAILURE); }
+	}
+	free(key);
 
-	for (el=target_tree->nodes_in_order->head; NULL != el; el=el->next) {
-		struct rnode *current = el->data;
-		if (is_leaf(current)) continue;
-		free(current->label);
-		// We need to allocate dynamically, since this will later be
-		// passed to free().
-		current->label = strdup("");
+	group->numbers = realloc(group->numbers, (index + 1) * sizeof(int));
+	group->matches = realloc(group->matches, (index + 1) * sizeof(bool));
+	if (NULL == group->numbers || NULL == group->matches) {
+		perror(NULL);
+		exit(EXIT_FAILURE);
 	}
-	/* The tree topology was not changed, so no need to recompute the node
-	 * list */
+	group->numbers[index] = number;
 }
 
-/* Removes all nodes in target tree whose labels are not found in the 'kept'
- * hash */
+/* Reads and compiles the pattern(s), either from the command line or from a
+ * file. The pattern trees themselves are not kept. */
 
-void prune_extra_labels(struct rooted_tree *target_tree, struct hash *kept)
+struct patterns *get_patterns(struct parameters params)
 {
-	struct list_elem *el;
+	struct patterns *patterns = malloc(sizeof(struct patterns));
+	if (NULL == patterns) { perror(NULL); exit(EXIT_FAILURE); }
+	patterns->count = 0;
+	patterns->newicks = NULL;
+	patterns->groups = create_llist();
+	if (NULL == patterns->groups) { perror(NULL); exit(EXIT_FAILURE); }
+	patterns->tree_count = 0;
+	patterns->rejected_count = 0;
+	/* This is only used while reading the patterns. Up to 1000 different
+	 * leaf sets should be plenty, and more would still work. */
+	struct hash *groups_by_key = create_hash(1000);
+	if (NULL == groups_by_key) { perror(NULL); exit(EXIT_FAILURE); }
+	struct llist *pattern_trees = create_llist();
+	if (NULL == pattern_trees) { perror(NULL); exit(EXIT_FAILURE); }
+	struct rooted_tree *pattern_tree;
 
-	for (el=target_tree->nodes_in_order->head; NULL != el; el=el->next) {
-		struct rnode *current = el->data;
-		char *label = current->label;
-		if (0 == strcmp("", label)) continue;
-		if (is_root(current)) continue;
-		if (NULL == hash_get(kept, current->label)) {
-			/* not in 'kept': remove */
-			struct rnode *unlink_root;
-			enum unlink_rnode_status result = unlink_rnode(current);
-			switch(result) {
-			case UNLINK_RNODE_DONE:
-				break;
-			case UNLINK_RNODE_ROOT_CHILD:
-				unlink_root = get_unlink_rnode_root_child(); 
-				unlink_root->parent = NULL;
-				target_tree->root = unlink_root;
-				break;
-			case UNLINK_RNODE_ERROR:
-				fprintf (stderr, "Memory error - "
-						"exiting.\n");
+	if (NULL == params.pattern_file) {
+		newick_scanner_set_string_input(params.pattern);
+		pattern_tree = parse_tree();
+		if (NULL == pattern_tree) {
+			fprintf (stderr, "Could not parse pattern tree '%s'\n",
+					params.pattern);
+			exit(EXIT_FAILURE);
+		}
+		newick_scanner_clear_string_input();
+		add_pattern(patterns, groups_by_key, pattern_tree);
+		if (! append_element(pattern_trees, pattern_tree)) {
+			perror(NULL);
+			exit(EXIT_FAILURE);
+		}
+	} else {
+		newick_scanner_set_file_input(params.pattern_file);
+		while (NULL != (pattern_tree = parse_tree())) {
+			add_pattern(patterns, groups_by_key, pattern_tree);
+			if (! append_element(pattern_trees, pattern_tree)) {
+				perror(NULL);
 				exit(EXIT_FAILURE);
-			default:
-				assert(0); /* programmer error */
 			}
 		}
+		fclose(params.pattern_file);
+		if (0 == patterns->count) {
+			fprintf (stderr, "No pattern tree found.\n");
+			exit(EXIT_FAILURE);
+		}
 	}
 
-	/* Topology may have been altered: recompute nodes_in_order. */
-	destroy_llist(target_tree->nodes_in_order);
-	target_tree->nodes_in_order = get_nodes_in_order(target_tree->root);
-}
+	patterns->matched = malloc(patterns->count * sizeof(bool));
+	patterns->match_counts = calloc(patterns->count, sizeof(int));
+	if (NULL == patterns->matched || NULL == patterns->match_counts) {
+		perror(NULL);
+		exit(EXIT_FAILURE);
+	}
 
-void prune_empty_labels(struct rooted_tree *target_tree)
-{
+	/* The compiled patterns are all we need from now on. */
+	destroy_all_rnodes(NULL);
 	struct list_elem *el;
-	for (el=target_tree->nodes_in_order->head; NULL != el; el=el->next) {
-		struct rnode *current = el->data;
-		char *label = current->label;
-		/* If none of the labels in the target tree are found in the
-		 * pattern, we end up with a null tree consisting of nothing
-		 * but an unlabeled root. We can't unlink it, hence the test.
-		 * */
-		if (is_leaf(current) && ! is_root(current)) {
-			if (0 == strcmp("", label)) {
-				struct rnode *unlink_root;
-				enum unlink_rnode_status result =
-					unlink_rnode(current);
-				switch(result) {
-				case UNLINK_RNODE_DONE:
-					break;
-				case UNLINK_RNODE_ROOT_CHILD:
-					unlink_root =
-						get_unlink_rnode_root_child(); 
-					unlink_root->parent = NULL;
-					target_tree->root = unlink_root;
-					break;
-				case UNLINK_RNODE_ERROR:
-					perror(NULL);
-					exit(EXIT_FAILURE);
-				default:
-					assert(0); /* programmer error */
-				}
-			}
-		}
-	}
+	for (el = pattern_trees->head; NULL != el; el = el->next)
+		destroy_tree(el->data);
+	destroy_llist(pattern_trees);
+	destroy_hash(groups_by_key);
 
-	/* Topology may have been altered: recompute nodes_in_order. */
-	destroy_llist(target_tree->nodes_in_order);
-	target_tree->nodes_in_order = get_nodes_in_order(target_tree->root);
+	return patterns;
 }
 
-void remove_branch_lengths(struct rooted_tree *target_tree)
+void destroy_patterns(struct patterns *patterns)
 {
 	struct list_elem *el;
-
-	for (el = target_tree->nodes_in_order->head; NULL != el; el = el->next) {
-		struct rnode *current = el->data;
-		if (strcmp("", current->edge_length_as_string) != 0) {
-			free(current->edge_length_as_string);
-			// We need to allocate dynamically, since this will
-			// later be passed to free():
-			// cur_edge->length_as_string = "" *WRONG!*
-			current->edge_length_as_string = strdup("");
-		}
+	int i;
+
+	for (el = patterns->groups->head; NULL != el; el = el->next) {
+		struct pattern_group *group = el->data;
+		destroy_label_filter(group->filter);
+		destroy_canonical_topology(group->topology);
+		free(group->numbers);
+		free(group->matches);
+		free(group);
 	}
-	/* The tree topology was not changed, so no need to recompute
-	 * nodes_in_order */
+	destroy_llist(patterns->groups);
+	for (i = 0; i < patterns->count; i++)
+		free(patterns->newicks[i]);
+	free(patterns->newicks);
+	free(patterns->matched);
+	free(patterns->match_counts);
+	free(patterns);
 }
 
-void remove_knee_nodes(struct rooted_tree *tree)
+/* The tree is left alone: its topology, restricted to the pattern's leaves, is
+ * compared to the pattern's in canonical form (see canonical_topology.h).
+ * Groups whose leaves are not all in the tree are skipped (see
+ * label_filter.h). Only trees that are output are converted to Newick. */
+
+void process_tree(struct rooted_tree *tree, struct patterns *patterns,
+		struct parameters params)
 {
 	struct list_elem *el;
-
-	for (el = tree->nodes_in_order->head; NULL != el; el = el->next) {
-		struct rnode *current = el->data;
-		if (is_inner_node(current))
-			if (1 == children_count(current)) { 
-				if (! splice_out_rnode(current)) {
-					perror(NULL);
-					exit(EXIT_FAILURE);
-				}
-				/* NOTE: don't destroy the current node here.
-				 * This is taken care of later in main(). */
-			}
+	int i;
+	bool any_match = false;
+	bool any_candidate = false;
+
+	patterns->tree_count++;
+	for (el = patterns->groups->head; NULL != el; el = el->next) {
+		struct pattern_group *group = el->data;
+		int n = canonical_pattern_count(group->topology);
+		if (! label_filter_accepts(group->filter, tree)) {
+			for (i = 0; i < n; i++)
+				patterns->matched[group->numbers[i]] = false;
+			continue;
+		}
+		any_candidate = true;
+		enum canonical_match result = match_canonical_patterns(
+				group->topology, tree, group->matches);
+		if (CANON_ERROR == result) { perror(NULL); exit(EXIT_FAILURE); }
+		for (i = 0; i < n; i++)
+			patterns->matched[group->numbers[i]] =
+				group->matches[i];
+		if (CANON_MATCH == result) any_match = true;
 	}
+	if (! any_candidate) patterns->rejected_count++;
 
-	/* If the root has only one child, make that child the new root */
-	if (1 == children_count(tree->root)) 
-		tree->root = tree->root->first_child;
+	if (params.counts) {
+		for (i = 0; i < patterns->count; i++)
+			if (patterns->matched[i] != params.reverse)
+				patterns->match_counts[i]++;
+		return;
+	}
 
-	/* Topology may have been altered: recompute nodes_in_order. */
-	struct llist *nodes_in_order = get_nodes_in_order(tree->root);
-	if (NULL == nodes_in_order) { perror(NULL); exit(EXIT_FAILURE); }
-	destroy_llist(tree->nodes_in_order);
-	tree->nodes_in_order = nodes_in_order;
-}
+	/* single pattern, or -v: print the tree as is */
+	if (NULL == params.pattern_file || params.reverse) {
+		if (any_match != params.reverse)
+			dump_newick(tree->root);
+		return;
+	}
 
-void process_tree(struct rooted_tree *tree, struct hash *pattern_labels,
-		char *pattern_newick, struct parameters params)
-{
-	/* NOTE: whenever I alter the tree structure, I rebuild nodes_in_order
-	 * as soon as possible. Then I no longer need to guard against this
-	 * list being invalid. */
-
-	/* In this case I stick with the old, recursive to_newick, because it
-	 * directly returns a char* */
-	char *original_newick = to_newick(tree->root);
-	remove_inner_node_labels(tree);
-	prune_extra_labels(tree, pattern_labels);
-	prune_empty_labels(tree);
-	remove_knee_nodes(tree);
-	remove_branch_lengths(tree);	
-	if (! order_tree_lbl(tree)) { perror(NULL); exit(EXIT_FAILURE); }
-	/* Ordering does not change topology, but it does change node
-	 * oridering, hence nodes_in_order must be recomputed. */
-	struct llist *nodes_in_order = get_nodes_in_order(tree->root);
-	if (NULL == nodes_in_order) { perror(NULL); exit(EXIT_FAILURE); }
-	destroy_llist(tree->nodes_in_order);
-	tree->nodes_in_order = nodes_in_order;
-
-	char *processed_newick = to_newick(tree->root);
-	int match = (0 == strcmp(processed_newick, pattern_newick));
-	match = params.reverse ? !match : match;
-	if (match) printf ("%s\n", original_newick);
-	free(processed_newick);
-	free(original_newick);
+	if (! any_match) return;
+	char *newick = to_newick(tree->root);
+	if (NULL == newick) { perror(NULL); exit(EXIT_FAILURE); }
+	for (i = 0; i < patterns->count; i++)
+		if (patterns->matched[i])
+			printf ("%d\t%s\n", i + 1, newick);
+	free(newick);
 }
 
 int main(int argc, char *argv[])
 {
-	struct rooted_tree *pattern_tree;	
 	struct rooted_tree *tree;	
-	char *pattern_newick;
-	struct hash *pattern_labels;
+	struct patterns *patterns;
+	int i;
 
 	struct parameters params = get_params(argc, argv);
 
-	pattern_tree = get_ordered_pattern_tree(params.pattern);
-	pattern_newick = to_newick(pattern_tree->root);
-	pattern_labels = create_label2node_map(pattern_tree->nodes_in_order);
+	patterns = get_patterns(params);
 
-	/* get_ordered_pattern_tree() causes a tree to be read from a string,
-	 * which means that we must now tell the lexer to change its input
-	 * source. It's not enough to just set the external FILE pointer
+	/* get_patterns() causes a tree to be read from a string (or another
+	 * file), which means that we must now tell the lexer to change its
+	 * input source. It's not enough to just set the external FILE pointer
 	 * 'nwsin' to standard input or the user-supplied file, apparently:
 	 * this would segfault. */
 	newick_scanner_set_file_input(params.target_trees);
 
 	while (NULL != (tree = parse_tree())) {
-		process_tree(tree, pattern_labels, pattern_newick, params);
+		process_tree(tree, patterns, params);
+		destroy_all_rnodes(NULL);
 		destroy_tree(tree);
 	}
 
-	destroy_hash(pattern_labels);
-	free(pattern_newick);
-	destroy_all_rnodes(NULL);
-	destroy_tree(pattern_tree);
+	if (params.counts)
+		for (i = 0; i < patterns->count; i++)
+			printf ("%d\t%s\n", patterns->match_counts[i],
+					patterns->newicks[i]);
+	if (params.statistics)
+		fprintf (stderr, "%d trees read, %d rejected by leaf labels\n",
+				patterns->tree_count,
+				patterns->rejected_count);
+
+	destroy_patterns(patterns);
 	return 0;
 }
@@ -153,32 +153,32 @@ inner_node: O_PAREN nodelist C_PAREN {
     | O_PAREN nodelist C_PAREN LABEL COLON LABEL {
 		struct list_elem* lep;
 		struct rnode *np;
-		np = create_rnode($4,$6);
+		np = create_rnode($4,NULL);
 		if (NULL == np) {
 			newick_parser_status = PARSER_STATUS_MALLOC_ERROR;
 			root = NULL;
 			YYACCEPT;
 		}
 		free($4);
+		adopt_edge_length_as_string(np, $6);
 		for (lep = $2->head; NULL != lep; lep = lep->next) 
 			add_child(np, (struct rnode*) lep->data); 
 		destroy_llist($2);
-		free($6);
 		$$ = np;
     }	
     | O_PAREN nodelist C_PAREN COLON LABEL {
 		struct list_elem* lep;
 		struct rnode *np;
-		np = create_rnode("",$5);
+		np = create_rnode("",NULL);
 		if (NULL == np) {
 			newick_parser_status = PARSER_STATUS_MALLOC_ERROR;
 			root = NULL;
 			YYACCEPT;
 		}
+		adopt_edge_length_as_string(np, $5);
 		for (lep = $2->head; NULL != lep; lep = lep->next) 
 			add_child(np, (struct rnode*) lep->data); 
 		destroy_llist($2);
-		free($5);
 		$$ = np;
     }
     | O_PAREN nodelist { 
@@ -229,24 +229,24 @@ leaf: LABEL {
 	}
     | LABEL COLON LABEL {
 		struct rnode *np;
-		np = create_rnode($1,$3);
+		np = create_rnode($1,NULL);
 		if (NULL == np) {
 			newick_parser_status = PARSER_STATUS_MALLOC_ERROR;
 			root = NULL;
 			YYACCEPT;
 		}
 		free($1);
-		free($3);
+		adopt_edge_length_as_string(np, $3);
 		$$ = np;
 	}
     | COLON LABEL {
-		struct rnode *np = create_rnode("",$2);
+		struct rnode *np = create_rnode("",NULL);
 		if (NULL == np) {
 			newick_parser_status = PARSER_STATUS_MALLOC_ERROR;
 			root = NULL;
 			YYACCEPT;
 		}
-		free($2);
+		adopt_edge_length_as_string(np, $2);
 		$$ = np;
 	}
     | /* empty */ {
@@ -103,33 +103,41 @@ void destroy_label2node_list_map(struct hash *map)
 }
 
 /* Returns a label->node map of (labeled) leaves descending from 'root' */
-/* Nodes' 'seen' member must be zero - see note above about the 'seen' member
- * of struct rnode. NOTE: this function is meant to work on any node, not just
- * a tree's root (e.g. in is_monophyletic()). So don't be tempted to rewrite it
- * to use tree->nodes_in_order. */
+/* NOTE: this function is meant to work on any node, not just a tree's root
+ * (e.g. in is_monophyletic()). So don't be tempted to rewrite it to use
+ * tree->nodes_in_order. */
 
 static const int INIT_HASH_SIZE = 1000;
 
 struct hash *get_leaf_label_map_from_node(struct rnode *root)
 {
-	struct rnode_iterator *it = create_rnode_iterator(root);
-	if (NULL == it) return NULL;
+	struct rnode_traversal *trav = create_rnode_traversal(root,
+			TRAVERSAL_PREORDER);
+	if (NULL == trav) return NULL;
 	struct rnode *current;
 	struct hash *result = create_hash(INIT_HASH_SIZE);
-	if (NULL == result) return NULL;
+	if (NULL == result) {
+		destroy_rnode_traversal(trav);
+		return NULL;
+	}
 
-	while ((current = rnode_iterator_next(it)) != NULL) {
+	while ((current = rnode_traversal_next(trav)) != NULL) {
 		if (is_leaf(current)) {
 			if (strcmp("", current->label) != 0) {
 				if (! hash_set(result,
 					current->label, current)) 
-						return NULL;
+						break;
 			}
 		}
 	}
+	/* either hash_set() or the traversal ran out of memory */
+	if (NULL != current || rnode_traversal_failed(trav)) {
+		destroy_hash(result);
+		destroy_rnode_traversal(trav);
+		return NULL;
+	}
 
-	destroy_rnode_iterator(it);
+	destroy_rnode_traversal(trav);
 
 	return result;
 }
-
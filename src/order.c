@@ -178,28 +178,24 @@ int main(int argc, char *argv[])
 {
 	struct rooted_tree *tree;	
 	struct parameters params = get_params(argc, argv);
-	int (*comparator)(const void*,const void*);
-	int (*sort_field_setter)(struct rnode *);
+	int (*order)(struct rooted_tree *);
 
 	switch(params.criterion) {
 	case ORDER_ALNUM_LBL:
-		comparator = lbl_comparator;
-		sort_field_setter = set_sort_field_label;
+		order = order_tree_lbl;
 		break;
 	case ORDER_DELADDERIZE:
-		comparator = num_desc_deladderize;
-		sort_field_setter = set_sort_field_num_desc;
+		order = order_tree_deladderize;
 		break;
 	case ORDER_NUM_DESCENDANTS:
-		comparator = num_desc_comparator;
-		sort_field_setter = set_sort_field_num_desc;
+		order = order_tree_num_desc;
 		break;
 	default:
 		assert(0); // programmer error
 	}
 
 	while (NULL != (tree = parse_tree())) {
-		if (! order_tree (tree, comparator, sort_field_setter)) {
+		if (! order(tree)) {
 			perror(NULL);
 			exit(EXIT_FAILURE);
 		}
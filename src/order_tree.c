@@ -33,6 +33,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <string.h>
 #include <stdlib.h>
+#include <stdbool.h>
 
 #include "rnode.h"
 #include "tree.h"
@@ -81,10 +82,6 @@ int order_tree(struct rooted_tree *tree,
 	return SUCCESS;
 }
 
-int order_tree_lbl(struct rooted_tree *tree)
-{
-	return order_tree(tree, lbl_comparator, set_sort_field_label);
-}
 
 int num_desc_comparator(const void *a, const void *b)
 {
@@ -135,16 +132,6 @@ int lbl_comparator(const void *a, const void *b)
 	return cmp;
 }
 
-int order_tree_num_desc(struct rooted_tree *tree)
-{
-	return order_tree(tree, num_desc_comparator, set_sort_field_num_desc);
-}
-
-int order_tree_deladderize(struct rooted_tree *tree)
-{
-	return order_tree(tree, num_desc_deladderize, set_sort_field_num_desc);
-}
-
 int set_sort_field_label(struct rnode *node)
 {
 	/* If the node has a non-empty label, or if it is a leaf (or both), we
@@ -183,3 +170,179 @@ int set_sort_field_num_desc(struct rnode *node)
 
 	return SUCCESS;
 }
+
+/* The functions below do the same job as order_tree() with the comparators
+ * above, but in a single postorder pass and without touching rnode->data.
+ * Sort keys (a leaf count, or a pointer to the sort label - never a copy) are
+ * kept on a stack: in postorder, a node's children are the top child_count
+ * entries, in child order. They are sorted there, stably (so that ties keep
+ * their order), and the node's children are relinked in that order before
+ * they are replaced by the node itself. Leaf counts, being small integers,
+ * are radix-sorted at large nodes; nothing is allocated per node. */
+
+struct keyed_node {
+	int key;
+	const char *label;
+	struct rnode *node;
+};
+
+/* Below this many children, insertion sort beats radix sort and qsort(). */
+#define SMALL_SORT 32
+
+/* Stable sort of 'count' nodes on their integer keys: insertion sort for small
+ * arrays, else least significant byte first radix sort, with as many passes
+ * as the largest key has bytes. 'tmp' must have room for 'count' nodes. */
+
+static void sort_on_key(struct keyed_node *kids, struct keyed_node *tmp,
+		int count)
+{
+	int i, j;
+
+	if (count < SMALL_SORT) {
+		for (i = 1; i < count; i++) {
+			struct keyed_node kid = kids[i];
+			for (j = i; j > 0 && kids[j-1].key > kid.key; j--)
+				kids[j] = kids[j-1];
+			kids[j] = kid;
+		}
+		return;
+	}
+
+	int max = 0;
+	for (i = 0; i < count; i++)
+		if (kids[i].key > max) max = kids[i].key;
+
+	struct keyed_node *from = kids, *to = tmp, *swap;
+	int shift;
+	for (shift = 0; shift < 32 && (max >> shift) > 0; shift += 8) {
+		int start[257] = { 0 };
+		for (i = 0; i < count; i++)
+			start[((from[i].key >> shift) & 0xff) + 1]++;
+		for (i = 1; i < 257; i++)
+			start[i] += start[i-1];
+		for (i = 0; i < count; i++)
+			to[start[(from[i].key >> shift) & 0xff]++] = from[i];
+		swap = from; from = to; to = swap;
+	}
+	if (from != kids)
+		memcpy(kids, from, count * sizeof(struct keyed_node));
+}
+
+/* For qsort()ing on labels: the key holds the original position, which makes
+ * the sort stable. */
+
+static int keyed_label_cmp(const void *a, const void *b)
+{
+	const struct keyed_node *ka = a, *kb = b;
+	int cmp = strcmp(ka->label, kb->label);
+	if (0 != cmp) return cmp;
+	return ka->key - kb->key;
+}
+
+/* Stable sort of 'count' nodes on their labels. */
+
+static void sort_on_label(struct keyed_node *kids, int count)
+{
+	int i, j;
+
+	if (count < SMALL_SORT) {
+		for (i = 1; i < count; i++) {
+			struct keyed_node kid = kids[i];
+			for (j = i; j > 0 && strcmp(kids[j-1].label,
+						kid.label) > 0; j--)
+				kids[j] = kids[j-1];
+			kids[j] = kid;
+		}
+		return;
+	}
+
+	for (i = 0; i < count; i++)
+		kids[i].key = i;
+	qsort(kids, count, sizeof(struct keyed_node), keyed_label_cmp);
+}
+
+enum order_key { KEY_LABEL, KEY_LEAF_COUNT, KEY_DELADDERIZE };
+
+static int order_tree_by_key(struct rooted_tree *tree, enum order_key key)
+{
+	/* No node has more children, nor the stack more entries, than there
+	 * are nodes. We walk the tree itself rather than
+	 * tree->nodes_in_order, as the stack needs a strict postorder. */
+	int node_count = tree->nodes_in_order->count;
+	struct keyed_node *stack = malloc(node_count
+			* sizeof(struct keyed_node));
+	if (NULL == stack) return FAILURE;
+	struct keyed_node *tmp = NULL;
+	if (KEY_LABEL != key) {
+		tmp = malloc(node_count * sizeof(struct keyed_node));
+		if (NULL == tmp) { free(stack); return FAILURE; }
+	}
+
+	struct rnode *node, *root = tree->root;
+	int top = 0, i;
+	bool descending = true;
+	for (node = postorder_first(root); NULL != node;
+			node = postorder_next(node, root)) {
+		struct keyed_node entry = { 1, node->label, node };
+		int count = node->child_count;
+
+		if (is_leaf(node)) {
+			stack[top++] = entry;
+			continue;
+		}
+
+		/* The children are the top 'count' entries. */
+		struct keyed_node *kids = stack + top - count;
+		top -= count;
+
+		if (KEY_LABEL == key) {
+			sort_on_label(kids, count);
+			/* If unlabeled, the node sorts as its first child */
+			if ('\0' == node->label[0])
+				entry.label = kids[0].label;
+		} else {
+			entry.key = 0;
+			for (i = 0; i < count; i++)
+				entry.key += kids[i].key;
+			/* When deladderizing, the direction alternates at
+			 * every node that has more than one child, starting
+			 * with increasing. Flipping the keys makes the sort
+			 * decreasing, and leaves ties in order. */
+			if (KEY_DELADDERIZE == key && count > 1) {
+				descending = ! descending;
+				if (descending)
+					for (i = 0; i < count; i++)
+						kids[i].key = entry.key
+							- kids[i].key;
+			}
+			sort_on_key(kids, tmp, count);
+		}
+
+		remove_children(node);
+		for (i = 0; i < count; i++) {
+			kids[i].node->next_sibling = NULL;
+			add_child(node, kids[i].node);
+		}
+
+		stack[top++] = entry;
+	}
+
+	free(tmp);
+	free(stack);
+	return SUCCESS;
+}
+
+int order_tree_lbl(struct rooted_tree *tree)
+{
+	return order_tree_by_key(tree, KEY_LABEL);
+}
+
+int order_tree_num_desc(struct rooted_tree *tree)
+{
+	return order_tree_by_key(tree, KEY_LEAF_COUNT);
+}
+
+int order_tree_deladderize(struct rooted_tree *tree)
+{
+	return order_tree_by_key(tree, KEY_DELADDERIZE);
+}
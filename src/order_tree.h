@@ -32,15 +32,24 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 struct rooted_tree;
 
 
+/* Canned orderings: by label, by increasing number of descendants (i.e.,
+ * leaves), and by number of descendants with the direction alternating from
+ * one node to the next, which breaks ladders. These give the same trees as
+ * order_tree() with the corresponding comparators below (except possibly for
+ * the order of ties), but in a single pass, without allocating per node and
+ * without using rnode->data. Children with equal keys keep their relative
+ * order. Return FAILURE iff malloc() fails. */
+
 int order_tree_lbl(struct rooted_tree *);
 int order_tree_num_desc(struct rooted_tree *);
+int order_tree_deladderize(struct rooted_tree *);
 
 /* A general-purpose sort function. Arguments are a tree, a node comparator
  * function, and a sort field setter function. The comparator is used by
  * qsort() to sort the children of a node, and the setter function sets the
  * node's sort field once its children have been sorted. See also
  * order_tree_lbl() and order_tree_num_desc(), which are
- * canned, easy-to-remember calls to this function. */
+ * canned, easy-to-remember (and faster) alternatives to this function. */
 
 int order_tree(struct rooted_tree *tree,
 		int (*comparator)(const void*,const void*),
@@ -0,0 +1,94 @@
+/* 
+
+Copyright (c) 2009 Thomas Junier and Evgeny Zdobnov, University of Geneva
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+* Neither the name of the University of Geneva nor the names of its
+    contributors may be used to endorse or promote products derived from this
+    software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+/* prng.c - xoshiro256** pseudorandom number generator, seeded with splitmix64
+ * (see http://prng.di.unimi.it/) */
+
+#include "prng.h"
+
+static uint64_t rotl(uint64_t x, int k)
+{
+	return (x << k) | (x >> (64 - k));
+}
+
+/* splitmix64: used only to turn a seed into a full state, since xoshiro's
+ * state must not be all zeroes and should not be "mostly" zeroes either. */
+
+static uint64_t splitmix64(uint64_t *x)
+{
+	uint64_t z = (*x += 0x9e3779b97f4a7c15ULL);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+void prng_seed(struct prng *prng, uint64_t seed, uint64_t stream)
+{
+	/* the multiplier is odd, so distinct streams give distinct starting
+	 * points */
+	uint64_t x = seed ^ (stream * 0xd1342543de82ef95ULL);
+	int i;
+	for (i = 0; i < 4; i++)
+		prng->s[i] = splitmix64(&x);
+}
+
+uint64_t prng_next(struct prng *prng)
+{
+	uint64_t *s = prng->s;
+	uint64_t result = rotl(s[1] * 5, 7) * 9;
+	uint64_t t = s[1] << 17;
+
+	s[2] ^= s[0];
+	s[3] ^= s[1];
+	s[1] ^= s[2];
+	s[0] ^= s[3];
+	s[2] ^= t;
+	s[3] = rotl(s[3], 45);
+
+	return result;
+}
+
+double prng_uniform(struct prng *prng)
+{
+	/* the top 53 bits fill a double's mantissa */
+	return (prng_next(prng) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+uint64_t prng_below(struct prng *prng, uint64_t n)
+{
+	/* reject the lowest (2^64 mod n) values, so that the remaining ones
+	 * map evenly onto 0..n-1 */
+	uint64_t threshold = -n % n;
+	uint64_t r;
+	do {
+		r = prng_next(prng);
+	} while (r < threshold);
+
+	return r % n;
+}
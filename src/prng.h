@@ -0,0 +1,64 @@
+/* 
+
+Copyright (c) 2009 Thomas Junier and Evgeny Zdobnov, University of Geneva
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+* Neither the name of the University of Geneva nor the names of its
+    contributors may be used to endorse or promote products derived from this
+    software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+/** \file
+ * A small, fast and seedable pseudorandom number generator (xoshiro256**, by
+ * Blackman and Vigna). Unlike rand(), its state is explicit, so that several
+ * independent generators can be used at once (e.g. one per thread), and its
+ * output does not depend on the C library. */
+
+#include <stdint.h>
+
+struct prng {
+	uint64_t s[4];
+};
+
+/** Seeds the generator. Different streams with the same seed yield unrelated
+ * sequences, so e.g. the n-th of several trees can be generated from stream n
+ * and will be the same whatever order (or thread) it is generated in.
+ * \arg \c prng the generator to seed
+ * \arg \c seed the seed
+ * \arg \c stream the stream number */
+
+void prng_seed(struct prng *prng, uint64_t seed, uint64_t stream);
+
+/** Returns the next 64-bit pseudorandom number */
+
+uint64_t prng_next(struct prng *prng);
+
+/** Returns a pseudorandom number 0 <= x < 1 */
+
+double prng_uniform(struct prng *prng);
+
+/** Returns a pseudorandom integer 0 <= x < n (without modulo bias). n must be
+ * > 0. */
+
+uint64_t prng_below(struct prng *prng, uint64_t n);
@@ -47,10 +47,6 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 enum prune_mode { PRUNE_DIRECT, PRUNE_REVERSE };
 
-struct prune_data {
-	bool kept_descendant;
-};
-
 struct parameters {
 	set_t 	*cl_labels;
 	enum prune_mode mode;
@@ -79,7 +75,8 @@ void help(char *argv[])
 "out the modified tree. If removing a node causes its parent to have only\n"
 "one child (as is always the case in strictly binary trees), the parent is\n"
 "spliced out and the remaining child is attached to its grandparent,\n"
-"preserving length.\n"
+"preserving length. If the root is left with only one child, that child\n"
+"becomes the root.\n"
 "\n"
 "Only labeled nodes are considered for pruning.\n"
 "\n"
@@ -174,116 +171,65 @@ struct parameters get_params(int argc, char *argv[])
 	return params;
 }
 
-/* We buld a hash of the passed labels, and visit the tree, unlinking nodes as
- * needed. In Direct mode, we traverse in reverse order, unlinking nodes to
- * prune. In Reverse mode, things are a bit more hairy because we need to keep
- * not just the nodes passed as argument, but also their ancestors. So we pass
- * through th etree first in direct order, marking nodes to keep and their
- * ancestors. Then we go back in reverse order, pruning. */
+/* We build a set of the passed labels, and mark nodes for pruning. The
+ * pruning itself is done in a single pass by prune_tree(). In Direct mode, we
+ * just drop nodes whose label was passed. In Reverse mode, things are a bit
+ * more hairy because we need to keep not just the nodes passed as argument,
+ * but also their ancestors and descendants. So we first go through the tree
+ * parents first, marking ("seen") the nodes passed and their descendants, and
+ * then children first, marking their ancestors. Unmarked nodes are then
+ * dropped. */
 
-static struct rooted_tree * process_tree_direct(
-		struct rooted_tree *tree, set_t *cl_labels)
+static bool drop_if_passed(struct rnode *node, void *param)
 {
-	struct llist *rev_nodes = llist_reverse(tree->nodes_in_order);
-	struct list_elem *el;
-	struct rnode *current;
-	char *label;
-
-	for (el = rev_nodes->head; NULL != el; el = el->next) {
-		current = el->data;
-		label = current->label;
-		/* skip this node iff parent is marked ("seen") */
-		if (!is_root(current) && current->parent->seen) {
-			current->seen = true;	/* inherit mark */
-			continue;
-		}
-		if (set_has_element(cl_labels, label)) {
-			unlink_rnode(current);
-			current->seen = true;
-		}
-	}
-
-	destroy_llist(rev_nodes);
-	reset_seen(tree);
-	return tree;
+	return set_has_element((set_t *) param, node->label);
 }
 
-/* Prune predicate: retains the nodes passed on CL, but discards their
- * children. */
-
-// TODO: this might be a useful prune predicate, add option to use it.
-
-bool prune_predicate_trim_kids(struct rnode *node, void *param)
+static bool drop_if_not_seen(struct rnode *node, void *param)
 {
-	if (node->seen) {
-		/* ancestor of a passed node */
-		return true;
-	}
+	return ! node->seen;
 }
 
-/* Prune predicate: retains the nodes passed on CL and their children. */
-
-bool prune_predicate_keep_clade(struct rnode *node, void *param)
+static struct rooted_tree * process_tree_direct(
+		struct rooted_tree *tree, set_t *cl_labels)
 {
-	set_t *cl_labels = (set_t *) param;
-
-	if (node->seen) {
-		return true;
-	}
-	/* Node isn't an ancestor of a passed node. Node can be a _descendant_
-	 * of a passed node, though, in which case we must keep it as well. */
-	if (!is_root(node)) {
-		if (NULL != node->parent->data) {
-			struct prune_data *pdata = node->parent->data;
-			if (pdata->kept_descendant) {
-				struct prune_data *pdata =
-					malloc(sizeof(struct prune_data));
-				if (NULL == pdata) {
-					perror(NULL); exit(EXIT_FAILURE);
-				}
-				pdata->kept_descendant = true;
-				node->data = pdata;
-				return true;
-			}
-		}
+	if (! prune_tree(tree, drop_if_passed, cl_labels)) {
+		perror(NULL);
+		exit(EXIT_FAILURE);
 	}
-	
-	/* neither an ancestor nor a descendant of a passed node - drop. */
-	return false;
+
+	return tree;
 }
 
 static struct rooted_tree * process_tree_reverse(
 		struct rooted_tree *tree, set_t *cl_labels)
 {
-	struct list_elem *el = tree->nodes_in_order->head;
-	struct rnode *current;
-	char *label;
-
-	for (; NULL != el; el = el->next) {
-		current = el->data;
-		if (is_root(current)) break;
-		label = current->label;
-		/* mark this node (to keep it) if its label is on the CL */
-		if (set_has_element(cl_labels, label)) {
+	int count, i;
+	struct rnode **nodes = get_nodes_in_order_array(tree->root, &count);
+	if (NULL == nodes) { perror(NULL); exit(EXIT_FAILURE); }
+
+	/* parents first: nodes passed on the CL, and their descendants */
+	for (i = count - 1; i >= 0; i--) {
+		struct rnode *current = nodes[i];
+		if (set_has_element(cl_labels, current->label) ||
+		    (! is_root(current) && current->parent->seen))
 			current->seen = true;
-			struct prune_data *pdata =
-				malloc(sizeof(struct prune_data));
-			if (NULL == pdata) {perror(NULL); exit(EXIT_FAILURE); }
-			pdata->kept_descendant = true;
-			current->data = pdata;
-		}
-		/* and propagate 'seen' to parent (kept_descendant is
-		 * propagated to children (not parents), see
-		 * prune_predicate_keep_clade() */
-		if (current->seen) {
+	}
+	/* children first: ancestors of marked nodes */
+	for (i = 0; i < count; i++) {
+		struct rnode *current = nodes[i];
+		if (current->seen && ! is_root(current))
 			current->parent->seen = true;	/* inherit mark */
-		}
 	}
+	free(nodes);
+
+	if (! prune_tree(tree, drop_if_not_seen, NULL)) {
+		perror(NULL);
+		exit(EXIT_FAILURE);
+	}
+	reset_seen(tree);
 
-	struct rooted_tree *pruned = clone_tree_cond(tree,
-			prune_predicate_keep_clade, cl_labels);	
-	destroy_tree(tree);
-	return pruned;
+	return tree;
 }
 
 int main(int argc, char *argv[])
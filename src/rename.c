@@ -43,16 +43,19 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "rnode.h"
 #include "readline.h"
 #include "common.h"
+#include "map_index.h"
 
 
 struct parameters {
-	/* Either uses a rename map (whose name is then stored in
-	 * map_filename), or gets the old and new labels from the command line.
-	 * This is determined from the number of arguments. */
-	char *map_filename;
+	/* Either uses rename maps (whose names are then stored in
+	 * map_filenames, in order of application), or gets the old and new
+	 * labels from the command line. This is determined from the number of
+	 * arguments, and from option -m. */
+	struct llist *map_filenames;
 	char *old_label;
 	char *new_label;
 	bool only_leaves;
+	bool use_index;
 };
 
 void help(char *argv[])
@@ -63,9 +66,11 @@ void help(char *argv[])
 "Synopsis\n"
 "--------\n"
 "\n"
-"%s [-hl] <newick trees filename|-> <map filename>\n"
+"%s [-hil] <newick trees filename|-> <map filename>\n"
 "or\n"
 "%s [-hl] <newick trees filename|-> <old-label> <new-label>\n"
+"or\n"
+"%s [-hil] -m <map filename> [-m <map filename>]... <newick trees filename|->\n"
 "\n"
 "Input\n"
 "-----\n"
@@ -91,6 +96,10 @@ void help(char *argv[])
 "requires a map file, while the second form requires no file but is limited\n"
 "to one label.\n"
 "\n"
+"In the third form, the maps passed with -m are applied one after the\n"
+"other, in the order given - as if the output of one run were piped into\n"
+"the next (see option -m).\n"
+"\n"
 "Output\n"
 "------\n"
 "\n"
@@ -100,6 +109,16 @@ void help(char *argv[])
 "-------\n"
 "\n"
 "    -h: print this message and exit\n"
+"    -i: use an index of the map file, which is stored next to it (with\n"
+"        '.idx' appended to its name) and is created, or updated when the\n"
+"        map has changed, as needed. For large maps, this makes startup\n"
+"        much faster than reading the map itself.\n"
+"    -m <map filename>: apply this map after the previous ones. The maps\n"
+"        are composed into a single map before any tree is read, so each\n"
+"        label is looked up only once, and the trees are read only once.\n"
+"        (With -i, the maps are read from their indexes, but they are\n"
+"        still composed, which takes time proportional to their size: the\n"
+"        fast startup of -i is only for a single map.)\n"
 "    -l: only replace leaf labels. This is useful if all labels are numeric,\n"
 "        but inner labels represent bootstraps, and you don't want to\n"
 "        accidentally modify bootstrap values.\n"
@@ -124,7 +143,14 @@ void help(char *argv[])
 "# In fact, we could directly condense the tree, so that only one leaf per\n"
 "# family is left:\n"
 "\n"
-"$ %s data/falconiformes data/falc_map | nw_condense -\n",
+"$ %s data/falconiformes data/falc_map | nw_condense -\n"
+"\n"
+"# Maps can be chained: this is the same as renaming with map1, then\n"
+"# renaming the result with map2:\n"
+"\n"
+"$ %s -m map1 -m map2 data/falconiformes\n",
+	argv[0],
+	argv[0],
 	argv[0],
 	argv[0],
 	argv[0],
@@ -188,26 +214,40 @@ struct parameters get_params(int argc, char *argv[])
 	struct parameters params;
 
 	params.only_leaves = false;	/* default: rename all nodes */
-	params.map_filename = NULL;
+	params.use_index = false;
+	params.map_filenames = create_llist();
+	if (NULL == params.map_filenames) { perror(NULL); exit(EXIT_FAILURE); }
 	params.old_label = NULL;
 	params.new_label = NULL;
 
 	int opt_char;
-	while ((opt_char = getopt(argc, argv, "hl")) != -1) {
+	while ((opt_char = getopt(argc, argv, "him:l")) != -1) {
 		switch (opt_char) {
 		case 'h':
 			help(argv);
 			exit(EXIT_SUCCESS);
+		case 'i':
+			params.use_index = true;
+			break;
 		case 'l':
 			params.only_leaves = true;
 			break;
+		case 'm':
+			if (! append_element(params.map_filenames, optarg)) {
+				perror(NULL);
+				exit(EXIT_FAILURE);
+			}
+			break;
 		}
 	}
 
 	/* check arguments */
-	if ((argc - optind) < 2)	{
-		fprintf(stderr, "Usage: %s [-hl] <filename|-> <map_filename>\n",
-				argv[0]);
+	int nargs = argc - optind;
+	if ((0 == params.map_filenames->count && nargs < 2) ||
+	    (params.map_filenames->count > 0 && 1 != nargs))	{
+		fprintf(stderr, "Usage: %s [-hil] <filename|-> <map_filename>\n"
+			"       %s [-hil] -m <map_filename> [-m <map_filename>]... "
+			"<filename|->\n", argv[0], argv[0]);
 		exit(EXIT_FAILURE);
 	} 
 
@@ -220,9 +260,12 @@ struct parameters get_params(int argc, char *argv[])
 		}
 		nwsin = fin;
 	}
-	if ((argc - optind) == 2)
-		params.map_filename = argv[optind+1];
-	else  {
+	if (2 == nargs) {
+		if (! append_element(params.map_filenames, argv[optind+1])) {
+			perror(NULL);
+			exit(EXIT_FAILURE);
+		}
+	} else if (3 <= nargs) {
 		params.old_label = argv[optind+1];
 		params.new_label = argv[optind+2];
 	}
@@ -230,7 +273,24 @@ struct parameters get_params(int argc, char *argv[])
 	return params;
 }
 
-void process_tree(struct rooted_tree *tree, struct hash *rename_map,
+/* The map is either a hash, or the index of a single map (option -i). */
+
+struct rename_map {
+	struct hash *hash;
+	struct map_index *index;
+};
+
+static const char *new_label_for(struct rename_map *map, const char *label)
+{
+	if (NULL == map->index)
+		return hash_get(map->hash, label);
+
+	const char *new_label = map_index_get(map->index, label);
+	if (map_index_failed(map->index)) { perror(NULL); exit(EXIT_FAILURE); }
+	return new_label;
+}
+
+void process_tree(struct rooted_tree *tree, struct rename_map *rename_map,
 		struct parameters params)
 {
 	/* visit each node, and change name if needed */
@@ -239,7 +299,7 @@ void process_tree(struct rooted_tree *tree, struct hash *rename_map,
 		struct rnode *current = (struct rnode *) elem->data;
 		if (params.only_leaves && ! is_leaf(current)) { continue; }
 		char *label = current->label;
-		char *new_label = hash_get(rename_map, label);
+		const char *new_label = new_label_for(rename_map, label);
 		if (NULL != new_label) {
 			current->label = strdup(new_label);
 			free(label);
@@ -249,10 +309,97 @@ void process_tree(struct rooted_tree *tree, struct hash *rename_map,
 	dump_newick(tree->root);
 }
 
+/* Frees the values, then the hash itself */
+
+static void destroy_map(struct hash *map)
+{
+	struct llist *keys = hash_keys(map);
+	if (NULL == keys) { perror(NULL); exit(EXIT_FAILURE); }
+	struct list_elem *e;
+	for (e = keys->head; NULL != e; e = e->next) {
+		char *key = (char *) e->data;
+		char *val = hash_get(map, key);
+		free(val);
+	}
+	destroy_llist(keys);
+	destroy_hash(map);
+}
+
+/* Composes the maps into 'map', so that a single lookup gives the final
+ * label. A label that is already renamed by 'map' gets its new label renamed
+ * by 'next'; a label that is not yet renamed is renamed by 'next' only. */
+
+static void compose_map(struct hash *map, struct hash *next)
+{
+	struct list_elem *e;
+
+	struct llist *keys = hash_keys(map);
+	if (NULL == keys) { perror(NULL); exit(EXIT_FAILURE); }
+	for (e = keys->head; NULL != e; e = e->next) {
+		char *val = hash_get(map, e->data);
+		char *next_val = hash_get(next, val);
+		if (NULL != next_val) {
+			char *new_val = strdup(next_val);
+			if (NULL == new_val ||
+			    ! hash_set(map, e->data, new_val)) {
+				perror(NULL);
+				exit(EXIT_FAILURE);
+			}
+			free(val);
+		}
+	}
+	destroy_llist(keys);
+
+	struct llist *next_keys = hash_keys(next);
+	if (NULL == next_keys) { perror(NULL); exit(EXIT_FAILURE); }
+	for (e = next_keys->head; NULL != e; e = e->next) {
+		if (NULL != hash_get(map, e->data)) continue;
+		char *new_val = strdup(hash_get(next, e->data));
+		if (NULL == new_val || ! hash_set(map, e->data, new_val)) {
+			perror(NULL);
+			exit(EXIT_FAILURE);
+		}
+	}
+	destroy_llist(next_keys);
+}
+
+static bool add_pair(const char *key, const char *value, void *map)
+{
+	char *val = strdup(value);
+	return NULL != val && hash_set(map, key, val);
+}
+
+/* Reads a map like read_map(), but from its index (see option -i), which is
+ * faster than parsing the map. */
+
+static struct hash *read_map_index(const char *filename)
+{
+	struct map_index *index = open_map_index(filename);
+	if (NULL == index) { perror(filename); exit(EXIT_FAILURE); }
+	struct hash *map = create_hash(map_index_count(index) + 1);
+	if (NULL == map) { perror(NULL); exit(EXIT_FAILURE); }
+	if (! map_index_foreach(index, add_pair, map)) {
+		perror(NULL);
+		exit(EXIT_FAILURE);
+	}
+	close_map_index(index);
+	return map;
+}
+
 struct hash *set_map(struct parameters params)
 {
-	if (NULL != params.map_filename)
-		return read_map(params.map_filename);
+	struct hash *(*read_one)(const char *) = params.use_index ?
+		read_map_index : read_map;
+	struct list_elem *el = params.map_filenames->head;
+	if (NULL != el) {
+		struct hash *map = read_one(el->data);
+		for (el = el->next; NULL != el; el = el->next) {
+			struct hash *next = read_one(el->data);
+			compose_map(map, next);
+			destroy_map(next);
+		}
+		return map;
+	}
 
 	struct hash *map = create_hash(1);
 	if (NULL == map) { perror(NULL); exit(EXIT_FAILURE); }
@@ -268,29 +415,39 @@ struct hash *set_map(struct parameters params)
 int main(int argc, char *argv[])
 {
 	struct rooted_tree *tree;	
-	struct hash *rename_map;
+	struct rename_map rename_map;
 	struct parameters params;
 	
 	params = get_params(argc, argv);
 
-	rename_map = set_map(params);
+	rename_map.hash = NULL;
+	rename_map.index = NULL;
+	/* A single map is looked up in its index directly, so it need not be
+	 * read at all. Several maps are composed into one hash (see
+	 * set_map()). */
+	if (params.use_index && 1 == params.map_filenames->count) {
+		char *map_filename = params.map_filenames->head->data;
+		rename_map.index = open_map_index(map_filename);
+		if (NULL == rename_map.index) {
+			perror(map_filename);
+			exit(EXIT_FAILURE);
+		}
+	} else {
+		rename_map.hash = set_map(params);
+	}
 
 	while (NULL != (tree = parse_tree())) {
-		process_tree(tree, rename_map, params);
+		process_tree(tree, &rename_map, params);
 		destroy_all_rnodes(NULL);
 		destroy_tree(tree);
 	}
 
-	struct llist *keys = hash_keys(rename_map);
-	if (NULL == keys) { perror(NULL); exit(EXIT_FAILURE); }
-	struct list_elem *e;
-	for (e = keys->head; NULL != e; e = e->next) {
-		char *key = (char *) e->data;
-		char *val = hash_get(rename_map, key);
-		free(val);
+	if (NULL != rename_map.index) {
+		close_map_index(rename_map.index);
+	} else {
+		destroy_map(rename_map.hash);
 	}
-	destroy_llist(keys);
-	destroy_hash(rename_map);
+	destroy_llist(params.map_filenames);
 
 	return 0;
 }
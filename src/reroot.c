@@ -46,7 +46,9 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "common.h"
 #include "link.h"
 
-enum reroot_status { REROOT_OK, LCA_IS_TREE_ROOT, NOT_PHYLOGRAM };
+enum reroot_status { REROOT_OK, LCA_IS_TREE_ROOT, NOT_PHYLOGRAM,
+	ALREADY_ROOTED };
+enum reroot_method { OUTGROUP, MIDPOINT, MIN_VARIANCE };
 enum deroot_status { DEROOT_OK, BALANCED, NOT_BIFURCATING, MEM_PROB };
 
 struct parameters {
@@ -54,6 +56,7 @@ struct parameters {
 	bool try_ingroup;
 	bool deroot;
 	bool i_node_lbl_as_support;	/* Treat inner node labels as support values */
+	enum reroot_method method;
 };
 
 void help(char *argv[])
@@ -64,7 +67,7 @@ void help(char *argv[])
 "Synopsis\n"
 "--------\n"
 "\n"
-"%s [-dhls] <newick trees filename|-> [label*]\n"
+"%s [-dhlmsv] <newick trees filename|-> [label*]\n"
 "\n"
 "Input\n"
 "-----\n"
@@ -100,6 +103,11 @@ void help(char *argv[])
 "        edges, and are treated differently from clade labels, which are\n"
 "        really properties of nodes. The \"Rerooting\" section of the manual\n"
 "        has more details.\n"
+"    -m: midpoint rooting - root the tree halfway along its longest\n"
+"        leaf-to-leaf path. Labels are ignored. The tree must be a phylogram.\n"
+"    -v: minimum variance rooting - root the tree at the point that\n"
+"        minimizes the variance of the root-to-leaf distances. Labels are\n"
+"        ignored. The tree must be a phylogram.\n"
 "\n"
 "Examples\n"
 "--------\n"
@@ -111,7 +119,12 @@ void help(char *argv[])
 "\n"
 "# We can reroot on more than one node:\n"
 "\n"
-"$ %s data/catarrhini_wrong_3og Cebus Aotus \n",
+"$ %s data/catarrhini_wrong_3og Cebus Aotus \n"
+"\n"
+"# No outgroup? Root on the midpoint:\n"
+"\n"
+"$ %s -m data/catarrhini_wrong\n",
+	argv[0],
 	argv[0],
 	argv[0],
 	argv[0]
@@ -126,9 +139,10 @@ struct parameters get_params(int argc, char *argv[])
 	params.try_ingroup = false;
 	params.deroot = false;
 	params.i_node_lbl_as_support = false;
+	params.method = OUTGROUP;
 
 	int opt_char;
-	while ((opt_char = getopt(argc, argv, "dhls")) != -1) {
+	while ((opt_char = getopt(argc, argv, "dhlmsv")) != -1) {
 		switch (opt_char) {
 		case '?':
 			// TODO what is this case for?
@@ -142,9 +156,15 @@ struct parameters get_params(int argc, char *argv[])
 		case 'l':
 			params.try_ingroup = true;
 			break;
+		case 'm':
+			params.method = MIDPOINT;
+			break;
 		case 's':
 			params.i_node_lbl_as_support = true;
 			break;
+		case 'v':
+			params.method = MIN_VARIANCE;
+			break;
 		default:
 			fprintf (stderr, "Unknown option '-%c'\n", opt_char);
 			exit (EXIT_FAILURE);
@@ -155,7 +175,7 @@ struct parameters get_params(int argc, char *argv[])
 	int nargs = argc - optind; /* non-option arguments */
 	if (nargs < 1) {
 		fprintf(stderr,
-			"Usage: %s [-dhl] <filename|->  [label+]\n",
+			"Usage: %s [-dhlmsv] <filename|->  [label+]\n",
 			argv[0]);
 		exit(EXIT_FAILURE);
 	}
@@ -199,9 +219,9 @@ struct rnode *node_with_longest_edge(struct rooted_tree *tree)
 	for (el = tree->nodes_in_order->head; NULL != el->next;
 			el = el->next) {
 		struct rnode *current = el->data;
-		if (strcmp(current->edge_length_as_string, "") == 0)
+		if (! has_edge_length(current))
 			return NULL;
-		double len = atof(current->edge_length_as_string);
+		double len = current->edge_length;
 		if (len > max) {
 			max = len;
 			result = current;
@@ -270,6 +290,278 @@ int reroot(struct rooted_tree *tree, struct llist *outgroup_nodes,
 	return REROOT_OK;
 }
 
+/* A point on the edge above 'node', at distance 'height' from it. */
+
+struct edge_point {
+	struct rnode *node;
+	double height;
+};
+
+/* Midpoint and minimum variance rooting work on the tree's nodes in postorder
+ * ('nodes', with the root last), numbered so that a node's rank is its index
+ * (see number_nodes()). Per-node values are kept in arrays indexed by rank.
+ * Both return NOT_PHYLOGRAM if some edge length is undefined. */
+
+static bool all_edges_have_length(struct rnode **nodes, int count)
+{
+	int i;
+	/* count - 1: the root's edge does not matter */
+	for (i = 0; i < count - 1; i++)
+		if (! has_edge_length(nodes[i]))
+			return false;
+	return true;
+}
+
+/* Finds the midpoint of the longest path between two leaves. One postorder
+ * pass finds the farthest leaf below each node, and thus the two farthest
+ * apart leaves (they are the farthest leaves below two children of the node
+ * where their path turns); a climb from the deeper of the two then finds the
+ * edge on which the midpoint lies. */
+
+static enum reroot_status midpoint(struct rnode **nodes, int count,
+		struct edge_point *point)
+{
+	if (! all_edges_have_length(nodes, count))
+		return NOT_PHYLOGRAM;
+
+	double *depth = malloc(count * sizeof(double));
+	if (NULL == depth) { perror(NULL); exit(EXIT_FAILURE); }
+	int *deepest_leaf = malloc(count * sizeof(int));
+	if (NULL == deepest_leaf) { perror(NULL); exit(EXIT_FAILURE); }
+
+	double diameter = -1;
+	int end = -1, i;
+	for (i = 0; i < count; i++) {
+		struct rnode *node = nodes[i];
+		if (is_leaf(node)) {
+			depth[i] = 0;
+			deepest_leaf[i] = i;
+			continue;
+		}
+		/* The two deepest paths through different children */
+		double first = -1, second = -1;
+		int first_leaf = -1;
+		struct rnode *kid;
+		for (kid = node->first_child; NULL != kid;
+				kid = kid->next_sibling) {
+			double d = depth[kid->rank] + kid->edge_length;
+			if (d > first) {
+				second = first;
+				first = d;
+				first_leaf = deepest_leaf[kid->rank];
+			} else if (d > second) {
+				second = d;
+			}
+		}
+		depth[i] = first;
+		deepest_leaf[i] = first_leaf;
+		if (second >= 0 && first + second > diameter) {
+			diameter = first + second;
+			end = first_leaf;
+		}
+	}
+	free(depth);
+	free(deepest_leaf);
+
+	if (end < 0) return ALREADY_ROOTED;	/* fewer than two leaves */
+
+	/* 'end' is at least half the diameter away from the turning node, so
+	 * we won't climb past it. */
+	double half = diameter / 2, climbed = 0;
+	struct rnode *node = nodes[end];
+	while (climbed + node->edge_length < half) {
+		climbed += node->edge_length;
+		node = node->parent;
+	}
+	point->node = node;
+	point->height = half - climbed;
+
+	return REROOT_OK;
+}
+
+/* Number of leaves, and sum and sum of squares of their distances, as seen
+ * from some node. */
+
+struct leaf_distances {
+	double count;
+	double sum;
+	double sum_sq;
+};
+
+/* The same leaves, seen from 'length' farther away. */
+
+static struct leaf_distances farther(struct leaf_distances d, double length)
+{
+	struct leaf_distances result = {
+		d.count,
+		d.sum + d.count * length,
+		d.sum_sq + 2 * length * d.sum + d.count * length * length
+	};
+	return result;
+}
+
+/* Finds the point that minimizes the variance of the root-to-leaf distances.
+ * A postorder pass gathers the distances to the leaves below each node, and a
+ * preorder pass those to the other leaves, each node's being derived from its
+ * parent's. On the edge above a node, the variance is then a quadratic
+ * function of the height, whose minimum is found directly. */
+
+static enum reroot_status min_variance(struct rnode **nodes, int count,
+		struct edge_point *point)
+{
+	if (! all_edges_have_length(nodes, count))
+		return NOT_PHYLOGRAM;
+
+	struct leaf_distances *below = malloc(count * sizeof(*below));
+	if (NULL == below) { perror(NULL); exit(EXIT_FAILURE); }
+	struct leaf_distances *above = malloc(count * sizeof(*above));
+	if (NULL == above) { perror(NULL); exit(EXIT_FAILURE); }
+
+	int i;
+	for (i = 0; i < count; i++) {
+		struct rnode *node = nodes[i];
+		struct leaf_distances d = { 0, 0, 0 };
+		if (is_leaf(node)) {
+			d.count = 1;
+		} else {
+			struct rnode *kid;
+			for (kid = node->first_child; NULL != kid;
+					kid = kid->next_sibling) {
+				struct leaf_distances k = farther(
+					below[kid->rank], kid->edge_length);
+				d.count += k.count;
+				d.sum += k.sum;
+				d.sum_sq += k.sum_sq;
+			}
+		}
+		below[i] = d;
+	}
+
+	struct leaf_distances none = { 0, 0, 0 };
+	above[count - 1] = none;
+	double n = below[count - 1].count;
+	double best_var = -1;
+	point->node = NULL;
+	/* Parents have higher ranks than their children */
+	for (i = count - 2; i >= 0; i--) {
+		struct rnode *node = nodes[i];
+		int parent = node->parent->rank;
+		double len = node->edge_length;
+		/* Leaves not below 'node', seen from its parent */
+		struct leaf_distances b = below[i];
+		struct leaf_distances k = farther(b, len);
+		struct leaf_distances o = {
+			above[parent].count + below[parent].count - k.count,
+			above[parent].sum + below[parent].sum - k.sum,
+			above[parent].sum_sq + below[parent].sum_sq - k.sum_sq
+		};
+		above[i] = farther(o, len);
+
+		/* At height x, the sum of distances is a0 + a1 x, and the sum of
+		 * their squares q0 + q1 x + n x^2. */
+		double a0 = b.sum + o.sum + o.count * len;
+		double a1 = b.count - o.count;
+		double q0 = b.sum_sq + o.sum_sq + 2 * len * o.sum
+			+ o.count * len * len;
+		double q1 = 2 * (b.sum - o.sum - o.count * len);
+		double c2 = 1 - (a1 * a1) / (n * n);
+		double c1 = q1 / n - 2 * a0 * a1 / (n * n);
+		double c0 = q0 / n - (a0 * a0) / (n * n);
+		double x;
+		if (c2 > 0)
+			x = - c1 / (2 * c2);
+		else
+			x = c1 > 0 ? 0 : len;
+		if (x < 0) x = 0;
+		if (x > len) x = len;
+		double var = c0 + c1 * x + c2 * x * x;
+		if (NULL == point->node || var < best_var) {
+			best_var = var;
+			point->node = node;
+			point->height = x;
+		}
+	}
+	free(below);
+	free(above);
+
+	if (NULL == point->node) return ALREADY_ROOTED;	/* single node */
+	return REROOT_OK;
+}
+
+/* Roots the tree at 'point', or returns ALREADY_ROOTED if it is the root. A
+ * point that falls on an inner node makes that node the root, rather than
+ * hanging it under a new root by a zero-length edge. */
+
+static enum reroot_status reroot_at_point(struct rooted_tree *tree,
+		struct edge_point point, bool i_node_lbl_as_support)
+{
+	struct rnode *node = point.node;
+	/* At the top of its edge, the point is on the parent */
+	while (! is_root(node) && point.height >= node->edge_length) {
+		node = node->parent;
+		point.height = 0;
+	}
+	if (is_root(node))
+		return ALREADY_ROOTED;
+
+	if (! reroot_tree(tree, node, i_node_lbl_as_support)) {
+		perror(NULL);
+		exit(EXIT_FAILURE);
+	}
+
+	/* reroot_tree() put the new root halfway along the edge (which is
+	 * longer if the old root was spliced out): move it. */
+	struct rnode *root = tree->root;
+	struct rnode *other = root->first_child == node ?
+		root->last_child : root->first_child;
+	double total = node->edge_length + other->edge_length;
+	if (! set_edge_length(node, point.height) ||
+	    ! set_edge_length(other, total - point.height)) {
+		perror(NULL);
+		exit(EXIT_FAILURE);
+	}
+
+	if (0 == point.height && ! is_leaf(node)) {
+		/* The new root takes the node's place (and name) */
+		if (! i_node_lbl_as_support) {
+			free(root->label);
+			root->label = node->label;
+			node->label = strdup("");
+			if (NULL == node->label) { perror(NULL); exit(EXIT_FAILURE); }
+		}
+		if (! splice_out_rnode(node)) { perror(NULL); exit(EXIT_FAILURE); }
+		destroy_llist(tree->nodes_in_order);
+		tree->nodes_in_order = get_nodes_in_order(tree->root);
+		if (NULL == tree->nodes_in_order) {
+			perror(NULL);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	return REROOT_OK;
+}
+
+/* Midpoint or minimum variance rooting */
+
+enum reroot_status reroot_without_outgroup(struct rooted_tree *tree,
+		enum reroot_method method, bool i_node_lbl_as_support)
+{
+	struct edge_point point;
+	int count;
+
+	number_nodes(tree->root);
+	struct rnode **nodes = get_nodes_in_order_array(tree->root, &count);
+	if (NULL == nodes) { perror(NULL); exit(EXIT_FAILURE); }
+	enum reroot_status result = MIDPOINT == method ?
+		midpoint(nodes, count, &point) :
+		min_variance(nodes, count, &point);
+	free(nodes);
+
+	if (REROOT_OK != result)
+		return result;
+	return reroot_at_point(tree, point, i_node_lbl_as_support);
+}
+
 /* De-roots a tree, in the sense that the top node must contain 3 (or more if
  * the tree isn't strictly bifurcating) children. */
 
@@ -280,10 +572,8 @@ enum deroot_status deroot(struct rooted_tree *tree)
 	struct rnode *left_kid = tree->root->first_child;
 	struct rnode *right_kid = tree->root->last_child;
 
-	struct llist *left_desc = get_nodes_in_order(left_kid);
-	if (NULL == left_desc) return MEM_PROB; 
-	struct llist *right_desc = get_nodes_in_order(right_kid);
-	if (NULL == right_desc) return MEM_PROB; 
+	int left_count = subtree_size(left_kid);
+	int right_count = subtree_size(right_kid);
 
 	/* We splice out the left or right kid of the root, and also free() it.
 	 * However, a simple splicing-out would result in incorrect branch
@@ -291,30 +581,23 @@ enum deroot_status deroot(struct rooted_tree *tree)
 	 * reason, we have to correct them.  */
 
 	struct rnode *ingroup = NULL, *outgroup = NULL;
-	char *ingroup_len = NULL, *outgroup_len = NULL;
 
-	if (left_desc->count < right_desc->count) {
+	if (left_count < right_count) {
 		ingroup = right_kid;
 		outgroup = left_kid;
 	}
-	else if (left_desc->count > right_desc->count) {
+	else if (left_count > right_count) {
 		ingroup = left_kid;
 		outgroup = right_kid;
 	}
 	else 
 		return BALANCED;
 
-	ingroup_len = ingroup->edge_length_as_string;
-	outgroup_len = outgroup->edge_length_as_string;
-
-	if ( (0 != strcmp("", ingroup_len)) &&
-	     (0 != strcmp("", outgroup_len)) ) {
-		char *og_new_len = add_len_strings(ingroup_len, outgroup_len); 
-		free(ingroup->edge_length_as_string);
-		ingroup->edge_length_as_string = strdup("0");
-		free(outgroup->edge_length_as_string);
-		outgroup->edge_length_as_string = strdup(og_new_len);
-		free(og_new_len);
+	if (has_edge_length(ingroup) && has_edge_length(outgroup)) {
+		if (! add_edge_length(outgroup, ingroup) ||
+		    ! set_edge_length_as_string(ingroup, "0")) {
+			perror(NULL); exit(EXIT_FAILURE);
+		}
 	}
 	if (! splice_out_rnode(ingroup)) {
 		perror(NULL); exit(EXIT_FAILURE);
@@ -393,6 +676,7 @@ void try_ingroup(struct rooted_tree *tree, struct parameters params)
 			params.i_node_lbl_as_support);
 	switch (result) {
 		case REROOT_OK:
+		case ALREADY_ROOTED:
 			dump_newick(tree->root);
 			break;
 		case LCA_IS_TREE_ROOT:
@@ -412,11 +696,17 @@ void process_tree(struct rooted_tree *tree, struct parameters params)
 {
 	struct llist *outgroup_nodes = get_outgroup_nodes(tree, params.labels);
 	if (! params.deroot) {
-		/* re-root according to outgroup nodes */
-		enum reroot_status result = reroot(tree, outgroup_nodes, 
-				params.i_node_lbl_as_support);
+		enum reroot_status result;
+		if (OUTGROUP == params.method)
+			/* re-root according to outgroup nodes */
+			result = reroot(tree, outgroup_nodes, 
+					params.i_node_lbl_as_support);
+		else
+			result = reroot_without_outgroup(tree, params.method,
+					params.i_node_lbl_as_support);
 		switch (result) {
 		case REROOT_OK:
+		case ALREADY_ROOTED:
 			dump_newick(tree->root);
 			break;
 		case LCA_IS_TREE_ROOT:
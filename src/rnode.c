@@ -38,6 +38,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "common.h"
 #include "list.h"
 #include "link.h"
+#include "masprintf.h"
 
 /* These variables are for keeping track of all allocated rnodes, so that we
  * can free them all (one call to free them all :-) */
@@ -51,6 +52,95 @@ static int rnode_count = 0;
 static int rnode_array_size = 0;	/* in number of nodes */
 static struct rnode** rnode_array = NULL;
 
+/* All undefined lengths share this string, which saves a strdup("") per node
+ * (that's most nodes in a cladogram). It must of course never be free()d, see
+ * free_edge_length_text(). */
+
+static char no_length[] = "";
+
+/* Exact powers of ten: 1e0 .. 1e22 are the only ones that a double can
+ * represent exactly. */
+
+static const double exact_powers_of_ten[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+/* Parses a length such as "12", "-0.035" or "1.5e-3". If the number has at
+ * most 15 significant digits and a decimal exponent of at most 22 (which is
+ * the case of practically every length found in a Newick file), its mantissa
+ * and the power of ten are both exactly representable as doubles, so a single
+ * multiplication or division gives the correctly rounded result (this is
+ * known as Clinger's fast path). Anything else (long mantissas, huge
+ * exponents, "inf", hex, trailing garbage...) goes through strtod(), so the
+ * result is always the same as strtod()'s - only faster. */
+
+static double parse_length(const char *s)
+{
+	const char *p = s;
+	bool negative = false;
+	unsigned long long mantissa = 0;
+	int nb_digits = 0;
+	int exponent = 0;
+
+	if ('-' == *p) { negative = true; p++; }
+	else if ('+' == *p) p++;
+
+	const char *digits_start = p;
+	for (; *p >= '0' && *p <= '9'; p++) {
+		if (0 == mantissa && '0' == *p) continue; /* leading zeros */
+		mantissa = 10 * mantissa + (*p - '0');
+		nb_digits++;
+		if (nb_digits > 15) goto slow_path;
+	}
+	bool had_int_part = p != digits_start;
+	if ('.' == *p) {
+		p++;
+		const char *frac_start = p;
+		for (; *p >= '0' && *p <= '9'; p++) {
+			mantissa = 10 * mantissa + (*p - '0');
+			if (0 != mantissa) nb_digits++;
+			if (nb_digits > 15) goto slow_path;
+			exponent--;
+		}
+		if (! had_int_part && p == frac_start) goto slow_path;
+	} else if (! had_int_part)
+		goto slow_path;
+	if ('e' == *p || 'E' == *p) {
+		p++;
+		bool neg_exp = false;
+		int exp_part = 0;
+		if ('-' == *p) { neg_exp = true; p++; }
+		else if ('+' == *p) p++;
+		if (*p < '0' || *p > '9') goto slow_path;
+		for (; *p >= '0' && *p <= '9'; p++) {
+			exp_part = 10 * exp_part + (*p - '0');
+			if (exp_part > 1000) goto slow_path;
+		}
+		exponent += neg_exp ? -exp_part : exp_part;
+	}
+	if ('\0' != *p) goto slow_path;
+	if (exponent < -22 || exponent > 22) goto slow_path;
+
+	double value = (double) mantissa;
+	if (exponent < 0)
+		value /= exact_powers_of_ten[-exponent];
+	else
+		value *= exact_powers_of_ten[exponent];
+	return negative ? -value : value;
+
+slow_path:
+	return strtod(s, NULL);
+}
+
+/* Releases the node's length text, unless it is the shared empty string. */
+
+static void free_edge_length_text(struct rnode *node)
+{
+	if (no_length != node->edge_length_as_string)
+		free(node->edge_length_as_string);
+}
+
 struct rnode *create_rnode(char *label, char *length_as_string)
 {
 	struct rnode *node;
@@ -65,24 +155,29 @@ struct rnode *create_rnode(char *label, char *length_as_string)
 		length_as_string = "";
 	}
 	node->label = strdup(label);
-	node->edge_length_as_string = strdup(length_as_string);
+	node->edge_length_as_string = no_length;
+	node->edge_length = 0;
+	if ('\0' != *length_as_string)
+		if (! set_edge_length_as_string(node, length_as_string))
+			return NULL;
 	node->parent = NULL;
 	node->next_sibling = NULL;
+	node->prev_sibling = NULL;
 	node->first_child = NULL;
 	node->last_child = NULL;
 	node->child_count = 0;
 	node->data = NULL;
-	/* We must initialize to some numeric value, so we use -1 to mean
-	 * unknown/undetermined. Note that negative branch lengths can occur,
-	 * e.g. with neighbor-joining. The reference variable here is
-	 * length_as_string, which will be an empty string ("") if the length
-	 * is not defined (as in cladograms). */
-	node->edge_length = -1;	
 	/* These are used when iterating on the tree structure. See
 	 * rnode_iterator.c */
 	node->current_child = NULL;
 	node->seen = false;
 	node->linked = false;
+	/* Not numbered: an empty range, which contains no node */
+	node->rank = -1;
+	node->first_rank = 0;
+	node->first_leaf_rank = 0;
+	node->last_leaf_rank = -1;
+	node->order_link = NULL;
 
 #ifdef SHOW_RNODE_CREATE
 	fprintf(stderr, "creating rnode %p '%s'\n", node, node->label);
@@ -107,7 +202,7 @@ void destroy_rnode(struct rnode *node, void (*free_data)(void *))
 	fprintf (stderr, " freeing rnode %p '%s'\n", node, node->label);
 #endif
 	free(node->label);
-	free(node->edge_length_as_string);
+	free_edge_length_text(node);
 	/* if free_data is not NULL, we call it to free the node data (use this
 	 * when the data cannot just be free()d); otherwise we just free()
 	 * node->data  */
@@ -127,6 +222,11 @@ void destroy_all_rnodes(void (*free_data)(void *))
 	rnode_array = NULL;
 }
 
+void disown_all_rnodes()
+{
+	rnode_count = 0;
+}
+
 void show_all_rnodes()
 {
 	struct rnode **rnode_h;
@@ -135,6 +235,67 @@ void show_all_rnodes()
 	}
 }
 
+bool has_edge_length(struct rnode *node)
+{
+	return '\0' != node->edge_length_as_string[0];
+}
+
+int set_edge_length_as_string(struct rnode *node, const char *length_as_string)
+{
+	if (NULL == length_as_string || '\0' == *length_as_string) {
+		unset_edge_length(node);
+		return SUCCESS;
+	}
+	char *copy = strdup(length_as_string);
+	if (NULL == copy) return FAILURE;
+	adopt_edge_length_as_string(node, copy);
+	return SUCCESS;
+}
+
+void adopt_edge_length_as_string(struct rnode *node, char *length_as_string)
+{
+	free_edge_length_text(node);
+	if ('\0' == *length_as_string) {
+		free(length_as_string);
+		node->edge_length_as_string = no_length;
+		node->edge_length = 0;
+	} else {
+		node->edge_length_as_string = length_as_string;
+		node->edge_length = parse_length(length_as_string);
+	}
+}
+
+int set_edge_length(struct rnode *node, double length)
+{
+	char *length_as_string = masprintf("%g", length);
+	if (NULL == length_as_string) return FAILURE;
+	free_edge_length_text(node);
+	node->edge_length_as_string = length_as_string;
+	node->edge_length = length;
+	return SUCCESS;
+}
+
+void unset_edge_length(struct rnode *node)
+{
+	free_edge_length_text(node);
+	node->edge_length_as_string = no_length;
+	node->edge_length = 0;
+}
+
+int copy_edge_length(struct rnode *dest, struct rnode *src)
+{
+	if (! has_edge_length(src)) {
+		unset_edge_length(dest);
+		return SUCCESS;
+	}
+	char *copy = strdup(src->edge_length_as_string);
+	if (NULL == copy) return FAILURE;
+	free_edge_length_text(dest);
+	dest->edge_length_as_string = copy;
+	dest->edge_length = src->edge_length;
+	return SUCCESS;
+}
+
 inline int children_count(struct rnode *node)
 {
 	return node->child_count;
@@ -220,59 +381,121 @@ struct rnode** children_array(struct rnode *node)
 	return array;
 }
 
-/* Computes the list by doing a tree traversal, then reversing it. */
-
 struct llist *get_nodes_in_order(struct rnode *root)
 {
-	struct rnode_iterator *it = create_rnode_iterator(root);
-	if (NULL == it) return NULL;
+	struct rnode_traversal *trav = create_rnode_traversal(root,
+			TRAVERSAL_POSTORDER);
+	if (NULL == trav) return NULL;
+	struct llist *nodes_in_order = create_llist();
+	if (NULL == nodes_in_order) {
+		destroy_rnode_traversal(trav);
+		return NULL;
+	}
 	struct rnode *current;
-	struct llist *traversal = create_llist();
-	if (NULL == traversal) return NULL;
-	struct llist *reverse_traversal;
-	struct llist *nodes_in_reverse_order = create_llist();
-	if (NULL == nodes_in_reverse_order) return NULL;
-	struct llist *nodes_in_order;
-
-	/* Iterates over the whole tree - note that a node is visited more than
-	 * once, except leaves. */
-	while ((current = rnode_iterator_next(it)) != NULL) {
-		current->seen = 0;
-		if (! append_element (traversal, current)) return NULL;
+
+	while ((current = rnode_traversal_next(trav)) != NULL)
+		if (! append_element(nodes_in_order, current)) break;
+	/* either append_element() or the traversal ran out of memory */
+	if (NULL != current || rnode_traversal_failed(trav)) {
+		destroy_llist(nodes_in_order);
+		destroy_rnode_traversal(trav);
+		return NULL;
 	}
+	destroy_rnode_traversal(trav);
+
+	return nodes_in_order;
+}
+
+/* Returns the first node of the subtree rooted at 'node' in postorder, i.e. its
+ * leftmost leaf. */
+
+static struct rnode *leftmost_leaf(struct rnode *node)
+{
+	while (! is_leaf(node)) node = node->first_child;
+	return node;
+}
+
+struct rnode *postorder_first(struct rnode *root)
+{
+	return leftmost_leaf(root);
+}
+
+/* The parent pointers tell us where to go next, so we need neither a stack nor
+ * the 'seen' flags. A node's successor in postorder is its parent if it is the
+ * last child, otherwise the leftmost leaf of its next sibling. */
+
+struct rnode *postorder_next(struct rnode *node, struct rnode *root)
+{
+	if (node == root) return NULL;
+	struct rnode *parent = node->parent;
+	if (node == parent->last_child)
+		return parent;
+	return leftmost_leaf(node->next_sibling);
+}
 
-	destroy_rnode_iterator(it);
-
-	reverse_traversal = llist_reverse(traversal);
-	if (NULL == reverse_traversal) return NULL;
-	destroy_llist(traversal);
-
-	/* This keeps only the first 'visit' through any node */
-	struct list_elem *el;
-	for (el = reverse_traversal->head; NULL != el; el = el->next) {
-		current = el->data;
-		/* Nodes will have been seen by the iterator above, hence they
-		 * start with a 'seen' value of 1. */
-		if (current->seen == 0) {
-			/* Not seen yet? add to list, and mark as seen (hash) */
-			if (! append_element
-					(nodes_in_reverse_order, current))
-				return NULL;
-			current->seen = 1;
+int subtree_size(struct rnode *root)
+{
+	struct rnode *current;
+	int n = 0;
+	for (current = postorder_first(root); NULL != current;
+			current = postorder_next(current, root))
+		n++;
+	return n;
+}
+
+struct rnode **get_nodes_in_order_array(struct rnode *root, int *count)
+{
+	/* The walk is cheap, so we do it twice rather than grow the array */
+	int size = subtree_size(root);
+	struct rnode **nodes = malloc(size * sizeof(struct rnode *));
+	if (NULL == nodes) return NULL;
+
+	struct rnode *current;
+	int n = 0;
+	for (current = postorder_first(root); NULL != current;
+			current = postorder_next(current, root))
+		nodes[n++] = current;
+
+	*count = n;
+	return nodes;
+}
+
+/* Same walk as get_nodes_in_order_array(). Children are numbered before
+ * their parent, so a parent's ranges are those of its first and last
+ * children, extended to itself. */
+
+void number_nodes(struct rnode *root)
+{
+	struct rnode *current;
+	int rank = 0, leaf_rank = 0;
+	for (current = postorder_first(root); NULL != current;
+			current = postorder_next(current, root)) {
+		current->rank = rank++;
+		if (is_leaf(current)) {
+			current->first_rank = current->rank;
+			current->first_leaf_rank = leaf_rank;
+			if ('\0' != current->label[0])
+				leaf_rank++;
+			current->last_leaf_rank = leaf_rank - 1;
+		} else {
+			current->first_rank = current->first_child->first_rank;
+			current->first_leaf_rank =
+				current->first_child->first_leaf_rank;
+			current->last_leaf_rank =
+				current->last_child->last_leaf_rank;
 		}
 	}
+}
 
-	destroy_llist(reverse_traversal);
-	nodes_in_order = llist_reverse(nodes_in_reverse_order);
-	if (NULL == nodes_in_order) return NULL;
-	destroy_llist(nodes_in_reverse_order);
+bool is_in_subtree(struct rnode *node, struct rnode *ancestor)
+{
+	return ancestor->first_rank <= node->rank &&
+		node->rank <= ancestor->rank;
+}
 
-	/* remove the 'seen' marks */
-	for (el = nodes_in_order->head; NULL != el; el = el->next) {
-		current = el->data;
-		current->seen = 0;
-	}
-	return nodes_in_order;
+int labeled_leaf_count(struct rnode *node)
+{
+	return node->last_leaf_rank - node->first_leaf_rank + 1;
 }
 
 /* One could get this one by passing a constantly true predicate to
@@ -280,9 +503,9 @@ struct llist *get_nodes_in_order(struct rnode *root)
 
 struct rnode *clone_rnode(struct rnode *target)
 {
-	struct rnode *result = create_rnode(target->label,
-			target->edge_length_as_string);
+	struct rnode *result = create_rnode(target->label, NULL);
 	if (NULL == result) return NULL;
+	if (! copy_edge_length(result, target)) return NULL;
 	struct rnode *kid = target->first_child;
 	for (; NULL != kid; kid = kid->next_sibling) {
 		struct rnode *kid_clone = clone_rnode(kid);
@@ -296,9 +519,9 @@ struct rnode *clone_rnode(struct rnode *target)
 struct rnode *clone_rnode_cond(struct rnode *target,
 		bool (*predicate)(struct rnode *, void *param), void *param)
 {
-	struct rnode *result = create_rnode(target->label,
-			target->edge_length_as_string);
+	struct rnode *result = create_rnode(target->label, NULL);
 	if (NULL == result) return NULL;
+	if (! copy_edge_length(result, target)) return NULL;
 
 	struct rnode *kid = target->first_child;
 	for (; NULL != kid; kid = kid->next_sibling) {
@@ -312,12 +535,8 @@ struct rnode *clone_rnode_cond(struct rnode *target,
 	if (1 == children_count(result) &&
 	    1 != children_count(target))
 	{
-		char *new_edge_len_s = add_len_strings(
-			result->first_child->edge_length_as_string,
-			result->edge_length_as_string);
-		if (NULL == new_edge_len_s) return NULL;
-		free(result->first_child->edge_length_as_string);
-		result->first_child->edge_length_as_string = new_edge_len_s;
+		if (! add_edge_length(result->first_child, result))
+			return NULL;
 		return result->first_child;
 	}
 
@@ -32,6 +32,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 struct rnode;
 struct hash;
+struct list_elem;
 
 /** A node in a rooted tree. One of the basic building blocks of the whole
  * package. */
@@ -39,14 +40,20 @@ struct hash;
 struct rnode {
 
 	char *label;	/**< The node's label. May be "", but is never NULL. */
-	/** The length of edge that leads to the parent (if any). Its value is
-	 * numeric, and it can be zero or even negative (NJ trees), it can also
-	 * be undefined (cladograms).  Therefore we store it as a string, with
-	 * "" indicating an undefined length. This is how Newick does it
-	 * anyway. */
+	/** The length of edge that leads to the parent (if any), as it was
+	 * found in the Newick input. Its value is numeric, and it can be zero
+	 * or even negative (NJ trees), it can also be undefined (cladograms),
+	 * in which case this is "". We keep the original text so that lengths
+	 * are output exactly as they were input (e.g. "0.10" stays "0.10").
+	 * Do not assign this member directly: use set_edge_length() and
+	 * friends (below), which keep it in sync with 'edge_length'. When the
+	 * value is changed, the original text is dropped and replaced by the
+	 * new value, formatted with "%g". */
 	char *edge_length_as_string;	
-	/** Used when we need the numerical value of the length
-	 * (which is not very frequent, but does happen). */
+	/** The numerical value of the length. It is parsed once, when the
+	 * length is set, so there is no need to call atof() on
+	 * 'edge_length_as_string'. It is 0 if the length is undefined - use
+	 * has_edge_length() to tell an undefined length from a zero one. */
 	double edge_length;
 	/** App-specific data. Any application-specific data (height, depth,
 	 * etc) can be put into a structure which is pointed to by this
@@ -56,6 +63,10 @@ struct rnode {
 	struct rnode *parent;		/**< NULL iff root */
 	/** NULL in leaves and root , normally not NULL otherwise */
 	struct rnode *next_sibling;	
+	/** NULL for the first child (and the root). This makes it possible
+	 * to unlink a node without scanning its siblings, which matters for
+	 * large polytomies. Maintained by link.c, don't set it directly. */
+	struct rnode *prev_sibling;
 	int child_count;		/**< 0 iff leaf */
 	struct rnode *first_child;	/**< NULL iff leaf */
 	struct rnode *last_child;	/**< NULL iff leaf */
@@ -66,6 +77,24 @@ struct rnode {
 	bool seen;	// TODO: rename to 'marked' (more multi-purpose)'
 	bool linked;
 
+	/** Set by number_nodes(), and only valid until the tree is next
+	 * modified. Nodes are ranked in postorder, so the nodes of a subtree
+	 * have consecutive ranks, from 'first_rank' (its leftmost leaf's) to
+	 * 'rank' (its root's). Labeled leaves are also ranked among
+	 * themselves, and those of a subtree range from 'first_leaf_rank' to
+	 * 'last_leaf_rank' (an empty range if there are none). */
+	int rank;
+	int first_rank;
+	int first_leaf_rank;
+	int last_leaf_rank;
+
+	/** Set by track_nodes_in_order() (see tree.h): the link that points to
+	 * this node's element in its tree's 'nodes_in_order', i.e. the
+	 * previous element's 'next' member, or the list's 'head'. This lets
+	 * the list be edited around the node in constant time. NULL if the
+	 * node is not tracked. */
+	struct list_elem **order_link;
+
 };
 
 /* allocates a rnode and returns a pointer to it, or exits. If 'label' is NULL
@@ -76,6 +105,39 @@ struct rnode {
 
 struct rnode *create_rnode(char *label, char *length_as_string);
 
+/* Returns true IFF the node's parent edge has a length (as opposed to the
+ * undefined lengths of cladograms). */
+
+bool has_edge_length(struct rnode *node);
+
+/* Sets the node's edge length from its textual form (e.g. "1.5e-3"), which is
+ * parsed right away (see member 'edge_length'). The text is copied and kept
+ * for output. An empty string (or NULL) makes the length undefined. */
+/* Returns FAILURE iff there is a malloc() problem. */
+
+int set_edge_length_as_string(struct rnode *node, const char *length_as_string);
+
+/* Like set_edge_length_as_string(), but 'length_as_string' (which must have
+ * been malloc()ed) is not copied: the node takes ownership of it. This is used
+ * by the parser, which already has its own copy of each length token. */
+
+void adopt_edge_length_as_string(struct rnode *node, char *length_as_string);
+
+/* Sets the node's edge length to 'length'. The original text (if any) is
+ * dropped, and replaced by 'length' formatted with "%g". */
+/* Returns FAILURE iff there is a malloc() problem. */
+
+int set_edge_length(struct rnode *node, double length);
+
+/* Makes the node's edge length undefined. */
+
+void unset_edge_length(struct rnode *node);
+
+/* Copies 'src''s edge length (both value and text) to 'dest'. */
+/* Returns FAILURE iff there is a malloc() problem. */
+
+int copy_edge_length(struct rnode *dest, struct rnode *src);
+
 /* Frees all rnode structures allocated so far. Use this after processing a
  * tree. */
 // NOTE: for some reason it seems to make no difference whether or not this f()
@@ -84,6 +146,19 @@ struct rnode *create_rnode(char *label, char *length_as_string);
 
 void destroy_all_rnodes();
 
+/* Frees a single rnode (and its data, using 'free_data' if not NULL, else
+ * free()). The rnode must not be in rnode_array (see disown_all_rnodes()),
+ * or destroy_all_rnodes() will free it again. */
+
+void destroy_rnode(struct rnode *node, void (*free_data)(void *));
+
+/* Empties rnode_array, without freeing the rnodes allocated so far: the caller
+ * becomes responsible for freeing them, e.g. with destroy_rnode(). This allows
+ * trees to be freed individually, e.g. when several trees are processed at
+ * the same time. */
+
+void disown_all_rnodes();
+
 /* returns the number of children a node has. */
 
 int children_count(struct rnode *node);
@@ -133,6 +208,45 @@ struct rnode** children_array(struct rnode *node);
 
 struct llist *get_nodes_in_order(struct rnode *);
 
+/* Like get_nodes_in_order(), but returns a newly allocated array instead of a
+ * list, in a single pass and without further allocation. The number of nodes
+ * is stored in 'count'. The array must be free()d by the caller. */
+/* Returns NULL in case of malloc() problems. */
+
+struct rnode **get_nodes_in_order_array(struct rnode *root, int *count);
+
+/* Walk the subtree rooted at 'root' in postorder, without a stack or any
+ * allocation:
+ *
+ * for (n = postorder_first(root); NULL != n; n = postorder_next(n, root))
+ *
+ * postorder_next() only looks at the node's parent and next sibling, so the
+ * loop body may reorder the children of the current node. */
+
+struct rnode *postorder_first(struct rnode *root);
+struct rnode *postorder_next(struct rnode *node, struct rnode *root);
+
+/* Returns the number of nodes in the subtree rooted at 'root' (including
+ * 'root'), using the above walk. */
+
+int subtree_size(struct rnode *root);
+
+/* Numbers the nodes of the subtree rooted at 'root' (see 'rank' and friends in
+ * struct rnode). This is O(n) and needs no allocation; the functions below are
+ * then O(1). The numbering must be redone after the tree is modified. */
+
+void number_nodes(struct rnode *root);
+
+/* Returns true iff 'node' is 'ancestor' or one of its descendants. Both must
+ * have been numbered from the same root, or 'node' not at all. */
+
+bool is_in_subtree(struct rnode *node, struct rnode *ancestor);
+
+/* Returns the number of labeled leaves in the subtree rooted at 'node', which
+ * must have been numbered. */
+
+int labeled_leaf_count(struct rnode *node);
+
 /* CLones a node (and descendants). A new rnode structure is allocated for each
  * node in the target. */
 
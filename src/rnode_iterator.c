@@ -37,6 +37,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "list.h"
 #include "rnode.h"
 #include "tree.h"
+#include "common.h"
 
 /* Some debugging macros. Compile with -DDEBUG_ITERATOR and the addresses and
  * labels of the next nodes (as returned by rnode_iterator_next()) will be
@@ -214,3 +215,139 @@ struct rnode *rnode_iterator_next_sibling(struct rnode_iterator *iter)
 	SHOW;
 	return iter->current;
 }
+
+/* The reentrant traversal. Each stack frame holds a node, and the next of its
+ * children to visit. */
+
+static const int TRAVERSAL_INIT_STACK_SIZE = 64;
+
+struct traversal_frame
+{
+	struct rnode *node;
+	struct rnode *next_child;	/**< NULL when all have been visited */
+	int visit_index;		/**< number of children visited */
+	bool entered;			/**< node was visited at least once */
+};
+
+struct rnode_traversal
+{
+	enum traversal_order order;
+	struct traversal_frame *stack;
+	int stack_size;			/**< allocated frames */
+	int top;			/**< index of top frame, -1 if empty */
+	int visit_index;		/**< see rnode_traversal_visit_index() */
+	int depth;			/**< see rnode_traversal_depth() */
+	bool failed;
+};
+
+static int traversal_push(struct rnode_traversal *trav, struct rnode *node)
+{
+	if (trav->top + 1 == trav->stack_size) {
+		int new_size = 2 * trav->stack_size;
+		struct traversal_frame *new_stack = realloc(trav->stack,
+				new_size * sizeof(struct traversal_frame));
+		if (NULL == new_stack) return FAILURE;
+		trav->stack = new_stack;
+		trav->stack_size = new_size;
+	}
+	struct traversal_frame *frame = &(trav->stack[++trav->top]);
+	frame->node = node;
+	frame->next_child = node->first_child;
+	frame->visit_index = 0;
+	frame->entered = false;
+
+	return SUCCESS;
+}
+
+struct rnode_traversal *create_rnode_traversal(struct rnode *root,
+		enum traversal_order order)
+{
+	struct rnode_traversal *trav = malloc(sizeof(struct rnode_traversal));
+	if (NULL == trav) return NULL;
+	trav->stack = malloc(TRAVERSAL_INIT_STACK_SIZE *
+			sizeof(struct traversal_frame));
+	if (NULL == trav->stack) { free(trav); return NULL; }
+	trav->stack_size = TRAVERSAL_INIT_STACK_SIZE;
+	trav->order = order;
+	trav->top = -1;
+	trav->visit_index = 0;
+	trav->depth = 0;
+	trav->failed = false;
+	traversal_push(trav, root);	/* can't fail: stack is empty */
+
+	return trav;
+}
+
+struct rnode *rnode_traversal_next(struct rnode_traversal *trav)
+{
+	while (trav->top >= 0) {
+		struct traversal_frame *frame = &(trav->stack[trav->top]);
+
+		/* First visit: that's all we need in preorder */
+		if (! frame->entered) {
+			frame->entered = true;
+			if (TRAVERSAL_POSTORDER != trav->order) {
+				trav->visit_index = 0;
+				trav->depth = trav->top;
+				return frame->node;
+			}
+		}
+
+		/* Descend into next child, if any */
+		if (NULL != frame->next_child) {
+			/* NOTE: we stop at the last child rather than at a NULL
+			 * next_sibling, since add_child() doesn't reset it. */
+			struct rnode *child = frame->next_child;
+			if (child == frame->node->last_child)
+				frame->next_child = NULL;
+			else
+				frame->next_child = child->next_sibling;
+			if (! traversal_push(trav, child)) {
+				trav->failed = true;
+				return NULL;
+			}
+			continue;
+		}
+
+		/* All children visited: we're done with this node. */
+		struct rnode *node = frame->node;
+		trav->top--;
+		if (TRAVERSAL_POSTORDER == trav->order) {
+			trav->visit_index = node->child_count;
+			trav->depth = trav->top + 1;
+			return node;
+		}
+		/* In an Euler tour, we now visit the parent again. */
+		if (TRAVERSAL_EULER == trav->order && trav->top >= 0) {
+			struct traversal_frame *parent_frame =
+				&(trav->stack[trav->top]);
+			parent_frame->visit_index++;
+			trav->visit_index = parent_frame->visit_index;
+			trav->depth = trav->top;
+			return parent_frame->node;
+		}
+	}
+
+	return NULL;
+}
+
+int rnode_traversal_visit_index(struct rnode_traversal *trav)
+{
+	return trav->visit_index;
+}
+
+int rnode_traversal_depth(struct rnode_traversal *trav)
+{
+	return trav->depth;
+}
+
+bool rnode_traversal_failed(struct rnode_traversal *trav)
+{
+	return trav->failed;
+}
+
+void destroy_rnode_traversal(struct rnode_traversal *trav)
+{
+	free(trav->stack);
+	free(trav);
+}
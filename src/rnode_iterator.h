@@ -56,6 +56,14 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  * and it is much faster (the first version of rnode_iterator kept track of
  * seen nodes with a hash table, and it was significantly slower. */
 
+/* The rnode_traversal (see second half of this file) does not have this
+ * limitation: it keeps its cursor on a stack of its own, outside the nodes, so
+ * the tree is strictly read-only during traversal. Any number of traversals
+ * can thus run on the same tree at the same time, be they nested (e.g., a
+ * traversal of each node's subtree within a traversal of the whole tree) or
+ * in different threads. New code should use it rather than the rnode_iterator.
+ * */
+
 #include <stdbool.h>
 
 struct rnode;
@@ -98,3 +106,51 @@ bool more_children_to_visit (struct rnode_iterator *);
  * state. */
 
 struct rnode *rnode_iterator_next_sibling(struct rnode_iterator *iter);
+
+/* Traversal orders for rnode_traversal. In an Euler tour, a node is visited
+ * once before its first child, once after each of its children (so a leaf is
+ * visited just once, and an inner node with n children n+1 times). This is
+ * what it takes to e.g. write Newick: '(' on the first visit, ',' between
+ * children, and ')' on the last. */
+
+enum traversal_order {
+	TRAVERSAL_PREORDER,	/* nodes come before their descendants */
+	TRAVERSAL_POSTORDER,	/* nodes come after their descendants */
+	TRAVERSAL_EULER		/* see above */
+};
+
+struct rnode_traversal;
+
+/* Creates a traversal of the subtree rooted at 'root', in the specified
+ * order. The stack is preallocated (and grows if the tree is deeper than
+ * expected). */
+/* Returns NULL in case of malloc() problems. */
+
+struct rnode_traversal *create_rnode_traversal(struct rnode *root,
+		enum traversal_order order);
+
+/* Gets the next node, or NULL when the traversal is over (or in case of a
+ * malloc() problem when growing the stack - see rnode_traversal_failed()). */
+
+struct rnode *rnode_traversal_next(struct rnode_traversal *);
+
+/* Returns the number of children of the last node returned by
+ * rnode_traversal_next() that have been completely visited, i.e. 0 on the
+ * first visit of a node in an Euler tour, and the node's number of children on
+ * its last visit. In pre- and postorder this is respectively always 0 and
+ * always the number of children. */
+
+int rnode_traversal_visit_index(struct rnode_traversal *);
+
+/* Returns the depth (in number of edges, from the traversal's root) of the
+ * last node returned by rnode_traversal_next(). */
+
+int rnode_traversal_depth(struct rnode_traversal *);
+
+/* Returns true IFF the traversal stopped because of a malloc() problem. */
+
+bool rnode_traversal_failed(struct rnode_traversal *);
+
+/* Destroys a traversal. The tree is of course left untouched. */
+
+void destroy_rnode_traversal(struct rnode_traversal *);
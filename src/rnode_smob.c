@@ -12,6 +12,13 @@
 
 static scm_t_bits rnode_tag;
 
+/* SMOBs of the current tree's nodes, indexed by rank (#f: not yet created),
+ * see rnode_smob_cache_nodes(). The vector is reused from tree to tree, and
+ * only grows; 'cached_count' is the number of nodes in the current tree. */
+
+static SCM smob_cache = SCM_BOOL_F;
+static int cached_count = 0;
+
 // As we don't store any SCM; we can pass NULL to scm_set_smob_mark(), etc
 // instead of defining these functions.
 
@@ -34,9 +41,35 @@ void init_scm_rnode()
 	scm_set_smob_free(rnode_tag, NULL);
 }
 
+void rnode_smob_cache_nodes(int node_count)
+{
+	if (node_count > 0 && (scm_is_false(smob_cache)
+		|| SCM_SIMPLE_VECTOR_LENGTH(smob_cache) < node_count)) {
+		if (scm_is_true(smob_cache))
+			scm_gc_unprotect_object(smob_cache);
+		smob_cache = scm_gc_protect_object(
+				scm_c_make_vector(node_count, SCM_BOOL_F));
+	} else if (node_count > 0) {
+		int i;
+		for (i = 0; i < node_count; i++)
+			SCM_SIMPLE_VECTOR_SET(smob_cache, i, SCM_BOOL_F);
+	}
+	cached_count = node_count;
+}
+
 SCM rnode_smob(struct rnode *node)
 {
 	SCM smob;
+
+	if (0 <= node->rank && node->rank < cached_count) {
+		smob = SCM_SIMPLE_VECTOR_REF(smob_cache, node->rank);
+		if (scm_is_false(smob)) {
+			SCM_NEWSMOB (smob, rnode_tag, node);
+			SCM_SIMPLE_VECTOR_SET(smob_cache, node->rank, smob);
+		}
+		return smob;
+	}
+
 	SCM_NEWSMOB (smob, rnode_tag, node);
 
 	return smob;
@@ -4,9 +4,16 @@ struct rnode;
 /* Initializes the SCM rnode SMOB */
 void init_scm_rnode();
 
-/* Creates an rnode SMOB. Argument is a pointer to a struct rnode. */
+/* Creates an rnode SMOB. Argument is a pointer to a struct rnode. If there
+ * is a cache (see below) and the node's rank is within it, the node's SMOB is
+ * created only once and then reused, so that (eq?) works on nodes. */
 SCM rnode_smob(struct rnode*);
 
+/* Starts caching SMOBs for nodes ranked 0 to 'node_count' - 1, replacing any
+ * cache for a previous tree. Call this for each tree, after ranking the
+ * nodes. Passing 0 stops caching. */
+void rnode_smob_cache_nodes(int node_count);
+
 /* Accessors */
 
 /* All the following f()s work as getters if the second argument is 
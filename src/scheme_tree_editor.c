@@ -62,6 +62,22 @@ struct rnode *current_node;
 
 enum order { POST_ORDER, PRE_ORDER };
 enum mult_values { MULT_UNSPECIFIED, MULT_SINGLE, MULT_MULTIPLE };
+/* see option -a */
+enum native_action { NO_NATIVE_ACTION, NATIVE_PRINT, NATIVE_UNLINK,
+	NATIVE_OPEN };
+
+/* The predefined variables. Their bindings are looked up once (see
+ * define_predefined_variables()), and only their values are set for each
+ * node. */
+
+enum predefined_variable { VAR_LABEL, VAR_NODE, VAR_SUPPORT, VAR_INNER,
+	VAR_LEAF, VAR_LENGTH, VAR_CHILDREN, VAR_DEPTH, VAR_ANCESTORS,
+	VAR_DESCENDANTS, VAR_ROOT, VAR_COUNT };
+
+static const char *predefined_variable_names[VAR_COUNT] = { "lbl", "N", "b",
+	"i", "l", "L", "c", "d", "a", "D", "r" };
+
+static SCM predefined_variables[VAR_COUNT];
 
 struct parameters {
 	bool scheme_on_CLI;	
@@ -73,6 +89,7 @@ struct parameters {
 	int order;
 	bool stop_clade_at_first_match;
 	bool single;
+	enum native_action native_action;
 };
 
 void help(char *argv[])
@@ -84,7 +101,7 @@ void help(char *argv[])
 "Synopsis\n"
 "--------\n"
 "\n"
-"%s [-hnor] <newick trees filename|-> <Scheme expression>\n"
+"%s [-hnor] [-a <action>] <newick trees filename|-> <Scheme expression>\n"
 "\n"
 "NOTE: this program is still very experimental and will probably change!\n"
 "\n"
@@ -204,6 +221,10 @@ void help(char *argv[])
 "Options\n"
 "-------\n"
 "\n"
+"    -a <s|u|o>: perform this action on matching nodes: print the subtree\n"
+"        (s), unlink the node (u), or open it (o), like the functions of the\n"
+"        same names, but without going through Scheme. The Scheme expression\n"
+"        is then just the selector, e.g. '(& i (< b 10))'.\n"
 "    -h: print this help text, and exit\n"
 "    -n: do not print the (possibly modified) tree at the end of the run \n"
 "        (modeled after sed -n)\n"
@@ -268,12 +289,26 @@ static struct parameters get_params(int argc, char *argv[])
 	params.order = POST_ORDER;
 	params.stop_clade_at_first_match = false;
 	params.single = true;
+	params.native_action = NO_NATIVE_ACTION;
 
 	enum mult_values mult = MULT_UNSPECIFIED;
 
 	int opt_char;
-	while ((opt_char = getopt(argc, argv, "f:hnm:or")) != -1) {
+	while ((opt_char = getopt(argc, argv, "a:f:hnm:or")) != -1) {
 		switch (opt_char) {
+		case 'a':
+			if (strcmp("s", optarg) == 0)
+				params.native_action = NATIVE_PRINT;
+			else if (strcmp("u", optarg) == 0)
+				params.native_action = NATIVE_UNLINK;
+			else if (strcmp("o", optarg) == 0)
+				params.native_action = NATIVE_OPEN;
+			else {
+				fprintf (stderr, "Unknown action '%s' (must "
+					"be one of s, u, or o)\n", optarg);
+				exit (EXIT_FAILURE);
+			}
+			break;
 		case 'f':
 			params.scheme_on_CLI = false;
 			params.scheme_test_list = optarg;
@@ -319,7 +354,7 @@ static struct parameters get_params(int argc, char *argv[])
 		if (2 == (argc - optind))
 			params.scheme_test_list = argv[optind+1];
 	} else {
-		fprintf(stderr, "Usage: %s [-hnro] <filename|-> "
+		fprintf(stderr, "Usage: %s [-hnro] [-a <action>] <filename|-> "
 				"<Scheme expression>\n",
 				argv[0]);
 		exit(EXIT_FAILURE);
@@ -341,6 +376,9 @@ static struct parameters get_params(int argc, char *argv[])
 	default:
 		assert(0);
 	}
+	/* with a native action, the Scheme code is just a selector */
+	if (NO_NATIVE_ACTION != params.native_action)
+		params.single = true;
 
 	return params;
 }
@@ -401,17 +439,13 @@ static void reverse_parse_order_traversal(struct rooted_tree *tree)
 		rndata->nb_ancestors = parent_data->nb_ancestors + 1;
 
 		if (parent_data->is_depth_defined) {
-			double edge_length;
-			char *endptr;
-			edge_length = strtod(node->edge_length_as_string,
-					&endptr);
-			if (endptr == node->edge_length_as_string) {
-				/* no conversion: depth is undefined */
+			if (! has_edge_length(node)) {
+				/* no length: depth is undefined */
 				rndata->is_depth_defined = false;
 			} else {
 				rndata->is_depth_defined = true; 
 				rndata->depth = parent_data->depth
-					+ edge_length;
+					+ node->edge_length;
 			}
 		} else {
 			/* We don't even set the value: it must not be used. */
@@ -443,77 +477,89 @@ static void parse_order_traversal(struct rooted_tree *tree)
 	}
 }
 
+/* Defines the predefined variables (i, l, a, etc), initially unbound, and
+ * keeps their bindings. */
+
+static void define_predefined_variables()
+{
+	int i;
+	for (i = 0; i < VAR_COUNT; i++)
+		predefined_variables[i] = scm_c_define(
+				predefined_variable_names[i], SCM_UNDEFINED);
+}
+
+static void set_variable(enum predefined_variable var, SCM value)
+{
+	scm_variable_set_x(predefined_variables[var], value);
+}
+
 /* Sets the value of the predefined variables (i, l, a, etc), according to the
  * node passed as argument. This is normally the current node, while visiting
  * the tree. Using variables rather than functions makes for shorter Scheme
  * expression can be shorter, because function calls can be replaced by
  * variables, e.g. (< 2 a) instead of (< 2 (a)) to check that the current node
- * has fewer than two ancestors. On the command line, this is handy. */
+ * has fewer than two ancestors. On the command line, this is handy. An
+ * undefined value (e.g. the length of an edge that has none) leaves the
+ * variable unbound. */
 
 static void set_predefined_variables(struct rnode *node)
 {
 	SCM label = scm_from_locale_string(node->label);
-	SCM edge_length_as_scm_string  = scm_from_locale_string(
-			node->edge_length_as_string);
-	scm_c_define("lbl", label);
+	set_variable(VAR_LABEL, label);
 
 	/* N: current node */
-	SCM node_smob = rnode_smob(node);
-	scm_c_define("N", node_smob);
+	set_variable(VAR_NODE, rnode_smob(node));
 
 	/* b: returns node label, as a bootstrap support value (or undefined if
 	this can't be done) */
 	if (is_leaf(node))
-		scm_c_define("b", SCM_UNDEFINED);
+		set_variable(VAR_SUPPORT, SCM_UNDEFINED);
 	else {
 		SCM support_value = scm_string_to_number(label, SCM_UNDEFINED);
 		if (SCM_BOOL_F == support_value)
-			scm_c_define("b", SCM_UNDEFINED);
+			set_variable(VAR_SUPPORT, SCM_UNDEFINED);
 		else
-			scm_c_define("b", support_value);
+			set_variable(VAR_SUPPORT, support_value);
 	}
 
 	/* i: true IFF node is inner (not leaf, not root) */
-	if (is_inner_node(node))
-		scm_c_define("i", SCM_BOOL_T);
-	else
-		scm_c_define("i", SCM_BOOL_F);
+	set_variable(VAR_INNER, scm_from_bool(is_inner_node(node)));
 
 	/* l: true IFF node is a leaf */
-	if (is_leaf(node))
-		scm_c_define("l", SCM_BOOL_T);
-	else
-		scm_c_define("l", SCM_BOOL_F);
+	set_variable(VAR_LEAF, scm_from_bool(is_leaf(node)));
 
-	/* L: parent edge's length */
-	if (strcmp ("", node->edge_length_as_string) == 0) 
-		scm_c_define("L", SCM_UNDEFINED);
-	else	
-		scm_c_define("L", scm_string_to_number(
-				edge_length_as_scm_string, SCM_UNDEFINED));
+	/* L: parent edge's length. It is read from the text, so that e.g. "16"
+	 * stays the exact integer 16 (as a double, (* 2 L) would print as
+	 * "32.0"). */
+	if (! has_edge_length(node)) 
+		set_variable(VAR_LENGTH, SCM_UNDEFINED);
+	else {
+		SCM length = scm_string_to_number(scm_from_locale_string(
+				node->edge_length_as_string), SCM_UNDEFINED);
+		if (scm_is_false(length))
+			length = scm_from_double(node->edge_length);
+		set_variable(VAR_LENGTH, length);
+	}
 
 	/* c: number of children */
-	scm_c_define("c", scm_from_int(current_node->child_count));
+	set_variable(VAR_CHILDREN, scm_from_int(node->child_count));
 	
-	struct rnode_data *data = current_node->data;
+	struct rnode_data *data = node->data;
 
 	/* d: depth */
 	if (data->is_depth_defined)
-		scm_c_define("d", scm_from_double(data->depth));
+		set_variable(VAR_DEPTH, scm_from_double(data->depth));
 	else
-		scm_c_define("d", SCM_UNDEFINED);
+		set_variable(VAR_DEPTH, SCM_UNDEFINED);
 
 	/* a: number of ancestors */
-	scm_c_define("a", scm_from_int(data->nb_ancestors));
+	set_variable(VAR_ANCESTORS, scm_from_int(data->nb_ancestors));
 
 	/* D: number of descendants */
-	scm_c_define("D", scm_from_int(data->nb_descendants));
+	set_variable(VAR_DESCENDANTS, scm_from_int(data->nb_descendants));
 
 	/* r: true iff node is root */
-	if (is_root(node))
-		scm_c_define("r", SCM_BOOL_T);
-	else
-		scm_c_define("r", SCM_BOOL_F);
+	set_variable(VAR_ROOT, scm_from_bool(is_root(node)));
 }
 
 /* Makes C functions available to Scheme */
@@ -601,8 +647,7 @@ static SCM scm_set_length(SCM edge_length)
 	 * set the node's edge length to "" (i.e., unspecified) */
 
 	if (SCM_UNDEFINED == edge_length) {
-		free(current_node->edge_length_as_string);
-		current_node->edge_length_as_string = strdup("");
+		unset_edge_length(current_node);
 		return SCM_UNSPECIFIED;
 	}
 
@@ -616,9 +661,8 @@ static SCM scm_set_length(SCM edge_length)
 	scm_to_locale_stringbuf(edge_length_as_scm_string, buffer, buffer_length);
 	buffer[buffer_length] = '\0';
 
-	/* Set the allocated buffer as the current node's length-as-string */
-	free(current_node->edge_length_as_string);
-	current_node->edge_length_as_string = buffer;
+	/* The current node takes over the allocated buffer */
+	adopt_edge_length_as_string(current_node, buffer);
 
 	return SCM_UNSPECIFIED;
 }
@@ -696,27 +740,59 @@ SCM get_test_list_for_phase(const char *phase, SCM code_phase__alist)
 			scm_from_locale_symbol(phase)));
 }
 
-/* Returns a Scheme function for evaluating a list of tests. A test is a
-(clause action) pair. Iff the clause is #t, the action gets evaluated. The
-function returns #t iff at least one test is #t. */
-
-static SCM define_test_list_eval()
+/* Returns a Scheme function for compiling a list of tests. A test is a
+ * (clause action) pair, and is compiled into a (clause-thunk . action-thunk)
+ * pair, i.e. procedures of no argument that evaluate the clause and action
+ * (they see the predefined variables, which are top-level). This is done once
+ * for the run, instead of having primitive-eval expand the clause and action
+ * again for every node. Code that contains top-level definitions, e.g.
+ * (define x 1), would become local to the thunk, so it is still passed to
+ * primitive-eval at each call. An action of #f yields no thunk (see option
+ * -a). */
+
+static SCM define_test_list_compiler()
 {
 	return scm_c_eval_string(
 "(lambda (lst)"
-"	(letrec ((eval-tests (lambda (L)"
-"		(if (null? L)"
-"      #f"
-"      (let* ((test (car L))"
-"             (clause (car test))"
-"             (action (cadr test)))"
-"        (if (primitive-eval clause)"
-"            (begin (primitive-eval action) (or (eval-tests (cdr L)) #t))"
-"            (or (eval-tests (cdr L)) #f )))))))"
-"	(eval-tests lst)))"
+"  (letrec ((defines? (lambda (expr)"
+"             (and (pair? expr)"
+"                  (or (eq? (car expr) 'define)"
+"                      (and (eq? (car expr) 'begin)"
+"                           (or-map defines? (cdr expr)))))))"
+"           (compile-thunk (lambda (expr)"
+"             (primitive-eval"
+"               (if (defines? expr)"
+"                   (list 'lambda '() (list 'primitive-eval (list 'quote expr)))"
+"                   (list 'lambda '() expr))))))"
+"    (map (lambda (test)"
+"           (cons (compile-thunk (car test))"
+"                 (and (cadr test) (compile-thunk (cadr test)))))"
+"         lst)))"
 	);
 }
 
+/* Evaluates a list of compiled tests (see define_test_list_compiler()) on the
+ * current node: for each test, iff the clause is true, the action (if any) is
+ * called. Returns true iff at least one clause is true. */
+
+static bool eval_tests(SCM compiled_tests)
+{
+	bool match = false;
+	SCM tests;
+
+	for (tests = compiled_tests; ! scm_is_null(tests);
+			tests = scm_cdr(tests)) {
+		SCM test = scm_car(tests);
+		if (scm_is_true(scm_call_0(scm_car(test)))) {
+			match = true;
+			if (scm_is_true(scm_cdr(test)))
+				scm_call_0(scm_cdr(test));
+		}
+	}
+
+	return match;
+}
+
 /* Evaluates "phase code", i.e. user-supplied Scheme code that must be run at a
  * particular moment in the run (start, start-tree, end-tree, or end).  'start'
  * is like BEGIN in awk, etc.  */
@@ -813,19 +889,44 @@ static SCM get_user_code(struct parameters params)
 
 
 
-/* 'test_list' is the Scheme list of tests (i.e., (clause action) pairs) and
- * 'test_list_eval' is the Scheme function that evaluates them. */
+/* Performs the action passed to -a on the current node. */
+
+static void run_native_action(enum native_action action)
+{
+	switch (action) {
+	case NATIVE_PRINT:
+		scm_dump_subclade();
+		break;
+	case NATIVE_UNLINK:
+		scm_unlink_node();
+		break;
+	case NATIVE_OPEN:
+		scm_splice_out_node();
+		break;
+	default:
+		assert(0);	/* programmer error */
+	}
+}
+
+/* 'compiled_tests' is the list of compiled tests (see
+ * define_test_list_compiler()). */
 
-static void process_tree(struct rooted_tree *tree, SCM test_list,
-		SCM test_list_eval, struct parameters params)
+static void process_tree(struct rooted_tree *tree, SCM compiled_tests,
+		struct parameters params)
 {
 	struct llist *nodes;
 	struct list_elem *el;
+	int rank = 0;
 
 	/* these two traversals fill the node data. */
 	reverse_parse_order_traversal(tree);
 	parse_order_traversal(tree);
 
+	/* rank the nodes, so that their SMOBs can be cached */
+	for (el = tree->nodes_in_order->head; NULL != el; el = el->next)
+		((struct rnode *) el->data)->rank = rank++;
+	rnode_smob_cache_nodes(rank);
+
 	if (POST_ORDER == params.order)
 		nodes = tree->nodes_in_order;
 	else if (PRE_ORDER == params.order) {
@@ -852,9 +953,11 @@ static void process_tree(struct rooted_tree *tree, SCM test_list,
 		} 
 
 		set_predefined_variables(current_node);
-		SCM is_match = scm_call_1(test_list_eval, test_list);
+		bool is_match = eval_tests(compiled_tests);
 
-		if (! scm_is_false(is_match)) {
+		if (is_match) {
+			if (NO_NATIVE_ACTION != params.native_action)
+				run_native_action(params.native_action);
 			/* see -o switch */
 			if (params.stop_clade_at_first_match)
 				((struct rnode_data *)
@@ -867,6 +970,9 @@ static void process_tree(struct rooted_tree *tree, SCM test_list,
 	 * need to free it. */
 	if (PRE_ORDER == params.order)
 		destroy_llist(nodes);
+
+	/* the nodes will be freed before the next tree */
+	rnode_smob_cache_nodes(0);
 }
 
 static void inner_main(void *closure, int argc, char* argv[])
@@ -879,11 +985,17 @@ static void inner_main(void *closure, int argc, char* argv[])
 	init_scm_rnode();
 
 	scheme_preamble();
+	define_predefined_variables();
 	
-	SCM test_list_eval = define_test_list_eval();
+	SCM test_list_compiler = define_test_list_compiler();
 	SCM partition_code = define_partition_code();
 
 	SCM user_code = get_user_code(params);
+	/* With a native action, the code is a selector: make it a test with
+	 * no action. */
+	if (NO_NATIVE_ACTION != params.native_action)
+		user_code = scm_list_1(scm_list_2(scm_car(user_code),
+					SCM_BOOL_F));
 	SCM code_phase_alist = scm_call_1(partition_code, user_code);
 	// scm_write_line(code_phase_alist, scm_current_output_port ());
 
@@ -893,11 +1005,13 @@ static void inner_main(void *closure, int argc, char* argv[])
 			scm_assq_ref(code_phase_alist, 
 				scm_from_locale_symbol("within-tree")));
 	// scm_write_line(within_tree_tests, scm_current_output_port ());
+	SCM compiled_tests = scm_call_1(test_list_compiler,
+			within_tree_tests);
 
 	run_phase_code(code_phase_alist, "start");
 	while (NULL != (tree = parse_tree())) {
 		run_phase_code(code_phase_alist, "start-tree");
-		process_tree(tree, within_tree_tests, test_list_eval, params);
+		process_tree(tree, compiled_tests, params);
 		if (params.show_tree) {
 			dump_newick(tree->root);
 		}
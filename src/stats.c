@@ -41,7 +41,45 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "rnode.h"
 #include "common.h"
 
-enum stats_output_format {STATS_OUTPUT_LINE, STATS_OUTPUT_COLUMN};
+enum stats_output_format {STATS_OUTPUT_LINE, STATS_OUTPUT_COLUMN,
+	STATS_OUTPUT_TSV, STATS_OUTPUT_JSON};
+
+/* The statistics that can be printed, in their default order (see -s). The
+ * first ones (up to STAT_INNER_LABELS) are printed by default. */
+
+enum statistic {
+	STAT_TYPE,
+	STAT_NODES,
+	STAT_LEAVES,
+	STAT_DICHOTOMIES,
+	STAT_LEAF_LABELS,
+	STAT_INNER_LABELS,
+	STAT_HEIGHT,
+	STAT_LENGTH,
+	STAT_COLLESS,
+	STAT_SACKIN,
+	STAT_CHERRIES,
+	STAT_RTT_MIN,
+	STAT_RTT_MAX,
+	STAT_RTT_MEAN,
+	STAT_MAX_DEGREE,
+	STAT_DUP_LABELS,
+	NB_STATISTICS
+};
+
+#define NB_DEFAULT_STATISTICS (STAT_INNER_LABELS + 1)
+
+/* names are for -s, TSV headers and JSON keys; labels are for columns */
+
+static const char *stat_names[] = { "type", "nodes", "leaves", "dichotomies",
+	"leaf_labels", "inner_labels", "height", "length", "colless",
+	"sackin", "cherries", "rtt_min", "rtt_max", "rtt_mean", "max_degree",
+	"dup_labels" };
+
+static const char *stat_labels[] = { "Type", "#nodes", "#leaves",
+	"#dichotomies", "#leaf labels", "#inner labels", "Height", "Length",
+	"Colless", "Sackin", "#cherries", "Min root-tip", "Max root-tip",
+	"Mean root-tip", "Max degree", "#dup labels" };
 
 struct tree_properties {
 	enum tree_type type;
@@ -50,14 +88,46 @@ struct tree_properties {
 	int num_dichotomies;
 	int num_leaf_labels;
 	int num_inner_labels;
+	int height;		/* in edges */
+	double length;		/* sum of edge lengths */
+	long colless;
+	long sackin;
+	int num_cherries;
+	double min_root_tip;
+	double max_root_tip;
+	double mean_root_tip;
+	int max_degree;
+	int num_dup_labels;	/* labels that occur more than once */
 };
 
 struct parameters {
 	enum stats_output_format output_format;
-	void (* output_function)(struct tree_properties *);
+	enum statistic statistics[NB_STATISTICS];
+	int nb_statistics;
+	bool need_subtree_stats;	/* height, Colless, root-tip, etc. */
+	bool need_dup_labels;
 	bool headers;
 };
 
+/* Per-subtree values, accumulated in postorder (see get_properties()). The
+ * root-tip values are distances from the subtree's root to its leaves. */
+
+struct subtree_stats {
+	int num_leaves;
+	int height;
+	double min_root_tip;
+	double max_root_tip;
+	double sum_root_tip;
+};
+
+/* Work space for get_properties(), kept from one tree to the next */
+
+struct buffers {
+	struct subtree_stats *subtrees;
+	char **labels;
+	int capacity;
+};
+
 static void help(char *argv[])
 {
 	printf (
@@ -66,7 +136,7 @@ static void help(char *argv[])
 "Synopsis\n"
 "--------\n"
 "\n"
-"%s [-hHf:] <newick trees filename|->\n"
+"%s [-hHf:s:] <newick trees filename|->\n"
 "\n"
 "Input\n"
 "-----\n"
@@ -88,18 +158,42 @@ static void help(char *argv[])
 "#leaf labels:	10\n"
 "#inner labels:	6\n"
 "\n"
+"Other statistics can be chosen with option -s. All are computed in a\n"
+"single pass over the tree. Their names are:\n"
+"\n"
+"    type, nodes, leaves, dichotomies, leaf_labels, inner_labels: as above\n"
+"    height: largest number of edges between the root and a leaf\n"
+"    length: sum of all edge lengths (except the root's)\n"
+"    colless: Colless index, i.e. sum of |L - R| over all dichotomies,\n"
+"        where L and R are the numbers of leaves in each child's subtree\n"
+"    sackin: Sackin index, i.e. sum of the leaves' depths (in edges)\n"
+"    cherries: number of inner nodes that have exactly two leaf children\n"
+"    rtt_min, rtt_max, rtt_mean: minimum, maximum and mean root-to-tip\n"
+"        distance (i.e., sum of edge lengths; undefined lengths count as 0)\n"
+"    max_degree: largest number of children of any node\n"
+"    dup_labels: number of labels that occur more than once\n"
+"\n"
 "Options\n"
 "-------\n"
 "\n"
 "    -h: print this message and exit\n"
-"    -f [lc]: format in lines (l) or columns (c). Default is l.\n"
+"    -f [lctj]: format in lines (l), columns (c), tab-separated values\n"
+"       with a header line (t) or JSON (j), one object per line.\n"
+"       Default is c.\n"
+"    -s <names>: print the statistics in the comma-separated list\n"
+"       <names>, in that order, or all of them if <names> is 'all'.\n"
 "\n"
 "Examples\n"
 "--------\n"
 "\n"
 "# default statistics:\n"
 "\n"
-"$ %s data/catarrhini.nw\n",
+"$ %s data/catarrhini.nw\n"
+"\n"
+"# tree shape indices of each tree in a file, as a table:\n"
+"\n"
+"$ %s -f t -s leaves,height,colless,sackin,cherries data/forest.nw\n",
+	argv[0],
 	argv[0],
 	argv[0]
 		);
@@ -120,52 +214,158 @@ static char *type_string(enum tree_type type)
 	return NULL; /* dummy, won't compile with -Wall otherwise */
 }
 
-static void print_line(struct tree_properties *props)
+static void print_value(struct tree_properties *props, enum statistic stat,
+		bool quote_strings)
 {
-	printf("%s\t%d\t%d\t%d\t%d\t%d\n",
-		type_string(props->type),
-		props->num_nodes,
-		props->num_leaves,
-		props->num_dichotomies,
-		props->num_leaf_labels,
-		props->num_inner_labels
-		);
+	switch (stat) {
+	case STAT_TYPE:
+		printf(quote_strings ? "\"%s\"" : "%s",
+				type_string(props->type));
+		break;
+	case STAT_NODES: printf("%d", props->num_nodes); break;
+	case STAT_LEAVES: printf("%d", props->num_leaves); break;
+	case STAT_DICHOTOMIES: printf("%d", props->num_dichotomies); break;
+	case STAT_LEAF_LABELS: printf("%d", props->num_leaf_labels); break;
+	case STAT_INNER_LABELS: printf("%d", props->num_inner_labels); break;
+	case STAT_HEIGHT: printf("%d", props->height); break;
+	case STAT_LENGTH: printf("%g", props->length); break;
+	case STAT_COLLESS: printf("%ld", props->colless); break;
+	case STAT_SACKIN: printf("%ld", props->sackin); break;
+	case STAT_CHERRIES: printf("%d", props->num_cherries); break;
+	case STAT_RTT_MIN: printf("%g", props->min_root_tip); break;
+	case STAT_RTT_MAX: printf("%g", props->max_root_tip); break;
+	case STAT_RTT_MEAN: printf("%g", props->mean_root_tip); break;
+	case STAT_MAX_DEGREE: printf("%d", props->max_degree); break;
+	case STAT_DUP_LABELS: printf("%d", props->num_dup_labels); break;
+	case NB_STATISTICS: break;
+	}
+}
+
+/* Used for both line and TSV output */
+
+static void print_line(struct tree_properties *props,
+		struct parameters *params)
+{
+	int i;
+	for (i = 0; i < params->nb_statistics; i++) {
+		if (i > 0) putchar('\t');
+		print_value(props, params->statistics[i], false);
+	}
+	putchar('\n');
 }
 
-static void print_column(struct tree_properties *props)
+static void print_column(struct tree_properties *props,
+		struct parameters *params)
 {
-	printf("Type:\t%s\n#nodes:\t%d\n#leaves:\t%d\n#dichotomies:\t%d\n"
-		"#leaf labels:\t%d\n#inner labels:\t%d\n",
-		type_string(props->type),
-		props->num_nodes,
-		props->num_leaves,
-		props->num_dichotomies,
-		props->num_leaf_labels,
-		props->num_inner_labels
-		);
+	int i;
+	for (i = 0; i < params->nb_statistics; i++) {
+		printf("%s:\t", stat_labels[params->statistics[i]]);
+		print_value(props, params->statistics[i], false);
+		putchar('\n');
+	}
+}
+
+static void print_json(struct tree_properties *props,
+		struct parameters *params)
+{
+	int i;
+	putchar('{');
+	for (i = 0; i < params->nb_statistics; i++) {
+		if (i > 0) printf(", ");
+		printf("\"%s\": ", stat_names[params->statistics[i]]);
+		print_value(props, params->statistics[i], true);
+	}
+	printf("}\n");
+}
+
+static void print_properties(struct tree_properties *props,
+		struct parameters *params)
+{
+	switch (params->output_format) {
+	case STATS_OUTPUT_COLUMN:
+		print_column(props, params);
+		break;
+	case STATS_OUTPUT_JSON:
+		print_json(props, params);
+		break;
+	default:
+		print_line(props, params);
+		break;
+	}
+}
+
+static void print_tsv_header(struct parameters *params)
+{
+	int i;
+	for (i = 0; i < params->nb_statistics; i++) {
+		if (i > 0) putchar('\t');
+		printf("%s", stat_names[params->statistics[i]]);
+	}
+	putchar('\n');
+}
+
+/* Sets the statistics to print from a comma-separated list of names */
+
+static void parse_statistics(struct parameters *params, char *list)
+{
+	int i;
+
+	params->nb_statistics = 0;
+	if (0 == strcmp("all", list)) {
+		for (i = 0; i < NB_STATISTICS; i++)
+			params->statistics[params->nb_statistics++] = i;
+		return;
+	}
+
+	char *name;
+	for (name = strtok(list, ","); NULL != name;
+			name = strtok(NULL, ",")) {
+		for (i = 0; i < NB_STATISTICS; i++)
+			if (0 == strcmp(stat_names[i], name))
+				break;
+		if (NB_STATISTICS == i) {
+			fprintf(stderr, "Unknown statistic '%s'.\n", name);
+			exit(EXIT_FAILURE);
+		}
+		if (NB_STATISTICS == params->nb_statistics) {
+			fprintf(stderr, "Too many statistics.\n");
+			exit(EXIT_FAILURE);
+		}
+		params->statistics[params->nb_statistics++] = i;
+	}
 }
 
 static struct parameters get_params(int argc, char *argv[])
 {
 	struct parameters params;
+	int i;
 
-	params.output_function = print_column;
 	params.output_format = STATS_OUTPUT_COLUMN;
+	for (i = 0; i < NB_DEFAULT_STATISTICS; i++)
+		params.statistics[i] = i;
+	params.nb_statistics = NB_DEFAULT_STATISTICS;
 	params.headers = false;
 
 	int opt_char;
-	while ((opt_char = getopt(argc, argv, "f:Hh")) != -1) {
+	while ((opt_char = getopt(argc, argv, "f:Hhs:")) != -1) {
 		switch (opt_char) {
 		case 'f':
 			switch (optarg[0]) {
 			case 'l':
 			case 'L':
 				params.output_format = STATS_OUTPUT_LINE;
-				params.output_function = print_line;
 				break;
 			case 'c':
 			case 'C':
 				break;	/* keep defaults */
+			case 't':
+			case 'T':
+				params.output_format = STATS_OUTPUT_TSV;
+				break;
+			case 'j':
+			case 'J':
+				params.output_format = STATS_OUTPUT_JSON;
+				break;
 			default:
 				fprintf (stderr,
 				"WARNING: wrong argument to option -f\n");
@@ -177,12 +377,36 @@ static struct parameters get_params(int argc, char *argv[])
 		case 'h':
 			help(argv);
 			exit(EXIT_SUCCESS);
+		case 's':
+			parse_statistics(&params, optarg);
+			break;
 		default:
 			fprintf (stderr, "Unknown option '-%c'\n", opt_char);
 			exit (EXIT_FAILURE);
 		}
 	}
 
+	params.need_subtree_stats = false;
+	params.need_dup_labels = false;
+	for (i = 0; i < params.nb_statistics; i++) {
+		switch (params.statistics[i]) {
+		case STAT_HEIGHT:
+		case STAT_COLLESS:
+		case STAT_SACKIN:
+		case STAT_CHERRIES:
+		case STAT_RTT_MIN:
+		case STAT_RTT_MAX:
+		case STAT_RTT_MEAN:
+			params.need_subtree_stats = true;
+			break;
+		case STAT_DUP_LABELS:
+			params.need_dup_labels = true;
+			break;
+		default:
+			break;
+		}
+	}
+
 	/* check arguments */
 	if ((argc - optind) == 1)	{
 		if (0 != strcmp("-", argv[optind])) {
@@ -195,52 +419,165 @@ static struct parameters get_params(int argc, char *argv[])
 			nwsin = fin;
 		}
 	} else {
-		fprintf(stderr, "Usage: %s [-fHh] <filename|->\n", argv[0]);
+		fprintf(stderr, "Usage: %s [-fHhs] <filename|->\n", argv[0]);
 		exit(EXIT_FAILURE);
 	}
 
 	return params;
 }
 
-/* Iterate once over all nodes, updating various statistics */
+static int compare_labels(const void *a, const void *b)
+{
+	return strcmp(*(char * const *) a, *(char * const *) b);
+}
+
+static int count_dup_labels(char **labels, int num_labels)
+{
+	int i, num_dups = 0;
+
+	qsort(labels, num_labels, sizeof(char *), compare_labels);
+	for (i = 1; i < num_labels; i++)
+		/* count each duplicated label once, at its 2nd occurrence */
+		if (0 == strcmp(labels[i], labels[i-1]) &&
+			(i < 2 || 0 != strcmp(labels[i-1], labels[i-2])))
+			num_dups++;
+
+	return num_dups;
+}
+
+/* Iterates once over all nodes, in postorder, computing all statistics. A
+ * node's rank is its index in the postorder, so the per-subtree values of its
+ * children (which come before it) can be found in buffers->subtrees. */
 
 static int get_properties(struct rooted_tree *tree,
-		struct tree_properties *props)
+		struct tree_properties *props, struct parameters *params,
+		struct buffers *buffers)
 {
+	int num_nodes = tree->nodes_in_order->count;
+	int num_labels = 0;
+	int rank = 0;
+
+	if (num_nodes > buffers->capacity) {
+		struct subtree_stats *subtrees = realloc(buffers->subtrees,
+				num_nodes * sizeof(struct subtree_stats));
+		if (NULL == subtrees) return FAILURE;
+		buffers->subtrees = subtrees;
+		char **labels = realloc(buffers->labels,
+				num_nodes * sizeof(char *));
+		if (NULL == labels) return FAILURE;
+		buffers->labels = labels;
+		buffers->capacity = num_nodes;
+	}
+
+	props->num_nodes = num_nodes;
+	props->num_leaves = 0;
 	props->num_dichotomies = 0;
 	props->num_leaf_labels = 0;
 	props->num_inner_labels = 0;
+	props->length = 0;
+	props->colless = 0;
+	props->sackin = 0;
+	props->num_cherries = 0;
+	props->max_degree = 0;
 
 	struct list_elem *el;
-	for (el = tree->nodes_in_order->head; NULL != el; el =el->next) {
+	for (el = tree->nodes_in_order->head; NULL != el;
+			el = el->next, rank++) {
 		struct rnode *current = (struct rnode *) el->data;
 		int num_kids = current->child_count;
-		/* tests */
+		current->rank = rank;
+
+		if (! is_root(current))
+			props->length += current->edge_length;
 		if (2 == num_kids)
 			props->num_dichotomies++;
-		if (0 != strcmp("", current->label)) {
+		if (num_kids > props->max_degree)
+			props->max_degree = num_kids;
+		if (is_leaf(current))
+			props->num_leaves++;
+		if ('\0' != current->label[0]) {
 			if (is_leaf(current))
 				props->num_leaf_labels++;
-			if (is_inner_node(current))
+			else
 				props->num_inner_labels++;
+			if (params->need_dup_labels)
+				buffers->labels[num_labels++] = current->label;
 		}
+
+		if (! params->need_subtree_stats)
+			continue;
+
+		struct subtree_stats *stats = &buffers->subtrees[rank];
+		if (is_leaf(current)) {
+			stats->num_leaves = 1;
+			stats->height = 0;
+			stats->min_root_tip = 0;
+			stats->max_root_tip = 0;
+			stats->sum_root_tip = 0;
+			continue;
+		}
+
+		stats->num_leaves = 0;
+		stats->height = 0;
+		stats->sum_root_tip = 0;
+		struct rnode *kid;
+		for (kid = current->first_child; NULL != kid;
+				kid = kid->next_sibling) {
+			struct subtree_stats *kid_stats =
+				&buffers->subtrees[kid->rank];
+			double min = kid->edge_length + kid_stats->min_root_tip;
+			double max = kid->edge_length + kid_stats->max_root_tip;
+			if (kid == current->first_child ||
+					min < stats->min_root_tip)
+				stats->min_root_tip = min;
+			if (kid == current->first_child ||
+					max > stats->max_root_tip)
+				stats->max_root_tip = max;
+			if (kid_stats->height + 1 > stats->height)
+				stats->height = kid_stats->height + 1;
+			stats->num_leaves += kid_stats->num_leaves;
+			stats->sum_root_tip += kid_stats->sum_root_tip +
+				kid->edge_length * kid_stats->num_leaves;
+		}
+		/* each leaf's depth is its number of inner ancestors */
+		props->sackin += stats->num_leaves;
+		if (2 == num_kids) {
+			struct rnode *first = current->first_child;
+			struct rnode *last = current->last_child;
+			int diff = buffers->subtrees[first->rank].num_leaves -
+				buffers->subtrees[last->rank].num_leaves;
+			props->colless += diff >= 0 ? diff : -diff;
+			if (is_leaf(first) && is_leaf(last))
+				props->num_cherries++;
+		}
+	}
+
+	props->type = get_tree_type(tree);
+
+	if (params->need_subtree_stats) {
+		struct subtree_stats *root_stats =
+			&buffers->subtrees[tree->root->rank];
+		props->height = root_stats->height;
+		props->min_root_tip = root_stats->min_root_tip;
+		props->max_root_tip = root_stats->max_root_tip;
+		props->mean_root_tip = root_stats->sum_root_tip /
+			props->num_leaves;
 	}
+	if (params->need_dup_labels)
+		props->num_dup_labels = count_dup_labels(buffers->labels,
+				num_labels);
+
 	return SUCCESS;
 }
 
 static void process_tree(struct rooted_tree *tree,
-		void(* output_function)(struct tree_properties *))
+		struct tree_properties *props, struct parameters *params,
+		struct buffers *buffers)
 {
-	struct tree_properties props;
-
-	props.type = get_tree_type(tree);
-	props.num_nodes = tree->nodes_in_order->count;
-	props.num_leaves = leaf_count(tree);
-	if (! get_properties(tree, &props)) {
+	if (! get_properties(tree, props, params, buffers)) {
 		perror("Could not get tree properties");
 		exit(EXIT_FAILURE);
 	}
-	output_function(&props);
 }
 
 int main (int argc, char* argv[])
@@ -248,12 +585,20 @@ int main (int argc, char* argv[])
 
 	struct parameters params = get_params(argc, argv);
 
+	if (STATS_OUTPUT_TSV == params.output_format)
+		print_tsv_header(&params);
+
 	struct rooted_tree *tree;
+	struct tree_properties props;
+	struct buffers buffers = { NULL, NULL, 0 };
 	while ((tree = parse_tree()) != NULL) {
-		process_tree(tree, params.output_function);
+		process_tree(tree, &props, &params, &buffers);
+		print_properties(&props, &params);
 		destroy_all_rnodes(NULL);
 		destroy_tree(tree);
 	}
+	free(buffers.subtrees);
+	free(buffers.labels);
 
 	return 0;
 }
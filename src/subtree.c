@@ -31,32 +31,26 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <stdlib.h>
 
 #include "list.h"
-#include "hash.h"
 #include "rnode.h"
-#include "nodemap.h"
 #include "subtree.h"
 
+/* The descendants must all be labeled leaves of the ancestor's subtree, and
+ * there must be as many as the subtree has labeled leaves (repeated nodes
+ * make the count too high). */
+
 enum monophyly is_monophyletic(struct llist *descendants, struct rnode *subtree_root)
 {
-	int result = MONOPH_TRUE;
-
-	struct hash *leaf_map = get_leaf_label_map_from_node(subtree_root);
-	if (NULL == leaf_map) 
-		return MONOPH_ERROR;
-	if (leaf_map->count != descendants->count) {
-		destroy_hash(leaf_map);
+	if (labeled_leaf_count(subtree_root) != descendants->count)
 		return MONOPH_FALSE;
-	}
+
 	struct list_elem *el;
 	for (el = descendants->head; NULL != el; el = el->next) {
-		char *label = ((struct rnode *) el->data)->label;
-		if (NULL == hash_get(leaf_map, label)) {
-			result = MONOPH_FALSE;
-			break;
-		}
+		struct rnode *node = el->data;
+		if (! is_leaf(node) || '\0' == node->label[0])
+			return MONOPH_FALSE;
+		if (! is_in_subtree(node, subtree_root))
+			return MONOPH_FALSE;
 	}
 
-	destroy_hash(leaf_map);
-
-	return result;
+	return MONOPH_TRUE;
 }
@@ -0,0 +1,387 @@
+/* 
+
+Copyright (c) 2009 Thomas Junier and Evgeny Zdobnov, University of Geneva
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+* Neither the name of the University of Geneva nor the names of its
+    contributors may be used to endorse or promote products derived from this
+    software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+/* svg_buffer.c - compact SVG output: merged paths, grouped text (see
+ * svg_buffer.h) */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "common.h"
+#include "hash.h"
+#include "list.h"
+#include "svg_buffer.h"
+
+#define TEXT_GROUP_MAP_SIZE 100		/* bins */
+
+/* A growable string. Not '\0'-terminated, since it is only ever written out
+ * with fwrite(). */
+
+struct str_buf {
+	char *chars;
+	size_t length;
+	size_t size;
+};
+
+/* The path of a group, and the current point (where the last drawn edge
+ * ended), in 1/100 px */
+
+struct path {
+	struct str_buf d;
+	long x;
+	long y;
+};
+
+struct text_group {
+	char *class;
+	struct str_buf content;
+};
+
+struct svg_buffer {
+	struct path **paths;	/* indexed by group number + 1 (see NO_CLASS),
+				   NULL if group not used */
+	int nb_paths;
+	struct llist *text_groups;	/* in order of first use */
+	struct hash *text_group_map;	/* class -> text group */
+	struct str_buf extra;
+};
+
+/************************** strings and numbers *****************************/
+
+static int reserve(struct str_buf *buf, size_t n)
+{
+	if (buf->length + n <= buf->size)
+		return SUCCESS;
+
+	size_t size = buf->size > 0 ? buf->size : 256;
+	while (size < buf->length + n)
+		size *= 2;
+	char *chars = realloc(buf->chars, size);
+	if (NULL == chars) return FAILURE;
+	buf->chars = chars;
+	buf->size = size;
+
+	return SUCCESS;
+}
+
+static int append_chars(struct str_buf *buf, const char *chars, size_t n)
+{
+	if (! reserve(buf, n)) return FAILURE;
+	memcpy(buf->chars + buf->length, chars, n);
+	buf->length += n;
+	return SUCCESS;
+}
+
+static int append_str(struct str_buf *buf, const char *str)
+{
+	return append_chars(buf, str, strlen(str));
+}
+
+static long hundredths(double value)
+{
+	return lround(100 * value);
+}
+
+/* Appends a number given in hundredths, with no trailing zeroes and no
+ * leading zero (e.g. 1250 -> "12.5", -5 -> "-.05", 0 -> "0"). If 'sep' is not
+ * '\0', it is written before the number - unless the number is negative, as
+ * the minus sign is then enough to separate it from the previous one. */
+
+static int append_num(struct str_buf *buf, long value, char sep)
+{
+	char digits[32];
+	char *p = digits + sizeof(digits);
+	unsigned long abs_value = value < 0 ?
+		- (unsigned long) value : (unsigned long) value;
+	unsigned long int_part = abs_value / 100;
+	unsigned long frac_part = abs_value % 100;
+
+	/* written backwards */
+	if (frac_part > 0) {
+		if (frac_part % 10 > 0)
+			*--p = '0' + frac_part % 10;
+		*--p = '0' + frac_part / 10;
+		*--p = '.';
+	}
+	if (int_part > 0 || 0 == frac_part) {
+		do {
+			*--p = '0' + int_part % 10;
+			int_part /= 10;
+		} while (int_part > 0);
+	}
+	if (value < 0)
+		*--p = '-';
+	else if ('\0' != sep)
+		*--p = sep;
+
+	return append_chars(buf, p, digits + sizeof(digits) - p);
+}
+
+/************************** paths *****************************/
+
+struct svg_buffer *create_svg_buffer()
+{
+	struct svg_buffer *buf = calloc(1, sizeof(struct svg_buffer));
+	if (NULL == buf) return NULL;
+	buf->text_groups = create_llist();
+	if (NULL == buf->text_groups) {
+		free(buf);
+		return NULL;
+	}
+	buf->text_group_map = create_hash(TEXT_GROUP_MAP_SIZE);
+	if (NULL == buf->text_group_map) {
+		destroy_llist(buf->text_groups);
+		free(buf);
+		return NULL;
+	}
+	return buf;
+}
+
+static struct path *get_path(struct svg_buffer *buf, int group_nb)
+{
+	int index = group_nb + 1;
+
+	if (index >= buf->nb_paths) {
+		int nb_paths = index + 1;
+		struct path **paths = realloc(buf->paths,
+				nb_paths * sizeof(struct path *));
+		if (NULL == paths) return NULL;
+		memset(paths + buf->nb_paths, 0,
+			(nb_paths - buf->nb_paths) * sizeof(struct path *));
+		buf->paths = paths;
+		buf->nb_paths = nb_paths;
+	}
+	if (NULL == buf->paths[index]) {
+		buf->paths[index] = calloc(1, sizeof(struct path));
+		if (NULL == buf->paths[index]) return NULL;
+	}
+
+	return buf->paths[index];
+}
+
+/* Moves the path's current point to (x,y) (in 1/100 px), unless it is
+ * already there (e.g. when an edge starts where the previous one ended). */
+
+static int move_to(struct path *path, long x, long y)
+{
+	if (0 == path->d.length) {
+		if (! append_chars(&path->d, "M", 1)) return FAILURE;
+		if (! append_num(&path->d, x, '\0')) return FAILURE;
+		if (! append_num(&path->d, y, ',')) return FAILURE;
+	} else if (x != path->x || y != path->y) {
+		if (! append_chars(&path->d, "m", 1)) return FAILURE;
+		if (! append_num(&path->d, x - path->x, '\0')) return FAILURE;
+		if (! append_num(&path->d, y - path->y, ',')) return FAILURE;
+	}
+	path->x = x;
+	path->y = y;
+
+	return SUCCESS;
+}
+
+int svg_buffer_line(struct svg_buffer *buf, int group_nb,
+		double x1, double y1, double x2, double y2)
+{
+	struct path *path = get_path(buf, group_nb);
+	if (NULL == path) return FAILURE;
+
+	long start_x = hundredths(x1), start_y = hundredths(y1);
+	long dx = hundredths(x2) - start_x, dy = hundredths(y2) - start_y;
+
+	if (! move_to(path, start_x, start_y)) return FAILURE;
+	/* Zero-length edges still get an 'h0': like the <line>s of normal
+	 * output, they may be visible, depending on stroke-linecap. */
+	if (0 == dy) {
+		if (! append_chars(&path->d, "h", 1)) return FAILURE;
+		if (! append_num(&path->d, dx, '\0')) return FAILURE;
+	} else if (0 == dx) {
+		if (! append_chars(&path->d, "v", 1)) return FAILURE;
+		if (! append_num(&path->d, dy, '\0')) return FAILURE;
+	} else {
+		if (! append_chars(&path->d, "l", 1)) return FAILURE;
+		if (! append_num(&path->d, dx, '\0')) return FAILURE;
+		if (! append_num(&path->d, dy, ',')) return FAILURE;
+	}
+	path->x += dx;
+	path->y += dy;
+
+	return SUCCESS;
+}
+
+int svg_buffer_arc(struct svg_buffer *buf, int group_nb,
+		double x1, double y1, double radius, int large_arc_flag,
+		double x2, double y2)
+{
+	struct path *path = get_path(buf, group_nb);
+	if (NULL == path) return FAILURE;
+
+	long start_x = hundredths(x1), start_y = hundredths(y1);
+	long dx = hundredths(x2) - start_x, dy = hundredths(y2) - start_y;
+	long r = hundredths(radius);
+
+	if (! move_to(path, start_x, start_y)) return FAILURE;
+	if (! append_chars(&path->d, "a", 1)) return FAILURE;
+	if (! append_num(&path->d, r, '\0')) return FAILURE;
+	if (! append_num(&path->d, r, ',')) return FAILURE;
+	if (! append_str(&path->d, large_arc_flag ? " 0 1 1" : " 0 0 1"))
+		return FAILURE;
+	if (! append_num(&path->d, dx, ' ')) return FAILURE;
+	if (! append_num(&path->d, dy, ',')) return FAILURE;
+	path->x += dx;
+	path->y += dy;
+
+	return SUCCESS;
+}
+
+/************************** text *****************************/
+
+static struct text_group *get_text_group(struct svg_buffer *buf,
+		const char *class)
+{
+	struct text_group *group = hash_get(buf->text_group_map, class);
+	if (NULL != group) return group;
+
+	group = calloc(1, sizeof(struct text_group));
+	if (NULL == group) return NULL;
+	group->class = strdup(class);
+	if (NULL == group->class) return NULL;
+	if (! append_element(buf->text_groups, group)) return NULL;
+	if (! hash_set(buf->text_group_map, class, group)) return NULL;
+
+	return group;
+}
+
+int svg_buffer_text(struct svg_buffer *buf, const char *class, const char *url,
+		double x, double y, double angle_deg, bool anchor_end,
+		const char *text)
+{
+	struct text_group *group = get_text_group(buf, class);
+	if (NULL == group) return FAILURE;
+	struct str_buf *content = &group->content;
+	long angle = hundredths(angle_deg);
+
+	if (url) {
+		if (! append_str(content, "<a ")) return FAILURE;
+		if (! append_str(content, url)) return FAILURE;
+		if (! append_str(content, ">")) return FAILURE;
+	}
+	if (! append_str(content, "<text")) return FAILURE;
+	if (anchor_end)
+		if (! append_str(content, " style='text-anchor:end'"))
+			return FAILURE;
+	if (0 == angle) {
+		if (! append_str(content, " x='")) return FAILURE;
+		if (! append_num(content, hundredths(x), '\0')) return FAILURE;
+		if (! append_str(content, "' y='")) return FAILURE;
+		if (! append_num(content, hundredths(y), '\0')) return FAILURE;
+		if (! append_str(content, "'>")) return FAILURE;
+	} else {
+		/* same as rotate(angle,x,y) with attributes x and y, but
+		 * shorter */
+		if (! append_str(content, " transform='translate("))
+			return FAILURE;
+		if (! append_num(content, hundredths(x), '\0')) return FAILURE;
+		/* unlike in paths, a separator is required here */
+		if (! append_str(content, ",")) return FAILURE;
+		if (! append_num(content, hundredths(y), '\0')) return FAILURE;
+		if (! append_str(content, ")rotate(")) return FAILURE;
+		if (! append_num(content, angle, '\0')) return FAILURE;
+		if (! append_str(content, ")'>")) return FAILURE;
+	}
+	if (! append_str(content, text)) return FAILURE;
+	if (! append_str(content, "</text>")) return FAILURE;
+	if (url)
+		if (! append_str(content, "</a>")) return FAILURE;
+
+	return SUCCESS;
+}
+
+int svg_buffer_append(struct svg_buffer *buf, const char *svg)
+{
+	return append_str(&buf->extra, svg);
+}
+
+/************************** output *****************************/
+
+void svg_buffer_dump_paths(struct svg_buffer *buf)
+{
+	int i;
+
+	for (i = 0; i < buf->nb_paths; i++) {
+		struct path *path = buf->paths[i];
+		if (NULL == path || 0 == path->d.length)
+			continue;
+		if (0 == i)	/* NO_CLASS */
+			printf("<path d='");
+		else
+			printf("<path class='clade_%d' d='", i - 1);
+		fwrite(path->d.chars, 1, path->d.length, stdout);
+		printf("'/>");
+	}
+	fwrite(buf->extra.chars, 1, buf->extra.length, stdout);
+}
+
+void svg_buffer_dump_text(struct svg_buffer *buf)
+{
+	struct list_elem *elem;
+
+	for (elem = buf->text_groups->head; NULL != elem; elem = elem->next) {
+		struct text_group *group = elem->data;
+		printf("<g class='%s'>", group->class);
+		fwrite(group->content.chars, 1, group->content.length,
+				stdout);
+		printf("</g>");
+	}
+}
+
+void destroy_svg_buffer(struct svg_buffer *buf)
+{
+	int i;
+	struct list_elem *elem;
+
+	for (i = 0; i < buf->nb_paths; i++) {
+		if (NULL != buf->paths[i]) {
+			free(buf->paths[i]->d.chars);
+			free(buf->paths[i]);
+		}
+	}
+	free(buf->paths);
+	for (elem = buf->text_groups->head; NULL != elem; elem = elem->next) {
+		struct text_group *group = elem->data;
+		free(group->class);
+		free(group->content.chars);
+		free(group);
+	}
+	destroy_llist(buf->text_groups);
+	destroy_hash(buf->text_group_map);
+	free(buf->extra.chars);
+	free(buf);
+}
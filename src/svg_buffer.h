@@ -0,0 +1,86 @@
+/* 
+
+Copyright (c) 2009 Thomas Junier and Evgeny Zdobnov, University of Geneva
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+* Neither the name of the University of Geneva nor the names of its
+    contributors may be used to endorse or promote products derived from this
+    software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+/* Interface of svg_buffer.c: accumulates a tree's graphics for compact SVG
+ * output (nw_display -C). Instead of one element per edge and one per label,
+ * all edges of the same group (CSS class clade_<n>) end up in a single <path>,
+ * and all labels of the same class in a single <g>. Coordinates are rounded to
+ * 1/100 px, and path coordinates are relative to the previous point, which
+ * makes them short. */
+
+#include <stdbool.h>
+
+/* Group number of edges that have no class (e.g. the root's edge) */
+
+#define NO_CLASS -1
+
+struct svg_buffer;
+
+/* Creates an empty buffer. Returns NULL if memory is exhausted. */
+
+struct svg_buffer *create_svg_buffer();
+
+/* The following functions return FAILURE iff memory is exhausted */
+
+/* Adds a line from (x1,y1) to (x2,y2) to the path of group 'group_nb' */
+
+int svg_buffer_line(struct svg_buffer *, int group_nb,
+		double x1, double y1, double x2, double y2);
+
+/* Adds a circular arc (clockwise, i.e. with sweep flag 1) of radius 'radius'
+ * from (x1,y1) to (x2,y2) to the path of group 'group_nb'. */
+
+int svg_buffer_arc(struct svg_buffer *, int group_nb,
+		double x1, double y1, double radius, int large_arc_flag,
+		double x2, double y2);
+
+/* Adds a <text> element to the <g> of class 'class'. The text is rotated by
+ * 'angle_deg' around (x,y), and anchored by its end iff 'anchor_end' is
+ * true. If 'url' is not NULL, it is used as attributes of an <a> element
+ * around the text. */
+
+int svg_buffer_text(struct svg_buffer *, const char *class, const char *url,
+		double x, double y, double angle_deg, bool anchor_end,
+		const char *text);
+
+/* Adds SVG verbatim, to be output after the paths (e.g., ornaments) */
+
+int svg_buffer_append(struct svg_buffer *, const char *svg);
+
+/* Prints the paths (one per group, in increasing group number), followed by
+ * whatever was added with svg_buffer_append(). */
+
+void svg_buffer_dump_paths(struct svg_buffer *);
+
+/* Prints the text, in one <g> per class (in order of first use). */
+
+void svg_buffer_dump_text(struct svg_buffer *);
+
+void destroy_svg_buffer(struct svg_buffer *);
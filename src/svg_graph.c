@@ -102,6 +102,8 @@ double label_char_width = -1;
 enum inner_lbl_pos inner_label_pos = -1;
 bool scalebar_zero_at_root = true;
 int label_space = 10;
+bool compact_svg = false;
+double lod_threshold = 0;	/* px; 0 means no LOD */
 
 /* These are setters for the external variables. This way I can keep most of
  * them static. I just don't like variables open to anyone, maybe I did too
@@ -120,6 +122,8 @@ void set_plain_node_style(char *style) { plain_node_style = style; }
 void set_label_char_width(double width) { label_char_width = width; }
 void set_scalebar_zero_at_root(bool at_root) { scalebar_zero_at_root = at_root; }
 void add_to_label_space(int correction) { label_space += correction; }
+void set_compact_svg(bool compact) { compact_svg = compact; }
+void set_lod_threshold(double threshold) { lod_threshold = threshold; }
 
 /************************** functions *****************************/
 
@@ -138,6 +142,10 @@ static void svg_CSS_stylesheet()
 					css_el->style);
 		}
 	}
+	/* after the clade styles, which usually have 'fill:none' (for the
+	 * edges) */
+	if (lod_threshold > 0)
+		printf (" .collapsed {fill:lightgrey}\n");
 	printf (" .leaf-label {%s}\n", leaf_label_style);
 	printf (" .inner-label {%s}\n", inner_label_style);
 	printf (" .edge-label {%s}\n", edge_label_style);
@@ -651,6 +659,9 @@ int svg_alloc_node_pos(struct rooted_tree *tree)
 		svgd->group_nb = UNSTYLED_CLADE;	
 		svgd->lbl_group_nb = UNSTYLED_CLADE;
 		svgd->ornament = NULL;
+		svgd->nb_leaves = 0;
+		svgd->max_depth = -1.0;
+		svgd->lod = LOD_SHOWN;
 		node->data = svgd;
 	}
 	return SUCCESS;
@@ -686,6 +697,83 @@ double svg_get_node_depth (struct rnode *node)
 	return ((struct svg_data *) node->data)->depth;
 }
 
+int set_lod(struct rooted_tree *tree, bool align_leaves, double dmax,
+		double (*clade_extent)(struct svg_data *, void *scales),
+		void *scales)
+{
+	struct list_elem *elem;
+
+	/* Clade sizes: children come before their parent */
+	for (elem = tree->nodes_in_order->head; NULL != elem;
+			elem = elem->next) {
+		struct rnode *node = elem->data;
+		struct svg_data *node_data = node->data;
+		if (is_leaf(node)) {
+			node_data->nb_leaves = 1;
+			node_data->max_depth = align_leaves ?
+				dmax : node_data->depth;
+		} else {
+			node_data->nb_leaves = 0;
+			node_data->max_depth = node_data->depth;
+			struct rnode *kid;
+			for (kid = node->first_child; NULL != kid;
+					kid = kid->next_sibling) {
+				struct svg_data *kid_data = kid->data;
+				node_data->nb_leaves += kid_data->nb_leaves;
+				if (kid_data->max_depth > node_data->max_depth)
+					node_data->max_depth =
+						kid_data->max_depth;
+			}
+		}
+	}
+
+	/* Collapsing: parents come before their children */
+	struct llist *nodes_in_reverse_order;
+	nodes_in_reverse_order = llist_reverse(tree->nodes_in_order);
+	if (NULL == nodes_in_reverse_order) return FAILURE;
+	for (elem = nodes_in_reverse_order->head; NULL != elem;
+			elem = elem->next) {
+		struct rnode *node = elem->data;
+		struct svg_data *node_data = node->data;
+		if (! is_root(node) &&
+			LOD_SHOWN != ((struct svg_data *)
+				node->parent->data)->lod)
+			node_data->lod = LOD_HIDDEN;
+		else if (! is_leaf(node) &&
+			clade_extent(node_data, scales) < lod_threshold)
+			node_data->lod = LOD_COLLAPSED;
+		else
+			node_data->lod = LOD_SHOWN;
+	}
+	destroy_llist(nodes_in_reverse_order);
+
+	return SUCCESS;
+}
+
+char *collapsed_clade_label(struct rnode *node)
+{
+	struct svg_data *node_data = node->data;
+	if (0 == strcmp("", node->label))
+		return masprintf("%d leaves", node_data->nb_leaves);
+	else
+		return masprintf("%s (%d leaves)", node->label,
+				node_data->nb_leaves);
+}
+
+struct rnode *first_leaf(struct rnode *node)
+{
+	while (! is_leaf(node))
+		node = node->first_child;
+	return node;
+}
+
+struct rnode *last_leaf(struct rnode *node)
+{
+	while (! is_leaf(node))
+		node = node->last_child;
+	return node;
+}
+
 double largest_PoT_lte(double arg)
 {
 	double l10 = log(arg) / log(10);
@@ -846,14 +934,17 @@ enum display_status display_svg_tree(
 
  	prettify_labels(tree);
 
+	int status;
 	if (SVG_ORTHOGONAL == style)
-		display_svg_tree_orthogonal(tree, hd, align_leaves,
+		status = display_svg_tree_orthogonal(tree, hd, align_leaves,
 				with_scale_bar, branch_length_unit);
 	else if (SVG_RADIAL == style)
-		display_svg_tree_radial(tree, hd, align_leaves,
+		status = display_svg_tree_radial(tree, hd, align_leaves,
 				with_scale_bar, branch_length_unit);
 	else
 		return DISPLAY_UNKNOWN_STYLE;
+	if (! status)
+		return DISPLAY_MEM_ERROR;
 
 	return DISPLAY_OK;
 }
@@ -51,6 +51,12 @@ void set_URL_map_file(FILE *);
 void set_label_angle_correction(double);
 void set_left_label_angle_correction(double);
 void set_scalebar_zero_at_root(bool);
+/* If true, edges are merged into one <path> per CSS class, and labels into
+ * one <g> per class, with shorter coordinates (see svg_buffer.h) */
+void set_compact_svg(bool);
+/* Clades less than this many pixels across are drawn as a single triangle (or
+ * wedge, for radial trees) - see set_lod(). 0 (the default) means never. */
+void set_lod_threshold(double);
 
 /* Call this before calling svg_header(), etc, but _after_ the set_svg*()
  * functions. It will launch the initializations liek reading the color map,
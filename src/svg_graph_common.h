@@ -30,6 +30,8 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 /* Declarations used by SVG code, but not restricted to a single module. */
 
+#include <stdbool.h>
+
 #define ROOT_SPACE 10			/* pixels */
 #define LBL_VOFFSET 4			/* pixels */
 #define INNER_LBL_SPACE 4		/* pixels */
@@ -44,6 +46,8 @@ extern double graph_width;
 extern double label_char_width;
 extern int scale_bar_height;
 extern int label_space;
+extern bool compact_svg;
+extern double lod_threshold;
 
 /* rnode data for SVG trees */
 
@@ -52,6 +56,15 @@ extern int label_space;
  * often not be used. And even then, it is not clear that all nodes in the tree
  * will have URLs. So the current map-based approach seems best here. */
 
+/** Level of detail: clades that would be too small to see are drawn as a single
+ * shape (see set_lod()) */
+
+enum lod_state {
+	LOD_SHOWN,	/**< drawn normally */
+	LOD_COLLAPSED,	/**< drawn as a triangle or wedge, with a label */
+	LOD_HIDDEN	/**< in a collapsed clade: not drawn */
+};
+
 /** A structure for node data pertaining to SVG. Structs of this type are
  * pointed to by struct rnode's \a data member. */
 
@@ -62,6 +75,9 @@ struct svg_data {
 	int group_nb;		/**< For attributing CSS styles (class=...) to lines */
 	int lbl_group_nb;	/**< For attributing styles to labels */ 
 	char *ornament;		/**< SVG decorations */
+	int nb_leaves;		/**< leaves in clade (only set if LOD is used) */
+	double max_depth;	/**< depth of deepest leaf in clade (ditto) */
+	enum lod_state lod;
 	/* ... other node properties ... */
 };
 
@@ -87,3 +103,27 @@ double largest_PoT_lte(double);
 
 void draw_scale_bar(double, double, double, double, char *);
 
+struct rooted_tree;
+struct rnode;
+
+/* Level of detail. Sets the 'nb_leaves' and 'max_depth' of all nodes, then
+ * collapses every clade whose extent (in pixels, as computed by callback
+ * 'clade_extent', which is passed 'scales' as is) is less than lod_threshold,
+ * unless an ancestor is already collapsed. Leaves are never collapsed. The
+ * leaves' depth is taken to be 'dmax' if 'align_leaves' is true (cladograms).
+ * Returns FAILURE iff memory is exhausted. */
+
+int set_lod(struct rooted_tree *tree, bool align_leaves, double dmax,
+		double (*clade_extent)(struct svg_data *, void *scales),
+		void *scales);
+
+/* Returns the label of a collapsed clade, which shows its size and, if any,
+ * the label of its root. Returns NULL iff memory is exhausted. */
+
+char *collapsed_clade_label(struct rnode *);
+
+/* Returns the first (last) leaf of the node's clade, in Newick order */
+
+struct rnode *first_leaf(struct rnode *);
+struct rnode *last_leaf(struct rnode *);
+
@@ -28,6 +28,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 */
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <assert.h>
 #include <stdbool.h>
@@ -39,7 +40,9 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "node_pos_alloc.h"
 #include "graph_common.h"
 #include "svg_graph_common.h"
+#include "svg_buffer.h"
 #include "masprintf.h"
+#include "common.h"
 
 extern enum inner_lbl_pos inner_label_pos;
 static const int whole_v_shift = 20; 	/* Vertical translation of whole graph */
@@ -64,9 +67,46 @@ int graph_height(int nb_leaves, int with_scale_bar)
 	return height;
 }
 
-/* Outputs an SVG <g> element with all the tree branches, orthogonal */
+/* Extent of a clade, for LOD (see set_lod()): each leaf takes up one
+ * vertical skip */
 
-void draw_branches_ortho (struct rooted_tree *tree, const double h_scale,
+static double clade_extent(struct svg_data *node_data, void *v_scale)
+{
+	return node_data->nb_leaves * *(double *) v_scale;
+}
+
+/* Position of a collapsed clade's triangle: its apex is the node, and its
+ * base spans the clade's leaves, at the depth of the deepest one. */
+
+static void collapsed_clade_base(struct rnode *node, const double h_scale,
+		const double v_scale, double *h_pos, double *top,
+		double *bottom)
+{
+	struct svg_data *node_data = node->data;
+	*h_pos = ROOT_SPACE + (h_scale * node_data->max_depth);
+	*top = v_scale * ((struct svg_data *) first_leaf(node)->data)->top;
+	*bottom = v_scale * ((struct svg_data *) last_leaf(node)->data)->top;
+}
+
+/* Returns the SVG for a collapsed clade, or NULL if memory is exhausted */
+
+static char *collapsed_clade(struct rnode *node, const double h_scale,
+		const double v_scale, double svg_h_pos, double svg_mid_pos)
+{
+	struct svg_data *node_data = node->data;
+	double base_h_pos, base_top, base_bottom;
+	collapsed_clade_base(node, h_scale, v_scale, &base_h_pos, &base_top,
+			&base_bottom);
+	return masprintf("<path class='clade_%d collapsed' "
+			"d='M%.4f,%.4f L%.4f,%.4f L%.4f,%.4f Z'/>",
+			node_data->group_nb, svg_h_pos, svg_mid_pos,
+			base_h_pos, base_top, base_h_pos, base_bottom);
+}
+
+/* Outputs an SVG <g> element with all the tree branches, orthogonal. Returns
+ * FAILURE iff memory is exhausted. */
+
+static int draw_branches_ortho (struct rooted_tree *tree, const double h_scale,
 		const double v_scale, int align_leaves, double dmax)
 {
 	printf("<g "
@@ -89,8 +129,12 @@ void draw_branches_ortho (struct rooted_tree *tree, const double h_scale,
 		double svg_mid_pos =
 			0.5 * v_scale * (node_data->top+node_data->bottom);
 
-		/* draw node (vertical line), except for leaves */
-		if (! is_leaf(node)) {
+		if (LOD_HIDDEN == node_data->lod)
+			continue;
+
+		/* draw node (vertical line), except for leaves (and
+		 * collapsed clades) */
+		if (LOD_SHOWN == node_data->lod && ! is_leaf(node)) {
 		printf("<line class='clade_%d' "
 			"x1='%.4f' y1='%.4f' x2='%.4f' y2='%.4f'/>",
 			node_data->group_nb, svg_h_pos, svg_top_pos, svg_h_pos,
@@ -110,6 +154,13 @@ void draw_branches_ortho (struct rooted_tree *tree, const double h_scale,
 				node_data->group_nb, svg_parent_h_pos,
 				 svg_mid_pos, svg_h_pos, svg_mid_pos);
 		}
+		if (LOD_COLLAPSED == node_data->lod) {
+			char *clade = collapsed_clade(node, h_scale, v_scale,
+					svg_h_pos, svg_mid_pos);
+			if (NULL == clade) return FAILURE;
+			printf("%s", clade);
+			free(clade);
+		}
 		/* draw ornament, if any */
 		if (NULL != node_data->ornament) {
 			/* ornament is considered text IFF it starts
@@ -133,20 +184,20 @@ void draw_branches_ortho (struct rooted_tree *tree, const double h_scale,
 		}
 	}
 	printf("</g>");
+
+	return SUCCESS;
 }
 
-/* Draws a node label */
+/* Computes the position of a node label */
 
-void draw_label(const double svg_h_pos, const double svg_mid_pos,
+static void label_position(const double svg_h_pos, const double svg_mid_pos,
 		const double h_scale, struct rnode *node,
-		const char *class, const char *url)
+		double *h_pos_p, double *v_pos_p)
 {
 	/* Defaults: use node's position */
 	double h_pos = svg_h_pos + label_space;
 	double v_pos = svg_mid_pos + LBL_VOFFSET; 
 
-	if (url) printf ("<a %s>", url);
-
 	bool v_nudge = false;	/* set to true if label across branch */
 
 	/* inner node label can be positioned in various ways */
@@ -183,6 +234,21 @@ void draw_label(const double svg_h_pos, const double svg_mid_pos,
 	if (v_nudge)
 		v_pos -= KNEE_NODE_V_NUDGE;
 
+	*h_pos_p = h_pos;
+	*v_pos_p = v_pos;
+}
+
+/* Draws a node label */
+
+void draw_label(const double svg_h_pos, const double svg_mid_pos,
+		const double h_scale, struct rnode *node,
+		const char *class, const char *url)
+{
+	double h_pos, v_pos;
+	label_position(svg_h_pos, svg_mid_pos, h_scale, node, &h_pos, &v_pos);
+
+	if (url) printf ("<a %s>", url);
+
 	printf("<text class='%s' "
 	       "x='%.4f' y='%.4f'>%s</text>",
 		class, h_pos, v_pos, node->label);
@@ -190,9 +256,24 @@ void draw_label(const double svg_h_pos, const double svg_mid_pos,
 	if (url) printf ("</a>");
 }
 
-/* Prints the node text (labels and lengths) in a <g> element, orthogonal */
+/* A collapsed clade's label goes next to the middle of its triangle's base,
+ * like a leaf label. */
 
-void draw_text_ortho (struct rooted_tree *tree, const double h_scale,
+static void collapsed_clade_label_position(struct rnode *node,
+		const double h_scale, const double v_scale,
+		double *h_pos, double *v_pos)
+{
+	double base_h_pos, base_top, base_bottom;
+	collapsed_clade_base(node, h_scale, v_scale, &base_h_pos, &base_top,
+			&base_bottom);
+	*h_pos = base_h_pos + label_space;
+	*v_pos = 0.5 * (base_top + base_bottom) + LBL_VOFFSET;
+}
+
+/* Prints the node text (labels and lengths) in a <g> element, orthogonal.
+ * Returns FAILURE iff memory is exhausted. */
+
+static int draw_text_ortho (struct rooted_tree *tree, const double h_scale,
 		const double v_scale, int align_leaves, double dmax)
 {
 	printf( "<g style='stroke:none'>");
@@ -210,10 +291,23 @@ void draw_text_ortho (struct rooted_tree *tree, const double h_scale,
 		double svg_mid_pos =
 			0.5 * v_scale * (node_data->top+node_data->bottom);
 
+		if (LOD_HIDDEN == node_data->lod)
+			continue;
+
 		char *url = NULL;
 		if (url_map) url = hash_get(url_map, node->label);
 
-		if (0 != strcmp(node->label, "")) {
+		if (LOD_COLLAPSED == node_data->lod) {
+			char *label = collapsed_clade_label(node);
+			if (NULL == label) return FAILURE;
+			double h_pos, v_pos;
+			collapsed_clade_label_position(node, h_scale, v_scale,
+					&h_pos, &v_pos);
+			printf("<text class='%s' "
+			       "x='%.4f' y='%.4f'>%s</text>",
+				leaf_label_class, h_pos, v_pos, label);
+			free(label);
+		} else if (0 != strcmp(node->label, "")) {
 			char *class;
 			if (is_leaf(node))
 				class = leaf_label_class;
@@ -253,9 +347,178 @@ void draw_text_ortho (struct rooted_tree *tree, const double h_scale,
 
 	}
 	printf("</g>");
+
+	return SUCCESS;
+}
+
+/* Compact versions of draw_branches_ortho() and draw_text_ortho(): the
+ * graphics go to 'buf' (see svg_buffer.h), then are printed. They return
+ * FAILURE iff memory is exhausted. */
+
+static int draw_branches_ortho_compact(struct rooted_tree *tree,
+		const double h_scale, const double v_scale, int align_leaves,
+		double dmax, struct svg_buffer *buf)
+{
+	struct list_elem *elem;
+	for (elem=tree->nodes_in_order->head; NULL!=elem; elem=elem->next) {
+		struct rnode *node = elem->data;
+		struct svg_data *node_data = (struct svg_data *) node->data;
+
+		/* For cladograms */
+		if (align_leaves && is_leaf(node))
+			node_data->depth = dmax;
+
+		double svg_h_pos = ROOT_SPACE + (h_scale * node_data->depth);
+		double svg_top_pos = v_scale * node_data->top; 
+		double svg_bottom_pos = v_scale * node_data->bottom; 
+		double svg_mid_pos =
+			0.5 * v_scale * (node_data->top+node_data->bottom);
+		int group_nb = node_data->group_nb;
+
+		if (LOD_HIDDEN == node_data->lod)
+			continue;
+
+		/* draw node (vertical line), except for leaves (and
+		 * collapsed clades) */
+		if (LOD_SHOWN == node_data->lod && ! is_leaf(node))
+			if (! svg_buffer_line(buf, group_nb, svg_h_pos,
+				svg_top_pos, svg_h_pos, svg_bottom_pos))
+				return FAILURE;
+		/* draw horizontal line - from the node to its parent, so
+		 * that it starts close to where the node's vertical line
+		 * ended */
+		if (is_root(node)) {
+			if (! svg_buffer_line(buf, NO_CLASS, svg_h_pos,
+				svg_mid_pos, 0, svg_mid_pos))
+				return FAILURE;
+		} else {
+			struct svg_data *parent_data = node->parent->data;
+			double svg_parent_h_pos = ROOT_SPACE + (
+				h_scale * parent_data->depth);
+			if (! svg_buffer_line(buf, group_nb, svg_h_pos,
+				svg_mid_pos, svg_parent_h_pos, svg_mid_pos))
+				return FAILURE;
+		}
+		/* collapsed clades are filled, so they can't be merged with
+		 * the edges */
+		if (LOD_COLLAPSED == node_data->lod) {
+			char *clade = collapsed_clade(node, h_scale, v_scale,
+					svg_h_pos, svg_mid_pos);
+			if (NULL == clade) return FAILURE;
+			if (! svg_buffer_append(buf, clade)) return FAILURE;
+			free(clade);
+		}
+		/* ornaments are output after the paths, as they would be
+		 * drawn over the edges in normal output */
+		if (NULL != node_data->ornament) {
+			char *ornament;
+			if (strstr(node_data->ornament, "<text") == 
+					node_data->ornament)
+				ornament = masprintf(
+					"<g style='text-anchor:end;"
+					"stroke:none;fill:black'"
+					" transform='"
+					"translate(%g,%g)'>%s</g>",
+					svg_h_pos,
+					svg_mid_pos + edge_length_v_offset,
+					node_data->ornament);
+			else
+				ornament = masprintf("<g transform='"
+					"translate(%g,%g)'>%s</g>",
+					svg_h_pos, svg_mid_pos,
+					node_data->ornament);
+			if (NULL == ornament) return FAILURE;
+			if (! svg_buffer_append(buf, ornament))
+				return FAILURE;
+			free(ornament);
+		}
+	}
+
+	printf("<g "
+	       	" style='stroke:black;fill:none;stroke-width:1;"
+		"stroke-linecap:round'>"
+		);
+	svg_buffer_dump_paths(buf);
+	printf("</g>");
+
+	return SUCCESS;
+}
+
+static int draw_text_ortho_compact(struct rooted_tree *tree,
+		const double h_scale, const double v_scale, int align_leaves,
+		double dmax, struct svg_buffer *buf)
+{
+	struct list_elem *elem;
+	for (elem=tree->nodes_in_order->head; NULL!=elem; elem=elem->next) {
+		struct rnode *node = elem->data;
+		struct svg_data *node_data = (struct svg_data *) node->data;
+
+		/* For cladograms */
+		if (align_leaves && is_leaf(node))
+			node_data->depth = dmax;
+
+		double svg_h_pos = ROOT_SPACE + (h_scale * node_data->depth);
+		double svg_mid_pos =
+			0.5 * v_scale * (node_data->top+node_data->bottom);
+
+		if (LOD_HIDDEN == node_data->lod)
+			continue;
+
+		if (LOD_COLLAPSED == node_data->lod) {
+			char *label = collapsed_clade_label(node);
+			if (NULL == label) return FAILURE;
+			double h_pos, v_pos;
+			collapsed_clade_label_position(node, h_scale, v_scale,
+					&h_pos, &v_pos);
+			int status = svg_buffer_text(buf, leaf_label_class,
+					NULL, h_pos, v_pos, 0, false, label);
+			free(label);
+			if (! status) return FAILURE;
+		} else if (0 != strcmp(node->label, "")) {
+			char *url = NULL;
+			if (url_map) url = hash_get(url_map, node->label);
+			char *class;
+			if (is_leaf(node))
+				class = leaf_label_class;
+			else
+				class = inner_label_class;
+			if (UNSTYLED_CLADE != node_data->lbl_group_nb) {
+				class = masprintf("%s clade_%d", class,
+						node_data->lbl_group_nb);
+				if (NULL == class) return FAILURE;
+			}
+			double h_pos, v_pos;
+			label_position(svg_h_pos, svg_mid_pos, h_scale, node,
+					&h_pos, &v_pos);
+			int status = svg_buffer_text(buf, class, url,
+					h_pos, v_pos, 0, false, node->label);
+			if (UNSTYLED_CLADE != node_data->lbl_group_nb)
+				free (class);
+			if (! status) return FAILURE;
+		}
+
+		/* Branch lengths */
+		if (! is_root(node) &&
+			0 != strcmp(node->edge_length_as_string, "")) {
+			struct svg_data *parent_data = node->parent->data;
+			double svg_parent_h_pos = ROOT_SPACE + (
+				h_scale * parent_data->depth);
+			if (! svg_buffer_text(buf, "edge-label", NULL,
+				(svg_h_pos + svg_parent_h_pos) / 2.0,
+				edge_length_v_offset + svg_mid_pos, 0, false,
+				node->edge_length_as_string))
+				return FAILURE;
+		}
+	}
+
+	printf( "<g style='stroke:none'>");
+	svg_buffer_dump_text(buf);
+	printf("</g>");
+
+	return SUCCESS;
 }
 
-void display_svg_tree_orthogonal(struct rooted_tree *tree,
+int display_svg_tree_orthogonal(struct rooted_tree *tree,
 		struct h_data hd, int align_leaves, int with_scale_bar,
 		char *branch_length_unit)
 {
@@ -279,6 +542,11 @@ void display_svg_tree_orthogonal(struct rooted_tree *tree,
 	else
 		assert(0);	/* scale cannot be 0 */
 
+	if (lod_threshold > 0)
+		if (! set_lod(tree, align_leaves, hd.d_max, clade_extent,
+				&v_scale))
+			return FAILURE;
+
 	/* Tree is in a separate group - may be useful when (if?) there are
 	 * more than one tree*/
 	printf( "<g"
@@ -286,9 +554,25 @@ void display_svg_tree_orthogonal(struct rooted_tree *tree,
 		">", whole_v_shift);
 	/* We draw all the tree's branches in an SVG group of their own, to
 	 * facilitate editing via Inkscape, Illustrator, etc. */
-	draw_branches_ortho(tree, h_scale, v_scale, align_leaves, hd.d_max);
-	/* ... likewise for text */
-	draw_text_ortho(tree, h_scale, v_scale, align_leaves, hd.d_max);
+	if (compact_svg) {
+		struct svg_buffer *buf = create_svg_buffer();
+		if (NULL == buf) return FAILURE;
+		if (! draw_branches_ortho_compact(tree, h_scale, v_scale,
+				align_leaves, hd.d_max, buf))
+			return FAILURE;
+		if (! draw_text_ortho_compact(tree, h_scale, v_scale,
+				align_leaves, hd.d_max, buf))
+			return FAILURE;
+		destroy_svg_buffer(buf);
+	} else {
+		if (! draw_branches_ortho(tree, h_scale, v_scale,
+				align_leaves, hd.d_max))
+			return FAILURE;
+		/* ... likewise for text */
+		if (! draw_text_ortho(tree, h_scale, v_scale, align_leaves,
+				hd.d_max))
+			return FAILURE;
+	}
 	/* Draw scale bar if required */
 	if (with_scale_bar) {
 		double scalebar_vpos = (double) graph_height(leaf_count(tree),
@@ -297,4 +581,6 @@ void display_svg_tree_orthogonal(struct rooted_tree *tree,
 			branch_length_unit);
 	}
 	printf ("</g>");
+
+	return SUCCESS;
 }
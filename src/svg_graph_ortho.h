@@ -38,7 +38,10 @@ extern double leaf_vskip;
 
 int graph_height(int, int);
 
-void display_svg_tree_orthogonal (
+/* Displays an orthogonal tree in an SVG <g> element. Returns FAILURE iff
+ * memory is exhausted. */
+
+int display_svg_tree_orthogonal (
 		struct rooted_tree *tree,
 		struct h_data hd,
 		int align_leaves,
@@ -51,6 +51,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "math.h"
 #include "masprintf.h"
 #include "common.h"
+#include "svg_buffer.h"
 
 /* If USE_LIBXML2 is not defined, we explicitly define it to false. */
 #ifndef USE_LIBXML2	
@@ -164,7 +165,7 @@ static void nudge_baseline(xmlNodePtr node)
  * is to do compose the new tranform to the existing ones (think matrix
  * multiplication) */
 
-static void prepend_transform(xmlNodePtr node, char *transform)
+static void prepend_transform(xmlNodePtr node, const char *transform)
 {
 	const xmlChar *attr = (xmlChar *) "transform";
 	xmlChar *value = xmlGetProp(node, attr);
@@ -182,34 +183,15 @@ static void prepend_transform(xmlNodePtr node, char *transform)
 	}
 }
 
-/* adds a translation(x,y) to the element */
+/* special transforms for <text> elements: the text is nudged above the
+ * baseline, and either end-anchored (right side) or turned around the node by
+ * 'half_turn' (left side), so that it always reads left-to-right. */
 
-static void translate(xmlNodePtr node, double x, double y)
-{
-	char *translation = masprintf("translate(%g,%g)", x, y);
-	prepend_transform(node, translation);
-	free(translation);
-}
-
-/* adds a rotation(angle_deg) to the element */
-
-static void rotate(xmlNodePtr node, double angle_deg)
-{
-	// NOTE: if tests fail due to rounding errors in rotation angles,
-	// change the %g below into %f.
-	// char *rotation = masprintf("rotate(%.2f)", angle_deg);
-	char *rotation = masprintf("rotate(%g)", angle_deg);
-	prepend_transform(node, rotation);
-	free(rotation);
-}
-
-/* special transforms for <text> elements */
-
-static void text_transforms(xmlNodePtr node, double angle_deg,
-		double x, double y)
+static void text_transforms(xmlNodePtr node, bool left_side,
+		const char *half_turn)
 {
 	nudge_baseline(node); /* so text can be read */
-	if (angle_deg <= 90 || angle_deg >= 270) {
+	if (! left_side) {
 		// right side (cos >= 0) 
 		/* ensure end-anchoring */
 		xmlChar *style_attr = (xmlChar*) "style";
@@ -227,9 +209,7 @@ static void text_transforms(xmlNodePtr node, double angle_deg,
 		}
 	} else {
 		// left side (cos < 0)
-		char * half_turn = masprintf("rotate(180,%g,%g)", x, y);
 		prepend_transform(node, half_turn);
-		free(half_turn);
 		/* the rotation causes any x value to have wrong sign, so: */
 		change_x_sign(node); 
 	}
@@ -290,37 +270,45 @@ static void shift_one_width_leafwards(xmlNodePtr node)
 	xmlFree(width_value);
 }	
 
-static void image_transforms(xmlNodePtr node, double angle_deg,
-		double x, double y)
+static void image_transforms(xmlNodePtr node, bool left_side,
+		const char *half_turn)
 {
 	center_vertically(node);
 	/* if the image is on the left side, we i) rotate it 180° around the
 	 * node (tip of the parent edge)(so that it is not upside-down), and
 	 * ii) shift it one image length leafwards (to correct for the
 	 * rootwards shift caused by rotation) */
-	if (angle_deg > 90 && angle_deg < 270) {
+	if (left_side) {
 		// left side (cos < 0)
-		char * half_turn = masprintf("rotate(180,%g,%g)", x, y);
 		prepend_transform(node, half_turn);
-		free(half_turn);
 		shift_one_width_leafwards(node);
 	}
 }
 
-void apply_transforms(xmlDocPtr doc, double angle_deg, double x, double y)
+/* Applies the transforms to the snippet's elements: 'transform' (rotation and
+ * translation to the node's position) to all of them, and 'half_turn' (a
+ * 180° rotation around the node) to text and images on the left side. Returns
+ * the number of transforms applied. */
+
+static int apply_transforms(xmlDocPtr doc, bool left_side,
+		const char *transform, const char *half_turn)
 {
+	int nb_transforms = 0;
 	xmlNodePtr cur = xmlDocGetRootElement(doc)->xmlChildrenNode;
-	while (NULL != cur) {
-		/* apply the transforms, in this order */
-		rotate(cur, angle_deg);
-		translate(cur, x, y);
+	for (; NULL != cur; cur = cur->next) {	/* siblings */
+		if (XML_ELEMENT_NODE != cur->type)
+			continue;
+		prepend_transform(cur, transform);
+		nb_transforms++;
 		if (strcmp("text", (char *) cur->name) == 0)
-			text_transforms(cur, angle_deg, x, y);
+			text_transforms(cur, left_side, half_turn);
 		else if (strcmp("image", (char *) cur->name) == 0)
-			image_transforms(cur, angle_deg, x, y);
-
-		cur = cur->next;	/* sibling */
+			image_transforms(cur, left_side, half_turn);
+		else
+			continue;
+		if (left_side) nb_transforms++;
 	}
+	return nb_transforms;
 }
 
 /* unwraps the snippet out of its dummy doc, ready for embedding in the final
@@ -352,27 +340,15 @@ static char *unwrap_snippet(xmlDocPtr doc)
 	return tweaked_svg;
 }
 
-/* Transforms SVG elements by parsing XML. Argument is the ornaments string as
- * in the ornament file (i.e., an SVG snippet). Returns (and allocates - you
- * must free it) another SVG snippet in which the elements have been
- * transformed.
- * Transformations * include:
- *	o translation to node position (all elements)
- *	o rotation (the same as node edge and node labels) (all elements)
- *	o 180° rotation and/or alignment (text - so that it always reads
- *	  left-to-right)
- *	o further rotation and translation (images - so that they are oriented
- *	  right)
- *
- * This f() is not static because it needs to be tested directly (in
- * test_svg_graph_radial); but it is not in any header file either, because it
- * is not meant to be used outside this module.
- * Returns NULL in case of failure. */
+/* Parses the snippet, applies the transforms (see apply_transforms()) and
+ * returns the transformed snippet, or NULL in case of failure. If
+ * 'nb_transforms' is not NULL, it is set to the number of transforms
+ * applied. */
 
-char *xml_transform_ornaments(const char *ornaments, double angle_deg, double x,
-		double y)
+static char *transform_snippet(const char *ornaments, bool left_side,
+		const char *transform, const char *half_turn,
+		int *nb_transforms)
 {
-
 	xmlDocPtr doc;
 
 	char *wrapped_orn = wrap_in_dummy_doc(ornaments);
@@ -380,14 +356,15 @@ char *xml_transform_ornaments(const char *ornaments, double angle_deg, double x,
 
 	/* parse SVG from string */
 	doc = xmlParseMemory(wrapped_orn, strlen(wrapped_orn));
+	free(wrapped_orn);
 	if (NULL == doc) {
 		fprintf(stderr, "Failed to parse document\n");
 		return NULL;
 	}
-	free(wrapped_orn);
 
 	/* tweak according to element type */
-	apply_transforms(doc, angle_deg, x, y);
+	int n = apply_transforms(doc, left_side, transform, half_turn);
+	if (NULL != nb_transforms) *nb_transforms = n;
 
 	/* now get the altered snipped, unwrapped (will be NULL if there was a
 	 * problem).  */
@@ -397,6 +374,238 @@ char *xml_transform_ornaments(const char *ornaments, double angle_deg, double x,
 	return tweaked_svg;
 }
 
+/* Ornament templates. Parsing and serializing an ornament for each node is
+ * slow, but apart from the transforms (which depend on the node's position),
+ * the result is the same for all nodes on the same side of the tree. So each
+ * distinct ornament is transformed only once per side, with marks instead of
+ * the actual transforms, and the result is cut at the marks. For a node, we
+ * then just paste the pieces and the node's transforms together. */
+
+#define TRANSFORM_MARK "@NW_TRANSFORM@"
+#define HALF_TURN_MARK "@NW_HALF_TURN@"
+#define MARK_LENGTH 14		/* both marks */
+#define ORNAMENT_TEMPLATES_HASH_SIZE 100
+
+struct ornament_side {
+	bool compiled;
+	int nb_marks;		/* -1 if the marks are unusable (see below) */
+	char *buffer;		/* the transformed snippet; holds the pieces */
+	char **pieces;		/* nb_marks + 1 pieces */
+	size_t *lengths;	/* of the pieces */
+	bool *half_turns;	/* true iff mark i is a HALF_TURN_MARK */
+};
+
+struct ornament_template {
+	struct ornament_side sides[2];	/* right, left */
+};
+
+/* Keyed by ornament. Nodes have their own copy of their ornament, so we can't
+ * use its address. */
+
+static struct hash *ornament_templates = NULL;
+
+/* Returns the next mark in 's', or NULL if there are none. Sets 'half_turn'
+ * according to the mark's type. */
+
+static char *next_mark(char *s, bool *half_turn)
+{
+	for (s = strchr(s, '@'); NULL != s; s = strchr(s + 1, '@')) {
+		if (0 == strncmp(s, TRANSFORM_MARK, MARK_LENGTH)) {
+			*half_turn = false;
+			return s;
+		}
+		if (0 == strncmp(s, HALF_TURN_MARK, MARK_LENGTH)) {
+			*half_turn = true;
+			return s;
+		}
+	}
+	return NULL;
+}
+
+/* Transforms the ornament for one side of the tree, with marks instead of the
+ * transforms, and cuts it at the marks. Returns FAILURE iff memory is
+ * exhausted or the ornament can't be parsed. */
+
+static int compile_ornament_side(const char *ornaments, bool left_side,
+		struct ornament_side *side)
+{
+	int nb_transforms;
+	char *marked = transform_snippet(ornaments, left_side,
+			TRANSFORM_MARK, HALF_TURN_MARK, &nb_transforms);
+	if (NULL == marked) return FAILURE;
+
+	int nb_marks = 0;
+	bool half_turn;
+	char *mark;
+	for (mark = next_mark(marked, &half_turn); NULL != mark;
+			mark = next_mark(mark + MARK_LENGTH, &half_turn))
+		nb_marks++;
+	side->compiled = true;
+	/* If the ornament itself contains something that looks like a mark,
+	 * we can't tell them apart: this side is then transformed for each
+	 * node, as before. */
+	if (nb_marks != nb_transforms) {
+		free(marked);
+		side->nb_marks = -1;
+		return SUCCESS;
+	}
+
+	side->buffer = marked;
+	side->nb_marks = nb_marks;
+	side->pieces = malloc((nb_marks + 1) * sizeof(char *));
+	side->lengths = malloc((nb_marks + 1) * sizeof(size_t));
+	side->half_turns = malloc((nb_marks + 1) * sizeof(bool));
+	if (NULL == side->pieces || NULL == side->lengths ||
+			NULL == side->half_turns)
+		return FAILURE;
+
+	char *piece = marked;
+	int i;
+	for (i = 0; i < nb_marks; i++) {
+		mark = next_mark(piece, &side->half_turns[i]);
+		side->pieces[i] = piece;
+		side->lengths[i] = mark - piece;
+		*mark = '\0';
+		piece = mark + MARK_LENGTH;
+	}
+	side->pieces[nb_marks] = piece;
+	side->lengths[nb_marks] = strlen(piece);
+
+	return SUCCESS;
+}
+
+/* Returns the template for the ornament's side, compiling it if needed, or
+ * NULL in case of failure. */
+
+static struct ornament_side *get_ornament_side(const char *ornaments,
+		bool left_side)
+{
+	if (NULL == ornament_templates) {
+		ornament_templates = create_hash(ORNAMENT_TEMPLATES_HASH_SIZE);
+		if (NULL == ornament_templates) return NULL;
+	}
+	struct ornament_template *template = hash_get(ornament_templates,
+			ornaments);
+	if (NULL == template) {
+		template = calloc(1, sizeof(struct ornament_template));
+		if (NULL == template) return NULL;
+		if (! hash_set(ornament_templates, ornaments, template)) {
+			free(template);
+			return NULL;
+		}
+	}
+	struct ornament_side *side = &template->sides[left_side];
+	if (! side->compiled)
+		if (! compile_ornament_side(ornaments, left_side, side))
+			return NULL;
+	return side;
+}
+
+/* Pastes the template's pieces and the transforms together. Returns NULL iff
+ * memory is exhausted. */
+
+static char *fill_ornament_side(struct ornament_side *side,
+		const char *transform, const char *half_turn)
+{
+	size_t transform_length = strlen(transform);
+	size_t half_turn_length = strlen(half_turn);
+	size_t length = 0;
+	int i;
+	for (i = 0; i <= side->nb_marks; i++)
+		length += side->lengths[i];
+	for (i = 0; i < side->nb_marks; i++)
+		length += side->half_turns[i] ?
+			half_turn_length : transform_length;
+
+	char *result = malloc(length + 1);
+	if (NULL == result) return NULL;
+	char *p = result;
+	for (i = 0; i < side->nb_marks; i++) {
+		memcpy(p, side->pieces[i], side->lengths[i]);
+		p += side->lengths[i];
+		if (side->half_turns[i]) {
+			memcpy(p, half_turn, half_turn_length);
+			p += half_turn_length;
+		} else {
+			memcpy(p, transform, transform_length);
+			p += transform_length;
+		}
+	}
+	memcpy(p, side->pieces[i], side->lengths[i]);
+	p[side->lengths[i]] = '\0';
+
+	return result;
+}
+
+/* Frees all ornament templates */
+
+static void destroy_ornament_templates()
+{
+	if (NULL == ornament_templates) return;
+	struct llist *keys = hash_keys(ornament_templates);
+	if (NULL != keys) {
+		struct list_elem *elem;
+		for (elem = keys->head; NULL != elem; elem = elem->next) {
+			struct ornament_template *template = hash_get(
+					ornament_templates, elem->data);
+			int i;
+			for (i = 0; i < 2; i++) {
+				struct ornament_side *side =
+					&template->sides[i];
+				free(side->buffer);
+				free(side->pieces);
+				free(side->lengths);
+				free(side->half_turns);
+			}
+			free(template);
+		}
+		destroy_llist(keys);
+	}
+	destroy_hash(ornament_templates);
+	ornament_templates = NULL;
+}
+
+/* Transforms SVG elements by parsing XML. Argument is the ornaments string as
+ * in the ornament file (i.e., an SVG snippet). Returns (and allocates - you
+ * must free it) another SVG snippet in which the elements have been
+ * transformed.
+ * Transformations * include:
+ *	o translation to node position (all elements)
+ *	o rotation (the same as node edge and node labels) (all elements)
+ *	o 180° rotation and/or alignment (text - so that it always reads
+ *	  left-to-right)
+ *	o further rotation and translation (images - so that they are oriented
+ *	  right)
+ * The parsing is only done once per distinct ornament and side of the tree
+ * (see ornament templates, above).
+ *
+ * This f() is not static because it needs to be tested directly (in
+ * test_svg_graph_radial); but it is not in any header file either, because it
+ * is not meant to be used outside this module.
+ * Returns NULL in case of failure. */
+
+char *xml_transform_ornaments(const char *ornaments, double angle_deg, double x,
+		double y)
+{
+	bool left_side = angle_deg > 90 && angle_deg < 270;
+	struct ornament_side *side = get_ornament_side(ornaments, left_side);
+	if (NULL == side) return NULL;
+
+	/* plenty: %g is at most 13 characters */
+	char transform[100];
+	char half_turn[100];
+	// NOTE: if tests fail due to rounding errors in rotation angles,
+	// change the %g below into %f.
+	snprintf(transform, sizeof(transform), "translate(%g,%g) rotate(%g)",
+			x, y, angle_deg);
+	snprintf(half_turn, sizeof(half_turn), "rotate(180,%g,%g)", x, y);
+
+	if (side->nb_marks < 0)
+		return transform_snippet(ornaments, left_side, transform,
+				half_turn, NULL);
+	return fill_ornament_side(side, transform, half_turn);
+}
+
 #endif	/* USE_LIBXML2 */
 
 /* Embeds the ornaments in an SVG <g> tag, performing some crude transforms
@@ -439,6 +648,58 @@ static char *transform_ornaments(const char *svg_ornaments, double angle_deg,
 #endif
 }
 
+/* Scales passed to clade_extent() through set_lod() */
+
+struct radial_scales {
+	double r_scale;
+	double a_scale;
+};
+
+/* Extent of a clade, for LOD (see set_lod()): the length of the arc spanned by
+ * its leaves, at the depth of the deepest one */
+
+static double clade_extent(struct svg_data *node_data, void *scales)
+{
+	struct radial_scales *sc = scales;
+	double radius = root_length + (sc->r_scale * node_data->max_depth);
+	return node_data->nb_leaves * sc->a_scale * radius;
+}
+
+/* Position of a collapsed clade's wedge: its apex is the node, and its base is
+ * an arc that spans the clade's leaves, at the depth of the deepest one. */
+
+static void collapsed_clade_base(struct rnode *node, const double r_scale,
+		const double a_scale, double *radius, double *top_angle,
+		double *bottom_angle)
+{
+	struct svg_data *node_data = node->data;
+	*radius = root_length + (r_scale * node_data->max_depth);
+	*top_angle = a_scale *
+		((struct svg_data *) first_leaf(node)->data)->top;
+	*bottom_angle = a_scale *
+		((struct svg_data *) last_leaf(node)->data)->top;
+}
+
+/* Returns the SVG for a collapsed clade, or NULL if memory is exhausted */
+
+static char *collapsed_clade(struct rnode *node, const double r_scale,
+		const double a_scale, double mid_x_pos, double mid_y_pos)
+{
+	struct svg_data *node_data = node->data;
+	double radius, top_angle, bottom_angle;
+	collapsed_clade_base(node, r_scale, a_scale, &radius, &top_angle,
+			&bottom_angle);
+	int large_arc_flag = bottom_angle - top_angle > PI;
+	return masprintf("<path class='clade_%d collapsed' "
+			"d='M%.4f,%.4f L%.4f,%.4f A%.4f,%.4f 0 %d 1 "
+			"%.4f,%.4f Z'/>",
+			node_data->group_nb, mid_x_pos, mid_y_pos,
+			radius * cos(top_angle), radius * sin(top_angle),
+			radius, radius, large_arc_flag,
+			radius * cos(bottom_angle),
+			radius * sin(bottom_angle));
+}
+
 /* Draws the arc for inner nodes, including root */
 
 /* NOTE: we keep 'large_arc_flag' as an int (even though it is semantically a
@@ -541,8 +802,12 @@ static int draw_branches_radial (
 		else
 			large_arc_flag = 0;
 
-		/* draw node (arc), except for leaves */
-		if (! is_leaf(node)) {
+		if (LOD_HIDDEN == node_data->lod)
+			continue;
+
+		/* draw node (arc), except for leaves (and collapsed
+		 * clades) */
+		if (LOD_SHOWN == node_data->lod && ! is_leaf(node)) {
 			draw_inner_node_arc(top_angle, bottom_angle,
 					radius, group_nb, large_arc_flag);
 		}
@@ -555,6 +820,13 @@ static int draw_branches_radial (
 					mid_x_pos, mid_y_pos,
 					group_nb);
 		}
+		if (LOD_COLLAPSED == node_data->lod) {
+			char *clade = collapsed_clade(node, r_scale, a_scale,
+					mid_x_pos, mid_y_pos);
+			if (NULL == clade) return FAILURE;
+			printf("%s", clade);
+			free(clade);
+		}
 		/* draw ornament, if any */ 
 		if (NULL != node_data->ornament)
 			if (!draw_ornament(node_data, mid_angle, mid_x_pos,
@@ -566,10 +838,107 @@ static int draw_branches_radial (
 	return SUCCESS;
 }
 
-/* lower-level label drawing */
+/* Compact version of draw_branches_radial(): the graphics go to 'buf' (see
+ * svg_buffer.h), then are printed. Returns FAILURE iff memory is exhausted. */
 
-static void place_label(const char *label, const double radius, double
-		mid_angle, const bool nudge, const char *class)
+static int draw_branches_radial_compact(struct rooted_tree *tree,
+		const double r_scale, const double a_scale, bool align_leaves,
+		double dmax, struct svg_buffer *buf)
+{
+	struct list_elem *elem;
+	for (elem=tree->nodes_in_order->head; NULL!=elem; elem=elem->next) {
+		struct rnode *node = elem->data;
+		struct svg_data *node_data = (struct svg_data *) node->data;
+
+		/* For cladograms */
+		if (align_leaves && is_leaf(node))
+			node_data->depth = dmax;
+
+		int group_nb = node_data->group_nb;
+		double radius = root_length + (r_scale * node_data->depth);
+		double top_angle = a_scale * node_data->top; 
+		double bottom_angle = a_scale * node_data->bottom; 
+		double mid_angle =
+			0.5 * a_scale * (node_data->top+node_data->bottom);
+		double mid_x_pos = radius * cos(mid_angle);
+		double mid_y_pos = radius * sin(mid_angle);
+
+		if (LOD_HIDDEN == node_data->lod)
+			continue;
+
+		/* draw node (arc), except for leaves (and collapsed
+		 * clades) */
+		if (LOD_SHOWN == node_data->lod && ! is_leaf(node)) {
+			int large_arc_flag = bottom_angle - top_angle > PI;
+			if (! svg_buffer_arc(buf, group_nb,
+				radius * cos(top_angle),
+				radius * sin(top_angle),
+				radius, large_arc_flag,
+				radius * cos(bottom_angle),
+				radius * sin(bottom_angle)))
+				return FAILURE;
+		}
+		/* draw radial line, from the node to its parent */
+		if (is_root(node)) {
+			if (! svg_buffer_line(buf, NO_CLASS,
+				mid_x_pos, mid_y_pos, 0, 0))
+				return FAILURE;
+		} else {
+			struct svg_data *parent_data = node->parent->data;
+			double parent_radius = root_length + (
+				r_scale * parent_data->depth);
+			if (! svg_buffer_line(buf, group_nb,
+				mid_x_pos, mid_y_pos,
+				parent_radius * cos(mid_angle),
+				parent_radius * sin(mid_angle)))
+				return FAILURE;
+		}
+		/* collapsed clades are filled, so they can't be merged with
+		 * the edges */
+		if (LOD_COLLAPSED == node_data->lod) {
+			char *clade = collapsed_clade(node, r_scale, a_scale,
+					mid_x_pos, mid_y_pos);
+			if (NULL == clade) return FAILURE;
+			if (! svg_buffer_append(buf, clade)) return FAILURE;
+			free(clade);
+		}
+		/* ornaments are output after the paths (see
+		 * draw_ornament()) */
+		if (NULL != node_data->ornament) {
+			char *transformed_ornaments = transform_ornaments(
+					node_data->ornament,
+					mid_angle / (2*PI) * 360,
+					mid_x_pos, mid_y_pos);
+			if (NULL == transformed_ornaments) return FAILURE;
+			char *ornament = masprintf(
+				"<g style='stroke:none;fill:black'>%s</g>",
+				transformed_ornaments);
+			free(transformed_ornaments);
+			if (NULL == ornament) return FAILURE;
+			if (! svg_buffer_append(buf, ornament))
+				return FAILURE;
+			free(ornament);
+		}
+	}
+
+	printf( "<g"
+	       	" style='stroke:black;fill:none;stroke-width:1;"
+		"stroke-linecap:round'>"
+	    	);
+	svg_buffer_dump_paths(buf);
+	printf("</g>");
+
+	return SUCCESS;
+}
+
+/* lower-level label drawing. If 'buf' is not NULL, the label goes there
+ * (compact output, see svg_buffer.h) instead of being printed, and so does
+ * 'url' (otherwise the caller prints it). Returns FAILURE iff memory is
+ * exhausted. */
+
+static int place_label(const char *label, const double radius, double
+		mid_angle, const bool nudge, const char *class,
+		const char *url, struct svg_buffer *buf)
 {
 	double x_pos;
 	double y_pos;
@@ -581,6 +950,9 @@ static void place_label(const char *label, const double radius, double
 			x_pos -= (NUDGE_DISTANCE * cos(mid_angle + PI / 2));
 			y_pos -= (NUDGE_DISTANCE * sin(mid_angle + PI / 2));
 		}
+		if (NULL != buf)
+			return svg_buffer_text(buf, class, url, x_pos, y_pos,
+				mid_angle / (2*PI) * 360, false, label);
 		printf("<text class='%s' "
 		       "transform='rotate(%g,%g,%g)' "
 		       "x='%.4f' y='%.4f'>%s</text>",
@@ -597,6 +969,10 @@ static void place_label(const char *label, const double radius, double
 			x_pos += (NUDGE_DISTANCE * cos(mid_angle + PI / 2));
 			y_pos += (NUDGE_DISTANCE * sin(mid_angle + PI / 2));
 		}
+		/* rotating by 180 degrees around the same point */
+		if (NULL != buf)
+			return svg_buffer_text(buf, class, url, x_pos, y_pos,
+				mid_angle / (2*PI) * 360 + 180, true, label);
 		printf(	"<text class='%s' "
 			"style='text-anchor:end;' "
 			"transform='rotate(%f,%g,%g) rotate(180,%g,%g)' "
@@ -607,12 +983,16 @@ static void place_label(const char *label, const double radius, double
 			x_pos, y_pos,
 			x_pos, y_pos, label);
 	}
+
+	return SUCCESS;
 }
 
-/* Draws a node label */
+/* Draws a node label. As for place_label(), 'buf' is for compact output and
+ * may be NULL. Returns FAILURE iff memory is exhausted. */
 
-static void draw_label(struct rnode *node, double radius,
-		double mid_angle, const double r_scale)
+static int draw_label(struct rnode *node, double radius,
+		double mid_angle, const double r_scale,
+		struct svg_buffer *buf)
 {
 	char *class;
 	if (is_leaf(node)) {
@@ -625,10 +1005,12 @@ static void draw_label(struct rnode *node, double radius,
 			
 	/* override 'class' iff node has lbl style */
 	struct svg_data *node_data = node->data;
-	if (UNSTYLED_CLADE != node_data->lbl_group_nb)
+	if (UNSTYLED_CLADE != node_data->lbl_group_nb) {
 		class = masprintf("%s clade_%d",
 				class,
 				node_data->lbl_group_nb);
+		if (NULL == class) return FAILURE;
+	}
 
 	char *url = NULL;
 	if (url_map) url = hash_get(url_map, node->label);
@@ -637,7 +1019,7 @@ static void draw_label(struct rnode *node, double radius,
 	 * branch, rather than on the exact same line */
 	bool nudge = false;
 
-	if (url) printf ("<a %s>", url);
+	if (url && NULL == buf) printf ("<a %s>", url);
 
 	if (is_inner_node(node)) {
 		struct svg_data *parent_data = NULL;
@@ -664,20 +1046,26 @@ static void draw_label(struct rnode *node, double radius,
 		}
 	}
 
-	place_label(node->label, radius, mid_angle, nudge, class);
+	int status = place_label(node->label, radius, mid_angle, nudge, class,
+			url, buf);
 
-	if (url) printf("</a>");
+	if (url && NULL == buf) printf("</a>");
 
 	/* free iff was dynamically allocated */
 	if (UNSTYLED_CLADE != node_data->lbl_group_nb)
 		free (class);
+
+	return status;
 }
 
 
-/* Prints the node text (labels and lengths) in a <g> element, radial */
+/* Prints the node text (labels and lengths) in a <g> element, radial. If
+ * 'buf' is not NULL, the text is first collected there (compact output).
+ * Returns FAILURE iff memory is exhausted. */
 
-static void draw_text_radial (struct rooted_tree *tree, const double r_scale,
-		const double a_scale, bool align_leaves, double dmax)
+static int draw_text_radial (struct rooted_tree *tree, const double r_scale,
+		const double a_scale, bool align_leaves, double dmax,
+		struct svg_buffer *buf)
 {
 	printf( "<g style='stroke:none'>");
 
@@ -696,9 +1084,30 @@ static void draw_text_radial (struct rooted_tree *tree, const double r_scale,
 
 		mid_angle += label_angle_correction;
 
+		if (LOD_HIDDEN == node_data->lod)
+			continue;
+
+		/* a collapsed clade's label goes next to the middle of its
+		 * wedge's base, like a leaf label */
+		if (LOD_COLLAPSED == node_data->lod) {
+			char *label = collapsed_clade_label(node);
+			if (NULL == label) return FAILURE;
+			double base_radius, top_angle, bottom_angle;
+			collapsed_clade_base(node, r_scale, a_scale,
+				&base_radius, &top_angle, &bottom_angle);
+			int status = place_label(label,
+				base_radius + label_space,
+				0.5 * (top_angle + bottom_angle)
+					+ label_angle_correction,
+				false, leaf_label_class, NULL, buf);
+			free(label);
+			if (! status) return FAILURE;
+		}
 		/* draw label IFF it is nonempty */
-		if (0 != strcmp(node->label, ""))
-			draw_label(node, radius, mid_angle, r_scale);
+		else if (0 != strcmp(node->label, ""))
+			if (! draw_label(node, radius, mid_angle, r_scale,
+						buf))
+				return FAILURE;
 
 		/* draw edge length (except for root) */
 		if ((! is_root(node)) &&
@@ -707,11 +1116,17 @@ static void draw_text_radial (struct rooted_tree *tree, const double r_scale,
 			double parent_radius = root_length + (
 				r_scale * parent_data->depth);
 			radius = 0.5 * (radius + parent_radius);
-			place_label(node->edge_length_as_string, radius,
-					mid_angle, true, "edge-label");
+			if (! place_label(node->edge_length_as_string, radius,
+					mid_angle, true, "edge-label", NULL,
+					buf))
+				return FAILURE;
 		}
 	}
+	if (NULL != buf)
+		svg_buffer_dump_text(buf);
 	printf("</g>");
+
+	return SUCCESS;
 }
 
 /* Prints an SVG comment block with some run parameters. Useful for debugging */
@@ -783,17 +1198,44 @@ int display_svg_tree_radial(struct rooted_tree *tree,
 		 	graph_width / 2.0, graph_width / 2.0, rotation);
 	*/
 
+	if (lod_threshold > 0) {
+		struct radial_scales scales = { r_scale, a_scale };
+		if (! set_lod(tree, align_leaves, hd.d_max, clade_extent,
+				&scales))
+			return FAILURE;
+	}
+
 	printf( "<g transform='translate(%g,%g)'>", graph_width / 2.0,
 			graph_width / 2.0); 
 	/* We draw all the tree's branches in an SVG group of their own, to
 	 * facilitate editing. */
-	draw_branches_radial(tree, r_scale, a_scale, align_leaves, hd.d_max);
-	/* likewise for text */
-	draw_text_radial( tree, r_scale, a_scale, align_leaves, hd.d_max);
+	if (compact_svg) {
+		struct svg_buffer *buf = create_svg_buffer();
+		if (NULL == buf) return FAILURE;
+		if (! draw_branches_radial_compact(tree, r_scale, a_scale,
+				align_leaves, hd.d_max, buf))
+			return FAILURE;
+		if (! draw_text_radial(tree, r_scale, a_scale, align_leaves,
+				hd.d_max, buf))
+			return FAILURE;
+		destroy_svg_buffer(buf);
+	} else {
+		if (! draw_branches_radial(tree, r_scale, a_scale,
+				align_leaves, hd.d_max))
+			return FAILURE;
+		/* likewise for text */
+		if (! draw_text_radial(tree, r_scale, a_scale, align_leaves,
+				hd.d_max, NULL))
+			return FAILURE;
+	}
 	printf ("</g>");
 	if (with_scale_bar)
 		draw_scale_bar(Scale_bar_left_space, (double) graph_width,
 			r_scale, hd.d_max, branch_length_unit);
 
+#if USE_LIBXML2
+	destroy_ornament_templates();
+#endif
+
 	return SUCCESS;
 }
@@ -38,9 +38,10 @@ struct rooted_tree;
 
 void set_svg_root_length(int);
 
-/* Displays a radial tree in an SVG <g> element */
+/* Displays a radial tree in an SVG <g> element. Returns FAILURE iff memory is
+ * exhausted. */
 
-void display_svg_tree_radial(
+int display_svg_tree_radial(
 		struct rooted_tree *tree,
 		struct h_data hd,
 		int align_leaves,
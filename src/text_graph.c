@@ -115,118 +115,224 @@ void decorate_edge(struct canvas *canvas, struct rnode *node,
 		canvas_draw_node_to_edge(canvas, parent_h_pos, mid);
 }
 
-/* Writes the nodes to the canvas. Assumes that the edges have been
- * attributed a double value in field 'length' (in this case, it is done in
- * set_node_depth()). */
+/* The tree is drawn one row at a time, on a canvas of a single line, which is
+ * printed and cleared before the next row is drawn. This way, the memory
+ * needed does not grow with the number of leaves (a canvas for the whole tree
+ * would have two lines per leaf), and output starts right away.
+ *
+ * A row is affected by the nodes whose vertical line spans it ("open" nodes),
+ * which are a subset of the ancestors of the row's node(s). Where their
+ * drawings overlap, the result depends on the order in which they are drawn
+ * (e.g. '-' over '|' gives '+'), so each row is drawn exactly in the order in
+ * which the nodes would be drawn on a full canvas: first the edges and nodes,
+ * in reverse Newick order (which makes fixing edges easier), then the labels,
+ * in Newick order, then the root. The open nodes are kept sorted by
+ * decreasing rank, i.e. in reverse Newick order. */
+
+/* Rows are twice the nodes' vertical positions (see set_node_vpos_cb()) */
+
+static int node_top_row(struct rnode *node)
+{
+	struct simple_node_pos *pos = node->data;
+	return rint(2*pos->top);
+}
 
-// TODO: refactor this f(), it's way too long
+static int node_bottom_row(struct rnode *node)
+{
+	struct simple_node_pos *pos = node->data;
+	return rint(2*pos->bottom);
+}
 
-void draw_tree(struct canvas *canvas, struct rooted_tree *tree,
-		const double scale, int align_leaves, double dmax,
-		enum inner_lbl_pos inner_label_pos, enum text_graph_style style)
+static int node_mid_row(struct rnode *node)
 {
-	struct list_elem *elem;
+	struct simple_node_pos *pos = node->data;
+	return rint(pos->top+pos->bottom); /* (2*top + 2*bottom) / 2 */
+}
 
-	struct llist *rev_nodes = llist_reverse(tree->nodes_in_order);
+static int node_h_pos(struct rnode *node, const double scale)
+{
+	struct simple_node_pos *pos = node->data;
+	return rint(ROOT_SPACE + (scale * pos->depth));
+}
 
-	/* The edges and nodes are drawn first, in reverse Newick order (makes
-	 * fixing edges easier) */
-	for (elem = rev_nodes->head; NULL != elem; elem = elem->next) {
-		struct rnode *node =  elem->data;
-		struct simple_node_pos *pos =  node->data;
-		/* For cladograms */
-		if (align_leaves && is_leaf(node))
-			pos->depth = dmax;
+/* Draws the part of 'node' (edge and vertical line) that is on row 'row', on
+ * the canvas' only line. */
+
+static void draw_node_row(struct canvas *canvas, struct rnode *node, int row,
+		const double scale, enum text_graph_style style)
+{
+	struct simple_node_pos *pos = node->data;
+	int h_pos = node_h_pos(node, scale);
+	int mid = node_mid_row(node);
+	int parent_h_pos;
+	int parent_mid;
+
+	/* draw node */
+	canvas_draw_vline(canvas, h_pos, 0, 0);
+	if (mid != row)
+		return;
+
+	if (is_root(node)) {
+		parent_mid = -1;
+		/* parent H pos is ROOT_SPACE if root has length, or
+		 * 0 otherwise. */
+		if (0 == pos->depth) 
+			parent_h_pos = 0;
+		else
+			parent_h_pos = ROOT_SPACE;
+	} else {
+		parent_h_pos = node_h_pos(node->parent, scale);
+		parent_mid = node_mid_row(node->parent);
+	}
+	canvas_draw_hline(canvas, 0, parent_h_pos, h_pos);
+	/* rows are relative to the canvas' line */
+	decorate_edge(canvas, node, 0, h_pos, parent_mid - row, parent_h_pos,
+			style);
+}
+
+static void write_label(struct canvas *canvas, struct rnode *node,
+		const double scale, enum inner_lbl_pos inner_label_pos)
+{
+	/* Don't bother printing label if it is "" */
+	if (strcmp(node->label, "") == 0)
+		return;
 
-		int h_pos = rint(ROOT_SPACE + (scale * pos->depth));
-		int top = rint(2*pos->top);
-		int bottom = rint(2*pos->bottom);
-		int mid = rint(pos->top+pos->bottom);	/* (2*top + 2*bottom) / 2 */ // TODO is rint() needed
-		struct simple_node_pos *parent_data;
-		int parent_h_pos;
-		int parent_mid;
-		/* draw node */
-		canvas_draw_vline(canvas, h_pos, top, bottom);
-		if (is_root(node)) {
-			parent_data = NULL;
-			parent_mid = -1;
-			/* parent H pos is ROOT_SPACE if root has length, or
-			 * 0 otherwise. */
-			if (0 == pos->depth) 
-				parent_h_pos = 0;
-			else
-				parent_h_pos = ROOT_SPACE;
-		} else {
-			parent_data = node->parent->data;
-			parent_h_pos = rint(ROOT_SPACE +
-					(scale * parent_data->depth));
-			parent_mid = rint(parent_data->top +
-					parent_data->bottom); // see above about rint()
+	struct simple_node_pos *pos = node->data;
+	int h_pos;
+
+	/* print label */
+	if (is_inner_node(node)) {
+		double parent_depth = (
+			(struct simple_node_pos *)
+				node->parent->data)->depth;
+		switch (inner_label_pos) {
+		case INNER_LBL_LEAVES:
+			/* rint() rounds halfay, better than automatic
+			 * double->int conversion */
+			h_pos = rint(ROOT_SPACE + (scale * pos->depth));
+			h_pos += LBL_SPACE;
+			break;
+		case INNER_LBL_MIDDLE:
+			h_pos = rint(ROOT_SPACE + (scale *
+				(parent_depth + pos->depth) / 2));
+			break;
+		case INNER_LBL_ROOT:
+			h_pos = rint(ROOT_SPACE + (scale *
+				parent_depth));
+			h_pos += LBL_SPACE;
+			break;
+		default:
+			assert(0);
 		}
-		canvas_draw_hline(canvas, mid, parent_h_pos, h_pos);
-		decorate_edge(canvas, node, mid, h_pos, parent_mid, parent_h_pos, style);
+	} else {
+		// Root or leaves
+		h_pos = node_h_pos(node, scale) + LBL_SPACE;
 	}
+	canvas_write(canvas, h_pos, 0, node->label);
+}
 
-	destroy_llist(rev_nodes);
+/* Node, and the first row it is drawn on */
 
-	/* Then the labels are written. This separation of label-writing from
-	 * graph-drawing allows decorate_edge() to assume that no characters are
-	 * found in the canvas besides those that describe graph structure. */
-	// TODO: check the above comment
+struct node_start {
+	int row;
+	struct rnode *node;
+};
 
-	int mid; /* used after the loop */
-	for (elem = tree->nodes_in_order->head;
-			NULL != elem; elem = elem->next) {
-		struct rnode *node =  elem->data;
-		struct simple_node_pos *pos =  node->data;
+static int compare_node_starts(const void *a, const void *b)
+{
+	const struct node_start *sa = a;
+	const struct node_start *sb = b;
+	if (sa->row != sb->row)
+		return sa->row - sb->row;
+	return sa->node->rank - sb->node->rank;
+}
+
+/* Draws and prints rows 0 .. nb_rows-1 of the tree. Returns FAILURE iff
+ * memory can't be allocated. */
+
+static int draw_tree(struct canvas *canvas, struct rooted_tree *tree,
+		const double scale, int align_leaves, double dmax,
+		enum inner_lbl_pos inner_label_pos, enum text_graph_style style,
+		int nb_rows)
+{
+	int nb_nodes = tree->nodes_in_order->count;
+	struct node_start *starts = malloc(nb_nodes *
+			sizeof(struct node_start));
+	if (NULL == starts) return FAILURE;
+
+	struct list_elem *elem;
+	int rank = 0;
+	for (elem = tree->nodes_in_order->head; NULL != elem;
+			elem = elem->next, rank++) {
+		struct rnode *node = elem->data;
+		struct simple_node_pos *pos = node->data;
 		/* For cladograms */
 		if (align_leaves && is_leaf(node))
 			pos->depth = dmax;
-
-		int h_pos = rint(ROOT_SPACE + (scale * pos->depth));
-		int top = rint(2*pos->top);
-		int bottom = rint(2*pos->bottom);
-		mid = rint(pos->top+pos->bottom);	/* (2*top + 2*bottom) / 2 */
-
-		/* Don't bother printing label if it is "" */
-		if (strcmp(node->label, "") == 0)
-			continue;
-
-		/* print label */
-		if (is_inner_node(node)) {
-			double parent_depth = (
-				(struct simple_node_pos *)
-					node->parent->data)->depth;
-			switch (inner_label_pos) {
-			case INNER_LBL_LEAVES:
-				/* rint() rounds halfay, better than automatic
-				 * double->int conversion */
-				h_pos = rint(ROOT_SPACE + (scale * pos->depth));
-				h_pos += LBL_SPACE;
-				break;
-			case INNER_LBL_MIDDLE:
-				h_pos = rint(ROOT_SPACE + (scale *
-					(parent_depth + pos->depth) / 2));
-				break;
-			case INNER_LBL_ROOT:
-				h_pos = rint(ROOT_SPACE + (scale *
-					parent_depth));
-				h_pos += LBL_SPACE;
-				break;
-			default:
-				assert(0);
+		node->rank = rank;
+		starts[rank].row = node_top_row(node);
+		starts[rank].node = node;
+	}
+	qsort(starts, nb_nodes, sizeof(struct node_start),
+			compare_node_starts);
+
+	int root_mid = node_mid_row(tree->root);
+	struct rnode **open = NULL;
+	int nb_open = 0;
+	int open_capacity = 0;
+	int next_start = 0;
+	int row, i;
+
+	for (row = 0; row < nb_rows; row++) {
+		/* Close the nodes that end above this row... */
+		int nb_kept = 0;
+		for (i = 0; i < nb_open; i++)
+			if (node_bottom_row(open[i]) >= row)
+				open[nb_kept++] = open[i];
+		nb_open = nb_kept;
+		/* ...and open those that start on it. */
+		for (; next_start < nb_nodes && starts[next_start].row == row;
+				next_start++) {
+			struct rnode *node = starts[next_start].node;
+			if (nb_open == open_capacity) {
+				open_capacity = 2 * open_capacity + 16;
+				struct rnode **new_open = realloc(open,
+					open_capacity * sizeof(struct rnode *));
+				if (NULL == new_open) {
+					free(open);
+					free(starts);
+					return FAILURE;
+				}
+				open = new_open;
 			}
-		} else {
-			// Root or leaves
-			h_pos += LBL_SPACE;
+			for (i = nb_open; i > 0 && open[i-1]->rank < node->rank;
+					i--)
+				open[i] = open[i-1];
+			open[i] = node;
+			nb_open++;
 		}
-		canvas_write(canvas, h_pos, mid, node->label);
+
+		for (i = 0; i < nb_open; i++)
+			draw_node_row(canvas, open[i], row, scale, style);
+		/* Labels are written after the graph, so that decorate_edge()
+		 * can assume that no characters are found in the canvas
+		 * besides those that describe graph structure. */
+		for (i = nb_open - 1; i >= 0; i--)
+			if (node_mid_row(open[i]) == row)
+				write_label(canvas, open[i], scale,
+						inner_label_pos);
+		/* The decoration of the root must be done last, to overwrite
+		 * the edge decorations. */
+		if (row == root_mid)
+			canvas_draw_root(canvas, 0, 0);
+
+		canvas_dump(canvas);
+		canvas_clear(canvas);
 	}
 
-	/* The decoration of the root must be done at the end of this loop
-	 * (when node is the root), to overwrite the edge decorations done in
-	 * the previous loop. */
-	canvas_draw_root(canvas, 0, mid);
+	free(open);
+	free(starts);
+	return SUCCESS;
 }
 
 void draw_scalebar(struct canvas *canvas, const double scale,
@@ -289,6 +395,22 @@ void draw_scalebar(struct canvas *canvas, const double scale,
 
 }
 
+static struct canvas *create_text_canvas(int width, int height,
+		enum text_graph_style style)
+{
+	switch (style) {
+	case TEXT_STYLE_RAW:
+	case TEXT_STYLE_COMMAS:
+	case TEXT_STYLE_SLASHES:
+		return create_raw_canvas(width, height);
+	case TEXT_STYLE_VT100:
+		return create_vt100_canvas(width, height);
+	default:
+		assert(0);
+	}
+	return NULL;
+}
+
 /* We create a new canvas every time - we could reuse one, but this would then
 have to be passed, increasing coupling and diminishing implementation hiding.
 What's more, we can't assume that the new tree will fit in the old canvas. */
@@ -317,11 +439,6 @@ enum display_status display_tree(
 	double scale = -1;
 	struct canvas *canvasp;
 
-	int scalebar_space = 0;
-	if (with_scalebar)
-		scalebar_space = SCALEBAR_SPACE;
-	int height = 2 * num_leaves + scalebar_space;;
-
 	/* create canvas and draw nodes on it */
 	if (width > 0) 
 		scale = (width - hd.l_max - ROOT_SPACE - LBL_SPACE) / hd.d_max;
@@ -331,30 +448,24 @@ enum display_status display_tree(
 		width = scale * hd.d_max + hd.l_max;
 	}
 	if (0.0 == hd.d_max ) { scale = 1; } 	/* one-node trees */
-	switch (style) {
-	case TEXT_STYLE_RAW:
-	case TEXT_STYLE_COMMAS:
-	case TEXT_STYLE_SLASHES:
-		canvasp = create_raw_canvas(width, height);
-		break;
-	case TEXT_STYLE_VT100:
-		canvasp = create_vt100_canvas(width, height);
-		break;
-	default:
-		assert(0);
-	}
 
-	draw_tree(canvasp, tree, scale, align_leaves, hd.d_max,
-			inner_label_pos, style);
-	if (with_scalebar)
+	/* The tree is drawn one row at a time (see draw_tree()), and the
+	 * scale bar on its own canvas. */
+	canvasp = create_text_canvas(width, 1, style);
+	if (NULL == canvasp) return DISPLAY_MEM_ERROR;
+	if (! draw_tree(canvasp, tree, scale, align_leaves, hd.d_max,
+			inner_label_pos, style, 2 * num_leaves))
+		return DISPLAY_MEM_ERROR;
+	destroy_canvas(canvasp);
+
+	if (with_scalebar) {
+		canvasp = create_text_canvas(width, SCALEBAR_SPACE, style);
+		if (NULL == canvasp) return DISPLAY_MEM_ERROR;
 		draw_scalebar(canvasp, scale, hd.d_max, branch_length_units,
 				scale_zero_at_root);
-
-	/* output */
-	canvas_dump(canvasp);
-
-	/* release memory */
-	destroy_canvas(canvasp);
+		canvas_dump(canvasp);
+		destroy_canvas(canvasp);
+	}
 
 	return DISPLAY_OK;
 }
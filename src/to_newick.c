@@ -131,7 +131,7 @@ static int append_leaf(struct llist *result, struct rnode *current)
 	if (show_addresses) 
 		if (! append_element(result, masprintf("@%p", current)))
 			return FAILURE;
-	if (strcmp("", current->edge_length_as_string) != 0) {
+	if (has_edge_length(current)) {
 		if (! append_element(result, strdup(":")))
 			return FAILURE;
 		if (! append_element(result,
@@ -146,7 +146,6 @@ static int append_leaf(struct llist *result, struct rnode *current)
  * representing the end of an inner node. This always contains a ')', and may
  * also contain a label and a length (plus the node's address, if
  * show_addresses is true.) */
-/* Also, takes care of resetting the 'seen' member of the node. */
 /* Return value indicates SUCCESS or FAILURE. */
 
 static int append_inner_node_end(struct llist *result,
@@ -160,76 +159,72 @@ static int append_inner_node_end(struct llist *result,
 	if (show_addresses) 
 		if (! append_element( result, masprintf("@%p", current)))
 			return FAILURE;
-	if (strcmp("", current->edge_length_as_string) != 0) {
+	if (has_edge_length(current)) {
 		if (! append_element(result, strdup(":")))
 			return FAILURE;
 		if (! append_element(result,
 				strdup(current->edge_length_as_string)))
 			return FAILURE;
 	}
-	current->seen = 0;	/* reset */
 
 	return SUCCESS;
 }
 
 /* A helper function for to_newick_i(). Appends to 'result' strings
- * representing an inner node. */
+ * representing an inner node. What to append depends on how many children of
+ * the node have been visited so far (see rnode_traversal_visit_index()). */
 /* Return value indicates SUCCESS or FAILURE. */
 
-static int append_inner_node(struct rnode_iterator *it,
-		struct llist *result, struct rnode *current)
+static int append_inner_node(struct llist *result, struct rnode *current,
+		int visit_index)
 {
-	/* inner node: behaviour depends on whether we've
-	 * already 'seen' this node or not. */
-	if (0 == current->seen) {
-		/* not seen: print '(' */
-		current->seen = 1;
+	if (0 == visit_index) {
+		/* first visit: print '(' */
 		if (! append_element(result, strdup("(")))
 			return FAILURE;
+	} else if (visit_index < current->child_count) {
+		/* between two children */
+		if (! append_element(result, strdup(",")))
+			return FAILURE;
 	} else {
-		if (more_children_to_visit(it)) {
-			if (! append_element(result, strdup(",")))
-				return FAILURE;
-		}
-		else 
-			/* append ')' and possibly label and lenth */
-			if (! append_inner_node_end(result, current))
-				return FAILURE;
+		/* append ')' and possibly label and lenth */
+		if (! append_inner_node_end(result, current))
+			return FAILURE;
 	}
 
 	return SUCCESS;
 }
 
+/* The tree is visited by an Euler tour (see rnode_iterator.h), which does not
+ * touch the nodes: several threads can output the same tree at the same time.
+ * */
+
 struct llist *to_newick_i(struct rnode *node)
 {
-	struct rnode_iterator *it;
+	struct rnode_traversal *trav;
 	struct rnode *current;
 	struct llist *result = create_llist();
+	if (NULL == result) return NULL;
 
-	it = create_rnode_iterator(node);
-	if (NULL == it) return NULL;
+	trav = create_rnode_traversal(node, TRAVERSAL_EULER);
+	if (NULL == trav) return NULL;
 	
-	struct rnode *it_root = get_rnode_iterator_root(it);
-	it_root->seen = 1;
-
-	if (! is_leaf(it_root))
-		if (! append_element(result, strdup("(")))
-			return NULL;
-
-	while ((current = rnode_iterator_next(it)) != NULL) {
+	while ((current = rnode_traversal_next(trav)) != NULL) {
 		if (is_leaf(current)) {
 			if (! append_leaf(result, current))
 				return NULL;
 		}
 		else {
-			if (! append_inner_node(it, result, current))
+			if (! append_inner_node(result, current,
+				rnode_traversal_visit_index(trav)))
 				return NULL;
 		}
 	}
+	if (rnode_traversal_failed(trav)) return NULL;
 	if (! append_element(result, strdup(";")))
 		return NULL;
 
-	destroy_rnode_iterator(it);
+	destroy_rnode_traversal(trav);
 
 	return result;
 }
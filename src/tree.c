@@ -28,6 +28,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 */
 #include <stdlib.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <string.h>
 #include <sys/types.h>
@@ -182,7 +183,7 @@ enum tree_type get_tree_type(struct rooted_tree *tree)
 	struct list_elem *el;
 	for (el = tree->nodes_in_order->head; NULL != el; el = el->next) {
 		struct rnode *current = el->data;
-		if (strcmp(current->edge_length_as_string, "") == 0)	/* length is empty (NOT zero!) */
+		if (! has_edge_length(current))	/* length is empty (NOT zero!) */
 			nb_edges_without_lengths++;
 		else
 			nb_edges_with_lengths++;
@@ -193,7 +194,7 @@ enum tree_type get_tree_type(struct rooted_tree *tree)
 	else if (nb_edges_with_lengths == nb_nodes) 
 		return TREE_TYPE_PHYLOGRAM;
 	else if (nb_edges_with_lengths == nb_nodes - 1
-		&& strcmp("", tree->root->edge_length_as_string) == 0)
+		&& ! has_edge_length(tree->root))
 		return TREE_TYPE_PHYLOGRAM;
 	else
 		return TREE_TYPE_NEITHER;	/* weird, but legal */
@@ -280,3 +281,193 @@ struct rooted_tree *clone_tree_cond(struct rooted_tree *target,
 
 	return result;
 }
+
+void track_nodes_in_order(struct rooted_tree *tree)
+{
+	struct list_elem **link = &(tree->nodes_in_order->head);
+	for (; NULL != *link; link = &((*link)->next))
+		((struct rnode *) (*link)->data)->order_link = link;
+}
+
+/* Returns the element whose 'next' member is 'link', or NULL if 'link' is the
+ * list's head. */
+
+static struct list_elem *link_owner(struct llist *list,
+		struct list_elem **link)
+{
+	if (&(list->head) == link) return NULL;
+	return (struct list_elem *) ((char *) link -
+			offsetof(struct list_elem, next));
+}
+
+/* Removes (and frees) the run of consecutive elements of 'list' from that of
+ * 'first' to that of 'last', which must both be tracked. Apart from freeing
+ * the run, this takes constant time. */
+
+static void remove_node_run(struct llist *list, struct rnode *first,
+		struct rnode *last)
+{
+	struct list_elem **link = first->order_link;
+	struct list_elem *el = *link;
+	struct list_elem *end = *(last->order_link);
+	struct list_elem *after = end->next;
+
+	*link = after;
+	if (NULL == after)
+		list->tail = link_owner(list, link);
+	else
+		((struct rnode *) after->data)->order_link = link;
+
+	for (;;) {
+		struct list_elem *next = el->next;
+		bool done = (el == end);
+		((struct rnode *) el->data)->order_link = NULL;
+		free(el);
+		list->count--;
+		if (done) break;
+		el = next;
+	}
+}
+
+int splice_out_rnode_in_tree(struct rooted_tree *tree, struct rnode *node)
+{
+	if (NULL == node->order_link) return FAILURE;
+	if (! splice_out_rnode(node)) return FAILURE;
+	remove_node_run(tree->nodes_in_order, node, node);
+	return SUCCESS;
+}
+
+int insert_node_above_in_tree(struct rooted_tree *tree, struct rnode *node,
+		char *label)
+{
+	struct llist *list = tree->nodes_in_order;
+
+	if (NULL == node->order_link) return FAILURE;
+	if (! insert_node_above(node, label)) return FAILURE;
+
+	/* The new node is node's parent, and node is its only child: it comes
+	 * right after node in postorder. */
+	struct list_elem *el = *(node->order_link);
+	struct list_elem *new_el = malloc(sizeof(struct list_elem));
+	if (NULL == new_el) return FAILURE;
+	new_el->data = node->parent;
+	new_el->next = el->next;
+	el->next = new_el;
+	node->parent->order_link = &(el->next);
+	if (NULL == new_el->next)
+		list->tail = new_el;
+	else
+		((struct rnode *) new_el->next->data)->order_link =
+			&(new_el->next);
+	list->count++;
+
+	return SUCCESS;
+}
+
+int unlink_rnode_in_tree(struct rooted_tree *tree, struct rnode *node)
+{
+	if (is_root(node)) return UNLINK_RNODE_ROOT;
+	/* unlink_rnode() ignores nodes that are already unlinked */
+	if (! node->linked) return UNLINK_RNODE_DONE;
+	if (NULL == node->order_link) return UNLINK_RNODE_ERROR;
+
+	struct rnode *parent = node->parent;
+	/* The parent will be spliced out if it is left with only one child */
+	bool parent_goes = (2 == parent->child_count);
+	/* The subtree's run starts at its leftmost leaf */
+	struct rnode *first = node;
+	while (! is_leaf(first)) first = first->first_child;
+
+	switch (unlink_rnode(node)) {
+	case UNLINK_RNODE_DONE:
+		break;
+	case UNLINK_RNODE_ROOT_CHILD:
+		tree->root = get_unlink_rnode_root_child();
+		tree->root->parent = NULL;
+		break;
+	default:
+		return UNLINK_RNODE_ERROR;
+	}
+
+	/* The parent (or old root) comes after the node's subtree, so the
+	 * subtree must be removed first. */
+	remove_node_run(tree->nodes_in_order, first, node);
+	if (parent_goes)
+		remove_node_run(tree->nodes_in_order, parent, parent);
+
+	return UNLINK_RNODE_DONE;
+}
+
+int prune_tree(struct rooted_tree *tree,
+		bool (*drop)(struct rnode *, void *param), void *param)
+{
+	int count, i;
+	struct rnode **nodes = get_nodes_in_order_array(tree->root, &count);
+	if (NULL == nodes) return FAILURE;
+	struct llist *nodes_in_order = create_llist();
+	if (NULL == nodes_in_order) return FAILURE;
+	struct rnode *root = tree->root;
+
+	/* Pass 1, parents first: unlink dropped nodes and their descendants.
+	 * An unlinked node is simply emptied of its children, so there is no
+	 * sibling list surgery. */
+	for (i = count - 2; i >= 0; i--) {
+		struct rnode *current = nodes[i];
+		if (current->linked && drop(current, param))
+			current->linked = false;
+		if (! current->linked)
+			remove_children(current);
+	}
+
+	/* Pass 2, children first: rebuild each surviving node's children list
+	 * from its surviving children. At this point, a child that is not
+	 * linked is either dropped or emptied (and has no children), or
+	 * spliced out (and has exactly one, which takes its place). */
+	for (i = 0; i < count; i++) {
+		struct rnode *current = nodes[i];
+		if (! current->linked && current != root) continue;
+		if (is_leaf(current)) {
+			if (! append_element(nodes_in_order, current))
+				return FAILURE;
+			continue;
+		}
+
+		int orig_count = current->child_count;
+		struct rnode *last = current->last_child;
+		struct rnode *kid = current->first_child;
+		struct rnode *next;
+		current->first_child = current->last_child = NULL;
+		current->child_count = 0;
+		for (; NULL != kid; kid = next) {
+			next = (last == kid) ? NULL : kid->next_sibling;
+			if (kid->linked)
+				add_child(current, kid);
+			else if (1 == kid->child_count)
+				add_child(current, kid->first_child);
+		}
+		if (current->child_count > 0)
+			current->last_child->next_sibling = NULL;
+
+		if (1 == current->child_count && 1 != orig_count) {
+			/* splice out */
+			if (! add_edge_length(current->first_child, current))
+				return FAILURE;
+			current->linked = false;
+			if (current == root) {
+				tree->root = current->first_child;
+				tree->root->parent = NULL;
+			}
+		} else if (0 == current->child_count && current != root) {
+			current->linked = false;
+		} else {
+			if (! append_element(nodes_in_order, current))
+				return FAILURE;
+		}
+	}
+	free(nodes);
+
+	destroy_llist(tree->nodes_in_order);
+	tree->nodes_in_order = nodes_in_order;
+
+	return SUCCESS;
+}
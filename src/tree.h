@@ -138,3 +138,55 @@ struct rooted_tree *clone_tree(struct rooted_tree *tree);
 
 struct rooted_tree *clone_tree_cond(struct rooted_tree *tree,
 		bool (*predicate)(struct rnode *, void * param), void *param);
+
+/* Points each node of 'tree' to its element in 'nodes_in_order' (see member
+ * 'order_link' in rnode.h), which must be up to date. This takes linear time,
+ * but after it the following three functions can keep the list up to date in
+ * constant time per edit. Rebuilding 'nodes_in_order' by other means leaves
+ * the nodes pointing to the old list, so call this again afterwards. */
+
+void track_nodes_in_order(struct rooted_tree *tree);
+
+/* The following three functions perform the edit of the link.h function of the
+ * same name (minus the '_in_tree' suffix), and then patch 'nodes_in_order' in
+ * place instead of rebuilding it from the root. This works because these edits
+ * are local in postorder: a spliced-out node just drops out of the list, a node
+ * inserted above 'node' comes right after it, and an unlinked node's subtree is
+ * a contiguous run ending at the node itself. 'node' must be tracked (see
+ * track_nodes_in_order()). Nodes that drop out of the list are not freed. */
+
+/* Takes constant time. Returns FAILURE iff there is a malloc() problem, or
+ * 'node' is not tracked. */
+
+int splice_out_rnode_in_tree(struct rooted_tree *tree, struct rnode *node);
+
+/* Takes constant time. Returns FAILURE iff there is a malloc() problem, or
+ * 'node' is not tracked. The new node is tracked. */
+
+int insert_node_above_in_tree(struct rooted_tree *tree, struct rnode *node,
+		char *label);
+
+/* Unlinks 'node' and removes it and its descendants from the node list. If
+ * this leaves the root with a single child, that child becomes the tree's new
+ * root (and the old root is removed from the list). Takes time proportional to
+ * the depth and size of the removed subtree, whose list elements must be
+ * freed. Returns (see enum unlink_rnode_status in link.h) UNLINK_RNODE_ROOT if
+ * 'node' is the root (nothing is done), UNLINK_RNODE_ERROR in case of malloc()
+ * problem or if 'node' is not tracked, and UNLINK_RNODE_DONE otherwise. */
+
+int unlink_rnode_in_tree(struct rooted_tree *tree, struct rnode *node);
+
+/* Prunes 'tree' in one pass, without relinking nodes one by one as repeated
+ * calls to unlink_rnode() would. All non-root nodes for which 'drop(node,
+ * param)' returns true are removed, together with their descendants. drop() is
+ * called on parents before children, and not at all on the root or on
+ * descendants of dropped nodes. Then, inner nodes that are left with no
+ * children are removed too, and those left with a single child are spliced
+ * out (the child's edge length becomes the sum of both lengths). If the root
+ * is left with a single child, that child becomes the new root. Inner nodes
+ * that had a single child to start with are kept. nodes_in_order is updated.
+ * Removed nodes are not freed. */
+/* Returns FAILURE iff there is a malloc() problem. */
+
+int prune_tree(struct rooted_tree *tree,
+		bool (*drop)(struct rnode *, void *param), void *param);
@@ -43,7 +43,6 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "to_newick.h"
 #include "address_parser.h"
 #include "address_parser_status.h"
-#include "tree_editor_rnode_data.h"
 #include "common.h"
 
 void address_scanner_set_input(char *);
@@ -56,6 +55,7 @@ enum action { ACTION_DELETE, ACTION_SUBTREE, ACTION_SPLICE_OUT,
 enum order { POST_ORDER, PRE_ORDER };
 
 struct enode *expression_root;
+static struct enode_program *program;	/* compiled from expression_root */
 
 struct parameters {
 	char * address;
@@ -278,127 +278,145 @@ struct parameters get_params(int argc, char *argv[])
 	return params;
 }
 
-/* A helper for parse_order_traversal() - gets the number of descendants of a
- * node. This function is NOT recursive, the node data of all descendants must
- * have been set already - which is why we're calling it from
- * parse_order_traversal().
- * */
+/* Node attributes, as columns indexed by node rank (see number_nodes()).
+ * Only those the address reads are computed. */
 
-int get_nb_descendants(struct rnode *node)
-{
-	struct rnode *kid;
-	struct rnode_data *rndata;
-	int descendants = 0;
-
-	for (kid = node->first_child; NULL != kid; kid = kid->next_sibling) {
-		rndata = kid->data;
-		descendants += rndata->nb_descendants;
-		descendants += 1;	/* kid itself (no pun intended :-) ) */
-	}
-
-	return descendants;
-}
+struct node_columns {
+	float *columns[ENODE_COLUMN_COUNT];
+};
 
-/* This allocates the rnode_data structure for each node, and fills it with
- * "top-down" data,  i.e. data for which the parent's value needs to be known
- * (such as depth and number of ancestors). Some values do not depend on the
- * parent nor on the children, I also set them here (this is arbitrary, I
- * could set them in parse_order_traversal() below as well). */
+/* Allocates and fills the columns read by 'program', for the tree's nodes in
+ * postorder. Bottom-up attributes are filled in postorder, top-down ones in
+ * reverse. Values are computed (and rounded to float) exactly as eval_enode()
+ * used to see them. */
 
-void reverse_parse_order_traversal(struct rooted_tree *tree)
+void fill_columns(struct enode_program *program, struct rnode **nodes,
+		int count, float *columns[])
 {
-	struct list_elem *el;
-	struct llist *rev_nodes = llist_reverse(tree->nodes_in_order);
-	if (NULL == rev_nodes) { perror(NULL), exit(EXIT_FAILURE); }
-	struct rnode *node;
-	struct rnode_data *rndata;
-
-	el = rev_nodes->head;	/* root */
-	node = (struct rnode *) el->data;
-	rndata = malloc(sizeof(struct rnode_data));
-	if (NULL == rndata) { perror(NULL); exit (EXIT_FAILURE); }
-	rndata->nb_ancestors = 0;
-	rndata->depth = 0;
-	rndata->stop_mark = false;
-	node->data = rndata;
-
-	/* WARNING: don't forget to set values for the root's data, above. The
-	 * following loop starts at the first non-root node! */
-
-	for (el = rev_nodes->head->next; NULL != el; el = el -> next) {
-		node = (struct rnode *) el->data;
-		struct rnode_data *parent_data = node->parent->data;
-		rndata = malloc(sizeof(struct rnode_data));
-		if (NULL == rndata) { perror(NULL); exit (EXIT_FAILURE); }
-		rndata->nb_ancestors = parent_data->nb_ancestors + 1;
-		rndata->depth = parent_data->depth +
-			atof(node->edge_length_as_string);
-
-		rndata->stop_mark = false;
-		node->data = rndata;
+	int col, i;
+	for (col = 0; col < ENODE_COLUMN_COUNT; col++) {
+		columns[col] = NULL;
+		if (! enode_program_reads(program, col)) continue;
+		columns[col] = malloc(count * sizeof(float));
+		if (NULL == columns[col]) { perror(NULL); exit(EXIT_FAILURE); }
 	}
 
-	destroy_llist(rev_nodes);
+	float *support = columns[ENODE_COL_SUPPORT];
+	float *nb_desc = columns[ENODE_COL_NB_DESCENDANTS];
+	float *nb_children = columns[ENODE_COL_NB_CHILDREN];
+	float *is_leaf_col = columns[ENODE_COL_IS_LEAF];
+	float *is_inner_col = columns[ENODE_COL_IS_INNER];
+	float *is_root_col = columns[ENODE_COL_IS_ROOT];
+	for (i = 0; i < count; i++) {
+		struct rnode *node = nodes[i];
+		if (NULL != support)
+			support[i] = atof(node->label);
+		if (NULL != nb_desc) {
+			/* children and their descendants */
+			int descendants = 0;
+			struct rnode *kid;
+			for (kid = node->first_child; NULL != kid;
+					kid = kid->next_sibling)
+				descendants += nb_desc[kid->rank] + 1;
+			nb_desc[i] = descendants;
+		}
+		if (NULL != nb_children) nb_children[i] = node->child_count;
+		if (NULL != is_leaf_col) is_leaf_col[i] = is_leaf(node);
+		if (NULL != is_inner_col) is_inner_col[i] = is_inner_node(node);
+		if (NULL != is_root_col) is_root_col[i] = is_root(node);
+	}
+
+	float *depth = columns[ENODE_COL_DEPTH];
+	float *nb_anc = columns[ENODE_COL_NB_ANCESTORS];
+	if (NULL == depth && NULL == nb_anc) return;
+	/* root is last */
+	if (NULL != depth) depth[count-1] = 0;
+	if (NULL != nb_anc) nb_anc[count-1] = 0;
+	for (i = count - 2; i >= 0; i--) {
+		int parent = nodes[i]->parent->rank;
+		if (NULL != depth)
+			depth[i] = depth[parent] + nodes[i]->edge_length;
+		if (NULL != nb_anc)
+			nb_anc[i] = nb_anc[parent] + 1;
+	}
 }
 
-/* This fills bottom-up data. Note that it relies on rnode_data being already
- * allocated, which is done in reverse_parse_order_traversal(). Data that does
- * not depend on order is also filled in here. */
+/* Refreshes the attributes of 'node' that change when the tree is modified */
 
-void parse_order_traversal(struct rooted_tree *tree)
+void refresh_columns(struct rnode *node, float *columns[])
 {
-	struct list_elem *el;
-	struct rnode *node;
-	struct rnode_data *rndata;
-
-	for (el = tree->nodes_in_order->head; NULL != el; el = el -> next) {
-		node = (struct rnode *) el->data;
-		rndata = (struct rnode_data *) node->data;
-		rndata->support = atof(node->label);	
-		rndata->nb_descendants = get_nb_descendants(node);
-	}
+	int i = node->rank;
+	if (NULL != columns[ENODE_COL_NB_CHILDREN])
+		columns[ENODE_COL_NB_CHILDREN][i] = node->child_count;
+	if (NULL != columns[ENODE_COL_IS_LEAF])
+		columns[ENODE_COL_IS_LEAF][i] = is_leaf(node);
+	if (NULL != columns[ENODE_COL_IS_INNER])
+		columns[ENODE_COL_IS_INNER][i] = is_inner_node(node);
+	if (NULL != columns[ENODE_COL_IS_ROOT])
+		columns[ENODE_COL_IS_ROOT][i] = is_root(node);
 }
 
 void process_tree(struct rooted_tree *tree, struct parameters params)
 {
-	struct llist *nodes;
-	struct list_elem *el;
 	enum unlink_rnode_status result;
 	struct rnode *root_child;
-
-	/* these two traversals fill the node data. */
-	reverse_parse_order_traversal(tree);
-	parse_order_traversal(tree);
-
-	if (POST_ORDER == params.order)
-		nodes = tree->nodes_in_order;
-	else if (PRE_ORDER == params.order) {
-		nodes = llist_reverse(tree->nodes_in_order);
-		if (NULL == nodes) { perror(NULL); exit(EXIT_FAILURE); }
+	float *columns[ENODE_COLUMN_COUNT];
+	int count, i, col;
+
+	/* Only the nodes' ranks are needed (not the ranges that number_nodes()
+	 * also sets), and the parser's node list is already in postorder. */
+	count = tree->nodes_in_order->count;
+	struct rnode **nodes = malloc(count * sizeof(struct rnode *));
+	if (NULL == nodes) { perror(NULL); exit(EXIT_FAILURE); }
+	struct list_elem *el;
+	for (i = 0, el = tree->nodes_in_order->head; NULL != el;
+			i++, el = el->next) {
+		nodes[i] = el->data;
+		nodes[i]->rank = i;
 	}
-	else 
-		assert(0);	 /* programmer error... */
-
-
-	/* Main loop: Iterate over all nodes */
-	for (el = nodes->head; NULL != el; el = el -> next) {
-		struct rnode *current = (struct rnode *) el->data;
+	fill_columns(program, nodes, count, columns);
+
+	bool *match = malloc(count * sizeof(bool));
+	if (NULL == match) { perror(NULL); exit(EXIT_FAILURE); }
+	bool *stop_mark = calloc(count, sizeof(bool));
+	if (NULL == stop_mark) { perror(NULL); exit(EXIT_FAILURE); }
+
+	/* Deleting or splicing out nodes changes the number of children (and
+	 * thus leafness, etc.) of nodes visited later, so if the address uses
+	 * these, nodes must be evaluated one by one as they are visited.
+	 * Otherwise, the whole tree is evaluated in one go. */
+	bool modifies = ACTION_DELETE == params.action ||
+		ACTION_SPLICE_OUT == params.action;
+	bool live = modifies && (
+		enode_program_reads(program, ENODE_COL_NB_CHILDREN) ||
+		enode_program_reads(program, ENODE_COL_IS_LEAF) ||
+		enode_program_reads(program, ENODE_COL_IS_INNER) ||
+		enode_program_reads(program, ENODE_COL_IS_ROOT));
+	if (! live)
+		eval_enode_program(program, columns, 0, count, match);
+
+	/* Main loop: Iterate over all nodes, in postorder or preorder (i.e.,
+	 * the reverse) */
+	for (i = 0; i < count; i++) {
+		struct rnode *current = POST_ORDER == params.order ?
+			nodes[i] : nodes[count - 1 - i];
+		int rank = current->rank;
 
 		/* Check for stop mark in parent (see option -o) */
 		if (! is_root(current)) { 	/* root has no parent... */
-			if (((struct rnode_data *) current->parent->data)->stop_mark) {
+			if (stop_mark[current->parent->rank]) {
 				/* Stop-mark the current node and continue */ 
-				((struct rnode_data *)
-				current->data)->stop_mark = true;
+				stop_mark[rank] = true;
 				continue;
 			}
 		} 
 
-		/* Set the current node for evaluation, and evaluate the
-		 * expression - if the current node matches, then perform the
-		 * specified action */
-		enode_eval_set_current_rnode(current);
-		if (eval_enode(expression_root)) {
+		/* If the current node matches, perform the specified action */
+		if (live) {
+			refresh_columns(current, columns);
+			eval_enode_program(program, columns, rank, 1, match);
+		}
+		if (match[rank]) {
 			switch (params.action) {
 			case ACTION_SUBTREE:
 				dump_newick(current);
@@ -449,14 +467,15 @@ void process_tree(struct rooted_tree *tree, struct parameters params)
 			 * since this node matches -  we set the stop mark on
 			 * this node */
 			if (params.stop_clade_at_first_match)
-				((struct rnode_data *) current->data)->stop_mark = true;
+				stop_mark[rank] = true;
 		} /* matching node */	
 	}
 
-	/* If order is PRE_ORDER, the list of nodes is an inverted copy, so we
-	 * need to free it. */
-	if (PRE_ORDER == params.order)
-		destroy_llist(nodes);
+	for (col = 0; col < ENODE_COLUMN_COUNT; col++)
+		free(columns[col]);
+	free(stop_mark);
+	free(match);
+	free(nodes);
 }
 
 int main(int argc, char* argv[])
@@ -483,6 +502,8 @@ int main(int argc, char* argv[])
 		exit(EXIT_FAILURE);
 	}
 	address_scanner_clear_input();
+	program = compile_enode(expression_root);
+	if (NULL == program) { perror(NULL); exit(EXIT_FAILURE); }
 
 	while (NULL != (tree = parse_tree())) {
 		process_tree(tree, params);
@@ -493,5 +514,6 @@ int main(int argc, char* argv[])
 		destroy_tree(tree);
 	}
 
+	destroy_enode_program(program);
 	return 0;
 }
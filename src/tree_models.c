@@ -32,8 +32,8 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <stdlib.h>
 #include <stdio.h>
 #include <math.h>
-#include <stdio.h>
 #include <stdbool.h>
+#include <string.h>
 
 #include "list.h"
 #include "rnode.h"
@@ -42,6 +42,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "to_newick.h"
 #include "tree_models.h"
 #include "masprintf.h"
+#include "prng.h"
 
 #define UNUSED -1
 
@@ -174,9 +175,8 @@ double _tlt_grow_node(struct rnode *leaf, double branch_termination_rate,
 	if (remaining_time < 0)
 		length += remaining_time;
 
-	char *length_s = masprintf("%g", length);
-	free(leaf->edge_length_as_string);
-	leaf->edge_length_as_string = length_s;	/* NULL if masprintf() fails - check in caller */
+	/* leaves the length undefined if this fails - check in caller */
+	set_edge_length(leaf, length);
 
 	/* Return the remaining time so caller f() can take action based on
 	 * whether there is time left or not */
@@ -214,7 +214,7 @@ void free_data(struct llist *leaves_queue,
 	struct list_elem *elem;
 	for (elem = all_children->head; NULL != elem; elem = elem->next) {
 		kid = elem->data;
-		free(kid->edge_length_as_string);
+		unset_edge_length(kid);	/* frees the length's text */
 		free(kid->label);
 	       	free(kid->data);
 		free(kid);
@@ -261,8 +261,8 @@ int time_limited_tree(double branch_termination_rate, double duration)
 		struct rnode *current = shift(leaves_queue);
 		double remaining_time = _tlt_grow_node(current,
 				branch_termination_rate, UNUSED); 
-		/* length is set by tlt_grow_node(), NULL means error */
-		if (NULL == current->edge_length_as_string)
+		/* length is set by tlt_grow_node(), undefined means error */
+		if (! has_edge_length(current))
 			return FAILURE;
 		if (remaining_time > 0) {
 			kid = create_child_with_time_limit(remaining_time);
@@ -285,3 +285,347 @@ int time_limited_tree(double branch_termination_rate, double duration)
 
 	return SUCCESS;
 }
+
+/******************************************************************/
+/* Exact-size models */
+
+/* These write the tree as they go, so they need no more memory than the
+ * depth of the tree (plus the output buffer), whatever its size. Output is
+ * buffered here rather than by stdio, to avoid a function call (and a lock)
+ * for every character. */
+
+#define WRITE_BUFFER_SIZE 65536
+
+struct generator {
+	const struct exact_size_params *params;
+	struct prng *prng;
+	FILE *out;
+	bool error;
+	long leaf_number;
+	double height_scale;	/* YULE_TREE only */
+	/* sizes of the children of the nodes being written, top to bottom */
+	long *parts;
+	size_t parts_len;
+	size_t parts_capacity;
+	size_t buffer_len;
+	char buffer[WRITE_BUFFER_SIZE];
+};
+
+static void flush_output(struct generator *gen)
+{
+	if (gen->buffer_len > 0 &&
+		fwrite(gen->buffer, 1, gen->buffer_len, gen->out)
+			!= gen->buffer_len)
+		gen->error = true;
+	gen->buffer_len = 0;
+}
+
+static void write_char(struct generator *gen, char c)
+{
+	if (WRITE_BUFFER_SIZE == gen->buffer_len)
+		flush_output(gen);
+	gen->buffer[gen->buffer_len++] = c;
+}
+
+/* 'len' must not exceed WRITE_BUFFER_SIZE */
+
+static void write_chars(struct generator *gen, const char *s, size_t len)
+{
+	if (gen->buffer_len + len > WRITE_BUFFER_SIZE)
+		flush_output(gen);
+	memcpy(gen->buffer + gen->buffer_len, s, len);
+	gen->buffer_len += len;
+}
+
+static void write_leaf(struct generator *gen)
+{
+	char digits[24];
+	char *p = digits + sizeof(digits);
+	long n = ++gen->leaf_number;
+
+	do {
+		*(--p) = '0' + n % 10;
+		n /= 10;
+	} while (n > 0);
+	*(--p) = 'n';
+	write_chars(gen, p, digits + sizeof(digits) - p);
+}
+
+/* Writes ':' and the length, like printf's "%g" would (i.e., to 6 significant
+ * digits). Yule trees have two lengths per leaf, and printf() takes more time
+ * than all the rest, so the usual range is formatted here. */
+
+static void write_length(struct generator *gen, double length)
+{
+	static const double lower_bounds[] = { 1e-4, 1e-3, 1e-2, 1e-1, 1,
+		1e1, 1e2, 1e3, 1e4 };
+	static const double powers_of_ten[] = { 1, 1e1, 1e2, 1e3, 1e4, 1e5,
+		1e6, 1e7, 1e8, 1e9 };
+	char text[32];
+
+	/* 'length' is rounded to an integer 'mantissa' of 6 digits, with
+	 * 'decimals' digits after the point. Near-ties, where the scaling may
+	 * have rounded the wrong way, are left to printf(). */
+	int decimals = 0;
+	double scaled = 0, fraction = 0.5;
+	if (length >= 1e-4 && length < 1e5) {
+		int exponent = 4;
+		while (length < lower_bounds[exponent + 4])
+			exponent--;
+		decimals = 5 - exponent;
+		scaled = floor(length * powers_of_ten[decimals]);
+		fraction = length * powers_of_ten[decimals] - scaled;
+	}
+	if (fabs(fraction - 0.5) < 1e-6) {
+		int len = snprintf(text, sizeof(text), ":%g", length);
+		write_chars(gen, text, len);
+		return;
+	}
+
+	long mantissa = (long) scaled + (fraction > 0.5);
+	if (mantissa >= 1000000) {	/* rounded up to 10^(exponent+1) */
+		mantissa /= 10;
+		decimals--;
+	}
+	while (decimals > 0 && 0 == mantissa % 10) {
+		mantissa /= 10;
+		decimals--;
+	}
+
+	char *p = text + sizeof(text);
+	int i;
+	for (i = 0; i < decimals; i++) {
+		*(--p) = '0' + mantissa % 10;
+		mantissa /= 10;
+	}
+	if (decimals > 0)
+		*(--p) = '.';
+	do {
+		*(--p) = '0' + mantissa % 10;
+		mantissa /= 10;
+	} while (mantissa > 0);
+	*(--p) = ':';
+	write_chars(gen, p, text + sizeof(text) - p);
+}
+
+/* A node whose children are all leaves */
+
+static void write_fan(struct generator *gen, long nb_leaves)
+{
+	long i;
+	write_char(gen, '(');
+	for (i = 0; i < nb_leaves; i++) {
+		if (i > 0) write_char(gen, ',');
+		write_leaf(gen);
+	}
+	write_char(gen, ')');
+}
+
+/* No recursion here: a caterpillar is as deep as it has leaves. */
+
+static void write_caterpillar(struct generator *gen, long nb_leaves)
+{
+	long i;
+	for (i = 1; i < nb_leaves; i++) {
+		write_char(gen, '(');
+		write_leaf(gen);
+		write_char(gen, ',');
+	}
+	write_leaf(gen);
+	for (i = 1; i < nb_leaves; i++)
+		write_char(gen, ')');
+}
+
+/* Yule trees are generated as a coalescent point process: the depths of the
+ * n-1 inner nodes are independent and identically distributed, and each one
+ * "separates" two consecutive leaves; the deepest inner node is the root,
+ * and the ones to its left and right form its two subtrees (and so on
+ * recursively). So a subtree with n leaves whose parent has depth D has its
+ * root at the largest of n-1 depths drawn below D, at a position that is
+ * uniformly distributed. Depths are drawn as uniform variates ('bound' and
+ * 'v' below) and then mapped to the actual (truncated exponential)
+ * distribution of node depths in a Yule tree of a given age. */
+
+static double yule_node_depth(struct generator *gen, double v)
+{
+	return - log1p(- v * gen->height_scale) / gen->params->birth_rate;
+}
+
+static void write_yule_subtree(struct generator *gen, long nb_leaves,
+		double bound, double parent_depth, bool is_root)
+{
+	if (1 == nb_leaves) {
+		write_leaf(gen);
+		if (! is_root)
+			write_length(gen, parent_depth);
+		return;
+	}
+
+	double v = bound * pow(prng_uniform(gen->prng), 1.0 / (nb_leaves-1));
+	double depth = yule_node_depth(gen, v);
+	long nb_left = 1 + prng_below(gen->prng, nb_leaves - 1);
+
+	write_char(gen, '(');
+	write_yule_subtree(gen, nb_left, v, depth, false);
+	write_char(gen, ',');
+	write_yule_subtree(gen, nb_leaves - nb_left, v, depth, false);
+	write_char(gen, ')');
+	if (! is_root)
+		write_length(gen, parent_depth - depth);
+}
+
+static int compare_longs(const void *a, const void *b)
+{
+	long la = *(const long *) a;
+	long lb = *(const long *) b;
+	return (la > lb) - (la < lb);
+}
+
+void _random_composition(struct prng *prng, long n, int k, long *parts)
+{
+	/* A composition is given by k-1 distinct cut points among 1..n-1,
+	 * which are stored (sorted) in parts[0..k-2]. */
+	int nb_cuts = k - 1;
+	int nb_drawn = 0;
+
+	if (n < 2 * k) {
+		/* Few candidates: select each one with probability (cuts
+		 * still needed) / (candidates left). */
+		long cut;
+		for (cut = 1; nb_drawn < nb_cuts; cut++)
+			if (prng_below(prng, n - cut) <
+					(uint64_t) (nb_cuts - nb_drawn))
+				parts[nb_drawn++] = cut;
+	} else {
+		/* Many candidates: draw the missing cuts, then drop
+		 * duplicates, until there are enough. */
+		while (nb_drawn < nb_cuts) {
+			int i, j;
+			for (i = nb_drawn; i < nb_cuts; i++)
+				parts[i] = 1 + prng_below(prng, n - 1);
+			qsort(parts, nb_cuts, sizeof(long), compare_longs);
+			for (i = 1, j = 1; i < nb_cuts; i++)
+				if (parts[i] != parts[j-1])
+					parts[j++] = parts[i];
+			nb_drawn = j;
+		}
+	}
+
+	/* cut points -> sizes */
+	int i;
+	parts[nb_cuts] = n - parts[nb_cuts - 1];
+	for (i = nb_cuts - 1; i > 0; i--)
+		parts[i] -= parts[i-1];
+}
+
+/* Number of children of a node with 'nb_leaves' (> 1) leaves */
+
+static long node_degree(struct generator *gen, long nb_leaves)
+{
+	switch (gen->params->model) {
+	case POLYTOMY_TREE:
+		return gen->params->degree < nb_leaves ?
+			gen->params->degree : nb_leaves;
+	case SKEWED_TREE: {
+		/* 1 + floor(1/u), u uniform in (0,1] */
+		double inverse = 1.0 / (1.0 - prng_uniform(gen->prng));
+		if (inverse >= nb_leaves)
+			return nb_leaves;
+		return 1 + (long) inverse;
+	}
+	default:
+		return 2;
+	}
+}
+
+static bool reserve_parts(struct generator *gen, long nb_parts)
+{
+	if (gen->parts_len + nb_parts <= gen->parts_capacity)
+		return true;
+	size_t capacity = 2 * (gen->parts_len + nb_parts);
+	long *parts = realloc(gen->parts, capacity * sizeof(long));
+	if (NULL == parts)
+		return false;
+	gen->parts = parts;
+	gen->parts_capacity = capacity;
+	return true;
+}
+
+/* Balanced, polytomy and skewed trees: the node's leaves are split among its
+ * children, which are written in turn. The children's sizes are kept in
+ * gen->parts (not in a local array, as the degree is not bounded), and
+ * accessed by index since the recursive calls may move it. */
+
+static void write_split_subtree(struct generator *gen, long nb_leaves)
+{
+	if (1 == nb_leaves) {
+		write_leaf(gen);
+		return;
+	}
+
+	long degree = node_degree(gen, nb_leaves);
+	if (degree == nb_leaves) {
+		write_fan(gen, nb_leaves);
+		return;
+	}
+
+	if (! reserve_parts(gen, degree)) {
+		gen->error = true;
+		return;
+	}
+	size_t first = gen->parts_len;
+	long *parts = gen->parts + first;
+	if (BALANCED_TREE == gen->params->model) {
+		parts[0] = nb_leaves - nb_leaves / 2;
+		parts[1] = nb_leaves / 2;
+	} else {
+		_random_composition(gen->prng, nb_leaves, degree, parts);
+	}
+	gen->parts_len += degree;
+
+	long i;
+	write_char(gen, '(');
+	for (i = 0; i < degree && ! gen->error; i++) {
+		if (i > 0) write_char(gen, ',');
+		write_split_subtree(gen, gen->parts[first + i]);
+	}
+	write_char(gen, ')');
+
+	gen->parts_len = first;
+}
+
+int exact_size_tree(FILE *out, const struct exact_size_params *params,
+		struct prng *prng)
+{
+	struct generator *gen = malloc(sizeof(struct generator));
+	if (NULL == gen) return FAILURE;
+	gen->params = params;
+	gen->prng = prng;
+	gen->out = out;
+	gen->error = false;
+	gen->leaf_number = 0;
+	gen->parts = NULL;
+	gen->parts_len = gen->parts_capacity = 0;
+	gen->buffer_len = 0;
+
+	switch (params->model) {
+	case CATERPILLAR_TREE:
+		write_caterpillar(gen, params->nb_leaves);
+		break;
+	case YULE_TREE:
+		gen->height_scale = - expm1(- params->birth_rate *
+				params->duration);
+		write_yule_subtree(gen, params->nb_leaves, 1.0, 0, true);
+		break;
+	default:
+		write_split_subtree(gen, params->nb_leaves);
+		break;
+	}
+	write_chars(gen, ";\n", 2);
+	flush_output(gen);
+
+	int result = gen->error ? FAILURE : SUCCESS;
+	free(gen->parts);
+	free(gen);
+	return result;
+}
@@ -31,7 +31,31 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 /** \file
  * Different models of tree generation */
 
+#include <stdio.h>
+
 struct rnode;
+struct prng;
+
+/** Models that produce a tree with an exact number of leaves. These are
+ * written out as they are generated, without building the tree in memory, so
+ * they can be used for (very) large trees. */
+
+enum exact_size_model {
+	BALANCED_TREE,		/* binary, as balanced as possible */
+	CATERPILLAR_TREE,	/* binary, maximally unbalanced */
+	YULE_TREE,		/* random binary, with branch lengths */
+	POLYTOMY_TREE,		/* random, inner nodes have a fixed degree */
+	SKEWED_TREE		/* random, degrees have a heavy tail */
+};
+
+struct exact_size_params {
+	enum exact_size_model model;
+	long nb_leaves;
+	int degree;		/* only for POLYTOMY_TREE */
+	double birth_rate;	/* only for YULE_TREE */
+	double duration;	/* ditto */
+};
+
 
 /** Prints a random tree grown using a geometric model. A pretty simple model
  * where each node has a fixed probability of having 2 children. If set to >
@@ -56,6 +80,29 @@ int geometric_tree(double prob_node_has_children);
 
 int time_limited_tree(double branch_termination_rate, double duration);
 
+/** Writes a tree with exactly 'params->nb_leaves' leaves, labeled n1, n2,
+ * etc. from left to right. Inner nodes are not labeled.
+ *
+ * BALANCED_TREE and CATERPILLAR_TREE are deterministic. In a YULE_TREE, the
+ * leaves are split among the root's two children uniformly at random, which
+ * yields the same distribution of topologies as the Yule (pure-birth) and
+ * coalescent models; node depths are those of a Yule process with rate
+ * 'birth_rate' that started 'duration' time units ago, conditioned on the
+ * number of leaves. In a POLYTOMY_TREE, each inner node has 'degree' children
+ * (or as many as it has leaves below it, if that is fewer), and its leaves
+ * are split among them at random. A SKEWED_TREE is the same except that each
+ * inner node's degree d is drawn at random with P(d >= x) = 1/(x - 1),
+ * so that most nodes have few children but a few have very many, as in
+ * taxonomies.
+ * \arg \c out where to write the tree
+ * \arg \c params model and parameters
+ * \arg \c prng a seeded generator (unused by deterministic models)
+ * \return FAILURE (0) IFF there is any problem (memory allocation, or
+ * writing to 'out') */
+
+int exact_size_tree(FILE *out, const struct exact_size_params *params,
+		struct prng *prng);
+
 /** \cond -- The following functions are public only so they can be tested;
  * they should not be used outside tree_models.c (hence the leading _ in their
  * names). */
@@ -82,4 +129,11 @@ double _tlt_grow_node(struct rnode *, double branch_termination_rate,
 
 double _reciprocal_exponential_CDF(double x, double k);
 
+/** Splits 'n' leaves among 'k' children (1 < k < n) uniformly at random, i.e.
+ * each of the possible ways of writing n as a sum of k positive integers is
+ * equally likely. The sizes are written to 'parts', which must have room for
+ * 'k' elements. */
+
+void _random_composition(struct prng *prng, long n, int k, long *parts);
+
 /** \endcond */
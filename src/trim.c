@@ -178,10 +178,9 @@ void trim(struct rnode *node, struct parameters params)
 		/* Shrink parent edge length */
 		double excess = ndata->distance_depth - params.threshold;
 		double trimmed_edge_length = node->edge_length - excess;
-		free(node->edge_length_as_string);
-		char *new_length = masprintf("%g", trimmed_edge_length);
-		if (NULL == new_length) { perror(NULL); exit(EXIT_FAILURE); }
-		node->edge_length_as_string = new_length;
+		if (! set_edge_length(node, trimmed_edge_length)) {
+			perror(NULL); exit(EXIT_FAILURE);
+		}
 	}
 
 	remove_children(node);	/* no effect on leaves */
@@ -197,8 +196,7 @@ void process_tree(struct rooted_tree *tree, struct parameters params)
 
 	/* Simple case: trim root */
 	if (TRIM_UNDEFINED == params.threshold) {
-		free(tree->root->edge_length_as_string);
-		tree->root->edge_length_as_string = strdup("");
+		unset_edge_length(tree->root);
 		return;
 	} 
 
@@ -238,9 +236,8 @@ void process_tree(struct rooted_tree *tree, struct parameters params)
 		/* Parent not trimmed: See if we must trim this node. */
 	
 		/* compute this node's depth measures */
-		double edge_length = atof(node->edge_length_as_string);
-		node->edge_length = edge_length;
-		ndata->distance_depth = edge_length + parent_data->distance_depth;
+		ndata->distance_depth = node->edge_length
+			+ parent_data->distance_depth;
 		ndata->ancestry_depth = 1 + parent_data->ancestry_depth;
 
 		switch (params.depth_type) {
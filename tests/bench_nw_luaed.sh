@@ -0,0 +1,71 @@
+#!/bin/sh
+
+# bench_nw_luaed.sh - times nw_luaed on copies of data/20000.nw (a 40,000-node
+# tree), for a few selectors that use the predefined variables, so that the
+# cost of the Lua glue (as opposed to the user's code) can be compared between
+# versions. Like valgrind_nw_prog.sh, this is not part of the test suite: run
+# it by hand, from the directory where the test programs are built (../src
+# must contain nw_luaed). Arguments are the number of copies (default: 20)
+# and, optionally, another nw_luaed binary (e.g. built from an earlier
+# revision) to compare with; their outputs must be identical.
+
+ncopies=${1:-20}
+ref_bin=$2
+bin=../src/nw_luaed
+tmp=${TMPDIR:-/tmp}/bench_nw_luaed.$$
+
+for b in $bin $ref_bin ; do
+	if [ ! -x $b ] ; then
+		echo "$b not found or not executable."
+		exit 1
+	fi
+done
+
+mkdir $tmp || exit 1
+trap 'rm -rf $tmp' EXIT
+
+src_dir=$(dirname $0)
+i=0
+while [ $i -lt $ncopies ] ; do
+	cat $src_dir/../data/20000.nw
+	i=$((i+1))
+done > $tmp/trees.nw
+
+now()
+{
+	date +%s.%N
+}
+
+# Runs binary $1 with selector $2 and action $3, output goes to file $4.
+# Prints the elapsed time.
+
+run()
+{
+	start=$(now)
+	$1 -n $tmp/trees.nw "$2" "$3" > $4
+	echo $start $(now) | awk '{printf "%.2f", $2 - $1}'
+}
+
+printf "%d trees\n" $ncopies
+n=0
+while IFS='|' read selector action ; do
+	n=$((n+1))
+	time=$(run $bin "$selector" "$action" $tmp/out.$n)
+	if [ -n "$ref_bin" ] ; then
+		ref_time=$(run $ref_bin "$selector" "$action" $tmp/ref.$n)
+		if ! cmp -s $tmp/out.$n $tmp/ref.$n ; then
+			echo "Outputs differ for '$selector' '$action'!"
+			exit 1
+		fi
+		printf "%-32s %s s\t(%s: %s s)\n" "$selector" $time \
+			$ref_bin $ref_time
+	else
+		printf "%-32s %s s\n" "$selector" $time
+	fi
+done <<END
+false|x = 1
+l|x = 1
+i and (b ~= nil) and (d > 1)|N.len = 2 * L
+a > 100 and D < 50|x = N.par.lbl
+l and lbl == "1234"|print(N.par.c)
+END
@@ -0,0 +1,66 @@
+#!/bin/sh
+
+# bench_nw_rename.sh - compares renaming with three maps in a single nw_rename
+# run (option -m, with and without -i) to the equivalent 3-stage pipe. Like
+# valgrind_nw_prog.sh, this is not part of the test suite: run it by hand, from
+# the directory where the test programs are built (../src must contain
+# nw_rename). The number of trees can be passed as argument (default: 10000).
+
+ntrees=${1:-10000}
+bin=../src/nw_rename
+tmp=${TMPDIR:-/tmp}/bench_nw_rename.$$
+
+if [ ! -x $bin ] ; then
+	echo "$bin not found or not executable."
+	exit 1
+fi
+
+mkdir $tmp || exit 1
+trap 'rm -rf $tmp' EXIT
+
+# The trees: copies of the HRV tree. The maps form a chain: the first
+# renames its leaves to their group (A, B, ...), the second renames some
+# groups to HRV-A etc., and the third renames those to species names. Each
+# map thus only renames labels produced by the previous one.
+
+src_dir=$(dirname $0)
+i=0
+while [ $i -lt $ntrees ] ; do
+	cat $src_dir/newtree.nw
+	i=$((i+1))
+done > $tmp/trees.nw
+cp $src_dir/newtree.map $tmp/map1
+printf "A\tHRV-A\nB\tHRV-B\nE\tHEV\n" > $tmp/map2
+printf "HRV-A\tRhinovirus_A\nHRV-B\tRhinovirus_B\nHEV\tEnterovirus\n" \
+	> $tmp/map3
+
+now()
+{
+	date +%s.%N
+}
+
+start=$(now)
+$bin $tmp/trees.nw $tmp/map1 | $bin - $tmp/map2 | $bin - $tmp/map3 \
+	> $tmp/pipe.out
+pipe=$(echo $start $(now) | awk '{print $2 - $1}')
+
+start=$(now)
+$bin -m $tmp/map1 -m $tmp/map2 -m $tmp/map3 $tmp/trees.nw > $tmp/single.out
+single=$(echo $start $(now) | awk '{print $2 - $1}')
+
+# The same, from the maps' indexes (which are built by the first run)
+$bin -i -m $tmp/map1 -m $tmp/map2 -m $tmp/map3 $tmp/trees.nw > /dev/null
+start=$(now)
+$bin -i -m $tmp/map1 -m $tmp/map2 -m $tmp/map3 $tmp/trees.nw \
+	> $tmp/indexed.out
+indexed=$(echo $start $(now) | awk '{print $2 - $1}')
+
+if ! cmp -s $tmp/pipe.out $tmp/single.out ||
+   ! cmp -s $tmp/pipe.out $tmp/indexed.out ; then
+	echo "Outputs differ!"
+	exit 1
+fi
+
+printf "%d trees\n3-stage pipe:\t%.2f s\nsingle run:\t%.2f s\n" \
+	$ntrees $pipe $single
+printf "indexed run:\t%.2f s\n" $indexed
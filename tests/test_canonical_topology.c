@@ -0,0 +1,160 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tree.h"
+#include "parser.h"
+#include "canonical_topology.h"
+
+void newick_scanner_set_string_input(char *);
+void newick_scanner_clear_string_input();
+
+static struct rooted_tree *tree_from_string(char *newick)
+{
+	newick_scanner_set_string_input(newick);
+	struct rooted_tree *tree = parse_tree();
+	newick_scanner_clear_string_input();
+	return tree;
+}
+
+/* Checks that 'target' matches (or not, depending on 'exp') 'pattern' */
+
+static int check_match(const char *test_name, char *pattern, char *target,
+		enum canonical_match exp)
+{
+	struct rooted_tree *pattern_tree = tree_from_string(pattern);
+	struct canonical_topology *ct = create_canonical_topology(pattern_tree);
+	struct rooted_tree *target_tree = tree_from_string(target);
+	enum canonical_match obt = match_canonical_topology(ct, target_tree);
+	destroy_canonical_topology(ct);
+	destroy_tree(pattern_tree);
+	destroy_tree(target_tree);
+
+	if (exp != obt) {
+		printf ("%s: '%s' should%s match '%s'.\n", test_name, target,
+			CANON_MATCH == exp ? "" : " NOT", pattern);
+		return 1;
+	}
+	return 0;
+}
+
+int test_match()
+{
+	const char *test_name = __func__;
+	char *pattern = "((A,B),C);";
+
+	if (check_match(test_name, pattern, "((A,B),C);", CANON_MATCH))
+		return 1;
+	/* child order, lengths and inner labels don't matter */
+	if (check_match(test_name, pattern, "(C:1,(B:2,A:3)x:4)y;",
+				CANON_MATCH))
+		return 1;
+	/* extra leaves and knees are ignored */
+	if (check_match(test_name, pattern,
+				"((D,((A,E),(B,(F,G)))),((C)),H);",
+				CANON_MATCH))
+		return 1;
+	/* unlabeled leaves too */
+	if (check_match(test_name, pattern, "(((A,),B),(C,));", CANON_MATCH))
+		return 1;
+	/* knees in the pattern are ignored */
+	if (check_match(test_name, "(((A,B)),C);", "((A,B),C);", CANON_MATCH))
+		return 1;
+
+	printf ("%s: ok.\n", test_name);
+	return 0;
+}
+
+int test_no_match()
+{
+	const char *test_name = __func__;
+	char *pattern = "((A,B),C);";
+
+	if (check_match(test_name, pattern, "((A,C),B);", CANON_NO_MATCH))
+		return 1;
+	if (check_match(test_name, pattern, "(A,B,C);", CANON_NO_MATCH))
+		return 1;
+	/* a missing leaf */
+	if (check_match(test_name, pattern, "((A,B),D);", CANON_NO_MATCH))
+		return 1;
+	if (check_match(test_name, pattern, "((A,D),(B,C));", CANON_NO_MATCH))
+		return 1;
+	/* duplicate label */
+	if (check_match(test_name, pattern, "(((A,B),C),A);", CANON_NO_MATCH))
+		return 1;
+	/* unlabeled pattern leaves can't match */
+	if (check_match(test_name, "((A,B),);", "((A,B),);", CANON_NO_MATCH))
+		return 1;
+
+	printf ("%s: ok.\n", test_name);
+	return 0;
+}
+
+int test_patterns()
+{
+	const char *test_name = __func__;
+	struct rooted_tree *pattern_1 = tree_from_string("((A,B),(C,D));");
+	struct rooted_tree *pattern_2 = tree_from_string("(((A,B),C),D);");
+	struct rooted_tree *pattern_3 = tree_from_string("((D,C),(B,A));");
+	struct canonical_topology *ct = create_canonical_topology(pattern_1);
+	bool matches[3];
+
+	if (1 != add_canonical_pattern(ct, pattern_2) ||
+	    2 != add_canonical_pattern(ct, pattern_3)) {
+		printf ("%s: wrong pattern number.\n", test_name);
+		return 1;
+	}
+	if (3 != canonical_pattern_count(ct)) {
+		printf ("%s: expected 3 patterns.\n", test_name);
+		return 1;
+	}
+
+	struct rooted_tree *target = tree_from_string("(((A,E),B),(C,D));");
+	if (CANON_MATCH != match_canonical_patterns(ct, target, matches) ||
+	    ! matches[0] || matches[1] || ! matches[2]) {
+		printf ("%s: target should match patterns 1 and 3 only.\n",
+				test_name);
+		return 1;
+	}
+	destroy_tree(target);
+	target = tree_from_string("((((A,B),C),D),E);");
+	if (CANON_MATCH != match_canonical_patterns(ct, target, matches) ||
+	    matches[0] || ! matches[1] || matches[2]) {
+		printf ("%s: target should match pattern 2 only.\n",
+				test_name);
+		return 1;
+	}
+	destroy_tree(target);
+	target = tree_from_string("((A,C),(B,D));");
+	if (CANON_NO_MATCH != match_canonical_patterns(ct, target, matches) ||
+	    matches[0] || matches[1] || matches[2]) {
+		printf ("%s: target should match no pattern.\n", test_name);
+		return 1;
+	}
+	destroy_tree(target);
+
+	destroy_canonical_topology(ct);
+	destroy_tree(pattern_1);
+	destroy_tree(pattern_2);
+	destroy_tree(pattern_3);
+
+	printf ("%s: ok.\n", test_name);
+	return 0;
+}
+
+int main()
+{
+	int failures = 0;
+	printf("Starting canonical topology test...\n");
+	failures += test_match();
+	failures += test_no_match();
+	failures += test_patterns();
+	if (0 == failures) {
+		printf("All tests ok.\n");
+	} else {
+		printf("%d test(s) FAILED.\n", failures);
+		return 1;
+	}
+
+	return 0;
+}
@@ -516,6 +516,142 @@ int test_nb_children()
 	return 0;
 }
 
+/* Compiled programs must give the same results as eval_enode(). Each row of
+ * the columns describes a node, on which eval_enode() is also run. */
+
+#define NB_ROWS 4
+
+static struct rnode *row_nodes[NB_ROWS];
+static float *columns[ENODE_COLUMN_COUNT];
+
+void setup_rows()
+{
+	int i, col;
+	for (col = 0; col < ENODE_COLUMN_COUNT; col++) {
+		columns[col] = malloc(NB_ROWS * sizeof(float));
+		if (NULL == columns[col]) { perror(NULL); exit(EXIT_FAILURE); }
+	}
+	struct rnode *root = create_rnode("root", "");
+	for (i = 0; i < NB_ROWS; i++) {
+		struct rnode *node = create_rnode("n", "");
+		int k;
+		/* row i has i children */
+		for (k = 0; k < i; k++)
+			add_child(node, create_rnode("kid", ""));
+		if (i > 0) add_child(root, node);
+		struct rnode_data *data = malloc(sizeof(struct rnode_data));
+		if (NULL == data) { perror(NULL); exit(EXIT_FAILURE); }
+		data->support = 25.0 * i;
+		data->depth = 0.5 * i;
+		data->nb_ancestors = i > 0 ? 1 : 0;
+		data->nb_descendants = 2 * i;
+		node->data = data;
+		row_nodes[i] = node;
+
+		columns[ENODE_COL_SUPPORT][i] = data->support;
+		columns[ENODE_COL_DEPTH][i] = data->depth;
+		columns[ENODE_COL_NB_ANCESTORS][i] = data->nb_ancestors;
+		columns[ENODE_COL_NB_DESCENDANTS][i] = data->nb_descendants;
+		columns[ENODE_COL_NB_CHILDREN][i] = node->child_count;
+		columns[ENODE_COL_IS_LEAF][i] = is_leaf(node);
+		columns[ENODE_COL_IS_INNER][i] = is_inner_node(node);
+		columns[ENODE_COL_IS_ROOT][i] = is_root(node);
+	}
+}
+
+int check_program(const char *test_name, struct enode *expr)
+{
+	struct enode_program *prog = compile_enode(expr);
+	if (NULL == prog) { perror(NULL); exit(EXIT_FAILURE); }
+	bool result[NB_ROWS];
+	eval_enode_program(prog, columns, 0, NB_ROWS, result);
+	destroy_enode_program(prog);
+
+	int i;
+	for (i = 0; i < NB_ROWS; i++) {
+		enode_eval_set_current_rnode(row_nodes[i]);
+		bool expected = eval_enode(expr);
+		if (expected != result[i]) {
+			printf ("%s: row %d: expected %d, got %d.\n",
+					test_name, i, expected, result[i]);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+int test_program()
+{
+	const char *test_name = "test_program";
+	int failures = 0;
+	setup_rows();
+
+	/* b > 30 & ! l */
+	failures += check_program(test_name, create_enode_op(ENODE_AND,
+		create_enode_op(ENODE_GT, create_enode_func(ENODE_SUPPORT),
+			create_enode_constant(30)),
+		create_enode_not(create_enode_func(ENODE_IS_LEAF))));
+	/* d <= 0.5 | c == 3 */
+	failures += check_program(test_name, create_enode_op(ENODE_OR,
+		create_enode_op(ENODE_LTE, create_enode_func(ENODE_DEPTH),
+			create_enode_constant(0.5)),
+		create_enode_op(ENODE_EQ, create_enode_func(ENODE_NB_CHILDREN),
+			create_enode_constant(3))));
+	/* r | (a != 1 & D >= 4) */
+	failures += check_program(test_name, create_enode_op(ENODE_OR,
+		create_enode_func(ENODE_IS_ROOT),
+		create_enode_op(ENODE_AND,
+			create_enode_op(ENODE_NEQ,
+				create_enode_func(ENODE_NB_ANCESTORS),
+				create_enode_constant(1)),
+			create_enode_op(ENODE_GTE,
+				create_enode_func(ENODE_NB_DESCENDANTS),
+				create_enode_constant(4)))));
+	/* i < 1 (a boolean compared as a number) */
+	failures += check_program(test_name, create_enode_op(ENODE_LT,
+		create_enode_func(ENODE_IS_INNER), create_enode_constant(1)));
+
+	if (0 == failures)
+		printf("%s ok.\n", test_name);
+	return failures;
+}
+
+int test_program_folding()
+{
+	const char *test_name = "test_program_folding";
+
+	/* l & 2 < 1: the right operand is false, so this is always false and
+	 * does not read anything. */
+	struct enode *expr = create_enode_op(ENODE_AND,
+		create_enode_func(ENODE_IS_LEAF),
+		create_enode_op(ENODE_LT, create_enode_constant(2),
+			create_enode_constant(1)));
+	struct enode_program *prog = compile_enode(expr);
+	if (NULL == prog) { perror(NULL); exit(EXIT_FAILURE); }
+	if (enode_program_reads(prog, ENODE_COL_IS_LEAF)) {
+		printf ("%s: 'l & 2 < 1' should not read 'l'.\n", test_name);
+		return 1;
+	}
+	destroy_enode_program(prog);
+	if (check_program(test_name, expr)) return 1;
+
+	/* 1 & l reads only 'l' */
+	expr = create_enode_op(ENODE_AND, create_enode_constant(1),
+		create_enode_func(ENODE_IS_LEAF));
+	prog = compile_enode(expr);
+	if (NULL == prog) { perror(NULL); exit(EXIT_FAILURE); }
+	if (! enode_program_reads(prog, ENODE_COL_IS_LEAF) ||
+	    enode_program_reads(prog, ENODE_COL_DEPTH)) {
+		printf ("%s: '1 & l' should read 'l' (only).\n", test_name);
+		return 1;
+	}
+	destroy_enode_program(prog);
+	if (check_program(test_name, expr)) return 1;
+
+	printf("%s ok.\n", test_name);
+	return 0;
+}
+
 int main()
 {
 	int failures = 0;
@@ -538,6 +674,8 @@ int main()
 	failures += test_nb_ancestors();
 	failures += test_nb_descendants();
 	failures += test_nb_children();
+	failures += test_program();
+	failures += test_program_folding();
 	if (0 == failures) {
 		printf("All tests ok.\n");
 	} else {
@@ -0,0 +1,155 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "tree.h"
+#include "parser.h"
+#include "list.h"
+#include "label_filter.h"
+
+void newick_scanner_set_string_input(char *);
+void newick_scanner_clear_string_input();
+
+static struct rooted_tree *tree_from_string(char *newick)
+{
+	newick_scanner_set_string_input(newick);
+	struct rooted_tree *tree = parse_tree();
+	newick_scanner_clear_string_input();
+	return tree;
+}
+
+/* 'labels' is a NULL-terminated array */
+
+static struct label_filter *filter_from_labels(char **labels,
+		bool leaves_only)
+{
+	struct llist *list = create_llist();
+	for (; NULL != *labels; labels++)
+		append_element(list, *labels);
+	struct label_filter *filter = create_label_filter(list, leaves_only);
+	destroy_llist(list);
+	return filter;
+}
+
+/* Checks that 'filter' accepts (or not, depending on 'exp') 'newick' */
+
+static int check_accepts(const char *test_name, struct label_filter *filter,
+		char *newick, bool exp)
+{
+	struct rooted_tree *tree = tree_from_string(newick);
+	bool obt = label_filter_accepts(filter, tree);
+	destroy_tree(tree);
+
+	if (exp != obt) {
+		printf ("%s: '%s' should%s be accepted.\n", test_name, newick,
+				exp ? "" : " NOT");
+		return 1;
+	}
+	return 0;
+}
+
+int test_leaves_only()
+{
+	const char *test_name = __func__;
+	char *labels[] = {"A", "B", "C", "A", "", NULL};
+	struct label_filter *filter = filter_from_labels(labels, true);
+
+	if (3 != label_filter_count(filter)) {
+		printf ("%s: expected 3 distinct labels, got %d.\n", test_name,
+				label_filter_count(filter));
+		return 1;
+	}
+	if (check_accepts(test_name, filter, "((A,B),C);", true))
+		return 1;
+	if (check_accepts(test_name, filter, "((D,(C,E)),(B,(F,A)));", true))
+		return 1;
+	if (check_accepts(test_name, filter, "((A,B),D);", false))
+		return 1;
+	/* inner labels don't count */
+	if (check_accepts(test_name, filter, "((A,B)C,D);", false))
+		return 1;
+	/* a label seen twice still counts once */
+	if (check_accepts(test_name, filter, "((A,B),(A,D));", false))
+		return 1;
+	/* nothing carries over from one tree to the next */
+	if (check_accepts(test_name, filter, "(C,D);", false))
+		return 1;
+	if (check_accepts(test_name, filter, "(A,B);", false))
+		return 1;
+
+	destroy_label_filter(filter);
+	printf ("%s: ok.\n", test_name);
+	return 0;
+}
+
+int test_all_labels()
+{
+	const char *test_name = __func__;
+	char *labels[] = {"Homo", "Hominini", NULL};
+	struct label_filter *filter = filter_from_labels(labels, false);
+
+	if (check_accepts(test_name, filter, "((Pan,Homo)Hominini,Gorilla);",
+				true))
+		return 1;
+	if (check_accepts(test_name, filter, "((Pan,Homo),Gorilla);", false))
+		return 1;
+
+	destroy_label_filter(filter);
+	printf ("%s: ok.\n", test_name);
+	return 0;
+}
+
+/* Many labels, so that the Bloom filter is not trivially full */
+
+int test_many_labels()
+{
+	const char *test_name = __func__;
+	char *labels[1001];
+	char newick[20000];
+	char *p = newick;
+	int i;
+
+	for (i = 0; i < 1000; i++) {
+		labels[i] = malloc(10);
+		sprintf(labels[i], "L%d", i);
+	}
+	labels[1000] = NULL;
+	struct label_filter *filter = filter_from_labels(labels, true);
+
+	/* a tree with labels 0..999, plus as many other labels */
+	p += sprintf(p, "(");
+	for (i = 0; i < 2000; i++)
+		p += sprintf(p, "%s%c%d", i ? "," : "", i < 1000 ? 'L' : 'X',
+				i % 1000);
+	sprintf(p, ");");
+	if (check_accepts(test_name, filter, newick, true))
+		return 1;
+	/* L999 is missing */
+	strcpy(strstr(newick, ",L999,"), ",X0);");
+	if (check_accepts(test_name, filter, newick, false))
+		return 1;
+
+	destroy_label_filter(filter);
+	for (i = 0; i < 1000; i++)
+		free(labels[i]);
+	printf ("%s: ok.\n", test_name);
+	return 0;
+}
+
+int main()
+{
+	int failures = 0;
+	printf("Starting label filter test...\n");
+	failures += test_leaves_only();
+	failures += test_all_labels();
+	failures += test_many_labels();
+	if (0 == failures) {
+		printf("All tests ok.\n");
+	} else {
+		printf("%d test(s) FAILED.\n", failures);
+		return 1;
+	}
+
+	return 0;
+}
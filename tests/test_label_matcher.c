@@ -0,0 +1,92 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <regex.h>
+
+#include "label_matcher.h"
+
+/* Checks that the matcher agrees with regexec() on all labels, twice (the
+ * second time, results come from the cache, if any). */
+
+static int check_pattern(const char *test_name, char *regexp_string,
+		bool exp_literal)
+{
+	char *labels[] = {"", "Homo", "Homo_sapiens", "Pan", "HRV1B_1",
+		"POLIO1A", "xPOLIO", "a.b", "a*b", "Hom", NULL};
+	regex_t preg;
+	regcomp(&preg, regexp_string, 0);
+	struct label_matcher *matcher = create_label_matcher(regexp_string,
+			&preg, 10);
+	int pass, i;
+
+	if (exp_literal != label_matcher_is_literal(matcher)) {
+		printf ("%s: /%s/ should%s be treated as a literal.\n",
+			test_name, regexp_string, exp_literal ? "" : " NOT");
+		return 1;
+	}
+	for (pass = 0; pass < 2; pass++) {
+		for (i = 0; NULL != labels[i]; i++) {
+			bool exp = (0 == regexec(&preg, labels[i], 0, NULL, 0));
+			if (exp != label_matches(matcher, labels[i])) {
+				printf ("%s: /%s/ should%s match '%s'.\n",
+					test_name, regexp_string,
+					exp ? "" : " NOT", labels[i]);
+				return 1;
+			}
+		}
+	}
+
+	destroy_label_matcher(matcher);
+	regfree(&preg);
+	return 0;
+}
+
+int test_literals()
+{
+	const char *test_name = __func__;
+
+	if (check_pattern(test_name, "Homo", true)) return 1;
+	if (check_pattern(test_name, "^Homo", true)) return 1;
+	if (check_pattern(test_name, "Homo$", true)) return 1;
+	if (check_pattern(test_name, "^Homo$", true)) return 1;
+	if (check_pattern(test_name, "^POLIO.*", true)) return 1;
+	if (check_pattern(test_name, ".*POLIO", true)) return 1;
+	if (check_pattern(test_name, "^", true)) return 1;
+	if (check_pattern(test_name, ".*", true)) return 1;
+	/* '+' and '?' are not special in basic regexps */
+	if (check_pattern(test_name, "a+b", true)) return 1;
+
+	printf ("%s: ok.\n", test_name);
+	return 0;
+}
+
+int test_regexps()
+{
+	const char *test_name = __func__;
+
+	if (check_pattern(test_name, "a.b", false)) return 1;
+	if (check_pattern(test_name, "a\\.b", false)) return 1;
+	if (check_pattern(test_name, "a*b", false)) return 1;
+	if (check_pattern(test_name, "^H[RO]", false)) return 1;
+	if (check_pattern(test_name, "^Hom.*s$", false)) return 1;
+	if (check_pattern(test_name, "^HRV.*_1$", false)) return 1;
+
+	printf ("%s: ok.\n", test_name);
+	return 0;
+}
+
+int main()
+{
+	int failures = 0;
+	printf("Starting label matcher test...\n");
+	failures += test_literals();
+	failures += test_regexps();
+	if (0 == failures) {
+		printf("All tests ok.\n");
+	} else {
+		printf("%d test(s) FAILED.\n", failures);
+		return 1;
+	}
+
+	return 0;
+}
@@ -260,6 +260,76 @@ int test_lca_from_labels_multi()
 	return 0;
 }
 
+/* Checks the table against lca_from_numbered_nodes() on all pairs of nodes,
+ * and on a few larger sets. */
+
+int test_lca_from_table()
+{
+	const char *test_name = "test_lca_from_table";
+
+	struct rooted_tree tree = tree_2();	/* ((A,B)f,(C,(D,E)g)h)i; */
+	struct hash *map = create_label2node_map(tree.nodes_in_order);
+	struct lca_table *table = create_lca_table(tree.root);
+	struct llist *descendants;
+	struct list_elem *el1, *el2;
+	struct rnode *exp, *obt;
+
+	if (NULL == table) {
+		printf ("%s: could not create table.\n", test_name);
+		return 1;
+	}
+
+	for (el1 = tree.nodes_in_order->head; NULL != el1; el1 = el1->next)
+	for (el2 = tree.nodes_in_order->head; NULL != el2; el2 = el2->next) {
+		descendants = create_llist();
+		append_element(descendants, el1->data);
+		append_element(descendants, el2->data);
+		exp = lca_from_numbered_nodes(descendants);
+		obt = lca_from_table(table, descendants);
+		if (exp != obt) {
+			printf ("%s: expected node '%s' as LCA of '%s' and "
+				"'%s' (got '%s').\n", test_name, exp->label,
+				((struct rnode *) el1->data)->label,
+				((struct rnode *) el2->data)->label,
+				obt->label);
+			return 1;
+		}
+		destroy_llist(descendants);
+	}
+
+	descendants = create_llist();
+	append_element(descendants, hash_get(map, "E"));
+	append_element(descendants, hash_get(map, "C"));
+	append_element(descendants, hash_get(map, "D"));
+	obt = lca_from_table(table, descendants);
+	if (hash_get(map, "h") != obt) {
+		printf ("%s: expected node 'h' as LCA of 'E', 'C' and 'D' "
+				"(got '%s').\n", test_name, obt->label);
+		return 1;
+	}
+	append_element(descendants, hash_get(map, "B"));
+	obt = lca_from_table(table, descendants);
+	if (hash_get(map, "i") != obt) {
+		printf ("%s: expected node 'i' as LCA of 'E', 'C', 'D' and "
+				"'B' (got '%s').\n", test_name, obt->label);
+		return 1;
+	}
+	destroy_llist(descendants);
+
+	descendants = create_llist();
+	if (NULL != lca_from_table(table, descendants)) {
+		printf ("%s: expected NULL for an empty list.\n", test_name);
+		return 1;
+	}
+	destroy_llist(descendants);
+
+	destroy_lca_table(table);
+	destroy_hash(map);
+
+	printf("%s ok.\n", test_name);
+	return 0;
+}
+
 int main()
 {
 	int failures = 0;
@@ -268,6 +338,7 @@ int main()
 	failures += test_lca_from_labels();
 	failures += test_lca_from_labels_multi();
 	failures += test_lca_from_nodes();
+	failures += test_lca_from_table();
 	if (0 == failures) {
 		printf("All tests ok.\n");
 	} else {
@@ -1223,6 +1223,95 @@ int test_swap_nodes()
 	return 0;
 }
 
+/* Checks that the next_sibling and prev_sibling links of 'mum''s children are
+ * consistent with each other and with first_child, last_child and
+ * child_count. */
+
+static int check_sibling_links(const char *test_name, struct rnode *mum)
+{
+	struct rnode *kid, *prev = NULL;
+	int n = 0;
+
+	for (kid = mum->first_child; NULL != kid; kid = kid->next_sibling) {
+		if (kid->prev_sibling != prev) {
+			printf ("%s: wrong prev_sibling for %s.\n", test_name,
+					kid->label);
+			return 1;
+		}
+		n++;
+		prev = kid;
+		if (kid == mum->last_child) break;
+	}
+	if (prev != mum->last_child) {
+		printf ("%s: wrong last_child.\n", test_name);
+		return 1;
+	}
+	if (n != mum->child_count) {
+		printf ("%s: expected %d children, got %d.\n", test_name,
+				mum->child_count, n);
+		return 1;
+	}
+
+	return 0;
+}
+
+int test_polytomy()
+{
+	const char *test_name = __func__;
+	const int nb_kids = 1000;
+	struct rnode *mum = create_rnode("mum", "");
+	struct rnode *kids[nb_kids];
+	int i;
+
+	for (i = 0; i < nb_kids; i++) {
+		kids[i] = create_rnode("kid", "");
+		add_child(mum, kids[i]);
+	}
+	if (check_sibling_links(test_name, mum)) return 1;
+
+	/* remove every other kid, including the first one */
+	for (i = 0; i < nb_kids; i += 2)
+		if (UNLINK_RNODE_DONE != unlink_rnode(kids[i])) {
+			printf ("%s: could not unlink kid #%d.\n", test_name, i);
+			return 1;
+		}
+	if (check_sibling_links(test_name, mum)) return 1;
+	if (mum->first_child != kids[1] ||
+	    mum->last_child != kids[nb_kids - 1]) {
+		printf ("%s: wrong first or last child.\n", test_name);
+		return 1;
+	}
+
+	/* indexed insertion, near both ends */
+	if (! insert_child(mum, kids[0], 1) ||
+	    ! insert_child(mum, kids[2], mum->child_count - 1)) {
+		printf ("%s: insert_child() failed.\n", test_name);
+		return 1;
+	}
+	if (check_sibling_links(test_name, mum)) return 1;
+	if (kids[1]->next_sibling != kids[0] ||
+	    kids[2]->next_sibling != kids[nb_kids - 1]) {
+		printf ("%s: insert_child() inserted at wrong place.\n",
+				test_name);
+		return 1;
+	}
+	if (1 != remove_child(kids[0])) {
+		printf ("%s: remove_child() returned wrong index.\n",
+				test_name);
+		return 1;
+	}
+	int last_index = mum->child_count - 1;
+	if (last_index != remove_child(kids[nb_kids - 1])) {
+		printf ("%s: remove_child() returned wrong index.\n",
+				test_name);
+		return 1;
+	}
+	if (check_sibling_links(test_name, mum)) return 1;
+
+	printf("%s ok.\n", test_name);
+	return 0;
+}
+
 int main()
 {
 	int failures = 0;
@@ -1248,6 +1337,7 @@ int main()
 	failures += test_insert_remove_child_middle();
 	failures += test_insert_remove_child_tail();
 	failures += test_swap_nodes();
+	failures += test_polytomy();
 	// failures += test_is_stair();
 	if (0 == failures) {
 		printf("All tests ok.\n");
@@ -0,0 +1,223 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "map_index.h"
+
+static const char *MAP_FILENAME = "test_map_index.map";
+static const char *INDEX_FILENAME = "test_map_index.map.idx";
+
+static void write_map(const char *contents)
+{
+	FILE *map = fopen(MAP_FILENAME, "w");
+	fputs(contents, map);
+	fclose(map);
+}
+
+/* Checks that 'key' maps to 'exp' (NULL meaning no value) */
+
+static int check_value(const char *test_name, struct map_index *index,
+		const char *key, const char *exp)
+{
+	const char *obt = map_index_get(index, key);
+	if (NULL == exp && NULL == obt) return 0;
+	if (NULL == exp || NULL == obt || 0 != strcmp(exp, obt)) {
+		printf ("%s: expected '%s' -> '%s', got '%s'.\n", test_name,
+			key, NULL == exp ? "(none)" : exp,
+			NULL == obt ? "(none)" : obt);
+		return 1;
+	}
+	return 0;
+}
+
+int test_build()
+{
+	const char *test_name = __func__;
+
+	remove(INDEX_FILENAME);
+	write_map("# comment\n"
+		"HRV16 A\n"
+		"\n"
+		"HRV3\tB\n"
+		"hnr\n"
+		"HRV16 C\n");
+	struct map_index *index = open_map_index(MAP_FILENAME);
+	if (NULL == index) {
+		printf ("%s: could not build index.\n", test_name);
+		return 1;
+	}
+	if (3 != map_index_count(index)) {
+		printf ("%s: expected 3 keys, got %ld.\n", test_name,
+				map_index_count(index));
+		return 1;
+	}
+	/* later keys override earlier ones */
+	if (check_value(test_name, index, "HRV16", "C")) return 1;
+	if (check_value(test_name, index, "HRV3", "B")) return 1;
+	if (check_value(test_name, index, "hnr", "")) return 1;
+	if (check_value(test_name, index, "HRV", NULL)) return 1;
+	if (check_value(test_name, index, "#", NULL)) return 1;
+	close_map_index(index);
+
+	if (0 != access(INDEX_FILENAME, R_OK)) {
+		printf ("%s: index file was not written.\n", test_name);
+		return 1;
+	}
+
+	printf ("%s: ok.\n", test_name);
+	return 0;
+}
+
+int test_reuse()
+{
+	const char *test_name = __func__;
+
+	/* The index now exists: tamper with its values (but not its size),
+	 * and check that they are the ones we get - i.e. that the map was
+	 * not read again. */
+	FILE *idx = fopen(INDEX_FILENAME, "r+");
+	struct stat idx_stat;
+	stat(INDEX_FILENAME, &idx_stat);
+	/* The blob ends with "hnr\0\0HRV16\0C\0" */
+	fseek(idx, idx_stat.st_size - 2, SEEK_SET);
+	fputc('Z', idx);
+	fclose(idx);
+
+	struct map_index *index = open_map_index(MAP_FILENAME);
+	if (NULL == index) {
+		printf ("%s: could not open index.\n", test_name);
+		return 1;
+	}
+	if (check_value(test_name, index, "HRV3", "B")) return 1;
+	if (check_value(test_name, index, "HRV16", "Z")) return 1;
+	close_map_index(index);
+
+	printf ("%s: ok.\n", test_name);
+	return 0;
+}
+
+/* Overwrites 'length' bytes of the index at 'offset' with 'byte' */
+
+static void tamper(long offset, int byte, int length)
+{
+	FILE *idx = fopen(INDEX_FILENAME, "r+");
+	fseek(idx, offset, SEEK_SET);
+	while (length-- > 0)
+		fputc(byte, idx);
+	fclose(idx);
+}
+
+int test_corrupt()
+{
+	const char *test_name = __func__;
+
+	/* The slots (8 of them, for 3 keys) come right after the 56-byte
+	 * header. With these offsets they all point way past the blob. This
+	 * is only noticed by the first lookup (opening the index doesn't read
+	 * the slots), which must rebuild the index - undoing the 'Z' of
+	 * test_reuse() - rather than read outside of it. */
+	tamper(56, 0x7f, 8 * 24);
+	struct map_index *index = open_map_index(MAP_FILENAME);
+	if (NULL == index) {
+		printf ("%s: could not open index.\n", test_name);
+		return 1;
+	}
+	if (check_value(test_name, index, "HRV16", "C")) return 1;
+	if (check_value(test_name, index, "HRV3", "B")) return 1;
+	if (check_value(test_name, index, "HRV", NULL)) return 1;
+	if (map_index_failed(index)) {
+		printf ("%s: lookup failed.\n", test_name);
+		return 1;
+	}
+	close_map_index(index);
+
+	/* The rebuilt index was saved */
+	index = open_map_index(MAP_FILENAME);
+	if (NULL == index) {
+		printf ("%s: could not open index.\n", test_name);
+		return 1;
+	}
+	if (check_value(test_name, index, "HRV16", "C")) return 1;
+	close_map_index(index);
+
+	/* An index whose blob's last string is not terminated is rejected
+	 * when it is opened, and rebuilt */
+	struct stat idx_stat;
+	stat(INDEX_FILENAME, &idx_stat);
+	tamper(idx_stat.st_size - 1, 'Z', 1);
+	index = open_map_index(MAP_FILENAME);
+	if (NULL == index) {
+		printf ("%s: could not rebuild index.\n", test_name);
+		return 1;
+	}
+	if (check_value(test_name, index, "HRV16", "C")) return 1;
+	close_map_index(index);
+
+	/* A truncated index is rejected as well */
+	if (0 != truncate(INDEX_FILENAME, idx_stat.st_size - 1)) {
+		printf ("%s: could not truncate index.\n", test_name);
+		return 1;
+	}
+	index = open_map_index(MAP_FILENAME);
+	if (NULL == index) {
+		printf ("%s: could not rebuild index.\n", test_name);
+		return 1;
+	}
+	if (check_value(test_name, index, "HRV3", "B")) return 1;
+	close_map_index(index);
+
+	printf ("%s: ok.\n", test_name);
+	return 0;
+}
+
+int test_rebuild()
+{
+	const char *test_name = __func__;
+
+	/* A map of a different size invalidates the index */
+	write_map("HRV16 D\nHRV52 B\n");
+	struct map_index *index = open_map_index(MAP_FILENAME);
+	if (NULL == index) {
+		printf ("%s: could not rebuild index.\n", test_name);
+		return 1;
+	}
+	if (check_value(test_name, index, "HRV16", "D")) return 1;
+	if (check_value(test_name, index, "HRV52", "B")) return 1;
+	if (check_value(test_name, index, "HRV3", NULL)) return 1;
+	close_map_index(index);
+
+	/* An empty map is fine too */
+	write_map("");
+	index = open_map_index(MAP_FILENAME);
+	if (NULL == index || 0 != map_index_count(index) ||
+	    check_value(test_name, index, "HRV16", NULL)) {
+		printf ("%s: empty map not handled.\n", test_name);
+		return 1;
+	}
+	close_map_index(index);
+
+	remove(MAP_FILENAME);
+	remove(INDEX_FILENAME);
+	printf ("%s: ok.\n", test_name);
+	return 0;
+}
+
+int main()
+{
+	int failures = 0;
+	printf("Starting map index test...\n");
+	failures += test_build();
+	failures += test_reuse();
+	failures += test_corrupt();
+	failures += test_rebuild();
+	if (0 == failures) {
+		printf("All tests ok.\n");
+	} else {
+		printf("%d test(s) FAILED.\n", failures);
+		return 1;
+	}
+
+	return 0;
+}
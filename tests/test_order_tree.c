@@ -115,6 +115,45 @@ int test_order_deladderize()
 	return 0;
 }
 
+/* Checks that the linear-time orderings give the same trees as order_tree()
+ * does with the corresponding comparators, above. */
+
+int test_canned_order(const char *test_name, struct rooted_tree tree,
+		int (*order)(struct rooted_tree *), const char *exp_newick)
+{
+	if (! order(&tree)) {
+		printf ("%s: ordering failed.\n", test_name);
+		return 1;
+	}
+	char *obt_newick = to_newick(tree.root);
+
+	if (0 != strcmp(obt_newick, exp_newick)) {
+		printf ("%s: expected '%s', got '%s'.\n",
+			test_name, exp_newick,
+			obt_newick);
+		return 1;
+	}
+
+	printf("%s ok.\n", test_name);
+	return 0;
+}
+
+int test_order_canned()
+{
+	int failures = 0;
+	struct rooted_tree exp_tree = tree_14();
+
+	failures += test_canned_order("test_order_tree_lbl", tree_13(),
+		order_tree_lbl, "((Ant,Bee),((Cat,Dog),Eel));");
+	failures += test_canned_order("test_order_tree_num_desc", tree_15(),
+		order_tree_num_desc, to_newick(exp_tree.root));
+	failures += test_canned_order("test_order_tree_deladderize",
+		tree_15(), order_tree_deladderize,
+		"(Petromyzon,((Xenopus,((Equus,Homo)Mammalia,Columba)Amniota)Tetrapoda,Carcharodon)Gnathostomata)Vertebrata;");
+
+	return failures;
+}
+
 int main()
 {
 	int failures = 0;
@@ -122,6 +161,7 @@ int main()
 	failures += test_order();
 	failures += test_order_num_desc();
 	failures += test_order_deladderize();
+	failures += test_order_canned();
 	if (0 == failures) {
 		printf("All tests ok.\n");
 	} else {
@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <string.h>
+#include <stdlib.h>
 
 #include "rnode.h"
 #include "tree.h"
@@ -131,6 +132,43 @@ int test_static_rnode_vars_2()
 	return 0;
 }
 
+int test_disown_all_rnodes()
+{
+	const char *test_name = __func__;
+	struct rooted_tree tree_1, tree_2;
+	struct list_elem *el;
+
+	destroy_all_rnodes(NULL);
+	tree_1 = tree_8();
+	disown_all_rnodes();
+	if (0 != _get_rnode_count()) {
+		printf("%s: expected node count of 0, got %d.\n",
+				test_name, _get_rnode_count());
+		return 1;
+	}
+	/* tree_1's nodes are now ours, tree_2's are not. */
+	tree_2 = tree_8();
+	if (9 != _get_rnode_count()) {
+		printf("%s: expected node count of 9, got %d.\n",
+				test_name, _get_rnode_count());
+		return 1;
+	}
+	destroy_all_rnodes(NULL);
+	destroy_llist(tree_2.nodes_in_order);
+	/* tree_1 must have survived */
+	if (9 != tree_1.nodes_in_order->count
+		|| 0 != strcmp("HRV_A", tree_1.root->first_child->label)) {
+		printf("%s: disowned tree was freed.\n", test_name);
+		return 1;
+	}
+	for (el = tree_1.nodes_in_order->head; NULL != el; el = el->next)
+		destroy_rnode(el->data, NULL);
+	destroy_llist(tree_1.nodes_in_order);
+
+	printf("%s ok.\n", test_name);
+	return 0;
+}
+
 int test_create_rnode_nulllabel()
 {
 	const char *test_name = "test_create_rnode_nulllabel";
@@ -312,6 +350,55 @@ int test_create_rnode_emptylength()
 	return 0;
 }
 
+int test_get_nodes_in_order_array()
+{
+	const char *test_name = __func__;
+
+	/* (A:3,B:3,(C:2,(D:1,E:1)f:1)g:1)h; and
+	 * ((((Gorilla,(Pan,Homo)Hominini)Homininae)Hominidae)Hominoidea); */
+	struct rooted_tree trees[] = { tree_5(), tree_11() };
+	int t;
+
+	for (t = 0; t < 2; t++) {
+		struct llist *exp = get_nodes_in_order(trees[t].root);
+		int count;
+		struct rnode **obt = get_nodes_in_order_array(trees[t].root,
+				&count);
+		if (exp->count != count) {
+			printf ("%s: expected %d nodes, got %d.\n", test_name,
+					exp->count, count);
+			return 1;
+		}
+		struct list_elem *elem;
+		int i = 0;
+		for (elem = exp->head; NULL != elem; elem = elem->next, i++) {
+			if (elem->data != obt[i]) {
+				printf ("%s: expected node %s at position %d, "
+					"got %s.\n", test_name,
+					((struct rnode *) elem->data)->label,
+					i, obt[i]->label);
+				return 1;
+			}
+		}
+		free(obt);
+		destroy_llist(exp);
+	}
+
+	/* a subtree: (C:2,(D:1,E:1)f:1)g */
+	int count;
+	struct rnode **obt = get_nodes_in_order_array(
+			trees[0].root->last_child, &count);
+	if (5 != count || 5 != subtree_size(trees[0].root->last_child) ||
+			obt[4] != trees[0].root->last_child) {
+		printf ("%s: wrong subtree node array.\n", test_name);
+		return 1;
+	}
+	free(obt);
+
+	printf("%s ok.\n", test_name);
+	return 0;
+}
+
 int test_create_many()
 {
 	int i;
@@ -793,6 +880,67 @@ int test_clone_rnode_wkids()
 	return 0;
 }
 
+int test_edge_length()
+{
+	const char *test_name = __func__;
+
+	struct rnode *node = create_rnode("n", "0.10");
+	if (! has_edge_length(node)) {
+		printf("%s: node should have a length.\n", test_name);
+		return 1;
+	}
+	if (0.1 != node->edge_length) {
+		printf("%s: expected length 0.1, got %g\n", test_name,
+				node->edge_length);
+		return 1;
+	}
+	/* original text must be kept as is */
+	if (0 != strcmp("0.10", node->edge_length_as_string)) {
+		printf("%s: expected length text '0.10', got '%s'\n",
+				test_name, node->edge_length_as_string);
+		return 1;
+	}
+	/* exponents, signs, and longer mantissas */
+	set_edge_length_as_string(node, "-1.5e-3");
+	if (-0.0015 != node->edge_length) {
+		printf("%s: expected length -0.0015, got %g\n", test_name,
+				node->edge_length);
+		return 1;
+	}
+	set_edge_length_as_string(node, "0.12345678901234567890");
+	if (0.12345678901234567890 != node->edge_length) {
+		printf("%s: expected length 0.12345678901234567890, got %.20g\n",
+				test_name, node->edge_length);
+		return 1;
+	}
+	/* changing the value drops the original text */
+	set_edge_length(node, 0.25);
+	if (0 != strcmp("0.25", node->edge_length_as_string)) {
+		printf("%s: expected length text '0.25', got '%s'\n",
+				test_name, node->edge_length_as_string);
+		return 1;
+	}
+	unset_edge_length(node);
+	if (has_edge_length(node)) {
+		printf("%s: node should have no length.\n", test_name);
+		return 1;
+	}
+	if (0 != strcmp("", node->edge_length_as_string)) {
+		printf("%s: expected empty length text, got '%s'\n",
+				test_name, node->edge_length_as_string);
+		return 1;
+	}
+	/* a zero length is not an undefined one */
+	set_edge_length_as_string(node, "0");
+	if (! has_edge_length(node)) {
+		printf("%s: zero length should be defined.\n", test_name);
+		return 1;
+	}
+
+	printf("%s ok.\n", test_name);
+	return 0;
+}
+
 int main()
 {
 	int failures = 0;
@@ -800,6 +948,7 @@ int main()
 	failures += test_create_rnode();
 	failures += test_static_rnode_vars();
 	failures += test_static_rnode_vars_2();
+	failures += test_disown_all_rnodes();
 	failures += test_create_rnode_nulllabel();
 	failures += test_create_rnode_emptylabel();
 	failures += test_create_rnode_nulllength();
@@ -809,10 +958,12 @@ int main()
 	failures += test_get_nodes_in_order();
 	failures += test_get_nodes_in_order_linear();
 	failures += test_get_nodes_in_order_part_linear();
+	failures += test_get_nodes_in_order_array();
 	failures += test_create_many();
 	failures += test_children_array();
 	failures += test_clone_rnode();
 	failures += test_clone_rnode_wkids();
+	failures += test_edge_length();
 	if (0 == failures) {
 		printf("All tests ok.\n");
 	} else {
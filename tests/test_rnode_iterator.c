@@ -628,6 +628,118 @@ int test_iterator_sibling()
 	return 0;
 }
 
+/* Concatenates the labels of the nodes returned by a traversal of 'root' (and,
+ * if 'show_index' is true, their visit indexes). */
+
+static char *traversal_string(struct rnode *root, enum traversal_order order,
+		bool show_index)
+{
+	static char buf[1000];
+	struct rnode_traversal *trav = create_rnode_traversal(root, order);
+	struct rnode *node;
+	buf[0] = '\0';
+	while (NULL != (node = rnode_traversal_next(trav))) {
+		strcat(buf, node->label);
+		if (show_index)
+			sprintf(buf + strlen(buf), "%d",
+				rnode_traversal_visit_index(trav));
+	}
+	destroy_rnode_traversal(trav);
+	return buf;
+}
+
+int test_traversal()
+{
+	const char *test_name = __func__;
+
+	/* ((A:1,B:1.0)f:2.0,(C:1,(D:1,E:1)g:2)h:3)i; */
+	struct rooted_tree tree = tree_3();
+	char *exp, *obt;
+
+	exp = "ifABhCgDE";
+	obt = traversal_string(tree.root, TRAVERSAL_PREORDER, false);
+	if (0 != strcmp(exp, obt)) {
+		printf("%s: expected preorder '%s', got '%s'.\n", test_name,
+				exp, obt);
+		return 1;
+	}
+	exp = "ABfCDEghi";
+	obt = traversal_string(tree.root, TRAVERSAL_POSTORDER, false);
+	if (0 != strcmp(exp, obt)) {
+		printf("%s: expected postorder '%s', got '%s'.\n", test_name,
+				exp, obt);
+		return 1;
+	}
+	/* in postorder, all children have been visited */
+	exp = "A0B0f2C0D0E0g2h2i2";
+	obt = traversal_string(tree.root, TRAVERSAL_POSTORDER, true);
+	if (0 != strcmp(exp, obt)) {
+		printf("%s: expected postorder '%s', got '%s'.\n", test_name,
+				exp, obt);
+		return 1;
+	}
+	exp = "i0f0A0f1B0f2i1h0C0h1g0D0g1E0g2h2i2";
+	obt = traversal_string(tree.root, TRAVERSAL_EULER, true);
+	if (0 != strcmp(exp, obt)) {
+		printf("%s: expected Euler tour '%s', got '%s'.\n", test_name,
+				exp, obt);
+		return 1;
+	}
+	/* a leaf is a (trivial) tree, too */
+	struct hash *nodemap = create_label2node_map(tree.nodes_in_order);
+	struct rnode *node_D = hash_get(nodemap, "D");
+	exp = "D0";
+	obt = traversal_string(node_D, TRAVERSAL_EULER, true);
+	if (0 != strcmp(exp, obt)) {
+		printf("%s: expected Euler tour '%s', got '%s'.\n", test_name,
+				exp, obt);
+		return 1;
+	}
+
+	printf("%s ok.\n", test_name);
+	return 0;
+}
+
+/* Traversals keep no state in the nodes, so they can be nested. */
+
+int test_traversal_nested()
+{
+	const char *test_name = __func__;
+
+	/* ((A:1,B:1.0)f:2.0,(C:1,(D:1,E:1)g:2)h:3)i; */
+	struct rooted_tree tree = tree_3();
+	struct rnode_traversal *outer = create_rnode_traversal(tree.root,
+			TRAVERSAL_PREORDER);
+	struct rnode *node, *desc;
+	int count = 0;
+	char depths[20] = "";
+
+	while (NULL != (node = rnode_traversal_next(outer))) {
+		sprintf(depths + strlen(depths), "%d",
+				rnode_traversal_depth(outer));
+		struct rnode_traversal *inner = create_rnode_traversal(node,
+				TRAVERSAL_POSTORDER);
+		while (NULL != (desc = rnode_traversal_next(inner)))
+			count++;
+		destroy_rnode_traversal(inner);
+	}
+	destroy_rnode_traversal(outer);
+
+	/* sum of the sizes of all subtrees */
+	if (25 != count) {
+		printf("%s: expected 25 visits, got %d.\n", test_name, count);
+		return 1;
+	}
+	if (0 != strcmp("012212233", depths)) {
+		printf("%s: expected depths '012212233', got '%s'.\n",
+				test_name, depths);
+		return 1;
+	}
+
+	printf("%s ok.\n", test_name);
+	return 0;
+}
+
 int main()
 {
 	int failures = 0;
@@ -637,6 +749,8 @@ int main()
 	failures += test_iterator_leaf();
 	failures += test_iterator_repeat();
 	failures += test_iterator_sibling();
+	failures += test_traversal();
+	failures += test_traversal_nested();
 	if (0 == failures) {
 		printf("All tests ok.\n");
 	} else {
@@ -24,6 +24,7 @@ int test_is_monophyletic()
 	add_child(node_e, node_a);
 	add_child(node_e, node_d);
 
+	number_nodes(node_e);
 	append_element(descendants, node_c);
 
 	// TODO: test w/ empty list
@@ -76,11 +77,63 @@ int test_is_monophyletic()
 	return 0;
 }
 
+int test_numbering()
+{
+	const char *test_name = __func__;
+
+	struct rnode *node_a = create_rnode("a", NULL);
+	struct rnode *node_b = create_rnode("b", NULL);
+	struct rnode *node_c = create_rnode("", NULL);
+	struct rnode *node_d = create_rnode("d", NULL);
+	struct rnode *node_e = create_rnode("", NULL);
+	struct rnode *node_f = create_rnode("", NULL);
+	struct rnode *node_g = create_rnode("g", NULL);
+
+	/* ((a,b,),(d))g; - with an unlabeled leaf and a knee */
+	add_child(node_e, node_a);
+	add_child(node_e, node_b);
+	add_child(node_e, node_c);
+	add_child(node_f, node_d);
+	add_child(node_g, node_e);
+	add_child(node_g, node_f);
+
+	number_nodes(node_g);
+
+	if (! is_in_subtree(node_a, node_e) || ! is_in_subtree(node_e, node_e)
+	    || ! is_in_subtree(node_d, node_g)) {
+		printf ("%s: missed a descendant.\n", test_name);
+		return 1;
+	}
+	if (is_in_subtree(node_d, node_e) || is_in_subtree(node_g, node_f)
+	    || is_in_subtree(node_e, node_a)) {
+		printf ("%s: found a non-descendant.\n", test_name);
+		return 1;
+	}
+	if (2 != labeled_leaf_count(node_e) ||
+	    1 != labeled_leaf_count(node_f) ||
+	    3 != labeled_leaf_count(node_g) ||
+	    0 != labeled_leaf_count(node_c)) {
+		printf ("%s: wrong labeled leaf counts.\n", test_name);
+		return 1;
+	}
+
+	/* an unnumbered node is in no subtree */
+	struct rnode *node_h = create_rnode("h", NULL);
+	if (is_in_subtree(node_h, node_g)) {
+		printf ("%s: unnumbered node found in tree.\n", test_name);
+		return 1;
+	}
+
+	printf("%s ok.\n", test_name);
+	return 0;
+}
+
 int main()
 {
 	int failures = 0;
 	printf("Starting canvas test...\n");
 	failures += test_is_monophyletic();
+	failures += test_numbering();
 	if (0 == failures) {
 		printf("All tests ok.\n");
 	} else {
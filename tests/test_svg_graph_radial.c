@@ -96,6 +96,29 @@ unsigned int test_transform_ornaments()
 		return 1;
 	}
 
+	/* same ornament, other node: reuses the parsed ornament */
+	const char *exp_9 = "<circle r=\"2\" transform=\"translate(-5,20) rotate(60)\"/>";
+	const char *out_9 = xml_transform_ornaments(case_1, 60.0, -5.0, 20.0);
+
+	if (strcmp(out_9, exp_9) != 0) {
+		printf ("%s: expected '%s', got '%s'\n", test_name, exp_9,
+				out_9);
+		return 1;
+	}
+
+	/* text that looks like the marks used internally */
+	const char *case_10 = "<text>@NW_TRANSFORM@</text>";
+	const char *exp_10 = "<text transform=\"translate(10,10) rotate(45)\""
+				" y=\"-3\" style=\"text-anchor:end\">"
+				"@NW_TRANSFORM@</text>";
+	const char *out_10 = xml_transform_ornaments(case_10, 45.0, 10.0, 10.0);
+
+	if (strcmp(out_10, exp_10) != 0) {
+		printf ("%s: expected '%s', got '%s'\n", test_name, exp_10,
+				out_10);
+		return 1;
+	}
+
 	printf("%s ok.\n", test_name);
 
 	return 0;
@@ -756,6 +756,173 @@ int test_clone_tree_cond()
 
 }
 
+/* Checks that 'tree''s node list is what get_nodes_in_order() would return */
+
+static int check_nodes_in_order(const char *test_name, struct rooted_tree *tree)
+{
+	struct llist *exp = get_nodes_in_order(tree->root);
+	struct list_elem *exp_el = exp->head;
+	struct list_elem *obt_el = tree->nodes_in_order->head;
+
+	for (; NULL != exp_el; exp_el = exp_el->next, obt_el = obt_el->next) {
+		if (NULL == obt_el) {
+			printf ("%s: node list is too short.\n", test_name);
+			return 1;
+		}
+		if (exp_el->data != obt_el->data) {
+			printf ("%s: expected node '%s', got '%s'.\n",
+				test_name,
+				((struct rnode *) exp_el->data)->label,
+				((struct rnode *) obt_el->data)->label);
+			return 1;
+		}
+	}
+	if (NULL != obt_el) {
+		printf ("%s: node list is too long.\n", test_name);
+		return 1;
+	}
+	if (exp->count != tree->nodes_in_order->count ||
+	    tree->nodes_in_order->tail->data != tree->root) {
+		printf ("%s: wrong node list count or tail.\n", test_name);
+		return 1;
+	}
+	destroy_llist(exp);
+
+	return 0;
+}
+
+/* Checks that each node in the tree's node list points to its element. */
+
+static int check_order_links(const char *test_name, struct rooted_tree *tree)
+{
+	struct list_elem **link = &(tree->nodes_in_order->head);
+	for (; NULL != *link; link = &((*link)->next)) {
+		struct rnode *node = (*link)->data;
+		if (node->order_link != link) {
+			printf ("%s: node '%s' has a wrong order link.\n",
+				test_name, node->label);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+int test_edit_in_tree()
+{
+	const char *test_name = __func__;
+	struct rooted_tree tree = tree_3();	/* ((A:1,B:1.0)f:2.0,(C:1,(D:1,E:1)g:2)h:3)i; */
+	struct hash *map = create_label2node_map(tree.nodes_in_order);	
+	const char *exp;
+	char *obt;
+
+	/* untracked nodes are refused */
+	if (splice_out_rnode_in_tree(&tree, hash_get(map, "f"))) {
+		printf ("%s: untracked node was spliced out.\n", test_name);
+		return 1;
+	}
+	track_nodes_in_order(&tree);
+	if (check_order_links(test_name, &tree)) return 1;
+
+	/* g is left with one child and gets spliced out */
+	if (UNLINK_RNODE_DONE != unlink_rnode_in_tree(&tree,
+				hash_get(map, "D"))) {
+		printf ("%s: unlink_rnode_in_tree() failed.\n", test_name);
+		return 1;
+	}
+	if (check_nodes_in_order(test_name, &tree)) return 1;
+	if (check_order_links(test_name, &tree)) return 1;
+
+	if (! insert_node_above_in_tree(&tree, hash_get(map, "C"), "x")) {
+		printf ("%s: insert_node_above_in_tree() failed.\n", test_name);
+		return 1;
+	}
+	if (check_nodes_in_order(test_name, &tree)) return 1;
+	if (check_order_links(test_name, &tree)) return 1;
+
+	if (! splice_out_rnode_in_tree(&tree, hash_get(map, "f"))) {
+		printf ("%s: splice_out_rnode_in_tree() failed.\n", test_name);
+		return 1;
+	}
+	if (check_nodes_in_order(test_name, &tree)) return 1;
+	if (check_order_links(test_name, &tree)) return 1;
+
+	/* removes a whole subtree: (A:3,B:3)i; */
+	if (UNLINK_RNODE_DONE != unlink_rnode_in_tree(&tree,
+				hash_get(map, "h"))) {
+		printf ("%s: unlink_rnode_in_tree() failed.\n", test_name);
+		return 1;
+	}
+	if (check_nodes_in_order(test_name, &tree)) return 1;
+	if (check_order_links(test_name, &tree)) return 1;
+
+	/* the root is left with one child, which becomes the new root */
+	if (UNLINK_RNODE_DONE != unlink_rnode_in_tree(&tree,
+				hash_get(map, "A"))) {
+		printf ("%s: unlink_rnode_in_tree() failed.\n", test_name);
+		return 1;
+	}
+	if (check_nodes_in_order(test_name, &tree)) return 1;
+	if (check_order_links(test_name, &tree)) return 1;
+
+	exp = "B:3;";
+	obt = to_newick(tree.root);
+	if (strcmp (exp, obt) != 0) {
+		printf ("%s: expected '%s', got '%s'.\n", test_name, exp, obt);
+		return 1;
+	}
+	free(obt);
+	destroy_hash(map);
+
+	printf ("%s: ok.\n", test_name);
+	return 0;
+}
+
+static bool drop_labels_in_string(struct rnode *node, void *param)
+{
+	return ('\0' != node->label[0] &&
+		NULL != strstr((char *) param, node->label));
+}
+
+int test_prune_tree()
+{
+	const char *test_name = __func__;
+	/* ((A:1,B:1.0)f:2.0,(C:1,(D:1,E:1)g:2)h:3)i; */
+	struct rooted_tree tree = tree_3();
+	const char *exp;
+	char *obt;
+
+	/* g is emptied and removed, then h is spliced out */
+	if (! prune_tree(&tree, drop_labels_in_string, "D E")) {
+		printf ("%s: prune_tree() failed.\n", test_name);
+		return 1;
+	}
+	exp = "((A:1,B:1.0)f:2.0,C:4)i;";
+	obt = to_newick(tree.root);
+	if (strcmp (exp, obt) != 0) {
+		printf ("%s: expected '%s', got '%s'.\n", test_name, exp, obt);
+		return 1;
+	}
+	free(obt);
+	if (check_nodes_in_order(test_name, &tree)) return 1;
+
+	/* the root is left with one child, which becomes the new root */
+	if (! prune_tree(&tree, drop_labels_in_string, "C")) {
+		printf ("%s: prune_tree() failed.\n", test_name);
+		return 1;
+	}
+	exp = "(A:1,B:1.0)f:2;";
+	obt = to_newick(tree.root);
+	if (strcmp (exp, obt) != 0) {
+		printf ("%s: expected '%s', got '%s'.\n", test_name, exp, obt);
+		return 1;
+	}
+	free(obt);
+	if (check_nodes_in_order(test_name, &tree)) return 1;
+
+	printf ("%s: ok.\n", test_name);
+	return 0;
+}
+
 int main()
 {
 	int failures = 0;
@@ -776,6 +943,8 @@ int main()
 	failures += test_clone_tree_result();
 	failures += test_clone_tree_original();
 	failures += test_clone_tree_cond();
+	failures += test_edit_in_tree();
+	failures += test_prune_tree();
 	if (0 == failures) {
 		printf("All tests ok.\n");
 	} else {
@@ -1,11 +1,13 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h> 
+#include <string.h>
 
 #include "rnode.h"
 #include "list.h"
 #include "link.h"
 #include "tree_models.h"
+#include "prng.h"
 
 #define TOLERANCE 0.000001
 
@@ -68,12 +70,141 @@ int test_tlt_grow_node()
 	return 0;
 }
 	
+int test_prng()
+{
+	const char *test_name = "test_prng";
+	struct prng prng;
+	/* reference values computed independently from the published
+	 * algorithms */
+	uint64_t exp[] = { 0x3aacf10d660083ecULL, 0x6a3d14ba431e2fd9ULL,
+		0x1ff848c9b3bf407cULL };
+	int i;
+
+	prng_seed(&prng, 42, 3);
+	for (i = 0; i < 3; i++) {
+		uint64_t obt = prng_next(&prng);
+		if (exp[i] != obt) {
+			printf ("%s: expected %llx, got %llx\n", test_name,
+				(unsigned long long) exp[i],
+				(unsigned long long) obt);
+			return 1;
+		}
+	}
+	for (i = 0; i < 1000; i++) {
+		double u = prng_uniform(&prng);
+		if (u < 0 || u >= 1) {
+			printf ("%s: uniform value %g out of range\n",
+					test_name, u);
+			return 1;
+		}
+		if (prng_below(&prng, 7) >= 7) {
+			printf ("%s: prng_below() out of range\n", test_name);
+			return 1;
+		}
+	}
+
+	printf("%s ok.\n", test_name);
+	return 0;
+}
+
+int test_random_composition()
+{
+	const char *test_name = "test_random_composition";
+	struct prng prng;
+	long parts[10];
+	/* both the small-n and the large-n cases */
+	long sizes[] = { 3, 10, 11, 20, 1000000 };
+	int ks[] = { 2, 3, 5, 10 };
+	int i, j, r, p;
+
+	prng_seed(&prng, 1, 0);
+	for (i = 0; i < 5; i++)
+		for (j = 0; j < 4; j++) {
+			if (ks[j] >= sizes[i]) continue;
+			for (r = 0; r < 100; r++) {
+				long sum = 0;
+				_random_composition(&prng, sizes[i], ks[j],
+						parts);
+				for (p = 0; p < ks[j]; p++) {
+					if (parts[p] < 1) {
+						printf ("%s: part < 1\n",
+							test_name);
+						return 1;
+					}
+					sum += parts[p];
+				}
+				if (sum != sizes[i]) {
+					printf ("%s: expected sum %ld, got "
+						"%ld\n", test_name, sizes[i],
+						sum);
+					return 1;
+				}
+			}
+		}
+
+	printf("%s ok.\n", test_name);
+	return 0;
+}
+
+static int check_exact_size_tree(const char *test_name,
+		struct exact_size_params *params, const char *exp)
+{
+	struct prng prng;
+	char *obt = NULL;
+	size_t len;
+	FILE *out = open_memstream(&obt, &len);
+
+	prng_seed(&prng, 1, 0);
+	if (! exact_size_tree(out, params, &prng)) {
+		printf ("%s: exact_size_tree() failed\n", test_name);
+		return 1;
+	}
+	fclose(out);
+	if (0 != strcmp(exp, obt)) {
+		printf ("%s: expected '%s', got '%s'\n", test_name, exp, obt);
+		return 1;
+	}
+	free(obt);
+	return 0;
+}
+
+int test_exact_size_tree()
+{
+	const char *test_name = "test_exact_size_tree";
+	struct exact_size_params params;
+
+	params.nb_leaves = 5;
+	params.model = BALANCED_TREE;
+	if (check_exact_size_tree(test_name, &params,
+			"(((n1,n2),n3),(n4,n5));\n"))
+		return 1;
+	params.model = CATERPILLAR_TREE;
+	if (check_exact_size_tree(test_name, &params,
+			"(n1,(n2,(n3,(n4,n5))));\n"))
+		return 1;
+	/* a polytomy of degree >= the number of leaves is a fan */
+	params.model = POLYTOMY_TREE;
+	params.degree = 5;
+	if (check_exact_size_tree(test_name, &params,
+			"(n1,n2,n3,n4,n5);\n"))
+		return 1;
+	params.nb_leaves = 1;
+	if (check_exact_size_tree(test_name, &params, "n1;\n"))
+		return 1;
+
+	printf("%s ok.\n", test_name);
+	return 0;
+}
+
 int main()
 {
 	int failures = 0;
 	printf("Starting tree generation models test...\n");
 	failures += test_reciprocal_exponential_CDF();
 	failures += test_tlt_grow_node();
+	failures += test_prng();
+	failures += test_random_composition();
+	failures += test_exact_size_tree();
 	if (0 == failures) {
 		printf("All tests ok.\n");
 	} else {